@@ -91,6 +91,7 @@ LOCAL_SRC_FILES := \
 	src/dbextension.cpp \
 	src/dvrstream.cpp \
 	src/hdhr.cpp \
+	src/metrics.cpp \
 	src/pvr.cpp \
 	src/scheduler.cpp \
 	src/sqlite_exception.cpp
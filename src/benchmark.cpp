@@ -0,0 +1,886 @@
+//---------------------------------------------------------------------------
+// Copyright (c) 2018 Michael G. Brehm
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <version.h>
+
+#include "database.h"
+#include "dvrstream.h"
+#include "metrics.h"
+#include "string_exception.h"
+
+#pragma warning(push, 4)
+
+//---------------------------------------------------------------------------
+// CONSTANTS
+//---------------------------------------------------------------------------
+
+// BENCHMARK_CHANNELS
+//
+// Number of channels in the generated lineup
+static int const BENCHMARK_CHANNELS = 500;
+
+// BENCHMARK_EPISODES
+//
+// Number of scheduled episodes generated for each recording rule
+static int const BENCHMARK_EPISODES = 20;
+
+// BENCHMARK_GUIDEHOURS
+//
+// Number of hours of half-hour guide entries generated for each channel
+static int const BENCHMARK_GUIDEHOURS = 72;
+
+// BENCHMARK_RECORDINGRULES
+//
+// Number of recording rules in the generated database
+static int const BENCHMARK_RECORDINGRULES = 200;
+
+// BENCHMARK_RECORDINGS
+//
+// Number of recordings in the generated storage device data
+static int const BENCHMARK_RECORDINGS = 2000;
+
+// BENCHMARK_STREAM_PACKETS
+//
+// Number of mpeg-ts packets in the replayed stream (~256MiB)
+static long long const BENCHMARK_STREAM_PACKETS = 1427800;
+
+// MPEGTS_PACKET_LENGTH
+//
+// Length of a single mpeg-ts data packet
+static size_t const MPEGTS_PACKET_LENGTH = 188;
+
+// PACKETS_PER_SECOND
+//
+// Rate of the replayed stream, in packets per second (~19.39Mbps)
+static long long const PACKETS_PER_SECOND = 12894;
+
+// SCAN_BATCH_SIZE
+//
+// Number of packets scanned with a single call to scan_packets(), matches dvrstream
+static size_t const SCAN_BATCH_SIZE = 64;
+
+//---------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//---------------------------------------------------------------------------
+
+static void generate_packet(long long index, uint8_t* packet);
+static void report(char const* name, size_t operations, std::chrono::steady_clock::duration elapsed);
+static void report(char const* name, size_t operations, std::chrono::steady_clock::duration elapsed, long long bytes);
+
+//---------------------------------------------------------------------------
+// Class replayserver
+//
+// Implements a minimal HTTP/1.1 server on the loopback interface that replays the
+// synthetic benchmark stream with byte range support, along with a set of static
+// JSON documents that honor conditional (If-None-Match) requests
+
+class replayserver
+{
+public:
+
+	// Instance Constructor
+	//
+	replayserver(long long packets);
+
+	// Destructor
+	//
+	~replayserver();
+
+	//-----------------------------------------------------------------------
+	// Member Functions
+
+	// add_document
+	//
+	// Adds a static document to be served by the replay server
+	void add_document(char const* path, std::string const& content);
+
+	// url
+	//
+	// Generates the URL to access a path on the replay server
+	std::string url(char const* path) const;
+
+private:
+
+	replayserver(replayserver const&)=delete;
+	replayserver& operator=(replayserver const&)=delete;
+
+	//-----------------------------------------------------------------------
+	// Private Member Functions
+
+	// accept_connections
+	//
+	// Listener thread entry point
+	void accept_connections(void);
+
+	// send_data (static)
+	//
+	// Sends all of the provided data to a connected socket
+	static bool send_data(int socket, void const* data, size_t length);
+
+	// send_stream
+	//
+	// Sends a range of the synthetic benchmark stream to a connected socket
+	void send_stream(int socket, char const* request);
+
+	// serve_connection
+	//
+	// Connection thread entry point
+	void serve_connection(int socket);
+
+	//-----------------------------------------------------------------------
+	// Member Variables
+
+	long long const							m_length;			// Length of the replayed stream
+	int										m_listener = -1;	// Listening socket
+	unsigned short							m_port = 0;			// Listening port number
+	std::thread								m_acceptor;			// Listener thread
+	mutable std::mutex						m_lock;				// Synchronization object
+	std::map<std::string, std::string>		m_documents;		// Static documents
+	std::list<std::thread>					m_connections;		// Connection threads
+	std::set<int>							m_sockets;			// Connected sockets
+	std::atomic<bool>						m_stop{false};		// Flag to stop the server
+};
+
+//---------------------------------------------------------------------------
+// replayserver Constructor
+//
+// Arguments:
+//
+//	packets		- Number of mpeg-ts packets in the replayed stream
+
+replayserver::replayserver(long long packets) : m_length(packets * static_cast<long long>(MPEGTS_PACKET_LENGTH))
+{
+	struct sockaddr_in		address = {};			// Listener address
+	socklen_t				length = sizeof(address);
+
+	m_listener = socket(AF_INET, SOCK_STREAM, 0);
+	if(m_listener < 0) throw string_exception(__func__, ": socket() failed: ", strerror(errno));
+
+	// Bind the listener to an ephemeral port on the loopback interface
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+
+	if((bind(m_listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) || (listen(m_listener, 64) != 0) ||
+		(getsockname(m_listener, reinterpret_cast<struct sockaddr*>(&address), &length) != 0)) {
+
+		int error = errno;
+		::close(m_listener);
+		throw string_exception(__func__, ": unable to create listening socket: ", strerror(error));
+	}
+
+	m_port = ntohs(address.sin_port);
+	m_acceptor = std::thread(&replayserver::accept_connections, this);
+}
+
+//---------------------------------------------------------------------------
+// replayserver Destructor
+
+replayserver::~replayserver()
+{
+	m_stop = true;
+
+	// Shutting down the listening socket will cause accept() to fail
+	shutdown(m_listener, SHUT_RDWR);
+	if(m_acceptor.joinable()) m_acceptor.join();
+	::close(m_listener);
+
+	// Force any connections that remain open to close
+	std::unique_lock<std::mutex> lock(m_lock);
+	for(auto const& iterator : m_sockets) shutdown(iterator, SHUT_RDWR);
+	lock.unlock();
+
+	for(auto& iterator : m_connections) iterator.join();
+}
+
+//---------------------------------------------------------------------------
+// replayserver::accept_connections (private)
+//
+// Listener thread entry point
+//
+// Arguments:
+//
+//	NONE
+
+void replayserver::accept_connections(void)
+{
+	while(!m_stop) {
+
+		int connection = accept(m_listener, nullptr, nullptr);
+		if(connection < 0) { if(errno == EINTR) continue; else break; }
+
+		std::unique_lock<std::mutex> lock(m_lock);
+
+		if(m_stop) { ::close(connection); break; }
+
+		m_sockets.insert(connection);
+		m_connections.emplace_back(&replayserver::serve_connection, this, connection);
+	}
+}
+
+//---------------------------------------------------------------------------
+// replayserver::add_document
+//
+// Adds a static document to be served by the replay server
+//
+// Arguments:
+//
+//	path		- Path of the document, without any query string
+//	content		- Content of the document
+
+void replayserver::add_document(char const* path, std::string const& content)
+{
+	if(path == nullptr) throw std::invalid_argument("path");
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_documents[path] = content;
+}
+
+//---------------------------------------------------------------------------
+// replayserver::send_data (static, private)
+//
+// Sends all of the provided data to a connected socket
+//
+// Arguments:
+//
+//	socket		- Connected socket
+//	data		- Data to be sent
+//	length		- Length of the data to be sent
+
+bool replayserver::send_data(int socket, void const* data, size_t length)
+{
+	uint8_t const* current = reinterpret_cast<uint8_t const*>(data);
+
+	while(length > 0) {
+
+		ssize_t sent = send(socket, current, length, MSG_NOSIGNAL);
+		if(sent < 0) { if(errno == EINTR) continue; else return false; }
+
+		current += sent;
+		length -= static_cast<size_t>(sent);
+	}
+
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// replayserver::send_stream (private)
+//
+// Sends a range of the synthetic benchmark stream to a connected socket
+//
+// Arguments:
+//
+//	socket		- Connected socket
+//	request		- Request headers
+
+void replayserver::send_stream(int socket, char const* request)
+{
+	uint8_t				chunk[MPEGTS_PACKET_LENGTH * 256];	// Generated stream data
+	char				headers[512];						// Response headers
+	long long			start = 0;							// Range start position
+	long long			end = m_length - 1;					// Range end position
+
+	// Range: bytes=<range-start>-[<range-end>]
+	char const* range = strstr(request, "\r\nRange: bytes=");
+	if(range != nullptr) {
+
+		if(sscanf(range, "\r\nRange: bytes=%lld-%lld", &start, &end) < 1) start = 0;
+		end = std::min(end, m_length - 1);
+
+		// A range that starts at or beyond the end of the stream cannot be satisfied
+		if(start >= m_length) {
+
+			int length = snprintf(headers, std::extent<decltype(headers)>::value, "HTTP/1.1 416 Range Not Satisfiable\r\n"
+				"Accept-Ranges: bytes\r\nContent-Range: bytes */%lld\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", m_length);
+			send_data(socket, headers, static_cast<size_t>(length));
+			return;
+		}
+	}
+
+	int length = (range != nullptr) ?
+		snprintf(headers, std::extent<decltype(headers)>::value, "HTTP/1.1 206 Partial Content\r\nContent-Type: video/mp2t\r\nAccept-Ranges: bytes\r\n"
+			"Content-Range: bytes %lld-%lld/%lld\r\nContent-Length: %lld\r\nConnection: close\r\n\r\n", start, end, m_length, (end - start) + 1) :
+		snprintf(headers, std::extent<decltype(headers)>::value, "HTTP/1.1 200 OK\r\nContent-Type: video/mp2t\r\nAccept-Ranges: bytes\r\n"
+			"Content-Length: %lld\r\nConnection: close\r\n\r\n", m_length);
+	if(!send_data(socket, headers, static_cast<size_t>(length))) return;
+
+	// Generate and send the stream data in chunks; the range may not be aligned to a packet
+	long long position = start;
+	while((position <= end) && (!m_stop)) {
+
+		long long first = position / static_cast<long long>(MPEGTS_PACKET_LENGTH);
+		for(size_t index = 0; index < 256; index++) generate_packet(first + static_cast<long long>(index), &chunk[index * MPEGTS_PACKET_LENGTH]);
+
+		size_t offset = static_cast<size_t>(position % static_cast<long long>(MPEGTS_PACKET_LENGTH));
+		size_t count = static_cast<size_t>(std::min(static_cast<long long>(sizeof(chunk) - offset), (end - position) + 1));
+
+		if(!send_data(socket, &chunk[offset], count)) return;
+		position += static_cast<long long>(count);
+	}
+}
+
+//---------------------------------------------------------------------------
+// replayserver::serve_connection (private)
+//
+// Connection thread entry point
+//
+// Arguments:
+//
+//	socket		- Connected socket
+
+void replayserver::serve_connection(int socket)
+{
+	char		request[8192];				// Request headers
+	char		path[1024];					// Requested path
+	size_t		received = 0;				// Bytes of request data received
+
+	// Receive the request headers, only a single request is handled on each connection
+	while(received < (sizeof(request) - 1)) {
+
+		ssize_t result = recv(socket, &request[received], sizeof(request) - 1 - received, 0);
+		if(result <= 0) break;
+
+		received += static_cast<size_t>(result);
+		request[received] = '\0';
+		if(strstr(request, "\r\n\r\n") != nullptr) break;
+	}
+
+	request[received] = '\0';
+
+	if(sscanf(request, "GET %1023s HTTP/", path) == 1) {
+
+		// The query string is not used to locate the requested resource
+		char* query = strchr(path, '?');
+		if(query != nullptr) *query = '\0';
+
+		if(strcmp(path, "/stream.ts") == 0) send_stream(socket, request);
+
+		else {
+
+			std::unique_lock<std::mutex> lock(m_lock);
+			auto found = m_documents.find(path);
+			std::string content = (found != m_documents.end()) ? found->second : std::string();
+			bool exists = (found != m_documents.end());
+			lock.unlock();
+
+			char headers[512];
+			char etag[32];
+			snprintf(etag, std::extent<decltype(etag)>::value, "\"%zx\"", std::hash<std::string>()(content));
+
+			// Conditional requests that match the ETag of the document are not modified
+			char const* match = strstr(request, "\r\nIf-None-Match: ");
+			bool notmodified = (exists) && (match != nullptr) && (strncmp(match + 17, etag, strlen(etag)) == 0);
+
+			int length = (!exists) ? snprintf(headers, std::extent<decltype(headers)>::value, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n") :
+				(notmodified) ? snprintf(headers, std::extent<decltype(headers)>::value, "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: close\r\n\r\n", etag) :
+				snprintf(headers, std::extent<decltype(headers)>::value, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nETag: %s\r\n"
+					"Content-Length: %zu\r\nConnection: close\r\n\r\n", etag, content.size());
+
+			if(send_data(socket, headers, static_cast<size_t>(length)) && (exists) && (!notmodified)) send_data(socket, content.data(), content.size());
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_sockets.erase(socket);
+	::close(socket);
+}
+
+//---------------------------------------------------------------------------
+// replayserver::url
+//
+// Generates the URL to access a path on the replay server
+//
+// Arguments:
+//
+//	path		- Path to the resource
+
+std::string replayserver::url(char const* path) const
+{
+	return "http://127.0.0.1:" + std::to_string(m_port) + ((path != nullptr) ? path : "/");
+}
+
+//---------------------------------------------------------------------------
+// Class benchmark
+//
+// Implements the individual benchmarks; declared as a friend of dvrstream to
+// allow the packet filter to be exercised directly
+
+class benchmark
+{
+public:
+
+	//-----------------------------------------------------------------------
+	// Member Functions
+
+	// database (static)
+	//
+	// Benchmarks discovery and enumeration against a generated database
+	static void database(replayserver& server);
+
+	// filter (static)
+	//
+	// Benchmarks the transport stream packet filter against synthetic packets
+	static void filter(replayserver& server);
+
+	// scan (static)
+	//
+	// Benchmarks the SIMD and scalar packet header scanning implementations
+	static void scan(void);
+
+	// stream (static)
+	//
+	// Benchmarks dvrstream transfers from the replay server
+	static void stream(replayserver& server);
+
+private:
+
+	benchmark()=delete;
+};
+
+//---------------------------------------------------------------------------
+// benchmark::database (static)
+//
+// Benchmarks discovery and enumeration against a generated database
+//
+// Arguments:
+//
+//	server		- Replay server instance
+
+void benchmark::database(replayserver& server)
+{
+	char		path[64];					// Database file path
+	std::string	lineup = "[";				// Generated lineup document
+	std::string	recordings = "[";			// Generated recordings document
+	size_t		count = 0;					// Enumerated item count
+
+	time_t now = time(nullptr);
+
+	// Generate the lineup document for the tuner device, every channel is on its own subchannel
+	for(int index = 0; index < BENCHMARK_CHANNELS; index++) {
+
+		char channel[512];
+		snprintf(channel, std::extent<decltype(channel)>::value, "%s{\"GuideNumber\":\"%d.%d\",\"GuideName\":\"BENCH%d\",\"URL\":\"%s\",\"HD\":%d,\"Favorite\":%d}",
+			(index == 0) ? "" : ",", 2 + (index / 10), 1 + (index % 10), index, server.url("/stream.ts").c_str(), index % 2, ((index % 25) == 0) ? 1 : 0);
+		lineup.append(channel);
+	}
+
+	// Generate the recordings document for the storage device, each recording rule has multiple recordings
+	for(int index = 0; index < BENCHMARK_RECORDINGS; index++) {
+
+		char recording[1024];
+		long long recordstart = static_cast<long long>(now) - ((index + 1) * 3600LL);
+		snprintf(recording, std::extent<decltype(recording)>::value, "%s{\"ProgramID\":\"EP%08d\",\"Title\":\"Series %d\",\"EpisodeNumber\":\"S01E%02d\","
+			"\"EpisodeTitle\":\"Episode %d\",\"OriginalAirdate\":%lld,\"StartTime\":%lld,\"RecordStartTime\":%lld,\"RecordEndTime\":%lld,"
+			"\"Synopsis\":\"Synthetic benchmark recording %d\",\"ChannelName\":\"BENCH%d\",\"ChannelNumber\":\"%d.%d\",\"Resume\":0,"
+			"\"PlayURL\":\"%s\",\"CmdURL\":\"%s?id=%d\"}",
+			(index == 0) ? "" : ",", index, index % BENCHMARK_RECORDINGRULES, 1 + (index / BENCHMARK_RECORDINGRULES), index,
+			recordstart - 86400LL, recordstart, recordstart, recordstart + 1800LL, index, index % BENCHMARK_CHANNELS,
+			2 + ((index % BENCHMARK_CHANNELS) / 10), 1 + ((index % BENCHMARK_CHANNELS) % 10), server.url("/stream.ts").c_str(),
+			server.url("/recording").c_str(), index);
+		recordings.append(recording);
+	}
+
+	server.add_document("/lineup.json", lineup.append("]"));
+	server.add_document("/recordings.json", recordings.append("]"));
+
+	snprintf(path, std::extent<decltype(path)>::value, "/tmp/benchmark-%d.db", static_cast<int>(getpid()));
+	std::string connstr = std::string("file:") + path;
+
+	try {
+
+		auto pool = std::make_shared<connectionpool>(connstr.c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI);
+
+		// Generate the devices that point to the replay server documents
+		{
+			connectionpool::writehandle dbhandle(pool);
+			execute_non_query(dbhandle, ("insert into device values('10000001', 'tuner', json_object('DeviceID', '10000001', 'LineupURL', '" +
+				server.url("/lineup.json") + "'))").c_str());
+			execute_non_query(dbhandle, ("insert into device values('storage', 'storage', json_object('StorageID', 'storage', 'StorageURL', '" +
+				server.url("/recordings.json") + "'))").c_str());
+		}
+
+		// DISCOVERY
+		//
+		{
+			connectionpool::writehandle dbhandle(pool);
+
+			auto start = std::chrono::steady_clock::now();
+			discover_lineups(dbhandle);
+			report("discover_lineups", 1, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 10; index++) discover_lineups(dbhandle);
+			report("discover_lineups (not modified)", 10, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			discover_recordings(dbhandle);
+			report("discover_recordings", 1, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 10; index++) discover_recordings(dbhandle);
+			report("discover_recordings (not modified)", 10, std::chrono::steady_clock::now() - start);
+		}
+
+		// Generate the guide entries for every channel and the recording rules with their scheduled episodes
+		{
+			connectionpool::writehandle dbhandle(pool);
+
+			auto start = std::chrono::steady_clock::now();
+			execute_non_query(dbhandle, "begin immediate transaction");
+			execute_non_query(dbhandle, ("with recursive slot(n) as (select 0 union all select n + 1 from slot where n < " + std::to_string((BENCHMARK_GUIDEHOURS * 2) - 1) + ") "
+				"insert into guideentry select channelid, " + std::to_string(now - 14400) + " + (n * 1800), " + std::to_string(now - 12600) + " + (n * 1800), "
+				"'SH' || channelid, json_object('Title', 'Program ' || channelid || '-' || n, 'EpisodeTitle', 'Episode ' || n, 'EpisodeNumber', 'S01E' || n, "
+				"'Synopsis', 'Synthetic benchmark guide entry', 'Filter', json_array('Movies')), " + std::to_string(now) + " from (select distinct channelid from lineupentry) cross join slot").c_str());
+			execute_non_query(dbhandle, ("with recursive rule(n) as (select 0 union all select n + 1 from rule where n < " + std::to_string(BENCHMARK_RECORDINGRULES - 1) + ") "
+				"insert into recordingrule select n + 1, 'SH' || n, json_object('RecordingRuleID', n + 1, 'SeriesID', 'SH' || n, 'Title', 'Series ' || n) from rule").c_str());
+			execute_non_query(dbhandle, ("with recursive rule(n) as (select 0 union all select n + 1 from rule where n < " + std::to_string(BENCHMARK_RECORDINGRULES - 1) + "), "
+				"episode(n) as (select 0 union all select n + 1 from episode where n < " + std::to_string(BENCHMARK_EPISODES - 1) + ") "
+				"insert into episode select 'SH' || rule.n, json_group_array(json_object('ProgramID', 'EP' || rule.n || '-' || episode.n, "
+				"'StartTime', " + std::to_string(now) + " + (episode.n * 86400) + (rule.n * 60), 'EndTime', " + std::to_string(now + 1800) + " + (episode.n * 86400) + (rule.n * 60), "
+				"'ChannelNumber', (2 + ((rule.n % " + std::to_string(BENCHMARK_CHANNELS) + ") / 10)) || '.' || (1 + (rule.n % 10)), 'Title', 'Series ' || rule.n, "
+				"'Synopsis', 'Synthetic benchmark episode', 'RecordingRule', 1)) from rule cross join episode group by rule.n").c_str());
+			execute_non_query(dbhandle, "commit transaction");
+			report("generate guide and timers", 1, std::chrono::steady_clock::now() - start);
+		}
+
+		// ENUMERATION
+		//
+		{
+			connectionpool::handle dbhandle(pool);
+
+			auto start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 10; index++) enumerate_channels(dbhandle, true, false, [&](struct channel const&) { count++; });
+			report("enumerate_channels", 10, std::chrono::steady_clock::now() - start);
+
+			std::vector<union channelid> channelids;
+			enumerate_channelids(dbhandle, false, [&](union channelid const& channelid) { channelids.push_back(channelid); });
+
+			count = 0;
+			start = std::chrono::steady_clock::now();
+			for(auto const& channelid : channelids)
+				enumerate_guideentries(dbhandle, channelid, now, now + (BENCHMARK_GUIDEHOURS * 3600), true, [&](struct guideentry const&) { count++; });
+			report("enumerate_guideentries", channelids.size(), std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 10; index++) enumerate_recordings(dbhandle, false, [&](struct recording const&) { count++; });
+			report("enumerate_recordings", 10, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 10; index++) enumerate_recordingrules(dbhandle, [&](struct recordingrule const&) { count++; });
+			report("enumerate_recordingrules", 10, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 10; index++) enumerate_timers(dbhandle, -1, [&](struct timer const&) { count++; });
+			report("enumerate_timers", 10, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 100; index++) count += static_cast<size_t>(get_timer_count(dbhandle, -1));
+			report("get_timer_count", 100, std::chrono::steady_clock::now() - start);
+
+			start = std::chrono::steady_clock::now();
+			for(int index = 0; index < 100; index++) count += static_cast<size_t>(get_channel_count(dbhandle, false) + get_recording_count(dbhandle));
+			report("get_channel_count/get_recording_count", 100, std::chrono::steady_clock::now() - start);
+		}
+	}
+
+	catch(...) { unlink(path); unlink((std::string(path) + "-wal").c_str()); unlink((std::string(path) + "-shm").c_str()); throw; }
+
+	unlink(path);
+	unlink((std::string(path) + "-wal").c_str());
+	unlink((std::string(path) + "-shm").c_str());
+}
+
+//---------------------------------------------------------------------------
+// benchmark::filter (static)
+//
+// Benchmarks the transport stream packet filter against synthetic packets
+//
+// Arguments:
+//
+//	server		- Replay server instance
+
+void benchmark::filter(replayserver& server)
+{
+	size_t const PACKETS = 4096;			// Packets per filter operation
+	size_t const ITERATIONS = 256;			// Number of filter operations
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[PACKETS * MPEGTS_PACKET_LENGTH]);
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::duration::zero();
+
+	// The stream instance is only needed for its packet filter state; stop the transfer before
+	// using it so nothing else touches the filter while it's being exercised directly
+	auto stream = dvrstream::create(server.url("/stream.ts").c_str());
+	stream->close();
+
+	for(size_t iteration = 0; iteration < ITERATIONS; iteration++) {
+
+		// Generate fresh packets each iteration, the filter rewrites the PMT packets in place
+		long long first = static_cast<long long>(iteration * PACKETS);
+		for(size_t index = 0; index < PACKETS; index++) generate_packet(first + static_cast<long long>(index), &buffer[index * MPEGTS_PACKET_LENGTH]);
+
+		auto start = std::chrono::steady_clock::now();
+		stream->filter_packets(buffer.get(), PACKETS, first * static_cast<long long>(MPEGTS_PACKET_LENGTH));
+		elapsed += std::chrono::steady_clock::now() - start;
+	}
+
+	report("dvrstream::filter_packets", ITERATIONS, elapsed, static_cast<long long>(ITERATIONS * PACKETS * MPEGTS_PACKET_LENGTH));
+}
+
+//---------------------------------------------------------------------------
+// benchmark::scan (static)
+//
+// Benchmarks the SIMD and scalar packet header scanning implementations
+//
+// Arguments:
+//
+//	NONE
+
+void benchmark::scan(void)
+{
+	size_t const PACKETS = 4096;			// Packets per scan operation
+	size_t const ITERATIONS = 1024;			// Number of scan operations
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[PACKETS * MPEGTS_PACKET_LENGTH]);
+	std::unique_ptr<uint32_t[]> simd(new uint32_t[PACKETS]);
+	std::unique_ptr<uint32_t[]> scalar(new uint32_t[PACKETS]);
+	size_t scanned = 0;
+
+	for(size_t index = 0; index < PACKETS; index++) generate_packet(static_cast<long long>(index), &buffer[index * MPEGTS_PACKET_LENGTH]);
+
+	auto start = std::chrono::steady_clock::now();
+	for(size_t iteration = 0; iteration < ITERATIONS; iteration++)
+		for(size_t batch = 0; batch < PACKETS; batch += SCAN_BATCH_SIZE)
+			scanned += dvrstream::scan_packets(&buffer[batch * MPEGTS_PACKET_LENGTH], SCAN_BATCH_SIZE, &simd[batch]);
+	report("dvrstream::scan_packets", ITERATIONS, std::chrono::steady_clock::now() - start, static_cast<long long>(ITERATIONS * PACKETS * MPEGTS_PACKET_LENGTH));
+
+	start = std::chrono::steady_clock::now();
+	for(size_t iteration = 0; iteration < ITERATIONS; iteration++)
+		for(size_t batch = 0; batch < PACKETS; batch += SCAN_BATCH_SIZE)
+			scanned += dvrstream::scan_packets_scalar(&buffer[batch * MPEGTS_PACKET_LENGTH], SCAN_BATCH_SIZE, &scalar[batch]);
+	report("dvrstream::scan_packets_scalar", ITERATIONS, std::chrono::steady_clock::now() - start, static_cast<long long>(ITERATIONS * PACKETS * MPEGTS_PACKET_LENGTH));
+
+	// Both implementations have to scan every packet and generate identical descriptors
+	if((scanned != (ITERATIONS * PACKETS * 2)) || (memcmp(simd.get(), scalar.get(), PACKETS * sizeof(uint32_t)) != 0))
+		throw string_exception(__func__, ": SIMD and scalar packet scan results do not match");
+}
+
+//---------------------------------------------------------------------------
+// benchmark::stream (static)
+//
+// Benchmarks dvrstream transfers from the replay server
+//
+// Arguments:
+//
+//	server		- Replay server instance
+
+void benchmark::stream(replayserver& server)
+{
+	size_t const BUFFER_SIZE = (4 MiB);		// Stream ring buffer size
+	size_t const READ_SIZE = (64 KiB);		// Size of each read operation
+	size_t const SEEK_COUNT = 100;			// Number of random seek operations
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[READ_SIZE]);
+	std::string url = server.url("/stream.ts");
+
+	// Sequential read of the entire stream as a single transfer
+	{
+		long long total = 0;
+		size_t reads = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		auto stream = dvrstream::create(url.c_str(), BUFFER_SIZE);
+		for(size_t read = stream->read(buffer.get(), READ_SIZE); read > 0; read = stream->read(buffer.get(), READ_SIZE)) { total += read; reads++; }
+		stream->close();
+		report("dvrstream sequential read", reads, std::chrono::steady_clock::now() - start, total);
+	}
+
+	// Sequential read of the entire stream as a series of range request segments
+	{
+		long long total = 0;
+		size_t reads = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		auto stream = dvrstream::create(url.c_str(), BUFFER_SIZE, READ_SIZE, static_cast<size_t>(1 MiB));
+		for(size_t read = stream->read(buffer.get(), READ_SIZE); read > 0; read = stream->read(buffer.get(), READ_SIZE)) { total += read; reads++; }
+		stream->close();
+		report("dvrstream segmented read", reads, std::chrono::steady_clock::now() - start, total);
+	}
+
+	// Random seeks throughout the stream, each followed by a single read
+	{
+		std::mt19937 random(0);
+		std::uniform_int_distribution<long long> distribution(0, BENCHMARK_STREAM_PACKETS - 1);
+		long long total = 0;
+
+		auto stream = dvrstream::create(url.c_str(), BUFFER_SIZE);
+
+		auto start = std::chrono::steady_clock::now();
+		for(size_t index = 0; index < SEEK_COUNT; index++) {
+
+			stream->seek(distribution(random) * static_cast<long long>(MPEGTS_PACKET_LENGTH), SEEK_SET);
+			total += stream->read(buffer.get(), READ_SIZE);
+		}
+		report("dvrstream seek and read", SEEK_COUNT, std::chrono::steady_clock::now() - start, total);
+
+		stream->close();
+	}
+}
+
+//---------------------------------------------------------------------------
+// generate_packet
+//
+// Generates a single packet of the synthetic benchmark stream; the stream repeats a
+// PAT and a PMT (preceded by an SCTE 0xC0 entry) and carries a PCR every 10th packet
+//
+// Arguments:
+//
+//	index		- Index of the packet within the stream
+//	packet		- Buffer to receive the generated packet
+
+static void generate_packet(long long index, uint8_t* packet)
+{
+	// PAT: program 1 on PMT PID 0x1000
+	static uint8_t const pat[] = { 0x47, 0x40, 0x00, 0x10, 0x00, 0x00, 0xB0, 0x0D, 0x00, 0x01, 0xC1, 0x00, 0x00, 0x00, 0x01, 0xF0, 0x00 };
+
+	// PMT: 0xC0 entry followed by the program map for PCR/video PID 0x0100
+	static uint8_t const pmt[] = { 0x47, 0x50, 0x00, 0x10, 0x00, 0xC0, 0xB0, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x02, 0xB0, 0x12, 0x00, 0x01, 0xC1, 0x00, 0x00, 0xE1, 0x00, 0xF0, 0x00, 0x02, 0xE1, 0x00, 0xF0, 0x00 };
+
+	memset(packet, 0xFF, MPEGTS_PACKET_LENGTH);
+
+	if((index % 1000) == 0) memcpy(packet, pat, sizeof(pat));
+	else if((index % 1000) == 1) memcpy(packet, pmt, sizeof(pmt));
+
+	else if((index % 10) == 5) {
+
+		// PCR: 33-bit 90KHz base with a zero extension
+		uint64_t pcr = 90000ULL + static_cast<uint64_t>((index * 90000LL) / PACKETS_PER_SECOND);
+		uint8_t const header[] = { 0x47, 0x01, 0x00, 0x30, 0x07, 0x10, static_cast<uint8_t>(pcr >> 25), static_cast<uint8_t>(pcr >> 17),
+			static_cast<uint8_t>(pcr >> 9), static_cast<uint8_t>(pcr >> 1), static_cast<uint8_t>(((pcr & 0x01) << 7) | 0x7E), 0x00 };
+		memcpy(packet, header, sizeof(header));
+		memset(packet + sizeof(header), 0x00, MPEGTS_PACKET_LENGTH - sizeof(header));
+	}
+
+	else {
+
+		static uint8_t const header[] = { 0x47, 0x01, 0x00, 0x10 };
+		memcpy(packet, header, sizeof(header));
+		memset(packet + sizeof(header), 0x00, MPEGTS_PACKET_LENGTH - sizeof(header));
+	}
+}
+
+//---------------------------------------------------------------------------
+// report
+//
+// Writes the result of a benchmark to the standard output
+//
+// Arguments:
+//
+//	name		- Benchmark name
+//	operations	- Number of operations executed
+//	elapsed		- Total elapsed time of all operations
+//	bytes		- Number of bytes processed
+
+static void report(char const* name, size_t operations, std::chrono::steady_clock::duration elapsed)
+{
+	return report(name, operations, elapsed, 0);
+}
+
+static void report(char const* name, size_t operations, std::chrono::steady_clock::duration elapsed, long long bytes)
+{
+	double microseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+	double peroperation = (operations > 0) ? microseconds / static_cast<double>(operations) : 0.0;
+
+	if(bytes > 0) printf("%-40s %8zu ops %12.3f ms %12.3f us/op %10.2f MiB/s\n", name, operations, microseconds / 1000.0, peroperation,
+		(microseconds > 0.0) ? (static_cast<double>(bytes) / (1 MiB)) / (microseconds / 1000000.0) : 0.0);
+	else printf("%-40s %8zu ops %12.3f ms %12.3f us/op\n", name, operations, microseconds / 1000.0, peroperation);
+}
+
+//---------------------------------------------------------------------------
+// main
+//
+// Benchmark entry point; the benchmarks to execute (stream, filter, scan, database) can
+// be specified on the command line, otherwise all of them are executed
+//
+// Arguments:
+//
+//	argc		- Number of command line arguments
+//	argv		- Command line arguments
+
+int main(int argc, char** argv)
+{
+	std::set<std::string> selected(argv + 1, argv + argc);
+	auto enabled = [&](char const* name) -> bool { return selected.empty() || (selected.find(name) != selected.end()); };
+
+	printf("%s v%s benchmark\n\n", VERSION_PRODUCTNAME_ANSI, VERSION_VERSION3_ANSI);
+
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+
+	try {
+
+		replayserver server(BENCHMARK_STREAM_PACKETS);
+
+		if(enabled("stream")) benchmark::stream(server);
+		if(enabled("filter")) benchmark::filter(server);
+		if(enabled("scan")) benchmark::scan();
+		if(enabled("database")) benchmark::database(server);
+	}
+
+	catch(std::exception& ex) { fprintf(stderr, "benchmark failed: %s\n", ex.what()); curl_global_cleanup(); return 1; }
+
+	// Write the metrics recorded by the code under test
+	printf("\n%-40s %8s %12s %12s %12s %12s\n", "metric", "count", "total", "p50", "p90", "p99");
+	enumerate_metrics([](struct metric const& metric) -> void {
+
+		printf("%-40.40s %8llu %12llu %12llu %12llu %12llu\n", metric.name, metric.count, metric.total, metric.p50, metric.p90, metric.p99);
+	});
+
+	curl_global_cleanup();
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+
+#pragma warning(pop)
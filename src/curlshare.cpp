@@ -27,6 +27,11 @@
 
 #pragma warning(push, 4)
 
+// curlshare::MAX_POOLED_HANDLES (static)
+//
+// Maximum number of idle easy interface handles retained in the pool
+size_t const curlshare::MAX_POOLED_HANDLES = 16;
+
 //-----------------------------------------------------------------------------
 // curlshare Constructor
 //
@@ -39,10 +44,11 @@ curlshare::curlshare() : m_curlsh(nullptr)
 	m_curlsh = curl_share_init();
 	if(m_curlsh == nullptr) throw string_exception(__func__, ": curl_share_init() failed");
 
-	// Set up the cURL share interface to share DNS and connection caches and provide the
-	// required callbacks to the static lock and unlock synchronization routines
+	// Set up the cURL share interface to share DNS, connection and SSL session caches and provide
+	// the required callbacks to the static lock and unlock synchronization routines
 	CURLSHcode curlshresult = curl_share_setopt(m_curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
 	if(curlshresult == CURLSHE_OK) curlshresult = curl_share_setopt(m_curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+	if(curlshresult == CURLSHE_OK) curlshresult = curl_share_setopt(m_curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
 	if(curlshresult == CURLSHE_OK) curlshresult = curl_share_setopt(m_curlsh, CURLSHOPT_LOCKFUNC, curl_lock);
 	if(curlshresult == CURLSHE_OK) curlshresult = curl_share_setopt(m_curlsh, CURLSHOPT_UNLOCKFUNC, curl_unlock);
 	if(curlshresult == CURLSHE_OK) curlshresult = curl_share_setopt(m_curlsh, CURLSHOPT_USERDATA, this);
@@ -54,6 +60,10 @@ curlshare::curlshare() : m_curlsh(nullptr)
 
 curlshare::~curlshare()
 {
+	// The pooled easy handles have to be destroyed before the share they reference
+	for(auto const& iterator : m_handles) curl_easy_cleanup(iterator);
+	m_handles.clear();
+
 	if(m_curlsh != nullptr) curl_share_cleanup(m_curlsh);
 	m_curlsh = nullptr;
 }
@@ -67,6 +77,36 @@ curlshare::operator CURLSH*() const
 	return m_curlsh;
 }
 
+//---------------------------------------------------------------------------
+// curlshare::acquire_handle
+//
+// Acquires an easy interface handle from the pool, creating a new one as necessary;
+// returns nullptr if a new handle could not be created.  Handles are not associated
+// with the thread that released them, so a worker isn't guaranteed to get back the
+// handle (and connection) it used last; the shared connection cache still applies
+//
+// Arguments:
+//
+//	NONE
+
+CURL* curlshare::acquire_handle(void)
+{
+	std::unique_lock<std::mutex> lock(m_handleslock);
+
+	// Reuse the most recently released handle if one is available
+	if(!m_handles.empty()) {
+
+		CURL* handle = m_handles.back();
+		m_handles.pop_back();
+
+		return handle;
+	}
+
+	lock.unlock();
+
+	return curl_easy_init();
+}
+
 //---------------------------------------------------------------------------
 // curlshare::curl_lock (static)
 //
@@ -84,10 +124,11 @@ void curlshare::curl_lock(CURL* /*handle*/, curl_lock_data data, curl_lock_acces
 	curlshare* instance = reinterpret_cast<curlshare*>(context);
 	assert(instance != nullptr);
 
-	// The only implemented locks are for SHARE, DNS, and CONNECT
+	// The only implemented locks are for SHARE, DNS, CONNECT and SSL_SESSION; these can be re-entered on the same thread
 	if(data == curl_lock_data::CURL_LOCK_DATA_SHARE) instance->m_sharelock.lock();
 	else if(data == curl_lock_data::CURL_LOCK_DATA_DNS) instance->m_dnslock.lock();
 	else if(data == curl_lock_data::CURL_LOCK_DATA_CONNECT) instance->m_connlock.lock();
+	else if(data == curl_lock_data::CURL_LOCK_DATA_SSL_SESSION) instance->m_ssllock.lock();
 	else throw string_exception(__func__, ": invalid curl_lock_data type");
 }
 
@@ -107,12 +148,39 @@ void curlshare::curl_unlock(CURL* /*handle*/, curl_lock_data data, void* context
 	curlshare* instance = reinterpret_cast<curlshare*>(context);
 	assert(instance != nullptr);
 
-	// The only implemented locks are for SHARE, DNS, and CONNECT
+	// The only implemented locks are for SHARE, DNS, CONNECT and SSL_SESSION
 	if(data == curl_lock_data::CURL_LOCK_DATA_SHARE) instance->m_sharelock.unlock();
 	else if(data == curl_lock_data::CURL_LOCK_DATA_DNS) instance->m_dnslock.unlock();
 	else if(data == curl_lock_data::CURL_LOCK_DATA_CONNECT) instance->m_connlock.unlock();
+	else if(data == curl_lock_data::CURL_LOCK_DATA_SSL_SESSION) instance->m_ssllock.unlock();
 	else throw string_exception(__func__, ": invalid curl_lock_data type");
 }
+
+//---------------------------------------------------------------------------
+// curlshare::release_handle
+//
+// Releases a previously acquired easy interface handle back into the pool; the
+// handle is reset to the default options but retains its live connections
+//
+// Arguments:
+//
+//	handle		- Easy interface handle acquired via acquire_handle
+
+void curlshare::release_handle(CURL* handle)
+{
+	if(handle == nullptr) return;
+
+	curl_easy_reset(handle);
+
+	std::unique_lock<std::mutex> lock(m_handleslock);
+
+	// Retain the handle for reuse unless the pool already has enough idle handles
+	if(m_handles.size() < MAX_POOLED_HANDLES) { m_handles.push_back(handle); return; }
+
+	lock.unlock();
+
+	curl_easy_cleanup(handle);
+}
 	
 //---------------------------------------------------------------------------
 
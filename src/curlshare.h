@@ -25,16 +25,18 @@
 #pragma once
 
 #include <mutex>
+#include <vector>
 
 #pragma warning(push, 4)	
 
 //-----------------------------------------------------------------------------
 // Class curlshare
 //
-// cURL share interface implementation; allows sharing of the DNS and connection
-// cache among disparate cURL easy interface objects.  Note the use of recursive
-// mutexes as the synchronization objects; cURL can and does call into the lock
-// function multiple times on the same thread.
+// cURL share interface implementation; allows sharing of the DNS, connection and
+// SSL session caches among disparate cURL easy interface objects.  Note the use of
+// recursive mutexes for all of the shared data; cURL can and does call into the lock
+// function multiple times on the same thread.  Also maintains a pool of easy
+// interface handles that can be reused between requests.
 
 class curlshare
 {
@@ -51,9 +53,30 @@ public:
 	// CURLSH* conversion operator
 	//
 	operator CURLSH*() const;
+
+	//-----------------------------------------------------------------------
+	// Member Functions
+
+	// acquire_handle
+	//
+	// Acquires an easy interface handle from the pool, creating a new one as necessary
+	CURL* acquire_handle(void);
+
+	// release_handle
+	//
+	// Releases a previously acquired easy interface handle back into the pool
+	void release_handle(CURL* handle);
 	
 private:
 
+	curlshare(curlshare const&)=delete;
+	curlshare& operator=(curlshare const&)=delete;
+
+	// MAX_POOLED_HANDLES
+	//
+	// Maximum number of idle easy interface handles retained in the pool
+	static size_t const MAX_POOLED_HANDLES;
+
 	//-----------------------------------------------------------------------
 	// Private Member Functions
 
@@ -74,6 +97,9 @@ private:
 	mutable std::recursive_mutex	m_sharelock;	// General share synchronization object
 	mutable std::recursive_mutex	m_dnslock;		// DNS share synchronization object
 	mutable std::recursive_mutex	m_connlock;		// Connection share synchronization object
+	mutable std::recursive_mutex	m_ssllock;		// SSL session share synchronization object
+	std::vector<CURL*>				m_handles;		// Pool of idle easy interface handles
+	std::mutex						m_handleslock;	// Handle pool synchronization object
 };
 
 //-----------------------------------------------------------------------------
@@ -24,15 +24,22 @@
 #include "database.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <deque>
 #include <exception>
+#include <future>
+#include <new>
 #include <stdint.h>
 #include <string.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <uuid/uuid.h>
 #include <xbmc_pvr_types.h>
 
 #include "curlshare.h"
 #include "hdhr.h"
+#include "metrics.h"
 #include "sqlite_exception.h"
 #include "string_exception.h"
 
@@ -65,17 +72,40 @@ extern char const VERSION_VERSION3_ANSI[];
 // FUNCTION PROTOTYPES
 //---------------------------------------------------------------------------
 
+class sqlite_buffer;
+
+bool check_fingerprints(sqlite3* instance, char const* source, char const* table, char const* idcolumn, char const* hashcolumns);
 void clean_filename(sqlite3_context* context, int argc, sqlite3_value** argv);
 void decode_channel_id(sqlite3_context* context, int argc, sqlite3_value** argv);
-bool discover_devices_broadcast(sqlite3* instance);
-bool discover_devices_http(sqlite3* instance);
+std::vector<std::string> discover_devices_broadcast(void);
+bool discover_devices_concurrent(sqlite3* instance, bool usebroadcast);
 void encode_channel_id(sqlite3_context* context, int argc, sqlite3_value** argv);
 void fnv_hash(sqlite3_context* context, int argc, sqlite3_value** argv);
 void generate_uuid(sqlite3_context* context, int argc, sqlite3_value** argv);
 void get_channel_number(sqlite3_context* context, int argc, sqlite3_value** argv);
 void get_episode_number(sqlite3_context* context, int argc, sqlite3_value** argv);
 void get_season_number(sqlite3_context* context, int argc, sqlite3_value** argv);
+bool http_host_available(char const* url);
+int http_json_each_bestindex(sqlite3_vtab* vtab, sqlite3_index_info* info);
+int http_json_each_close(sqlite3_vtab_cursor* cursor);
+int http_json_each_column(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int ordinal);
+int http_json_each_connect(sqlite3* instance, void* aux, int argc, const char* const* argv, sqlite3_vtab** vtab, char** error);
+int http_json_each_disconnect(sqlite3_vtab* vtab);
+int http_json_each_eof(sqlite3_vtab_cursor* cursor);
+int http_json_each_filter(sqlite3_vtab_cursor* cursor, int indexnum, char const* indexstr, int argc, sqlite3_value** argv);
+int http_json_each_next(sqlite3_vtab_cursor* cursor);
+int http_json_each_open(sqlite3_vtab* vtab, sqlite3_vtab_cursor** cursor);
+int http_json_each_rowid(sqlite3_vtab_cursor* cursor, sqlite_int64* rowid);
 void http_request(sqlite3_context* context, int argc, sqlite3_value** argv);
+bool http_request_multi(sqlite3* instance, char const* table, bool ignoreerrors, int maxconcurrency);
+CURLcode prepare_http_request(CURL* curl, char const* url, sqlite_buffer* blob);
+CURLcode prepare_http_request(CURL* curl, char const* url, size_t(*write)(void const*, size_t, size_t, void*), void* userdata);
+int prepare_statement(sqlite3* instance, char const* sql, sqlite3_stmt** statement);
+int profile_statement(unsigned int type, void* context, void* statement, void* elapsed);
+void record_http_metrics(CURL* curl, char const* url, CURLcode curlresult, long responsecode);
+void release_statement(sqlite3_stmt* statement);
+void reset_statements(sqlite3* instance);
+void update_fingerprints(sqlite3* instance, char const* source, char const* table, char const* idcolumn, char const* hashcolumns);
 void url_encode(sqlite3_context* context, int argc, sqlite3_value** argv);
 
 //---------------------------------------------------------------------------
@@ -87,6 +117,423 @@ void url_encode(sqlite3_context* context, int argc, sqlite3_value** argv);
 // Function pointer for a CURL write function implementation
 typedef size_t(*CURL_WRITEFUNCTION)(void const*, size_t, size_t, void*);
 
+// circuitbreaker
+//
+// Tracks the health of the hosts that HTTP requests are sent to; after repeated transport
+// failures the circuit for a host is opened and requests fail immediately until a probe of
+// the host succeeds
+class circuitbreaker
+{
+public:
+
+	// Constructor / Destructor
+	//
+	circuitbreaker() {}
+	~circuitbreaker() {}
+
+	// available
+	//
+	// Determines if requests to the host of a URL are currently allowed
+	bool available(char const* url) const
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+
+		auto found = m_hosts.find(host(url));
+		return (found == m_hosts.end()) || (found->second < FAILURE_THRESHOLD);
+	}
+
+	// report
+	//
+	// Records the result of a request sent to the host of a URL
+	void report(char const* url, CURLcode curlresult)
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+
+		// Any response from the host, successful or not, indicates that it's reachable
+		if(curlresult == CURLE_OK) { m_hosts.erase(host(url)); return; }
+
+		// Only failures that indicate the host cannot be reached count against it
+		switch(curlresult) {
+
+			case CURLE_COULDNT_RESOLVE_HOST:
+			case CURLE_COULDNT_CONNECT:
+			case CURLE_OPERATION_TIMEDOUT:
+			case CURLE_SSL_CONNECT_ERROR:
+			case CURLE_GOT_NOTHING:
+			case CURLE_SEND_ERROR:
+			case CURLE_RECV_ERROR:
+				break;
+
+			default: return;
+		}
+
+		unsigned int& failures = m_hosts[host(url)];
+		if(++failures == FAILURE_THRESHOLD) increment_metric("http.circuit.opened");
+	}
+
+	// tripped
+	//
+	// Gets the base URLs of the hosts that currently have an open circuit
+	std::vector<std::string> tripped(void) const
+	{
+		std::vector<std::string> hosts;
+		std::unique_lock<std::mutex> lock(m_lock);
+
+		for(auto const& iterator : m_hosts) if(iterator.second >= FAILURE_THRESHOLD) hosts.push_back(iterator.first);
+		return hosts;
+	}
+
+private:
+
+	circuitbreaker(circuitbreaker const&)=delete;
+	circuitbreaker& operator=(circuitbreaker const&)=delete;
+
+	// FAILURE_THRESHOLD
+	//
+	// Number of consecutive failures that opens the circuit for a host
+	static unsigned int const FAILURE_THRESHOLD;
+
+	// host (static)
+	//
+	// Extracts the scheme, host and port from a URL
+	static std::string host(char const* url)
+	{
+		std::string host((url == nullptr) ? "" : url);
+
+		size_t start = host.find("://");
+		start = (start == std::string::npos) ? 0 : start + 3;
+
+		size_t end = host.find_first_of("/?#", start);
+		if(end != std::string::npos) host.erase(end);
+
+		// Host names are case-insensitive
+		std::transform(host.begin(), host.end(), host.begin(), [](char ch) -> char { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+		return host;
+	}
+
+	//-----------------------------------------------------------------------
+	// Member Variables
+
+	std::unordered_map<std::string, unsigned int>	m_hosts;	// Consecutive failures by host
+	mutable std::mutex								m_lock;		// Synchronization object
+};
+
+// circuitbreaker::FAILURE_THRESHOLD (static)
+//
+// Number of consecutive failures that opens the circuit for a host
+unsigned int const circuitbreaker::FAILURE_THRESHOLD = 3;
+
+// http_json_each_cursor
+//
+// Cursor for the http_json_each table-valued function; the top-level elements of a JSON
+// array are extracted from the response as it arrives rather than from the complete document
+class http_json_each_cursor : public sqlite3_vtab_cursor
+{
+public:
+
+	// Constructor / Destructor
+	//
+	http_json_each_cursor() : sqlite3_vtab_cursor() {}
+	~http_json_each_cursor() { close(); }
+
+	// eof
+	//
+	// Determines if the cursor has moved past the last element
+	bool eof(void) const { return m_eof; }
+
+	// next
+	//
+	// Advances the cursor to the next element, executing the transfer as necessary
+	void next(void)
+	{
+		while(m_elements.empty()) {
+
+			// Once the transfer has completed there are no more elements to extract
+			if(m_curlm == nullptr) { m_eof = true; return; }
+
+			// The transfer is paused whenever elements are waiting to be consumed; resuming it will
+			// immediately deliver the data that was being held by libcurl to the write callback
+			if(m_paused) {
+
+				m_paused = false;
+				CURLcode curlresult = curl_easy_pause(m_curl, CURLPAUSE_CONT);
+				if(curlresult != CURLE_OK) throw string_exception(__func__, ": curl_easy_pause() failed: ", curl_easy_strerror(curlresult));
+
+				continue;
+			}
+
+			int running = 0;
+			CURLMcode curlmresult = curl_multi_perform(m_curlm, &running);
+			if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_perform() failed with result code ", static_cast<int>(curlmresult));
+
+			if(running == 0) complete();
+			else if(m_elements.empty()) {
+
+				curlmresult = curl_multi_wait(m_curlm, nullptr, 0, 1000, nullptr);
+				if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_wait() failed with result code ", static_cast<int>(curlmresult));
+			}
+		}
+
+		m_value = std::move(m_elements.front());
+		m_elements.pop_front();
+		++m_rowid;
+	}
+
+	// open
+	//
+	// Starts the transfer from the specified URL and moves to the first element
+	void open(char const* url)
+	{
+		close();
+
+		m_url.assign((url == nullptr) ? "" : url);
+		m_pending.clear();
+		m_elements.clear();
+		m_value.clear();
+		m_format = format::unknown;
+		m_start = std::string::npos;
+		m_depth = 0;
+		m_instring = m_escape = false;
+		m_paused = m_checked = m_rejected = false;
+		m_rowid = -1;
+		m_eof = false;
+
+		// A null or zero-length URL results in no elements, similar to json_each(null)
+		if(m_url.empty()) { m_eof = true; return; }
+
+		// If the host is known to be unreachable, fail immediately rather than waiting for the request to time out
+		if(!http_host_available(m_url.c_str())) {
+
+			increment_metric("http.circuit.rejected");
+			throw string_exception(__func__, ": http request on [", m_url.c_str(), "] failed: host is unavailable");
+		}
+
+		m_curl = curl_easy_init();
+		if(m_curl == nullptr) throw string_exception(__func__, ": curl_easy_init() failed");
+
+		m_curlm = curl_multi_init();
+		if(m_curlm == nullptr) throw string_exception(__func__, ": curl_multi_init() failed");
+
+		CURLcode curlresult = prepare_http_request(m_curl, m_url.c_str(), write_function, this);
+		if(curlresult != CURLE_OK) throw string_exception(__func__, ": failed to set curl options: ", curl_easy_strerror(curlresult));
+
+		CURLMcode curlmresult = curl_multi_add_handle(m_curlm, m_curl);
+		if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_add_handle() failed with result code ", static_cast<int>(curlmresult));
+
+		next();
+	}
+
+	// rowid
+	//
+	// Gets the array index of the current element
+	sqlite3_int64 rowid(void) const { return m_rowid; }
+
+	// url
+	//
+	// Gets the URL of the transfer
+	std::string const& url(void) const { return m_url; }
+
+	// value
+	//
+	// Gets the JSON text of the current element
+	std::string const& value(void) const { return m_value; }
+
+private:
+
+	http_json_each_cursor(http_json_each_cursor const&)=delete;
+	http_json_each_cursor& operator=(http_json_each_cursor const&)=delete;
+
+	// format
+	//
+	// Format of the response document
+	enum class format { unknown, array, document, finished };
+
+	//-----------------------------------------------------------------------
+	// Private Member Functions
+
+	// close
+	//
+	// Releases the transfer handles
+	void close(void)
+	{
+		if(m_curlm != nullptr) {
+
+			if(m_curl != nullptr) curl_multi_remove_handle(m_curlm, m_curl);
+			curl_multi_cleanup(m_curlm);
+			m_curlm = nullptr;
+		}
+
+		if(m_curl != nullptr) curl_easy_cleanup(m_curl);
+		m_curl = nullptr;
+	}
+
+	// complete
+	//
+	// Checks the result of the completed transfer and releases the handles
+	void complete(void)
+	{
+		CURLcode	curlresult = CURLE_OK;		// Result from the transfer
+		long		responsecode = 0;			// HTTP response code
+		CURLMsg*	message;					// Message from the multi interface
+		int			remaining;					// Number of remaining messages
+
+		while((message = curl_multi_info_read(m_curlm, &remaining)) != nullptr) if(message->msg == CURLMSG_DONE) curlresult = message->data.result;
+		curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &responsecode);
+		record_http_metrics(m_curl, m_url.c_str(), curlresult, responsecode);
+		close();
+
+		// Check the HTTP response code first, the write callback aborts a transfer that was not successful
+		if((m_rejected) || ((curlresult == CURLE_OK) && ((responsecode < 200) || (responsecode > 299))))
+			throw string_exception(__func__, ": http request on url [", m_url.c_str(), "] failed with http response code ", responsecode);
+
+		if(curlresult != CURLE_OK) throw string_exception(__func__, ": http request on [", m_url.c_str(), "] failed: ", curl_easy_strerror(curlresult));
+
+		// A response that isn't an array is treated as a single element, with the exception of 'null'
+		if(m_format == format::document) {
+
+			size_t last = m_pending.find_last_not_of(" \t\r\n");
+			if(last != std::string::npos) m_pending.erase(last + 1);
+			if(m_pending != "null") m_elements.emplace_back(std::move(m_pending));
+			m_pending.clear();
+		}
+
+		else if(m_format == format::array) throw string_exception(__func__, ": incomplete json array received from [", m_url.c_str(), "]");
+	}
+
+	// emit
+	//
+	// Extracts the pending element that ends before the specified position
+	void emit(size_t end)
+	{
+		if(m_start == std::string::npos) return;
+
+		size_t last = m_pending.find_last_not_of(" \t\r\n", end - 1);
+		m_elements.emplace_back(m_pending, m_start, last - m_start + 1);
+		m_start = std::string::npos;
+	}
+
+	// scan
+	//
+	// Scans data received from the transfer for complete top-level array elements
+	void scan(char const* data, size_t length)
+	{
+		if(m_format == format::finished) return;
+
+		size_t offset = m_pending.size();
+		m_pending.append(data, length);
+
+		for(size_t index = offset; index < m_pending.size(); index++) {
+
+			char ch = m_pending[index];
+
+			// Strings are skipped over entirely, they cannot affect the structure
+			if(m_instring) {
+
+				if(m_escape) m_escape = false;
+				else if(ch == '\\') m_escape = true;
+				else if(ch == '"') m_instring = false;
+				continue;
+			}
+
+			// The first non-whitespace character determines if the response is an array
+			if(m_format == format::unknown) {
+
+				if(std::isspace(static_cast<unsigned char>(ch))) continue;
+
+				if(ch == '[') { m_format = format::array; m_depth = 1; continue; }
+				m_format = format::document;
+			}
+
+			// Anything other than an array is collected in its entirety
+			if(m_format == format::document) { if(ch == '"') m_instring = true; continue; }
+
+			switch(ch) {
+
+				case '"':
+					if((m_depth == 1) && (m_start == std::string::npos)) m_start = index;
+					m_instring = true;
+					break;
+
+				case '[':
+				case '{':
+					if((m_depth == 1) && (m_start == std::string::npos)) m_start = index;
+					++m_depth;
+					break;
+
+				case ']':
+				case '}':
+					if(--m_depth == 0) { emit(index); m_format = format::finished; }
+					break;
+
+				case ',':
+					if(m_depth == 1) emit(index);
+					break;
+
+				default:
+					if((m_depth == 1) && (m_start == std::string::npos) && (!std::isspace(static_cast<unsigned char>(ch)))) m_start = index;
+			}
+
+			if(m_format == format::finished) break;
+		}
+
+		// Discard everything that was scanned other than the start of an incomplete element
+		if(m_format == format::document) return;
+		else if(m_start == std::string::npos) m_pending.clear();
+		else { m_pending.erase(0, m_start); m_start = 0; }
+	}
+
+	// write_function (static)
+	//
+	// libcurl write callback
+	static size_t write_function(void const* data, size_t size, size_t count, void* userdata)
+	{
+		size_t cb = size * count;
+		http_json_each_cursor* cursor = reinterpret_cast<http_json_each_cursor*>(userdata);
+
+		try {
+
+			// Hold the data in libcurl until the elements that were already extracted have been consumed,
+			// this limits the amount of memory used to roughly the size of a single element
+			if(!cursor->m_elements.empty()) { cursor->m_paused = true; return CURL_WRITEFUNC_PAUSE; }
+
+			// Abort the transfer if the response was not successful, the caller generates the error
+			if(!cursor->m_checked) {
+
+				long responsecode = 0;
+				curl_easy_getinfo(cursor->m_curl, CURLINFO_RESPONSE_CODE, &responsecode);
+
+				cursor->m_checked = true;
+				if((responsecode < 200) || (responsecode > 299)) { cursor->m_rejected = true; return 0; }
+			}
+
+			cursor->scan(reinterpret_cast<char const*>(data), cb);
+			return cb;
+		}
+
+		catch(...) { return 0; }
+	}
+
+	//-----------------------------------------------------------------------
+	// Member Variables
+
+	std::string				m_url;						// Transfer URL
+	CURL*					m_curl = nullptr;			// Easy interface handle
+	CURLM*					m_curlm = nullptr;			// Multi interface handle
+	std::string				m_pending;					// Unprocessed response data
+	std::deque<std::string>	m_elements;					// Extracted elements
+	std::string				m_value;					// Current element
+	format					m_format = format::unknown;	// Response document format
+	size_t					m_start = std::string::npos;	// Start of the pending element
+	int						m_depth = 0;				// Current nesting depth
+	bool					m_instring = false;			// Flag if scanning a string
+	bool					m_escape = false;			// Flag if scanning an escape
+	bool					m_paused = false;			// Flag if the transfer is paused
+	bool					m_checked = false;			// Flag if response code was checked
+	bool					m_rejected = false;			// Flag if response was rejected
+	sqlite3_int64			m_rowid = -1;				// Current element index
+	bool					m_eof = false;				// Flag if past the last element
+};
+
 // sqlite_buffer
 //
 // A simple dynamically allocated buffer used to collect incremental data
@@ -107,33 +554,24 @@ public:
 	{
 		if((data == nullptr) || (length == 0)) return 0;
 
-		// sqlite3_malloc accepts a signed integer value, not a size_t
-		if(length > static_cast<size_t>(std::numeric_limits<int>::max())) throw std::bad_alloc();
-
-		// If the buffer has not been allocated, allocate a single chunk
-		if(m_data == nullptr) {
-
-			m_data = reinterpret_cast<uint8_t*>(sqlite3_malloc(static_cast<int>(length)));
-			if(m_data == nullptr) throw std::bad_alloc();
+		// sqlite3_realloc accepts a signed integer value, not a size_t
+		if(m_position + length > static_cast<size_t>(std::numeric_limits<int>::max())) throw std::bad_alloc();
 
-			m_size = length;
-			m_position = 0;
-		}
-
-		// If the buffer has been exhausted, allocate another chunk
-		else {
+		// If the buffer has been exhausted, grow it geometrically to avoid reallocating
+		// and copying the entire buffer for each chunk of data that is appended
+		if(m_position + length > m_size) {
 
-			// sqlite3_realloc accepts a signed integer value, not a size_t
-			if(m_size + length > static_cast<size_t>(std::numeric_limits<int>::max())) throw std::bad_alloc();
+			size_t newsize = std::max(std::max(m_size * 2, MINIMUM_SIZE), m_position + length);
+			newsize = std::min(newsize, static_cast<size_t>(std::numeric_limits<int>::max()));
 
-			uint8_t* newdata = reinterpret_cast<uint8_t*>(sqlite3_realloc(m_data, static_cast<int>(m_size + length)));
+			uint8_t* newdata = reinterpret_cast<uint8_t*>(sqlite3_realloc(m_data, static_cast<int>(newsize)));
 			if(newdata == nullptr) throw std::bad_alloc();
 
 			m_data = newdata;
-			m_size += length;
+			m_size = newsize;
 		}
 
-		// Append the data to the current position in the reallocated buffer
+		// Append the data to the current position in the buffer
 		memcpy(&m_data[m_position], data, length);
 		m_position += length;
 
@@ -146,6 +584,13 @@ public:
 	// Caller is responsible for calling sqlite3_free() on the pointer
 	uint8_t* detach(void)
 	{
+		// Release the unused portion of the buffer before handing it off
+		if((m_data != nullptr) && (m_position > 0) && (m_position < m_size)) {
+
+			uint8_t* newdata = reinterpret_cast<uint8_t*>(sqlite3_realloc(m_data, static_cast<int>(m_position)));
+			if(newdata != nullptr) m_data = newdata;
+		}
+
 		uint8_t* result = m_data;
 		
 		m_data = nullptr;
@@ -164,6 +609,11 @@ private:
 	sqlite_buffer(sqlite_buffer const&)=delete;
 	sqlite_buffer& operator=(sqlite_buffer const&)=delete;
 
+	// MINIMUM_SIZE
+	//
+	// Minimum buffer allocation length
+	static size_t const MINIMUM_SIZE;
+
 	//-----------------------------------------------------------------------
 	// Member Variables
 
@@ -172,20 +622,128 @@ private:
 	size_t					m_position = 0;				// Current position
 };
 
+// sqlite_buffer::MINIMUM_SIZE (static)
+//
+// Minimum buffer allocation length
+size_t const sqlite_buffer::MINIMUM_SIZE = 16384;
+
+// statementcache
+//
+// Prepared statements cached for an individual database connection; the statements
+// are keyed by the address of the SQL text, which must be a string literal
+struct statementcache {
+
+	std::unordered_map<char const*, sqlite3_stmt*>	statements;		// Cached statements
+	std::unordered_set<sqlite3_stmt*>				inuse;			// Cached statements in use
+};
+
 //---------------------------------------------------------------------------
 // GLOBAL VARIABLES
 //---------------------------------------------------------------------------
 
+// g_cachesize
+//
+// Page cache size applied to new database connections, in KiB
+static std::atomic<int> g_cachesize(4096);
+
+// g_circuitbreaker
+//
+// Global host health tracker used with all HTTP requests generated by the database layer
+static circuitbreaker g_circuitbreaker;
+
 // g_curlshare
 //
 // Global curlshare instance used with all easy interface handles generated
-// by the database layer via the http_request function
+// by the database layer via the http_request function; also provides the
+// pool of reusable easy interface handles for those requests
 static curlshare g_curlshare;
 
+// g_http_json_each_module
+//
+// SQLite module definition for the http_json_each table-valued function
+static sqlite3_module g_http_json_each_module = {
+
+	0,								// iVersion
+	nullptr,						// xCreate (eponymous-only)
+	http_json_each_connect,			// xConnect
+	http_json_each_bestindex,		// xBestIndex
+	http_json_each_disconnect,		// xDisconnect
+	nullptr,						// xDestroy
+	http_json_each_open,			// xOpen
+	http_json_each_close,			// xClose
+	http_json_each_filter,			// xFilter
+	http_json_each_next,			// xNext
+	http_json_each_eof,				// xEof
+	http_json_each_column,			// xColumn
+	http_json_each_rowid,			// xRowid
+	nullptr,						// xUpdate
+	nullptr,						// xBegin
+	nullptr,						// xSync
+	nullptr,						// xCommit
+	nullptr,						// xRollback
+	nullptr,						// xFindFunction
+	nullptr,						// xRename
+};
+
+// g_httpconcurrency
+//
+// Maximum number of concurrent transfers executed by http_request_multi
+static std::atomic<int> g_httpconcurrency(8);
+
+// g_httplowspeedtime
+//
+// Amount of time an HTTP transfer can be stalled before it's aborted, in seconds (zero for none)
+static std::atomic<long> g_httplowspeedtime(30);
+
+// g_httptimeout
+//
+// Maximum amount of time allowed for an HTTP transfer, in seconds (zero for none)
+static std::atomic<long> g_httptimeout(120);
+
+// g_mmapsize
+//
+// Maximum memory-mapped I/O size applied to new database connections, in bytes
+static std::atomic<long long> g_mmapsize(33554432);
+
+// g_statementcaches
+//
+// Prepared statement caches for each open database connection
+static std::unordered_map<sqlite3*, std::unique_ptr<statementcache>> g_statementcaches;
+
+// g_statementcacheslock
+//
+// Synchronization object for g_statementcaches
+static std::mutex g_statementcacheslock;
+
+// g_writelock
+//
+// Serializes write transactions against the database within the process
+static std::mutex g_writelock;
+
 //
 // CONNECTIONPOOL IMPLEMENTATION
 //
 
+// connectionpool::CHECKPOINT_INTERVAL (static)
+//
+// Amount of time the writer must be idle before a WAL checkpoint, in milliseconds
+unsigned int const connectionpool::CHECKPOINT_INTERVAL = 10000;
+
+// connectionpool::CHECKPOINT_LIMIT (static)
+//
+// Number of WAL frames that forces a checkpoint even when checkpoints are paused
+int const connectionpool::CHECKPOINT_LIMIT = 16384;
+
+// connectionpool::DEFAULT_POOL_SIZE (static)
+//
+// Default maximum number of connections in the pool
+size_t const connectionpool::DEFAULT_POOL_SIZE = 16;
+
+// connectionpool::DEFAULT_TIMEOUT (static)
+//
+// Default amount of time to wait for a connection, in milliseconds
+unsigned int const connectionpool::DEFAULT_TIMEOUT = 30000;
+
 //---------------------------------------------------------------------------
 // connectionpool Constructor
 //
@@ -194,17 +752,58 @@ static curlshare g_curlshare;
 //	connstring		- Database connection string
 //	flags			- Database connection flags
 
-connectionpool::connectionpool(char const* connstring, int flags) : m_connstr((connstring) ? connstring : ""), m_flags(flags)
+connectionpool::connectionpool(char const* connstring, int flags) : connectionpool(connstring, flags, DEFAULT_POOL_SIZE, 1, DEFAULT_TIMEOUT)
 {
-	sqlite3*		handle = nullptr;		// Initial database connection
+}
+
+//---------------------------------------------------------------------------
+// connectionpool Constructor
+//
+// Arguments:
+//
+//	connstring		- Database connection string
+//	flags			- Database connection flags
+//	poolsize		- Maximum number of connections in the pool
+//	warmcount		- Number of connections to open during construction
+//	timeout			- Amount of time to wait for a connection, in milliseconds
 
+connectionpool::connectionpool(char const* connstring, int flags, size_t poolsize, size_t warmcount, unsigned int timeout) : 
+	m_connstr((connstring) ? connstring : ""), m_flags(flags), m_poolsize(poolsize), m_timeout(timeout)
+{
 	if(connstring == nullptr) throw std::invalid_argument("connstring");
+	if(poolsize == 0) throw std::invalid_argument("poolsize");
+
+	// At least one connection is always created, and never more than the pool size
+	warmcount = std::min(std::max(warmcount, static_cast<size_t>(1)), poolsize);
+
+	try {
+
+		// Create and pool the initial connections now to give the caller an opportunity to catch any
+		// exceptions during initialization of the database; only the first connection initializes it
+		// and is always a read-write connection, the remainder are read-only connections
+		sqlite3* handle = open_connection(true, true);
+		m_writeconnections.push_back(handle);
+		m_writequeue.push(handle);
+
+		for(size_t index = 1; index < warmcount; index++) {
+
+			handle = open_connection(false, false);
+			m_connections.push_back(handle);
+			m_queue.push(handle);
+		}
+	}
 
-	// Create and pool the initial connection now to give the caller an opportunity
-	// to catch any exceptions during initialization of the database
-	handle = open_database(m_connstr.c_str(), m_flags, true);
-	m_connections.push_back(handle);
-	m_queue.push(handle);
+	catch(...) { 
+		
+		for(auto const& iterator : m_connections) close_database(iterator);
+		for(auto const& iterator : m_writeconnections) close_database(iterator);
+		throw;
+	}
+
+	m_counters.connections = m_connections.size() + m_writeconnections.size();
+
+	// Start the database writer thread last, nothing above can throw once it's running
+	m_writer = std::thread(&connectionpool::writer, this);
 }
 
 //---------------------------------------------------------------------------
@@ -212,40 +811,270 @@ connectionpool::connectionpool(char const* connstring, int flags) : m_connstr((c
 
 connectionpool::~connectionpool()
 {
+	// Signal the writer thread to execute any remaining mutations and stop
+	{
+		std::unique_lock<std::mutex> lock(m_writerlock);
+		m_stop = true;
+		m_writercond.notify_all();
+	}
+
+	if(m_writer.joinable()) m_writer.join();
+
 	// Close all of the connections that were created in the pool
 	for(auto const& iterator : m_connections) close_database(iterator);
+	for(auto const& iterator : m_writeconnections) close_database(iterator);
 }
 
 //---------------------------------------------------------------------------
 // connectionpool::acquire
 //
-// Acquires a database connection, opening a new one if necessary
+// Acquires a read-only database connection, opening a new one if necessary
 //
 // Arguments:
 //
 //	NONE
 
 sqlite3* connectionpool::acquire(void)
+{
+	return acquire(false);
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::acquire (private)
+//
+// Acquires a database connection, opening a new one if necessary
+//
+// Arguments:
+//
+//	writable	- Flag to acquire a read-write rather than a read-only connection
+
+sqlite3* connectionpool::acquire(bool writable)
 {
 	sqlite3* handle = nullptr;				// Handle to return to the caller
 
 	std::unique_lock<std::mutex> lock(m_lock);
 
-	if(m_queue.empty()) {
+	std::vector<sqlite3*>& connections = (writable) ? m_writeconnections : m_connections;
+	std::queue<sqlite3*>& queue = (writable) ? m_writequeue : m_queue;
+	std::vector<sqlite3*>& otherconnections = (writable) ? m_connections : m_writeconnections;
+	std::queue<sqlite3*>& otherqueue = (writable) ? m_queue : m_writequeue;
+
+	++m_counters.acquires;
+
+	// The pool size applies to both types of connection combined; when the pool is at capacity and no
+	// connection of the requested type is available, wait for a connection of either type to be released
+	if(queue.empty() && otherqueue.empty() && ((m_connections.size() + m_writeconnections.size()) >= m_poolsize)) {
+
+		++m_counters.waits;
+		auto start = std::chrono::steady_clock::now();
+
+		bool available = m_released.wait_for(lock, m_timeout, [&]() -> bool { return !queue.empty() || !otherqueue.empty(); });
+		m_counters.waittime += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		if(!available) throw string_exception(__func__, ": timed out waiting for an available database connection");
+	}
+
+	if(queue.empty()) {
+
+		// If the pool is at capacity, an idle connection of the other type has to be closed to make room
+		if((m_connections.size() + m_writeconnections.size()) >= m_poolsize) {
+
+			sqlite3* idle = otherqueue.front();
+			otherqueue.pop();
 
-		// No connections are available, open a new one using the same flags
-		handle = open_database(m_connstr.c_str(), m_flags, false);
-		m_connections.push_back(handle);
+			otherconnections.erase(std::remove(otherconnections.begin(), otherconnections.end(), idle), otherconnections.end());
+			close_database(idle);
+		}
+
+		// No connections are available, open a new one of the same type
+		handle = open_connection(writable, false);
+		connections.push_back(handle);
+		m_counters.connections = m_connections.size() + m_writeconnections.size();
 	}
 
 	// At least one connection is available for reuse
-	else { handle = m_queue.front(); m_queue.pop(); }
+	else { handle = queue.front(); queue.pop(); }
+
+	m_counters.highwater = std::max(m_counters.highwater, m_counters.connections - (m_queue.size() + m_writequeue.size()));
 
 	return handle;
 }
 
 //---------------------------------------------------------------------------
-// connectionpool::release
+// connectionpool::acquire_writable
+//
+// Acquires a read-write database connection, opening a new one if necessary
+//
+// Arguments:
+//
+//	NONE
+
+sqlite3* connectionpool::acquire_writable(void)
+{
+	return acquire(true);
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::checkpoint (private)
+//
+// Executes a passive WAL checkpoint against the database
+//
+// Arguments:
+//
+//	NONE
+
+void connectionpool::checkpoint(void)
+{
+	int				logframes = 0;				// Number of frames in the WAL
+	int				checkpointed = 0;			// Number of frames checkpointed
+
+	// The connection has to be acquired before g_writelock, in the same order as execute_batch
+	sqlite3* instance = acquire(true);
+
+	// Don't checkpoint while a write transaction is in progress, try again the next time the writer is idle
+	std::unique_lock<std::mutex> writelock(g_writelock, std::try_to_lock);
+	if(!writelock.owns_lock()) { release(instance); return; }
+
+	int frames = m_walframes.load();
+
+	int result = sqlite3_wal_checkpoint_v2(instance, nullptr, SQLITE_CHECKPOINT_PASSIVE, &logframes, &checkpointed);
+	release(instance);
+
+	if(result != SQLITE_OK) return;
+
+	// If every frame in the WAL was checkpointed, reset the frame count unless another commit has changed it
+	if(checkpointed >= logframes) m_walframes.compare_exchange_strong(frames, 0);
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	++m_counters.checkpoints;
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::enqueue
+//
+// Queues a mutation to be executed by the database writer
+//
+// Arguments:
+//
+//	key			- Optional key used to coalesce queued mutations
+//	mutation	- Mutation to be executed
+
+void connectionpool::enqueue(char const* key, mutation const& mutation)
+{
+	std::unique_lock<std::mutex> lock(m_writerlock);
+
+	if(!mutation) throw std::invalid_argument("mutation");
+	if(m_stop) throw string_exception(__func__, ": the database writer has been stopped");
+
+	// If a mutation with the same key is still queued, the new one replaces it in the same position
+	if((key != nullptr) && (*key != '\0')) {
+
+		auto found = std::find_if(m_mutations.begin(), m_mutations.end(), [&](std::pair<std::string, connectionpool::mutation> const& item) -> bool { return item.first == key; });
+		if(found != m_mutations.end()) {
+
+			found->second = mutation;
+
+			std::unique_lock<std::mutex> counterslock(m_lock);
+			++m_counters.coalesced;
+			return;
+		}
+	}
+
+	m_mutations.emplace_back((key) ? key : "", mutation);
+	m_writercond.notify_all();
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::execute_batch (private)
+//
+// Executes a batch of queued mutations within a single write transaction
+//
+// Arguments:
+//
+//	batch		- Batch of mutations to be executed
+
+void connectionpool::execute_batch(std::deque<std::pair<std::string, mutation>> const& batch)
+{
+	size_t				executed = 0;			// Number of successful mutations
+
+	sqlite3* instance = acquire(true);
+
+	try {
+
+		std::unique_lock<std::mutex> writelock(g_writelock);
+		execute_non_query(instance, "begin immediate transaction");
+
+		try {
+
+			// Each mutation executes within a savepoint so that a failure only rolls back that mutation; mutations
+			// cannot start their own transactions and there is no caller to report a failure to, they are
+			// expected to handle their own exceptions
+			for(auto const& iterator : batch) {
+
+				execute_non_query(instance, "savepoint mutation");
+
+				try { iterator.second(instance); execute_non_query(instance, "release savepoint mutation"); ++executed; }
+				catch(...) { try_execute_non_query(instance, "rollback to savepoint mutation"); try_execute_non_query(instance, "release savepoint mutation"); }
+			}
+
+			execute_non_query(instance, "commit transaction");
+		}
+
+		// Rollback the entire transaction on any failure above
+		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
+	}
+
+	catch(...) { release(instance); throw; }
+
+	release(instance);
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_counters.mutations += executed;
+	++m_counters.batches;
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::open_connection (private)
+//
+// Opens a new read-only or read-write database connection
+//
+// Arguments:
+//
+//	writable	- Flag to open a read-write rather than a read-only connection
+//	initialize	- Flag to initialize the database schema
+
+sqlite3* connectionpool::open_connection(bool writable, bool initialize)
+{
+	// Read-only connections are opened without SQLITE_OPEN_READWRITE or SQLITE_OPEN_CREATE; they can still
+	// create and modify temporary tables, only the main database is read-only
+	if(!writable) return open_database(m_connstr.c_str(), (m_flags & ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) | SQLITE_OPEN_READONLY, false);
+
+	sqlite3* handle = open_database(m_connstr.c_str(), m_flags, initialize);
+
+	// Registering a WAL hook disables automatic checkpoints on the connection, the writer thread
+	// performs them instead when it's idle
+	sqlite3_wal_hook(handle, wal_hook, this);
+
+	return handle;
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::pause_checkpoints
+//
+// Suspends idle WAL checkpoints until resume_checkpoints is called
+//
+// Arguments:
+//
+//	NONE
+
+void connectionpool::pause_checkpoints(void)
+{
+	std::unique_lock<std::mutex> lock(m_writerlock);
+	m_paused = true;
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::release
 //
 // Releases a database handle acquired from the pool
 //
@@ -259,7 +1088,111 @@ void connectionpool::release(sqlite3* handle)
 
 	if(handle == nullptr) throw std::invalid_argument("handle");
 
-	m_queue.push(handle);
+	// Ensure that none of the cached statements are left active when the connection is returned
+	reset_statements(handle);
+
+	// Return the connection to the queue for the same type of connection
+	bool writable = (std::find(m_writeconnections.begin(), m_writeconnections.end(), handle) != m_writeconnections.end());
+	((writable) ? m_writequeue : m_queue).push(handle);
+
+	// Both types of connection are waited on with the same condition, wake all of the waiters
+	m_released.notify_all();
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::resume_checkpoints
+//
+// Resumes idle WAL checkpoints suspended by pause_checkpoints
+//
+// Arguments:
+//
+//	NONE
+
+void connectionpool::resume_checkpoints(void)
+{
+	std::unique_lock<std::mutex> lock(m_writerlock);
+	m_paused = false;
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::statistics
+//
+// Gets the usage counters for the connection pool
+//
+// Arguments:
+//
+//	NONE
+
+struct connectionpool::counters connectionpool::statistics(void) const
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	return m_counters;
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::wal_hook (private, static)
+//
+// Callback invoked by SQLite after a transaction is committed to the WAL
+//
+// Arguments:
+//
+//	context		- connectionpool instance pointer
+//	instance	- SQLite database instance
+//	database	- Name of the database that was written to
+//	frames		- Number of frames currently in the WAL
+
+int connectionpool::wal_hook(void* context, sqlite3* /*instance*/, char const* /*database*/, int frames)
+{
+	connectionpool* pool = reinterpret_cast<connectionpool*>(context);
+	if(pool != nullptr) pool->m_walframes.store(frames);
+
+	return SQLITE_OK;
+}
+
+//---------------------------------------------------------------------------
+// connectionpool::writer (private)
+//
+// Database writer thread procedure
+//
+// Arguments:
+//
+//	NONE
+
+void connectionpool::writer(void)
+{
+	std::unique_lock<std::mutex> lock(m_writerlock);
+
+	while(true) {
+
+		// Wait for a mutation to be queued, the pool to be destroyed or the idle interval to elapse
+		bool signaled = m_writercond.wait_for(lock, std::chrono::milliseconds(CHECKPOINT_INTERVAL), 
+			[&]() -> bool { return m_stop || !m_mutations.empty(); });
+
+		// Execute all of the queued mutations as a single batch; mutations queued while the batch
+		// executes will be coalesced against each other and executed in the next batch
+		if(!m_mutations.empty()) {
+
+			std::deque<std::pair<std::string, mutation>> batch;
+			batch.swap(m_mutations);
+
+			lock.unlock();
+			try { execute_batch(batch); } catch(...) { }
+			lock.lock();
+
+			continue;
+		}
+
+		if(m_stop) break;
+
+		// The writer has been idle for the checkpoint interval; checkpoint the WAL unless checkpoints have been
+		// paused (while streaming), or the WAL has grown large enough that it needs to be checkpointed anyway
+		if((!signaled) && (m_walframes.load() > 0) && ((!m_paused) || (m_walframes.load() >= CHECKPOINT_LIMIT))) {
+
+			lock.unlock();
+			try { checkpoint(); } catch(...) { }
+			lock.lock();
+		}
+	}
 }
 
 //---------------------------------------------------------------------------
@@ -279,97 +1212,105 @@ void add_recordingrule(sqlite3* instance, struct recordingrule const& recordingr
 	
 	if(instance == nullptr) return;
 
-	// Clone the episode table schema into a temporary table to avoid the WHERE clause problem below
+	// Clone the recording rule and episode table schemas into temporary tables; the backend services responses are
+	// staged in these before the write lock is acquired, the HTTP requests can take as long as the request timeout
+	execute_non_query(instance, "drop table if exists add_recordingrule_rule");
 	execute_non_query(instance, "drop table if exists add_recordingrule_temp");
+	execute_non_query(instance, "create temp table add_recordingrule_rule as select * from recordingrule limit 0");
 	execute_non_query(instance, "create temp table add_recordingrule_temp as select * from episode limit 0");
 
 	try {
 
-		// Start a database transaction
-		execute_non_query(instance, "begin immediate transaction");
+		// Add the new recording rule and stage all updated rules for the series
+		auto sql = "insert into add_recordingrule_rule "
+			"select json_extract(value, '$.RecordingRuleID') as recordingruleid, "
+			"json_extract(value, '$.SeriesID') as seriesid, "
+			"value as data "
+			"from "
+			"json_each((with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
+			"select nullif(http_request('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Cmd=add&SeriesID=' || ?1 || "
+			"case when ?2 is null then '' else '&RecentOnly=' || ?2 end || "
+			"case when ?3 is null then '' else '&ChannelOnly=' || decode_channel_id(?3) end || "
+			"case when ?4 is null then '' else '&AfterOriginalAirdateOnly=' || strftime('%s', date(?4, 'unixepoch')) end || "
+			"case when ?5 is null then '' else '&DateTimeOnly=' || ?5 end || "
+			"case when ?6 is null then '' else '&StartPadding=' || ?6 end || "
+			"case when ?7 is null then '' else '&EndPadding=' || ?7 end), 'null') as data "
+			"from deviceauth))";
+
+		// Prepare the query
+		result = prepare_statement(instance, sql, &statement);
+		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 		try {
 
-			// Add the new recording rule and replace/insert all updated rules for the series
-			auto sql = "replace into recordingrule "
-				"select json_extract(value, '$.RecordingRuleID') as recordingruleid, "
-				"json_extract(value, '$.SeriesID') as seriesid, "
-				"value as data "
-				"from "
-				"json_each((with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-				"select nullif(http_request('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Cmd=add&SeriesID=' || ?1 || "
-				"case when ?2 is null then '' else '&RecentOnly=' || ?2 end || "
-				"case when ?3 is null then '' else '&ChannelOnly=' || decode_channel_id(?3) end || "
-				"case when ?4 is null then '' else '&AfterOriginalAirdateOnly=' || strftime('%s', date(?4, 'unixepoch')) end || "
-				"case when ?5 is null then '' else '&DateTimeOnly=' || ?5 end || "
-				"case when ?6 is null then '' else '&StartPadding=' || ?6 end || "
-				"case when ?7 is null then '' else '&EndPadding=' || ?7 end), 'null') as data "
-				"from deviceauth))";
-
-			// Prepare the query
-			result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
-			if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+			// Bind the non-null query parameter(s)
+			result = sqlite3_bind_text(statement, 1, recordingrule.seriesid, -1, SQLITE_STATIC);
+			if((result == SQLITE_OK) && (recordingrule.recentonly)) result = sqlite3_bind_int(statement, 2, 1);
+			if((result == SQLITE_OK) && (recordingrule.channelid.value != 0)) result = sqlite3_bind_int(statement, 3, recordingrule.channelid.value);
+			if((result == SQLITE_OK) && (recordingrule.afteroriginalairdateonly != 0)) result = sqlite3_bind_int(statement, 4, static_cast<int>(recordingrule.afteroriginalairdateonly));
+			if((result == SQLITE_OK) && (recordingrule.datetimeonly != 0)) result = sqlite3_bind_int(statement, 5, static_cast<int>(recordingrule.datetimeonly));
+			if((result == SQLITE_OK) && (recordingrule.startpadding != 30)) result = sqlite3_bind_int(statement, 6, recordingrule.startpadding);
+			if((result == SQLITE_OK) && (recordingrule.endpadding != 30))  result = sqlite3_bind_int(statement, 7, recordingrule.endpadding);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
 
-			try {
+			// Execute the query - no result set is expected
+			result = sqlite3_step(statement);
+			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-				// Bind the non-null query parameter(s)
-				result = sqlite3_bind_text(statement, 1, recordingrule.seriesid, -1, SQLITE_STATIC);
-				if((result == SQLITE_OK) && (recordingrule.recentonly)) result = sqlite3_bind_int(statement, 2, 1);
-				if((result == SQLITE_OK) && (recordingrule.channelid.value != 0)) result = sqlite3_bind_int(statement, 3, recordingrule.channelid.value);
-				if((result == SQLITE_OK) && (recordingrule.afteroriginalairdateonly != 0)) result = sqlite3_bind_int(statement, 4, static_cast<int>(recordingrule.afteroriginalairdateonly));
-				if((result == SQLITE_OK) && (recordingrule.datetimeonly != 0)) result = sqlite3_bind_int(statement, 5, static_cast<int>(recordingrule.datetimeonly));
-				if((result == SQLITE_OK) && (recordingrule.startpadding != 30)) result = sqlite3_bind_int(statement, 6, recordingrule.startpadding);
-				if((result == SQLITE_OK) && (recordingrule.endpadding != 30))  result = sqlite3_bind_int(statement, 7, recordingrule.endpadding);
-				if(result != SQLITE_OK) throw sqlite_exception(result);
-
-				// Execute the query - no result set is expected
-				result = sqlite3_step(statement);
-				if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
-				if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
-
-				sqlite3_finalize(statement);			// Finalize the SQLite statement
-			}
+			release_statement(statement);			// Release the SQLite statement
+		}
 
-			catch(...) { sqlite3_finalize(statement); throw; }
+		catch(...) { release_statement(statement); throw; }
 
-			//
-			// NOTE: This had to be broken up into a multi-step query involving a temp table to avoid a SQLite bug/feature
-			// wherein using a function (http_request in this case) as part of a column definition is reevaluated when
-			// that column is subsequently used as part of a WHERE clause:
-			//
-			// [http://mailinglists.sqlite.org/cgi-bin/mailman/private/sqlite-users/2015-August/061083.html]
-			//
-			
-			// Update the episode data to take the new recording rule(s) into account; watch out for the web
-			// services returning 'null' on the episode query -- this happens when there are no episodes
-			sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-				"insert into add_recordingrule_temp select ?1 as seriesid, "
-				"http_request('http://api.hdhomerun.com/api/episodes?DeviceAuth=' || coalesce(deviceauth.code, '') || '&SeriesID=' || ?1) as data "
-				"from deviceauth";
-
-			// Prepare the query
-			result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
-			if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+		//
+		// NOTE: This had to be broken up into a multi-step query involving a temp table to avoid a SQLite bug/feature
+		// wherein using a function (http_request in this case) as part of a column definition is reevaluated when
+		// that column is subsequently used as part of a WHERE clause:
+		//
+		// [http://mailinglists.sqlite.org/cgi-bin/mailman/private/sqlite-users/2015-August/061083.html]
+		//
+		
+		// Stage the episode data to take the new recording rule(s) into account; watch out for the web
+		// services returning 'null' on the episode query -- this happens when there are no episodes
+		sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
+			"insert into add_recordingrule_temp select ?1 as seriesid, "
+			"http_request('http://api.hdhomerun.com/api/episodes?DeviceAuth=' || coalesce(deviceauth.code, '') || '&SeriesID=' || ?1) as data "
+			"from deviceauth";
 
-			try {
+		// Prepare the query
+		result = prepare_statement(instance, sql, &statement);
+		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-				// Bind the non-null query parameter(s)
-				result = sqlite3_bind_text(statement, 1, recordingrule.seriesid, -1, SQLITE_STATIC);
-				if(result != SQLITE_OK) throw sqlite_exception(result);
+		try {
 
-				// Execute the query - no result set is expected
-				result = sqlite3_step(statement);
-				if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
-				if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+			// Bind the non-null query parameter(s)
+			result = sqlite3_bind_text(statement, 1, recordingrule.seriesid, -1, SQLITE_STATIC);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
 
-				sqlite3_finalize(statement);			// Finalize the SQLite statement
-			}
+			// Execute the query - no result set is expected
+			result = sqlite3_step(statement);
+			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-			catch(...) { sqlite3_finalize(statement); throw; }
+			release_statement(statement);			// Release the SQLite statement
+		}
 
-			// Complete the replace operation into the episode table from the temporary table that was generated above
+		catch(...) { release_statement(statement); throw; }
+
+		// Start a database transaction; only the local writes from the staged data are done under the write lock
+		std::unique_lock<std::mutex> writelock(g_writelock);
+		execute_non_query(instance, "begin immediate transaction");
+
+		try {
+
+			// Complete the replace operations into the recording rule and episode tables from the temporary tables
+			execute_non_query(instance, "replace into recordingrule select recordingruleid, seriesid, data from add_recordingrule_rule");
 			execute_non_query(instance, "replace into episode select seriesid, data from add_recordingrule_temp where cast(data as text) <> 'null'");
 
+			// The local recording rule and episode data no longer matches the last discovery
+			execute_non_query(instance, "delete from fingerprint where source in ('recordingrule', 'episode')");
+
 			// Commit the transaction
 			execute_non_query(instance, "commit transaction");
 		}
@@ -377,15 +1318,72 @@ void add_recordingrule(sqlite3* instance, struct recordingrule const& recordingr
 		// Rollback the entire transaction on any failure above
 		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
 
+		writelock.unlock();
+
 		// Poke the recording engine(s) after a successful rule change; don't worry about exceptions
 		try_execute_non_query(instance, "select http_request(json_extract(data, '$.BaseURL') || '/recording_events.post?sync') from device where type = 'storage'");
 
-		// Drop the temporary table
+		// Drop the temporary tables
 		execute_non_query(instance, "drop table add_recordingrule_temp");
+		execute_non_query(instance, "drop table add_recordingrule_rule");
 	}
 
-	// Drop the temporary table on any exception
-	catch(...) { execute_non_query(instance, "drop table add_recordingrule_temp"); throw; }
+	// Drop the temporary tables on any exception
+	catch(...) { try_execute_non_query(instance, "drop table add_recordingrule_temp"); execute_non_query(instance, "drop table add_recordingrule_rule"); throw; }
+}
+
+//---------------------------------------------------------------------------
+// check_fingerprints
+//
+// Determines if any of the discovered data differs from the last data successfully applied from the same source
+//
+// Arguments:
+//
+//	instance	- SQLite database instance
+//	source		- Name of the discovery data source
+//	table		- Name of the table containing the discovered data
+//	idcolumn	- Name of the column that identifies each row within the source
+//	hashcolumns	- Comma-separated list of the columns used to generate the fingerprint
+
+bool check_fingerprints(sqlite3* instance, char const* source, char const* table, char const* idcolumn, char const* hashcolumns)
+{
+	sqlite3_stmt*				statement;			// SQL statement to execute
+	int							result;				// Result from SQLite function
+	bool						changed = true;		// Flag if any of the data has changed
+
+	if(instance == nullptr) throw std::invalid_argument("instance");
+	if(source == nullptr) throw std::invalid_argument("source");
+	if(table == nullptr) throw std::invalid_argument("table");
+	if(idcolumn == nullptr) throw std::invalid_argument("idcolumn");
+	if(hashcolumns == nullptr) throw std::invalid_argument("hashcolumns");
+
+	// Rows that are new or have a different fingerprint indicate a change; rows that have been removed are
+	// handled by the caller since that doesn't require the discovered data to be merged into the main table
+	auto sql = sqlite3_mprintf("select exists(select 1 from \"%w\" as discovery left outer join fingerprint on fingerprint.source = ?1 "
+		"and fingerprint.id = discovery.\"%w\" where fingerprint.hash is null or fingerprint.hash <> fnv_hash(%s))", table, idcolumn, hashcolumns);
+	if(sql == nullptr) throw std::bad_alloc();
+
+	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	sqlite3_free(reinterpret_cast<void*>(sql));
+	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+	try {
+
+		// Bind the query parameter(s)
+		result = sqlite3_bind_text(statement, 1, source, -1, SQLITE_STATIC);
+		if(result != SQLITE_OK) throw sqlite_exception(result);
+
+		// Execute the query; one result column is expected
+		result = sqlite3_step(statement);
+		if(result == SQLITE_ROW) changed = (sqlite3_column_int(statement, 0) != 0);
+		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+		sqlite3_finalize(statement);			// Finalize the SQLite statement
+	}
+
+	catch(...) { sqlite3_finalize(statement); throw; }
+
+	return changed;
 }
 
 //---------------------------------------------------------------------------
@@ -442,10 +1440,14 @@ void clear_database(sqlite3* instance)
 	// Not very interesting, just delete all the data from each discovery table
 	execute_non_query(instance, "delete from episode");
 	execute_non_query(instance, "delete from recordingrule");
+	execute_non_query(instance, "delete from guideentry");
 	execute_non_query(instance, "delete from guide");
 	execute_non_query(instance, "delete from recording");
 	execute_non_query(instance, "delete from lineup");
 	execute_non_query(instance, "delete from device");
+	execute_non_query(instance, "delete from httpcache");
+	execute_non_query(instance, "delete from fingerprint");
+	execute_non_query(instance, "delete from discovery");
 }
 
 //---------------------------------------------------------------------------
@@ -459,7 +1461,21 @@ void clear_database(sqlite3* instance)
 
 void close_database(sqlite3* instance)
 {
-	if(instance) sqlite3_close(instance);
+	if(instance == nullptr) return;
+
+	// The cached statements have to be finalized before the connection can be closed
+	std::unique_lock<std::mutex> lock(g_statementcacheslock);
+
+	auto found = g_statementcaches.find(instance);
+	if(found != g_statementcaches.end()) {
+
+		for(auto const& iterator : found->second->statements) sqlite3_finalize(iterator.second);
+		g_statementcaches.erase(found);
+	}
+
+	lock.unlock();
+
+	sqlite3_close(instance);
 }
 
 //---------------------------------------------------------------------------
@@ -512,12 +1528,12 @@ void delete_recording(sqlite3* instance, char const* recordingid, bool rerecord)
 	// Prepare a query that will delete the specified recording from the storage device and the database
 	auto sql = "with httprequest(response) as (select http_request(?1 || '&cmd=delete&rerecord=' || ?2)) "
 		"replace into recording select "
-		"deviceid, "
-		"(select case when fullkey is null then recording.data else json_remove(recording.data, fullkey) end) as data "
-		"from httprequest, recording, "
-		"(select fullkey from recording, json_each(recording.data) as entry where json_extract(entry.value, '$.CmdURL') like ?1 limit 1)";
+		"recording.deviceid, "
+		"json_remove(recording.data, recordingentry.fullkey) as data "
+		"from httprequest cross join recordingentry inner join recording on recordingentry.deviceid = recording.deviceid "
+		"where recordingentry.recordingid = ?1";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -532,10 +1548,13 @@ void delete_recording(sqlite3* instance, char const* recordingid, bool rerecord)
 		if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
 		if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
+
+	// The local recording data no longer matches the last discovery
+	execute_non_query(instance, "delete from fingerprint where source = 'recording'");
 }
 
 //---------------------------------------------------------------------------
@@ -555,17 +1574,19 @@ void delete_recordingrule(sqlite3* instance, unsigned int recordingruleid)
 	
 	if(instance == nullptr) return;
 
-	execute_non_query(instance, "begin immediate transaction");
+	// The backend services response is staged in a temporary table before the write lock is acquired
+	execute_non_query(instance, "drop table if exists delete_recordingrule_temp");
+	execute_non_query(instance, "create temp table delete_recordingrule_temp(recordingruleid text)");
 
 	try {
 
-		// Delete the recording rule from the backend services and the local database
+		// Delete the recording rule from the backend services, the rule is staged as null if that was not successful
 		auto sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-			"delete from recordingrule where recordingruleid in "
-			"(select case when cast(http_request('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, '') || "
-			"'&Cmd=delete&RecordingRuleID=' || ?1) as text) = 'null' then ?1 else null end from deviceauth)";
+			"insert into delete_recordingrule_temp "
+			"select case when cast(http_request('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, '') || "
+			"'&Cmd=delete&RecordingRuleID=' || ?1) as text) = 'null' then ?1 else null end from deviceauth";
 
-		result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+		result = prepare_statement(instance, sql, &statement);
 		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 		try {
@@ -579,23 +1600,44 @@ void delete_recordingrule(sqlite3* instance, unsigned int recordingruleid)
 			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
 			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-			sqlite3_finalize(statement);			// Finalize the SQLite statement
+			release_statement(statement);			// Release the SQLite statement
 		}
 
-		catch(...) { sqlite3_finalize(statement); throw; }
+		catch(...) { release_statement(statement); throw; }
 
-		// Remove episode data that no longer has an associated recording rule
-		execute_non_query(instance, "delete from episode where seriesid not in (select json_extract(data, '$.SeriesID') from recordingrule)");
+		// Start a database transaction; only the local deletions are done under the write lock
+		std::unique_lock<std::mutex> writelock(g_writelock);
+		execute_non_query(instance, "begin immediate transaction");
 
-		// Commit the transaction
-		execute_non_query(instance, "commit transaction");
-	}
+		try {
+
+			// Delete the staged recording rule from the local database
+			execute_non_query(instance, "delete from recordingrule where recordingruleid in (select recordingruleid from delete_recordingrule_temp)");
+
+			// Remove episode data that no longer has an associated recording rule
+			execute_non_query(instance, "delete from episode where seriesid not in (select json_extract(data, '$.SeriesID') from recordingrule)");
+
+			// The local recording rule and episode data no longer matches the last discovery
+			execute_non_query(instance, "delete from fingerprint where source in ('recordingrule', 'episode')");
+
+			// Commit the transaction
+			execute_non_query(instance, "commit transaction");
+		}
+
+		// Rollback the entire transaction on any failure above
+		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
+
+		writelock.unlock();
+
+		// Poke the recording engine(s) after a successful rule change; don't worry about exceptions
+		try_execute_non_query(instance, "select http_request(json_extract(data, '$.BaseURL') || '/recording_events.post?sync') from device where type = 'storage");
 
-	// Rollback the entire transaction on any failure above
-	catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
+		// Drop the temporary table
+		execute_non_query(instance, "drop table delete_recordingrule_temp");
+	}
 
-	// Poke the recording engine(s) after a successful rule change; don't worry about exceptions
-	try_execute_non_query(instance, "select http_request(json_extract(data, '$.BaseURL') || '/recording_events.post?sync') from device where type = 'storage");
+	// Drop the temporary table on any exception
+	catch(...) { execute_non_query(instance, "drop table delete_recordingrule_temp"); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -606,7 +1648,7 @@ void delete_recordingrule(sqlite3* instance, unsigned int recordingruleid)
 // Arguments:
 //
 //	instance		- SQLite database instance
-//	usebroadcast	- Flag to use broadcast rather than HTTP discovery
+//	usebroadcast	- Flag to prefer broadcast rather than HTTP discovery
 
 void discover_devices(sqlite3* instance, bool usebroadcast)
 {
@@ -622,7 +1664,7 @@ void discover_devices(sqlite3* instance, bool usebroadcast)
 // Arguments:
 //
 //	instance		- SQLite database instance
-//	usebroadcast	- Flag to use broadcast rather than HTTP discovery
+//	usebroadcast	- Flag to prefer broadcast rather than HTTP discovery
 //	changed			- Flag indicating if the data has changed
 
 void discover_devices(sqlite3* instance, bool usebroadcast, bool& changed)
@@ -639,9 +1681,9 @@ void discover_devices(sqlite3* instance, bool usebroadcast, bool& changed)
 
 	try {
 
-		// The logic required to load the temp table from broadcast differs greatly from the method
-		// used to load from the HTTP API; the specific mechanisms have been broken out into helpers
-		hastuners = (usebroadcast) ? discover_devices_broadcast(instance) : discover_devices_http(instance);
+		// Load the temp table from both UDP broadcast and the HTTP API concurrently; the selected
+		// mechanism takes precedence when the same device is discovered by both of them
+		hastuners = discover_devices_concurrent(instance, usebroadcast);
 
 		// If no tuner devices were found during discovery, throw an exception to abort the device discovery.
 		// The intention here is to prevent transient discovery problems from clearing out the existing devices
@@ -649,6 +1691,7 @@ void discover_devices(sqlite3* instance, bool usebroadcast, bool& changed)
 		if(!hastuners) throw string_exception(__func__, ": no tuner devices were discovered; aborting device discovery");
 
 		// This requires a multi-step operation against the device table; start a transaction
+		std::unique_lock<std::mutex> writelock(g_writelock);
 		execute_non_query(instance, "begin immediate transaction");
 
 		try {
@@ -663,6 +1706,9 @@ void discover_devices(sqlite3* instance, bool usebroadcast, bool& changed)
 			// Update the JSON for every device based on the discovery data; this is not considered a change as
 			// the device authorization string changes routinely.  (REPLACE INTO is easier than UPDATE in this case)
 			execute_non_query(instance, "replace into device select * from discover_device");
+
+			// Record the time of the successful discovery to allow the device set to be reused at startup
+			execute_non_query(instance, "replace into discovery values('device', cast(strftime('%s', 'now') as integer))");
 			
 			// Commit the database transaction
 			execute_non_query(instance, "commit transaction");
@@ -671,6 +1717,8 @@ void discover_devices(sqlite3* instance, bool usebroadcast, bool& changed)
 		// Rollback the transaction on any exception
 		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
 
+		writelock.unlock();
+
 		// Drop the temporary table
 		execute_non_query(instance, "drop table discover_device");
 	}
@@ -682,103 +1730,134 @@ void discover_devices(sqlite3* instance, bool usebroadcast, bool& changed)
 //---------------------------------------------------------------------------
 // discover_devices_broadcast
 //
-// discover_devices helper -- loads the discover_device table from UDP broadcast
+// discover_devices helper -- enumerates the devices accessible via UDP broadcast
 //
 // Arguments:
 //
-//	instance		- SQLite database instance
+//	NONE
 
-bool discover_devices_broadcast(sqlite3* instance)
+std::vector<std::string> discover_devices_broadcast(void)
 {
-	bool					hastuners = false;		// Flag indicating tuners were found
-	sqlite3_stmt*			statement;				// SQL statement to execute
-	int						result;					// Result from SQLite function
-
-	assert(instance != nullptr);
-
-	// deviceid | type | data
-	auto sql = "insert into discover_device values(printf('%08X', ?1), ?2, ?3)";
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
-	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
-
-	try {
-
-		// Enumerate the devices on the local network accessible via UDP broadcast and insert them
-		// into the temp table using the baseurl as 'data' rather than the discovery JSON
-		enumerate_devices([&](struct discover_device const& device) -> void { 
-
-			// The presence or lack of tuner devices is used as the function return value
-			if(device.devicetype == device_type::tuner) hastuners = true;
-			
-			// Bind the query parameter(s)
-			result = sqlite3_bind_int(statement, 1, device.deviceid);
-			if(result == SQLITE_OK) result = sqlite3_bind_text(statement, 2, (device.devicetype == device_type::tuner) ? "tuner" : "storage", -1, SQLITE_STATIC);
-			if(result == SQLITE_OK) result = sqlite3_bind_text(statement, 3, device.baseurl, -1, SQLITE_STATIC);
-			if(result != SQLITE_OK) throw sqlite_exception(result);
-
-			// This is a non-query, it's not expected to return any rows
-			result = sqlite3_step(statement);
-			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
-			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
-
-			// Reset the prepared statement so that it can be executed again
-			result = sqlite3_reset(statement);
-			if(result != SQLITE_OK) throw sqlite_exception(result);
-		});
+	std::vector<std::string>	devices;		// deviceid | type | baseurl triplets
 
-		// Finalize the statement after all devices have been processed
-		sqlite3_finalize(statement);
-	}
-		
-	catch(...) { sqlite3_finalize(statement); throw; }
+	// The database cannot be accessed from the broadcast thread, capture the results in a
+	// flattened vector<> of strings that can be bound to the INSERT statement afterwards
+	enumerate_devices([&](struct discover_device const& device) -> void {
 
-	// Replace the base URL temporarily stored in the data column with the full discovery JSON
-	execute_non_query(instance, "update discover_device set data = http_request(data || '/discover.json')");
+		char deviceid[9];
+		snprintf(deviceid, std::extent<decltype(deviceid)>::value, "%08X", device.deviceid);
 
-	// Update the deviceid column for storage devices, the broadcast mechanism has no means to return the StorageID
-	execute_non_query(instance, "update discover_device set deviceid = coalesce(json_extract(data, '$.StorageID'), '00000000') where type = 'storage'");
+		devices.emplace_back(deviceid);
+		devices.emplace_back((device.devicetype == device_type::tuner) ? "tuner" : "storage");
+		devices.emplace_back(device.baseurl);
+	});
 
-	// Indicate if any tuner devices were detected during discovery or not
-	return hastuners;
+	return devices;
 }
 
 //---------------------------------------------------------------------------
-// discover_devices_http
+// discover_devices_concurrent
 //
-// discover_devices helper -- loads the discover_device table from the HTTP API
+// discover_devices helper -- loads the discover_device table from both UDP broadcast and the HTTP API
 //
 // Arguments:
 //
 //	instance		- SQLite database instance
+//	usebroadcast	- Flag to prefer broadcast rather than HTTP discovery
 
-bool discover_devices_http(sqlite3* instance)
+bool discover_devices_concurrent(sqlite3* instance, bool usebroadcast)
 {
-	sqlite3_stmt*				statement;				// Database query statement
+	sqlite3_stmt*				statement;				// SQL statement to execute
 	int							tuners = 0;				// Number of tuners found
-	int							result;					// Result from SQLite function call
+	int							result;					// Result from SQLite function
+	std::exception_ptr			broadcasterror;			// Exception from broadcast discovery
+	std::exception_ptr			httperror;				// Exception from HTTP discovery
 
 	assert(instance != nullptr);
-														//
-	// NOTE: This had to be broken up into a multi-step query involving a temp table to avoid a SQLite bug/feature
-	// wherein using a function (http_request in this case) as part of a column definition is reevaluated when
-	// that column is subsequently used as part of a WHERE clause:
-	//
-	// [http://mailinglists.sqlite.org/cgi-bin/mailman/private/sqlite-users/2015-August/061083.html]
-	//
 
-	// Discover the devices from the HTTP API and insert them into the discover_device temp table
-	execute_non_query(instance, "drop table if exists discover_device_http");
-	execute_non_query(instance, "create temp table discover_device_http as select "
-		"coalesce(json_extract(discovery.value, '$.DeviceID'), json_extract(discovery.value, '$.StorageID')) as deviceid, "
-		"case when json_type(discovery.value, '$.DeviceID') is not null then 'tuner' when json_type(discovery.value, '$.StorageID') is not null then 'storage' else 'unknown' end as type, "
-		"http_request(json_extract(discovery.value, '$.DiscoverURL'), null) as data from json_each(http_request('http://api.hdhomerun.com/discover')) as discovery");
-	execute_non_query(instance, "insert into discover_device select deviceid, type, data from discover_device_http where data is not null and json_extract(data, '$.Legacy') is null");
-	execute_non_query(instance, "drop table discover_device_http");
+	// The UDP broadcast does not involve the database, start it on a separate thread and let it run while the
+	// device list is retrieved from the HTTP API.  Destruction of the future<> waits for the thread to complete
+	std::future<std::vector<std::string>> broadcast = std::async(std::launch::async, discover_devices_broadcast);
+
+	// url | deviceid | type | broadcast | data
+	execute_non_query(instance, "drop table if exists discover_device_concurrent");
+	execute_non_query(instance, "create temp table discover_device_concurrent(url text primary key not null, deviceid text, type text, broadcast integer, data text)");
+
+	try {
+
+		// Load the devices discovered from the HTTP API; a failure here is only fatal if broadcast discovery fails too
+		try {
+		
+			execute_non_query(instance, "insert or ignore into discover_device_concurrent select json_extract(discovery.value, '$.DiscoverURL'), "
+				"coalesce(json_extract(discovery.value, '$.DeviceID'), json_extract(discovery.value, '$.StorageID')), "
+				"case when json_type(discovery.value, '$.DeviceID') is not null then 'tuner' when json_type(discovery.value, '$.StorageID') is not null then 'storage' else 'unknown' end, "
+				"0, null from http_json_each('http://api.hdhomerun.com/discover') as discovery where json_extract(discovery.value, '$.DiscoverURL') is not null");
+		}
+
+		catch(...) { httperror = std::current_exception(); }
 
-	// Determine if any tuner devices were discovered from the HTTP discovery query
+		// Load the devices discovered from UDP broadcast; these replace any entries with the same URL from the HTTP API
+		try {
+
+			std::vector<std::string> devices = broadcast.get();
+
+			auto sql = "insert or replace into discover_device_concurrent values(?3 || '/discover.json', ?1, ?2, 1, null)";
+			result = prepare_statement(instance, sql, &statement);
+			if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+			try {
+
+				for(size_t index = 0; (index + 2) < devices.size(); index += 3) {
+
+					// Bind the query parameter(s)
+					result = sqlite3_bind_text(statement, 1, devices[index].c_str(), -1, SQLITE_STATIC);
+					if(result == SQLITE_OK) result = sqlite3_bind_text(statement, 2, devices[index + 1].c_str(), -1, SQLITE_STATIC);
+					if(result == SQLITE_OK) result = sqlite3_bind_text(statement, 3, devices[index + 2].c_str(), -1, SQLITE_STATIC);
+					if(result != SQLITE_OK) throw sqlite_exception(result);
+
+					// This is a non-query, it's not expected to return any rows
+					result = sqlite3_step(statement);
+					if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+					if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+					// Reset the prepared statement so that it can be executed again
+					result = sqlite3_reset(statement);
+					if(result != SQLITE_OK) throw sqlite_exception(result);
+				}
+
+				// Finalize the statement after all devices have been processed
+				release_statement(statement);
+			}
+
+			catch(...) { release_statement(statement); throw; }
+		}
+
+		catch(...) { broadcasterror = std::current_exception(); }
+
+		// Retrieve the discovery JSON for every device from both mechanisms concurrently, failures are ignored
+		http_request_multi(instance, "discover_device_concurrent", true, g_httpconcurrency.load());
+
+		// Move each uniquely identified device into the discover_device table. The broadcast mechanism has no means to
+		// return the StorageID and legacy devices are only accepted from broadcast, matching the individual mechanisms
+		auto insertsql = sqlite3_mprintf("insert into discover_device select deviceid, type, data from (select deviceid, type, data, min(priority) from "
+			"(select case when type = 'storage' then coalesce(json_extract(data, '$.StorageID'), '00000000') else coalesce(json_extract(data, '$.DeviceID'), deviceid) end as deviceid, "
+			"type, data, case when broadcast = %d then 0 else 1 end as priority from discover_device_concurrent "
+			"where data is not null and (broadcast = 1 or json_extract(data, '$.Legacy') is null)) where deviceid is not null group by deviceid)", (usebroadcast) ? 1 : 0);
+		if(insertsql == nullptr) throw std::bad_alloc();
+
+		try { execute_non_query(instance, insertsql); sqlite3_free(insertsql); }
+		catch(...) { sqlite3_free(insertsql); throw; }
+
+		execute_non_query(instance, "drop table discover_device_concurrent");
+	}
+
+	// Drop the temporary table on any exception
+	catch(...) { execute_non_query(instance, "drop table discover_device_concurrent"); throw; }
+
+	// Determine if any tuner devices were discovered by either of the mechanisms
 	auto sql = "select count(deviceid) as numtuners from discover_device where type = 'tuner'";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try { 
@@ -790,11 +1869,22 @@ bool discover_devices_http(sqlite3* instance)
 		if(result == SQLITE_ROW) tuners = sqlite3_column_int(statement, 0);
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
-		return (tuners > 0);
+		release_statement(statement);
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
+
+	// If no tuners were discovered, report the exception thrown by the preferred mechanism if there was one
+	if(tuners == 0) {
+
+		std::exception_ptr preferred = (usebroadcast) ? broadcasterror : httperror;
+		std::exception_ptr secondary = (usebroadcast) ? httperror : broadcasterror;
+
+		if(preferred) std::rethrow_exception(preferred);
+		if(secondary) std::rethrow_exception(secondary);
+	}
+
+	return (tuners > 0);
 }
 
 //---------------------------------------------------------------------------
@@ -834,13 +1924,34 @@ void discover_episodes(sqlite3* instance, bool& changed)
 
 	try {
 
-		// Discover the episode information for each series that has a recording rule
-		execute_non_query(instance, "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-			"insert into discover_episode select entry.seriesid as seriesid, "
-			"http_request('http://api.hdhomerun.com/api/episodes?DeviceAuth=' || coalesce(deviceauth.code, '') || '&SeriesID=' || entry.seriesid) as data "
-			"from deviceauth, (select distinct json_extract(data, '$.SeriesID') as seriesid from recordingrule where seriesid is not null) as entry");
+		// Discover the episode information for each series that has a recording rule; the requests for
+		// each individual series are executed concurrently via an intermediate temp table that has been
+		// preloaded with the existing episode data to allow for conditional requests
+		execute_non_query(instance, "drop table if exists discover_episode_http");
+		execute_non_query(instance, "create temp table discover_episode_http as "
+			"with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
+			"select entry.seriesid as seriesid, "
+			"'http://api.hdhomerun.com/api/episodes?DeviceAuth=' || coalesce(deviceauth.code, '') || '&SeriesID=' || entry.seriesid as url, episode.data as data "
+			"from deviceauth, (select distinct json_extract(data, '$.SeriesID') as seriesid from recordingrule where seriesid is not null) as entry "
+			"left outer join episode on episode.seriesid = entry.seriesid");
+		bool modified = http_request_multi(instance, "discover_episode_http", false, g_httpconcurrency.load());
+
+		// If none of the episode data has been modified, or all of it matches the fingerprints of the data that was last
+		// applied for each series, the only possible change is the removal of a series and no transaction is required
+		if(!modified || !check_fingerprints(instance, "episode", "discover_episode_http", "seriesid", "data")) {
+
+			if(execute_non_query(instance, "delete from episode where seriesid not in (select seriesid from discover_episode_http)") > 0) changed = true;
+			execute_non_query(instance, "delete from fingerprint where source = 'episode' and id not in (select seriesid from discover_episode_http)");
+
+			execute_non_query(instance, "drop table discover_episode_http");
+			execute_non_query(instance, "drop table discover_episode");
+			return;
+		}
+
+		execute_non_query(instance, "insert into discover_episode select seriesid, data from discover_episode_http");
 
 		// This requires a multi-step operation against the episode table; start a transaction
+		std::unique_lock<std::mutex> writelock(g_writelock);
 		execute_non_query(instance, "begin immediate transaction");
 
 		try {
@@ -856,6 +1967,9 @@ void discover_episodes(sqlite3* instance, bool& changed)
 			if(execute_non_query(instance, "replace into episode select discover_episode.* from discover_episode left outer join episode using(seriesid) "
 				"where (discover_episode.data not like 'null') and (coalesce(episode.data, '') <> coalesce(discover_episode.data, ''))") > 0) changed = true;
 
+			// Replace the fingerprints for each series with those of the data that was just applied
+			update_fingerprints(instance, "episode", "discover_episode_http", "seriesid", "data");
+
 			// Commit the database transaction
 			execute_non_query(instance, "commit transaction");
 		}
@@ -863,12 +1977,15 @@ void discover_episodes(sqlite3* instance, bool& changed)
 		// Rollback the transaction on any exception
 		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
 
-		// Drop the temporary table
+		writelock.unlock();
+
+		// Drop the temporary tables
+		execute_non_query(instance, "drop table discover_episode_http");
 		execute_non_query(instance, "drop table discover_episode");
 	}
 
-	// Drop the temporary table on any exception
-	catch(...) { execute_non_query(instance, "drop table discover_episode"); throw; }
+	// Drop the temporary tables on any exception
+	catch(...) { try_execute_non_query(instance, "drop table if exists discover_episode_http"); execute_non_query(instance, "drop table discover_episode"); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -915,9 +2032,21 @@ void discover_guide(sqlite3* instance, bool& changed)
 			"json_extract(discovery.value, '$.GuideName') as channelname, "
 			"json_extract(discovery.value, '$.ImageURL') as iconurl, "
 			"null as data "
-			"from deviceauth, json_each(http_request('http://api.hdhomerun.com/api/guide?DeviceAuth=' || coalesce(deviceauth.code, ''))) as discovery");
+			"from deviceauth, http_json_each('http://api.hdhomerun.com/api/guide?DeviceAuth=' || coalesce(deviceauth.code, '')) as discovery");
+
+		// If all of the channels match the fingerprints of the data that was last applied, the only possible
+		// change is the removal of a channel and no transaction is required
+		if(!check_fingerprints(instance, "guide", "discover_guide", "channelid", "channelname, iconurl")) {
+
+			if(execute_non_query(instance, "delete from guide where channelid not in (select channelid from discover_guide)") > 0) changed = true;
+			execute_non_query(instance, "delete from fingerprint where source = 'guide' and id not in (select channelid from discover_guide)");
+
+			execute_non_query(instance, "drop table discover_guide");
+			return;
+		}
 
 		// This requires a multi-step operation against the guide table; start a transaction
+		std::unique_lock<std::mutex> writelock(g_writelock);
 		execute_non_query(instance, "begin immediate transaction");
 
 		try {
@@ -930,6 +2059,9 @@ void discover_guide(sqlite3* instance, bool& changed)
 				"where coalesce(guide.channelname, '') <> coalesce(discover_guide.channelname, '') "
 				"or coalesce(guide.iconurl, '') <> coalesce(discover_guide.iconurl, '')") > 0) changed = true;
 
+			// Replace the fingerprints for each channel with those of the data that was just applied
+			update_fingerprints(instance, "guide", "discover_guide", "channelid", "channelname, iconurl");
+
 			// Commit the database transaction
 			execute_non_query(instance, "commit transaction");
 		}
@@ -937,6 +2069,8 @@ void discover_guide(sqlite3* instance, bool& changed)
 		// Rollback the transaction on any exception
 		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
 
+		writelock.unlock();
+
 		// Drop the temporary table
 		execute_non_query(instance, "drop table discover_guide");
 	}
@@ -945,6 +2079,198 @@ void discover_guide(sqlite3* instance, bool& changed)
 	catch(...) { execute_non_query(instance, "drop table discover_guide"); throw; }
 }
 
+//---------------------------------------------------------------------------
+// discover_guideentries
+//
+// Loads the electronic program guide entries for the specified time frame
+//
+// Arguments:
+//
+//	instance	- SQLite database instance
+//	maxdays		- Number of days from now to load guide entries for
+
+void discover_guideentries(sqlite3* instance, int maxdays)
+{
+	return discover_guideentries(instance, maxdays, nullptr);
+}
+
+//---------------------------------------------------------------------------
+// discover_guideentries
+//
+// Loads the electronic program guide entries for the specified time frame
+//
+// Arguments:
+//
+//	instance	- SQLite database instance
+//	maxdays		- Number of days from now to load guide entries for
+//	callback	- Callback function invoked for each channel with changed entries
+
+void discover_guideentries(sqlite3* instance, int maxdays, enumerate_channelids_callback callback)
+{
+	sqlite3_stmt*				statement;			// SQL statement to execute
+	int							result;				// Result from SQLite function
+
+	if(instance == nullptr) throw std::invalid_argument("instance");
+
+	// If the maximum number of days wasn't provided, use a month as the boundary
+	if(maxdays < 0) maxdays = 31;
+
+	// Nothing older than 4 hours in the past is kept (14400 = (60 * 60 * 4) = 4 hours)
+	time_t now = time(nullptr);
+	time_t oldest = now - 14400;
+	time_t horizon = now + (static_cast<time_t>(maxdays) * 86400);
+
+	// Guide entries that haven't been refreshed in 24 hours are requested again (86400 = (60 * 60 * 24) = 24 hours)
+	time_t stale = now - 86400;
+
+	// Remove any guide entries that have expired or belong to channels that are no longer in the lineup
+	auto sql = sqlite3_mprintf("delete from guideentry where endtime < %lld or channelid not in (select channelid from lineupentry)", static_cast<long long>(oldest));
+	if(sql == nullptr) throw std::bad_alloc();
+
+	try { execute_non_query(instance, sql); sqlite3_free(reinterpret_cast<void*>(sql)); }
+	catch(...) { sqlite3_free(reinterpret_cast<void*>(sql)); throw; }
+
+	// discover_guideentry_channel: channelid(pk) | starttime | changed
+	// discover_guideentry_http: channelid | url | data
+	// discover_guideentry: channelid | starttime | endtime | seriesid | data | discovered
+	execute_non_query(instance, "drop table if exists discover_guideentry_channel");
+	execute_non_query(instance, "drop table if exists discover_guideentry_http");
+	execute_non_query(instance, "drop table if exists discover_guideentry");
+	execute_non_query(instance, "create temp table discover_guideentry_channel(channelid integer primary key not null, starttime integer, changed integer not null)");
+	execute_non_query(instance, "create temp table discover_guideentry_http(channelid integer not null, url text, data blob)");
+	execute_non_query(instance, "create temp table discover_guideentry as select * from guideentry limit 0");
+
+	try {
+
+		// The first request for each channel always starts at the current time to pick up any changes to the entries
+		// that are about to air, channels without any guide entries yet start at the oldest time that will be kept
+		sql = sqlite3_mprintf("insert into discover_guideentry_channel select channelid, "
+			"case when exists(select 1 from guideentry where guideentry.channelid = lineupchannel.channelid) then %lld else %lld end, 0 "
+			"from (select distinct(channelid) as channelid from lineupentry) as lineupchannel",
+			static_cast<long long>(now), static_cast<long long>(oldest));
+		if(sql == nullptr) throw std::bad_alloc();
+
+		try { execute_non_query(instance, sql); sqlite3_free(reinterpret_cast<void*>(sql)); }
+		catch(...) { sqlite3_free(reinterpret_cast<void*>(sql)); throw; }
+
+		while(true) {
+
+			// Generate the guide request for each channel that has not yet reached the end of the time frame
+			execute_non_query(instance, "delete from discover_guideentry_http");
+			sql = sqlite3_mprintf("with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
+				"insert into discover_guideentry_http select channelid, "
+				"'http://api.hdhomerun.com/api/guide?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Channel=' || decode_channel_id(channelid) || '&Start=' || starttime, null "
+				"from deviceauth, discover_guideentry_channel where starttime is not null and starttime < %lld", static_cast<long long>(horizon));
+			if(sql == nullptr) throw std::bad_alloc();
+
+			try { if(execute_non_query(instance, sql) == 0) { sqlite3_free(reinterpret_cast<void*>(sql)); break; } sqlite3_free(reinterpret_cast<void*>(sql)); }
+			catch(...) { sqlite3_free(reinterpret_cast<void*>(sql)); throw; }
+
+			// Execute the guide requests for all of the channels concurrently; a failed request leaves the data null and
+			// that channel is finished for this pass rather than abandoning the requests for all of the other channels
+			http_request_multi(instance, "discover_guideentry_http", true, g_httpconcurrency.load());
+
+			// Each guide request URL is unique; don't let the validator cache accumulate entries for them
+			execute_non_query(instance, "delete from httpcache where url like 'http://api.hdhomerun.com/api/guide?%&Start=%'");
+
+			execute_non_query(instance, "delete from discover_guideentry");
+			sql = sqlite3_mprintf("insert into discover_guideentry select discover_guideentry_http.channelid, "
+				"json_extract(entry.value, '$.StartTime') as starttime, "
+				"json_extract(entry.value, '$.EndTime') as endtime, "
+				"json_extract(entry.value, '$.SeriesID') as seriesid, "
+				"entry.value as data, "
+				"%lld as discovered "
+				"from discover_guideentry_http, json_each(json_extract(nullif(discover_guideentry_http.data, 'null'), '$[0].Guide')) as entry "
+				"where json_extract(entry.value, '$.StartTime') is not null and json_extract(entry.value, '$.EndTime') is not null", static_cast<long long>(now));
+			if(sql == nullptr) throw std::bad_alloc();
+
+			try { execute_non_query(instance, sql); sqlite3_free(reinterpret_cast<void*>(sql)); }
+			catch(...) { sqlite3_free(reinterpret_cast<void*>(sql)); throw; }
+
+			// This requires a multi-step operation against the guideentry table; start a transaction
+			std::unique_lock<std::mutex> writelock(g_writelock);
+			execute_non_query(instance, "begin immediate transaction");
+
+			try {
+
+				// Flag the channels that have new or different guide entries, or have existing guide entries
+				// within the time period covered by the response that are no longer present in the data
+				execute_non_query(instance, "with period(channelid, starttime, endtime) as (select channelid, min(starttime), max(endtime) from discover_guideentry group by channelid) "
+					"update discover_guideentry_channel set changed = 1 where channelid in ("
+					"select channelid from discover_guideentry where not exists(select 1 from guideentry where guideentry.channelid = discover_guideentry.channelid "
+					"and guideentry.starttime = discover_guideentry.starttime and guideentry.endtime = discover_guideentry.endtime and guideentry.data is discover_guideentry.data) "
+					"union select guideentry.channelid from guideentry inner join period on guideentry.channelid = period.channelid "
+					"and guideentry.starttime >= period.starttime and guideentry.starttime < period.endtime "
+					"where not exists(select 1 from discover_guideentry where discover_guideentry.channelid = guideentry.channelid and discover_guideentry.starttime = guideentry.starttime))");
+
+				// Replace all of the existing guide entries within the time period covered by the response
+				execute_non_query(instance, "with period(channelid, starttime, endtime) as (select channelid, min(starttime), max(endtime) from discover_guideentry group by channelid) "
+					"delete from guideentry where exists(select 1 from period where period.channelid = guideentry.channelid "
+					"and guideentry.starttime >= period.starttime and guideentry.starttime < period.endtime)");
+				execute_non_query(instance, "replace into guideentry select * from discover_guideentry");
+
+				// Commit the database transaction
+				execute_non_query(instance, "commit transaction");
+			}
+
+			// Rollback the transaction on any exception
+			catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
+
+			writelock.unlock();
+
+			// Move each channel past the entries that were just returned to the next guide entry that has gone stale, or to the
+			// end of the known guide entries if none of the remaining ones have.  If nothing was returned and the request was
+			// for a time in the past, move to the current time and try again.  Otherwise that channel is complete
+			sql = sqlite3_mprintf("with response(channelid, endtime) as (select channelid, max(endtime) from discover_guideentry group by channelid) "
+				"update discover_guideentry_channel set starttime = "
+				"case when coalesce((select endtime from response where response.channelid = discover_guideentry_channel.channelid), 0) > starttime "
+				"then coalesce((select min(guideentry.starttime) from guideentry inner join response on guideentry.channelid = response.channelid "
+				"where guideentry.channelid = discover_guideentry_channel.channelid and guideentry.starttime >= response.endtime and guideentry.discovered < %lld), "
+				"(select max(endtime) from guideentry where guideentry.channelid = discover_guideentry_channel.channelid)) "
+				"when starttime < %lld then %lld else null end where starttime is not null", static_cast<long long>(stale), static_cast<long long>(now), static_cast<long long>(now));
+			if(sql == nullptr) throw std::bad_alloc();
+
+			try { execute_non_query(instance, sql); sqlite3_free(reinterpret_cast<void*>(sql)); }
+			catch(...) { sqlite3_free(reinterpret_cast<void*>(sql)); throw; }
+		}
+
+		// Invoke the callback for each channel that had guide entry changes
+		if(callback != nullptr) {
+
+			result = sqlite3_prepare_v2(instance, "select channelid from discover_guideentry_channel where changed = 1", -1, &statement, nullptr);
+			if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+			try {
+
+				while(sqlite3_step(statement) == SQLITE_ROW) {
+
+					union channelid channelid;
+					channelid.value = static_cast<unsigned int>(sqlite3_column_int(statement, 0));
+					callback(channelid);
+				}
+
+				sqlite3_finalize(statement);
+			}
+
+			catch(...) { sqlite3_finalize(statement); throw; }
+		}
+
+		// Drop the temporary tables
+		execute_non_query(instance, "drop table discover_guideentry");
+		execute_non_query(instance, "drop table discover_guideentry_http");
+		execute_non_query(instance, "drop table discover_guideentry_channel");
+	}
+
+	// Drop the temporary tables on any exception
+	catch(...) {
+
+		execute_non_query(instance, "drop table discover_guideentry");
+		execute_non_query(instance, "drop table discover_guideentry_http");
+		execute_non_query(instance, "drop table discover_guideentry_channel");
+		throw;
+	}
+}
+
 //---------------------------------------------------------------------------
 // discover_lineups
 //
@@ -990,13 +2316,29 @@ void discover_lineups(sqlite3* instance, bool& changed)
 		// [http://mailinglists.sqlite.org/cgi-bin/mailman/private/sqlite-users/2015-August/061083.html]
 		//
 
-		// Discover the channel lineups for all available tuner devices; watch for results that return 'null'
+		// Discover the channel lineups for all available tuner devices concurrently; watch for results that return 'null'.
+		// The temp table is preloaded with the existing lineup data to allow for conditional requests
 		execute_non_query(instance, "drop table if exists discover_lineup_temp");
-		execute_non_query(instance, "create temp table discover_lineup_temp as select deviceid, http_request(json_extract(device.data, '$.LineupURL') || '?show=demo') as json from device where device.type = 'tuner'");
-		execute_non_query(instance, "insert into discover_lineup select deviceid, json from discover_lineup_temp where cast(json as text) <> 'null'");
-		execute_non_query(instance, "drop table discover_lineup_temp");
+		execute_non_query(instance, "create temp table discover_lineup_temp as select device.deviceid as deviceid, json_extract(device.data, '$.LineupURL') || '?show=demo' as url, "
+			"lineup.data as data from device left outer join lineup using(deviceid) where device.type = 'tuner'");
+		bool modified = http_request_multi(instance, "discover_lineup_temp", false, g_httpconcurrency.load());
+
+		// If none of the lineup data has been modified, or all of it matches the fingerprints of the data that was last
+		// applied for each device, the only possible change is the removal of a tuner device and no transaction is required
+		if(!modified || !check_fingerprints(instance, "lineup", "discover_lineup_temp", "deviceid", "data")) {
+
+			if(execute_non_query(instance, "delete from lineup where deviceid not in (select deviceid from discover_lineup_temp)") > 0) changed = true;
+			execute_non_query(instance, "delete from fingerprint where source = 'lineup' and id not in (select deviceid from discover_lineup_temp)");
+
+			execute_non_query(instance, "drop table discover_lineup_temp");
+			execute_non_query(instance, "drop table discover_lineup");
+			return;
+		}
+
+		execute_non_query(instance, "insert into discover_lineup select deviceid, data from discover_lineup_temp where cast(data as text) <> 'null'");
 
 		// This requires a multi-step operation against the lineup table; start a transaction
+		std::unique_lock<std::mutex> writelock(g_writelock);
 		execute_non_query(instance, "begin immediate transaction");
 
 		try {
@@ -1008,6 +2350,9 @@ void discover_lineups(sqlite3* instance, bool& changed)
 			if(execute_non_query(instance, "replace into lineup select discover_lineup.* from discover_lineup left outer join lineup using(deviceid) "
 				"where coalesce(lineup.data, '') <> coalesce(discover_lineup.data, '')") > 0) changed = true;
 
+			// Replace the fingerprints for each device with those of the data that was just applied
+			update_fingerprints(instance, "lineup", "discover_lineup_temp", "deviceid", "data");
+
 			// Commit the database transaction
 			execute_non_query(instance, "commit transaction");
 		}
@@ -1015,12 +2360,15 @@ void discover_lineups(sqlite3* instance, bool& changed)
 		// Rollback the transaction on any exception
 		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
 
-		// Drop the temporary table
+		writelock.unlock();
+
+		// Drop the temporary tables
+		execute_non_query(instance, "drop table discover_lineup_temp");
 		execute_non_query(instance, "drop table discover_lineup");
 	}
 
-	// Drop the temporary table on any exception
-	catch(...) { execute_non_query(instance, "drop table discover_lineup"); throw; }
+	// Drop the temporary tables on any exception
+	catch(...) { try_execute_non_query(instance, "drop table if exists discover_lineup_temp"); execute_non_query(instance, "drop table discover_lineup"); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1065,10 +2413,22 @@ void discover_recordingrules(sqlite3* instance, bool& changed)
 			"insert into discover_recordingrule select "
 			"json_extract(value, '$.RecordingRuleID') as recordingruleid, "
 			"json_extract(value, '$.SeriesID') as seriesid, "
-			"value as data "
-			"from deviceauth, json_each(http_request('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, '')))");
+			"json(value) as data "
+			"from deviceauth, http_json_each('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, ''))");
+
+		// If all of the recording rules match the fingerprints of the data that was last applied, the only possible
+		// change is the removal of a recording rule and no transaction is required
+		if(!check_fingerprints(instance, "recordingrule", "discover_recordingrule", "recordingruleid", "seriesid, data")) {
+
+			if(execute_non_query(instance, "delete from recordingrule where recordingruleid not in (select recordingruleid from discover_recordingrule)") > 0) changed = true;
+			execute_non_query(instance, "delete from fingerprint where source = 'recordingrule' and id not in (select recordingruleid from discover_recordingrule)");
+
+			execute_non_query(instance, "drop table discover_recordingrule");
+			return;
+		}
 
 		// This requires a multi-step operation against the recording table; start a transaction
+		std::unique_lock<std::mutex> writelock(g_writelock);
 		execute_non_query(instance, "begin immediate transaction");
 
 		try {
@@ -1082,6 +2442,9 @@ void discover_recordingrules(sqlite3* instance, bool& changed)
 				"where coalesce(recordingrule.seriesid, '') <> coalesce(discover_recordingrule.seriesid, '') "
 				"or coalesce(recordingrule.data, '') <> coalesce(discover_recordingrule.data, '')") > 0) changed = true;
 
+			// Replace the fingerprints for each recording rule with those of the data that was just applied
+			update_fingerprints(instance, "recordingrule", "discover_recordingrule", "recordingruleid", "seriesid, data");
+
 			// Commit the database transaction
 			execute_non_query(instance, "commit transaction");
 		}
@@ -1089,6 +2452,8 @@ void discover_recordingrules(sqlite3* instance, bool& changed)
 		// Rollback the transaction on any exception
 		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
 
+		writelock.unlock();
+
 		// Drop the temporary table
 		execute_non_query(instance, "drop table discover_recordingrule");
 	}
@@ -1134,11 +2499,29 @@ void discover_recordings(sqlite3* instance, bool& changed)
 
 	try {
 
-		// Discover the recording information for all available storage devices
-		execute_non_query(instance, "insert into discover_recording select deviceid, http_request(json_extract(device.data, '$.StorageURL')) "
-			"from device where device.type = 'storage'");
+		// Discover the recording information for all available storage devices concurrently; the temp table is
+		// preloaded with the existing recording data to allow for conditional requests
+		execute_non_query(instance, "drop table if exists discover_recording_http");
+		execute_non_query(instance, "create temp table discover_recording_http as select device.deviceid as deviceid, json_extract(device.data, '$.StorageURL') as url, "
+			"recording.data as data from device left outer join recording using(deviceid) where device.type = 'storage'");
+		bool modified = http_request_multi(instance, "discover_recording_http", false, g_httpconcurrency.load());
+
+		// If none of the recording data has been modified, or all of it matches the fingerprints of the data that was last
+		// applied for each device, the only possible change is the removal of a storage device and no transaction is required
+		if(!modified || !check_fingerprints(instance, "recording", "discover_recording_http", "deviceid", "data")) {
+
+			if(execute_non_query(instance, "delete from recording where deviceid not in (select deviceid from discover_recording_http)") > 0) changed = true;
+			execute_non_query(instance, "delete from fingerprint where source = 'recording' and id not in (select deviceid from discover_recording_http)");
+
+			execute_non_query(instance, "drop table discover_recording_http");
+			execute_non_query(instance, "drop table discover_recording");
+			return;
+		}
+
+		execute_non_query(instance, "insert into discover_recording select deviceid, data from discover_recording_http");
 
 		// This requires a multi-step operation against the recording table; start a transaction
+		std::unique_lock<std::mutex> writelock(g_writelock);
 		execute_non_query(instance, "begin immediate transaction");
 
 		try {
@@ -1150,6 +2533,9 @@ void discover_recordings(sqlite3* instance, bool& changed)
 			if(execute_non_query(instance, "replace into recording select discover_recording.* from discover_recording left outer join recording using(deviceid) "
 				"where coalesce(recording.data, '') <> coalesce(discover_recording.data, '')") > 0) changed = true;
 
+			// Replace the fingerprints for each device with those of the data that was just applied
+			update_fingerprints(instance, "recording", "discover_recording_http", "deviceid", "data");
+
 			// Commit the database transaction
 			execute_non_query(instance, "commit transaction");
 		}
@@ -1157,12 +2543,15 @@ void discover_recordings(sqlite3* instance, bool& changed)
 		// Rollback the transaction on any exception
 		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
 
-		// Drop the temporary table
+		writelock.unlock();
+
+		// Drop the temporary tables
+		execute_non_query(instance, "drop table discover_recording_http");
 		execute_non_query(instance, "drop table discover_recording");
 	}
 
-	// Drop the temporary table on any exception
-	catch(...) { execute_non_query(instance, "drop table discover_recording"); throw; }
+	// Drop the temporary tables on any exception
+	catch(...) { try_execute_non_query(instance, "drop table if exists discover_recording_http"); execute_non_query(instance, "drop table discover_recording"); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1223,16 +2612,16 @@ void enumerate_channels(sqlite3* instance, bool prependnumbers, bool showdrm, en
 
 	// channelid | channelname | iconurl | drm
 	auto sql = "select "
-		"distinct(encode_channel_id(json_extract(entry.value, '$.GuideNumber'))) as channelid, "
-		"case when ?1 then json_extract(entry.value, '$.GuideNumber') || ' ' else '' end || "
-		"case when guide.channelid is null then json_extract(entry.value, '$.GuideName') else guide.channelname end as channelname, "
+		"distinct(lineupentry.channelid) as channelid, "
+		"case when ?1 then lineupentry.guidenumber || ' ' else '' end || "
+		"case when guide.channelid is null then lineupentry.guidename else guide.channelname end as channelname, "
 		"guide.iconurl as iconurl, "
-		"coalesce(json_extract(entry.value, '$.DRM'), 0) as drm "
-		"from lineup, json_each(lineup.data) as entry left outer join guide on encode_channel_id(json_extract(entry.value, '$.GuideNumber')) = guide.channelid "
-		"where nullif(json_extract(entry.value, '$.DRM'), ?2) is null "
+		"coalesce(lineupentry.drm, 0) as drm "
+		"from lineupentry left outer join guide on lineupentry.channelid = guide.channelid "
+		"where nullif(lineupentry.drm, ?2) is null "
 		"order by channelid";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1254,10 +2643,10 @@ void enumerate_channels(sqlite3* instance, bool prependnumbers, bool showdrm, en
 			callback(item);						// Invoke caller-supplied callback
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1279,10 +2668,9 @@ void enumerate_channelids(sqlite3* instance, bool showdrm, enumerate_channelids_
 	if((instance == nullptr) || (callback == nullptr)) return;
 
 	// channelid
-	auto sql = "select distinct(encode_channel_id(json_extract(entry.value, '$.GuideNumber'))) as channelid "
-		"from lineup, json_each(lineup.data) as entry where nullif(json_extract(entry.value, '$.DRM'), ?1) is null";
+	auto sql = "select distinct(channelid) as channelid from lineupentry where nullif(drm, ?1) is null";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1300,10 +2688,10 @@ void enumerate_channelids(sqlite3* instance, bool showdrm, enumerate_channelids_
 			callback(channelid);
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1329,10 +2717,10 @@ void enumerate_channeltuners(sqlite3* instance, union channelid channelid, enume
 		"(select deviceid, json_extract(device.data, '$.TunerCount') - 1 from device where type = 'tuner' "
 		"union all select deviceid, tunerid - 1 from tuners where tunerid > 0) "
 		"select tuners.deviceid || '-' || tuners.tunerid as tunerid "
-		"from tuners inner join lineup using(deviceid), json_each(lineup.data) as lineupdata "
-		"where json_extract(lineupdata.value, '$.GuideNumber') = decode_channel_id(?1) order by tunerid desc";
+		"from tuners inner join lineupentry using(deviceid) "
+		"where lineupentry.channelid = ?1 order by tunerid desc";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1344,10 +2732,10 @@ void enumerate_channeltuners(sqlite3* instance, union channelid channelid, enume
 		// Execute the query and iterate over all returned rows
 		while(sqlite3_step(statement) == SQLITE_ROW) callback(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1369,11 +2757,9 @@ void enumerate_demo_channelids(sqlite3* instance, bool showdrm, enumerate_channe
 	if((instance == nullptr) || (callback == nullptr)) return;
 
 	// channelid
-	auto sql = "select distinct(encode_channel_id(json_extract(entry.value, '$.GuideNumber'))) as channelid "
-		"from lineup, json_each(lineup.data) as entry where json_extract(entry.value, '$.Demo') = 1 "
-		"and nullif(json_extract(entry.value, '$.DRM'), ?1) is null";
+	auto sql = "select distinct(channelid) as channelid from lineupentry where demo = 1 and nullif(drm, ?1) is null";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1391,10 +2777,10 @@ void enumerate_demo_channelids(sqlite3* instance, bool showdrm, enumerate_channe
 			callback(channelid);
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1417,7 +2803,7 @@ void enumerate_device_names(sqlite3* instance, enumerate_device_names_callback c
 	// name
 	auto sql = "select coalesce(json_extract(data, '$.FriendlyName'), 'unknown') || ' ' || deviceid as name from device";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1431,10 +2817,10 @@ void enumerate_device_names(sqlite3* instance, enumerate_device_names_callback c
 			callback(device_name);
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1455,10 +2841,9 @@ void enumerate_episode_channelids(sqlite3* instance, enumerate_channelids_callba
 	if((instance == nullptr) || (callback == nullptr)) return;
 
 	// channelid
-	auto sql = "select distinct(encode_channel_id(json_extract(value, '$.ChannelNumber'))) as channelid "
-		"from episode, json_each(episode.data) where channelid <> 0";
+	auto sql = "select distinct(channelid) as channelid from episodeentry where channelid <> 0";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1472,10 +2857,10 @@ void enumerate_episode_channelids(sqlite3* instance, enumerate_channelids_callba
 			callback(channelid);
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1497,11 +2882,9 @@ void enumerate_favorite_channelids(sqlite3* instance, bool showdrm, enumerate_ch
 	if((instance == nullptr) || (callback == nullptr)) return;
 
 	// channelid
-	auto sql = "select distinct(encode_channel_id(json_extract(entry.value, '$.GuideNumber'))) as channelid "
-		"from lineup, json_each(lineup.data) as entry where json_extract(entry.value, '$.Favorite') = 1 "
-		"and nullif(json_extract(entry.value, '$.DRM'), ?1) is null";
+	auto sql = "select distinct(channelid) as channelid from lineupentry where favorite = 1 and nullif(drm, ?1) is null";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1519,10 +2902,10 @@ void enumerate_favorite_channelids(sqlite3* instance, bool showdrm, enumerate_ch
 			callback(channelid);
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1547,7 +2930,7 @@ void enumerate_expired_recordingruleids(sqlite3* instance, int expiry, enumerate
 	auto sql = "select distinct(recordingruleid) as recordingruleid from recordingrule "
 		"where json_extract(data, '$.DateTimeOnly') < (cast(strftime('%s', 'now') as int) - ?1)";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1559,10 +2942,10 @@ void enumerate_expired_recordingruleids(sqlite3* instance, int expiry, enumerate
 		// Execute the query and iterate over all returned rows
 		while(sqlite3_step(statement) == SQLITE_ROW) callback(static_cast<unsigned int>(sqlite3_column_int(statement, 0)));
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1591,83 +2974,59 @@ void enumerate_guideentries(sqlite3* instance, union channelid channelid, time_t
 	starttime = std::max(starttime, now - 14400);
 
 	// seriesid | title | starttime | endtime | synopsis | year | iconurl | genretype | genres | originalairdate | seriesnumber | episodenumber | episodename
-	auto sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-		"select json_extract(entry.value, '$.SeriesID') as seriesid, "
-		"json_extract(entry.value, '$.Title') as title, "
-		"json_extract(entry.value, '$.StartTime') as starttime, "
-		"json_extract(entry.value, '$.EndTime') as endtime, "
-		"json_extract(entry.value, '$.Synopsis') as synopsis, "
-		"cast(strftime('%Y', coalesce(json_extract(entry.value, '$.OriginalAirdate'), 0), 'unixepoch') as int) as year, "
-		"json_extract(entry.value, '$.ImageURL') as iconurl, "
-		"coalesce((select genretype from genremap where filter like json_extract(entry.value, '$.Filter[0]')), 0) as genretype, "
-		"(select group_concat(value) from json_each(json_extract(entry.value, '$.Filter'))) as genres, "
-		"json_extract(entry.value, '$.OriginalAirdate') as originalairdate, "
-		"get_season_number(json_extract(entry.value, '$.EpisodeNumber')) as seriesnumber, "
-		"get_episode_number(json_extract(entry.value, '$.EpisodeNumber')) as episodenumber, "
-		"case when ?1 then coalesce(json_extract(value, '$.EpisodeNumber') || ' - ', '') else '' end || json_extract(entry.value, '$.EpisodeTitle') as episodename "
-		"from deviceauth, "
-		"json_each(json_extract(nullif(http_request('http://api.hdhomerun.com/api/guide?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Channel=' || decode_channel_id(?2) || '&Start=' || ?3), 'null'), '$[0].Guide')) as entry";
-
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	auto sql = "select seriesid, "
+		"json_extract(data, '$.Title') as title, "
+		"starttime, "
+		"endtime, "
+		"json_extract(data, '$.Synopsis') as synopsis, "
+		"cast(strftime('%Y', coalesce(json_extract(data, '$.OriginalAirdate'), 0), 'unixepoch') as int) as year, "
+		"json_extract(data, '$.ImageURL') as iconurl, "
+		"coalesce((select genretype from genremap where filter like json_extract(data, '$.Filter[0]')), 0) as genretype, "
+		"(select group_concat(value) from json_each(json_extract(data, '$.Filter'))) as genres, "
+		"json_extract(data, '$.OriginalAirdate') as originalairdate, "
+		"get_season_number(json_extract(data, '$.EpisodeNumber')) as seriesnumber, "
+		"get_episode_number(json_extract(data, '$.EpisodeNumber')) as episodenumber, "
+		"case when ?1 then coalesce(json_extract(data, '$.EpisodeNumber') || ' - ', '') else '' end || json_extract(data, '$.EpisodeTitle') as episodename "
+		"from guideentry where channelid = ?2 and starttime < ?4 and endtime > ?3 order by starttime";
+
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
 
-		while(starttime < endtime) {
-
-			// Bind the query parameters
-			result = sqlite3_bind_int(statement, 1, (prependnumber) ? 1 : 0);
-			if(result == SQLITE_OK) result = sqlite3_bind_int(statement, 2, channelid.value);
-			if(result == SQLITE_OK) result = sqlite3_bind_int(statement, 3, static_cast<int>(starttime));
-			if(result != SQLITE_OK) throw sqlite_exception(result);
-
-			// Execute the SQL statement
-			result = sqlite3_step(statement);
-			if((result != SQLITE_DONE) && (result != SQLITE_ROW)) throw sqlite_exception(result, sqlite3_errmsg(instance));
+		// Bind the query parameters
+		result = sqlite3_bind_int(statement, 1, (prependnumber) ? 1 : 0);
+		if(result == SQLITE_OK) result = sqlite3_bind_int(statement, 2, channelid.value);
+		if(result == SQLITE_OK) result = sqlite3_bind_int64(statement, 3, static_cast<sqlite3_int64>(starttime));
+		if(result == SQLITE_OK) result = sqlite3_bind_int64(statement, 4, static_cast<sqlite3_int64>(endtime));
+		if(result != SQLITE_OK) throw sqlite_exception(result);
 
-			// If no rows were returned from the query and the start time is still in the past,
-			// fast-forward it to the current time and try again.  Otherwise stop - no more data
-			if(result == SQLITE_DONE) {
-				
-				if(starttime < now) starttime = now;
-				else break;
-			}
+		// Execute the query and iterate over all returned rows
+		while(sqlite3_step(statement) == SQLITE_ROW) {
 
-			// Process each row returned from the query (if any)
-			while(result == SQLITE_ROW) {
-
-				struct guideentry item;
-				item.seriesid = reinterpret_cast<char const*>(sqlite3_column_text(statement, 0));
-				item.title = reinterpret_cast<char const*>(sqlite3_column_text(statement, 1));
-				item.channelid = channelid.value;
-				item.starttime = static_cast<unsigned int>(sqlite3_column_int(statement, 2));
-				item.endtime = static_cast<unsigned int>(sqlite3_column_int(statement, 3));
-				item.synopsis = reinterpret_cast<char const*>(sqlite3_column_text(statement, 4));
-				item.year = sqlite3_column_int(statement, 5);
-				item.iconurl = reinterpret_cast<char const*>(sqlite3_column_text(statement, 6));
-				item.genretype = sqlite3_column_int(statement, 7);
-				item.genres = reinterpret_cast<char const*>(sqlite3_column_text(statement, 8));
-				item.originalairdate = sqlite3_column_int(statement, 9);
-				item.seriesnumber = sqlite3_column_int(statement, 10);
-				item.episodenumber = sqlite3_column_int(statement, 11);
-				item.episodename = reinterpret_cast<char const*>(sqlite3_column_text(statement, 12));
-
-				// Move the starttime to the last seen endtime to continue the backend queries
-				if(item.endtime > starttime) starttime = item.endtime;
-
-				callback(item);							// Invoke caller-supplied callback
-				result = sqlite3_step(statement);		// Move to the next row of data
-			}
+			struct guideentry item;
+			item.seriesid = reinterpret_cast<char const*>(sqlite3_column_text(statement, 0));
+			item.title = reinterpret_cast<char const*>(sqlite3_column_text(statement, 1));
+			item.channelid = channelid.value;
+			item.starttime = static_cast<unsigned int>(sqlite3_column_int(statement, 2));
+			item.endtime = static_cast<unsigned int>(sqlite3_column_int(statement, 3));
+			item.synopsis = reinterpret_cast<char const*>(sqlite3_column_text(statement, 4));
+			item.year = sqlite3_column_int(statement, 5);
+			item.iconurl = reinterpret_cast<char const*>(sqlite3_column_text(statement, 6));
+			item.genretype = sqlite3_column_int(statement, 7);
+			item.genres = reinterpret_cast<char const*>(sqlite3_column_text(statement, 8));
+			item.originalairdate = sqlite3_column_int(statement, 9);
+			item.seriesnumber = sqlite3_column_int(statement, 10);
+			item.episodenumber = sqlite3_column_int(statement, 11);
+			item.episodename = reinterpret_cast<char const*>(sqlite3_column_text(statement, 12));
 
-			// Reset the prepared statement so that it can be executed again
-			result = sqlite3_reset(statement);
-			if(result != SQLITE_OK) throw sqlite_exception(result);
-		};
+			callback(item);						// Invoke caller-supplied callback
+		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1689,11 +3048,9 @@ void enumerate_hd_channelids(sqlite3* instance, bool showdrm, enumerate_channeli
 	if((instance == nullptr) || (callback == nullptr)) return;
 
 	// channelid
-	auto sql = "select distinct(encode_channel_id(json_extract(entry.value, '$.GuideNumber'))) as channelid "
-		"from lineup, json_each(lineup.data) as entry where json_extract(entry.value, '$.HD') = 1 "
-		"and nullif(json_extract(entry.value, '$.DRM'), ?1) is null";
+	auto sql = "select distinct(channelid) as channelid from lineupentry where hd = 1 and nullif(drm, ?1) is null";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1711,10 +3068,10 @@ void enumerate_hd_channelids(sqlite3* instance, bool showdrm, enumerate_channeli
 			callback(channelid);
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1752,24 +3109,24 @@ void enumerate_recordings(sqlite3* instance, bool episodeastitle, enumerate_reco
 
 	// recordingid | title | episodename | seriesnumber | episodenumber | year | streamurl | directory | plot | channelname | thumbnailpath | recordingtime | duration | lastposition | channelid
 	auto sql = "select "
-		"json_extract(value, '$.CmdURL') as recordingid, "
-		"case when ?1 then coalesce(json_extract(value, '$.EpisodeNumber'), json_extract(value, '$.Title')) else json_extract(value, '$.Title') end as title, "
-		"json_extract(value, '$.EpisodeTitle') as episodename, "
-		"get_season_number(json_extract(value, '$.EpisodeNumber')) as seriesnumber, "
-		"get_episode_number(json_extract(value, '$.EpisodeNumber')) as episodenumber, "
-		"cast(strftime('%Y', coalesce(json_extract(value, '$.OriginalAirdate'), 0), 'unixepoch') as int) as year, "
-		"json_extract(value, '$.PlayURL') as streamurl, "
-		"case when json_extract(value, '$.DisplayGroupTitle') is null then json_extract(value, '$.Title') else json_extract(value, '$.DisplayGroupTitle') end as directory, "
-		"json_extract(value, '$.Synopsis') as plot, "
-		"json_extract(value, '$.ChannelName') as channelname, "
-		"json_extract(value, '$.ImageURL') as thumbnailpath, "
-		"coalesce(json_extract(value, '$.RecordStartTime'), 0) as recordingtime, "
-		"coalesce(json_extract(value, '$.RecordEndTime'), 0) - coalesce(json_extract(value, '$.RecordStartTime'), 0) as duration, "
-		"coalesce(json_extract(value, '$.Resume'), 0) as lastposition, "
-		"encode_channel_id(json_extract(value, '$.ChannelNumber')) as channelid "
-		"from recording, json_each(recording.data)";
-
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+		"recordingid, "
+		"case when ?1 then coalesce(episodenumber, title) else title end as title, "
+		"episodetitle as episodename, "
+		"get_season_number(episodenumber) as seriesnumber, "
+		"get_episode_number(episodenumber) as episodenumber, "
+		"cast(strftime('%Y', coalesce(originalairdate, 0), 'unixepoch') as int) as year, "
+		"playurl as streamurl, "
+		"case when displaygrouptitle is null then title else displaygrouptitle end as directory, "
+		"synopsis as plot, "
+		"channelname, "
+		"imageurl as thumbnailpath, "
+		"coalesce(recordstarttime, 0) as recordingtime, "
+		"coalesce(recordendtime, 0) - coalesce(recordstarttime, 0) as duration, "
+		"coalesce(resume, 0) as lastposition, "
+		"channelid "
+		"from recordingentry";
+
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1801,10 +3158,10 @@ void enumerate_recordings(sqlite3* instance, bool episodeastitle, enumerate_reco
 			callback(item);						// Invoke caller-supplied callback
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1825,7 +3182,7 @@ void enumerate_recordingrules(sqlite3* instance, enumerate_recordingrules_callba
 	if((instance == nullptr) || (callback == nullptr)) return;
 
 	// recordingruleid | type | seriesid | channelid | recentonly | afteroriginalairdateonly | datetimeonly | title | synopsis | startpadding | endpadding
-	auto sql = "with guidenumbers(guidenumber) as (select distinct(json_extract(value, '$.GuideNumber')) as guidenumber from lineup, json_each(lineup.data)) "
+	auto sql = "with guidenumbers(guidenumber) as (select distinct(guidenumber) as guidenumber from lineupentry) "
 		"select recordingruleid, "
 		"case when json_extract(data, '$.DateTimeOnly') is null then 0 else 1 end as type, "
 		"json_extract(data, '$.SeriesID') as seriesid, "
@@ -1839,7 +3196,7 @@ void enumerate_recordingrules(sqlite3* instance, enumerate_recordingrules_callba
 		"coalesce(json_extract(data, '$.EndPadding'), 30) as endpadding "
 		"from recordingrule left outer join guidenumbers on json_extract(data, '$.ChannelOnly') = guidenumbers.guidenumber";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1863,10 +3220,10 @@ void enumerate_recordingrules(sqlite3* instance, enumerate_recordingrules_callba
 			callback(item);						// Invoke caller-supplied callback
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1888,11 +3245,9 @@ void enumerate_sd_channelids(sqlite3* instance, bool showdrm, enumerate_channeli
 	if((instance == nullptr) || (callback == nullptr)) return;
 
 	// channelid
-	auto sql = "select distinct(encode_channel_id(json_extract(entry.value, '$.GuideNumber'))) as channelid "
-		"from lineup, json_each(lineup.data) as entry where json_extract(entry.value, '$.HD') is null "
-		"and nullif(json_extract(entry.value, '$.DRM'), ?1) is null";
+	auto sql = "select distinct(channelid) as channelid from lineupentry where hd is null and nullif(drm, ?1) is null";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1910,10 +3265,10 @@ void enumerate_sd_channelids(sqlite3* instance, bool showdrm, enumerate_channeli
 			callback(channelid);
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1939,10 +3294,10 @@ void enumerate_series(sqlite3* instance, char const* title, enumerate_series_cal
 		"select "
 		"json_extract(value, '$.Title') as title, "
 		"json_extract(value, '$.SeriesID') as seriesid "
-		"from deviceauth, json_each(http_request('http://api.hdhomerun.com/api/search?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Search=' || url_encode(?1))) "
+		"from deviceauth, http_json_each('http://api.hdhomerun.com/api/search?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Search=' || url_encode(?1)) "
 		"where title like '%' || ?1 || '%'";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -1961,10 +3316,10 @@ void enumerate_series(sqlite3* instance, char const* title, enumerate_series_cal
 			callback(item);						// Invoke caller-supplied callback
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -1989,23 +3344,12 @@ void enumerate_timers(sqlite3* instance, int maxdays, enumerate_timers_callback
 	if(maxdays < 0) maxdays = 31;
 
 	// recordingruleid | parenttype | timerid | channelid | starttime | endtime | title | synopsis
-	auto sql = "with guidenumbers(guidenumber) as (select distinct(json_extract(value, '$.GuideNumber')) as guidenumber from lineup, json_each(lineup.data)) "
-		"select case when json_extract(recordingrule.data, '$.DateTimeOnly') is not null then recordingrule.recordingruleid else "
-		"(select recordingruleid from recordingrule where json_extract(recordingrule.data, '$.DateTimeOnly') is null and seriesid = episode.seriesid limit 1) end as recordingruleid, "
-		"case when json_extract(recordingrule.data, '$.DateTimeOnly') is not null then 1 else 0 end as parenttype, "
-		"fnv_hash(json_extract(value, '$.ProgramID'), json_extract(value, '$.StartTime'), json_extract(value, '$.ChannelNumber')) as timerid, "
-		"case when guidenumbers.guidenumber is null then -1 else encode_channel_id(json_extract(value, '$.ChannelNumber')) end as channelid, "
-		"json_extract(value, '$.StartTime') as starttime, "
-		"json_extract(value, '$.EndTime') as endtime, "
-		"json_extract(value, '$.Title') as title, "
-		"json_extract(value, '$.Synopsis') as synopsis "
-		"from episode, json_each(episode.data) "
-		"left outer join recordingrule on episode.seriesid = recordingrule.seriesid and json_extract(value, '$.StartTime') = json_extract(recordingrule.data, '$.DateTimeOnly') "
-		"left outer join guidenumbers on json_extract(value, '$.ChannelNumber') = guidenumbers.guidenumber "
-		"where json_extract(value, '$.RecordingRule') = 1 and "
-		"(starttime < (cast(strftime('%s', 'now') as integer) + (?1 * 86400)))";
+	auto sql = "select recordingruleid, parenttype, timerid, "
+		"case when exists(select 1 from lineupentry where lineupentry.channelid = timer.channelid) then timer.channelid else -1 end as channelid, "
+		"starttime, endtime, title, synopsis "
+		"from timer where starttime < (cast(strftime('%s', 'now') as integer) + (?1 * 86400))";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2030,10 +3374,47 @@ void enumerate_timers(sqlite3* instance, int maxdays, enumerate_timers_callback
 			callback(item);						// Invoke caller-supplied callback
 		}
 	
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
+}
+
+//---------------------------------------------------------------------------
+// enumerate_tuners
+//
+// Enumerates all of the tuners available on the discovered tuner devices
+//
+// Arguments:
+//
+//	instance	- Database instance
+//	callback	- Callback function
+
+void enumerate_tuners(sqlite3* instance, enumerate_tuners_callback callback)
+{
+	sqlite3_stmt*				statement;			// SQL statement to execute
+	int							result;				// Result from SQLite function
+	
+	if((instance == nullptr) || (callback == nullptr)) return;
+	
+	// tunerid
+	auto sql = "with recursive tuners(deviceid, tunerid) as "
+		"(select deviceid, json_extract(device.data, '$.TunerCount') - 1 from device where type = 'tuner' "
+		"union all select deviceid, tunerid - 1 from tuners where tunerid > 0) "
+		"select tuners.deviceid || '-' || tuners.tunerid as tunerid from tuners";
+
+	result = prepare_statement(instance, sql, &statement);
+	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+	try {
+
+		// Execute the query and iterate over all returned rows
+		while(sqlite3_step(statement) == SQLITE_ROW) callback(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
+	
+		release_statement(statement);			// Release the SQLite statement
+	}
+
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2083,34 +3464,35 @@ std::string find_seriesid(sqlite3* instance, union channelid channelid, time_t t
 
 	if(instance == nullptr) return 0;
 
-	// No guide data is stored locally anymore; always use the backend service to search for the seriesid.
-	// Use the electronic program guide API to locate a seriesid based on a channel and timestamp
-	auto sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-		"select json_extract(json_extract(nullif(http_request('http://api.hdhomerun.com/api/guide?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Channel=' || decode_channel_id(?1) || '&Start=' || ?2), 'null'), '$[0].Guide[0]'), '$.SeriesID') "
-		"from deviceauth";
+	// Use the locally stored guide entries to locate the seriesid airing on the channel at or after the timestamp
+	auto sql = "select seriesid from guideentry where channelid = ?1 and endtime > ?2 order by starttime limit 1";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
 
 		// Bind the query parameters(s)
 		result = sqlite3_bind_int(statement, 1, channelid.value);
-		if(result == SQLITE_OK) result = sqlite3_bind_int(statement, 2, static_cast<int>(timestamp));
+		if(result == SQLITE_OK) result = sqlite3_bind_int64(statement, 2, static_cast<sqlite3_int64>(timestamp));
 		if(result != SQLITE_OK) throw sqlite_exception(result);
 		
 		// Execute the scalar query
 		result = sqlite3_step(statement);
 
 		// There should be a single SQLITE_ROW returned from the initial step
-		if(result == SQLITE_ROW) seriesid.assign(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
+		if(result == SQLITE_ROW) {
+
+			char const* value = reinterpret_cast<char const*>(sqlite3_column_text(statement, 0));
+			if(value != nullptr) seriesid.assign(value);
+		}
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return seriesid;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2136,11 +3518,11 @@ std::string find_seriesid(sqlite3* instance, char const* title)
 	auto sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
 		"select "
 		"json_extract(value, '$.SeriesID') as seriesid "
-		"from deviceauth, json_each(http_request('http://api.hdhomerun.com/api/search?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Search=' || url_encode(?1))) "
+		"from deviceauth, http_json_each('http://api.hdhomerun.com/api/search?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Search=' || url_encode(?1)) "
 		"where json_extract(value, '$.Title') like ?1"
 		"limit 1";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2156,11 +3538,11 @@ std::string find_seriesid(sqlite3* instance, char const* title)
 		if(result == SQLITE_ROW) seriesid.assign(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return seriesid;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2262,7 +3644,7 @@ long long get_available_storage_space(sqlite3* instance)
 	// Prepare a query to get the sum of all available storage space
 	auto sql = "select sum(coalesce(json_extract(device.data, '$.FreeSpace'), 0)) from device where device.type = 'storage'";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try { 
@@ -2274,11 +3656,11 @@ long long get_available_storage_space(sqlite3* instance)
 		if(result == SQLITE_ROW) space = sqlite3_column_int64(statement, 0);
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return space;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2300,10 +3682,9 @@ int get_channel_count(sqlite3* instance, bool showdrm)
 	if(instance == nullptr) return 0;
 
 	// Prepare a query to get the number of distinct channels in the lineup
-	auto sql = "select count(distinct(json_extract(value, '$.GuideNumber'))) "
-		"from lineup, json_each(lineup.data) where nullif(json_extract(value, '$.DRM'), ?1) is null";
+	auto sql = "select count(distinct(guidenumber)) from lineupentry where nullif(drm, ?1) is null";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try { 
@@ -2319,11 +3700,11 @@ int get_channel_count(sqlite3* instance, bool showdrm)
 		if(result == SQLITE_ROW) channels = sqlite3_column_int(statement, 0);
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return channels;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2353,6 +3734,46 @@ void get_channel_number(sqlite3_context* context, int argc, sqlite3_value** argv
 	else return sqlite3_result_int(context, 0);
 }
 
+//---------------------------------------------------------------------------
+// get_device_discovery_age
+//
+// Gets the number of seconds since the last successful device discovery, or -1 if unknown
+//
+// Arguments:
+//
+//	instance	- SQLite database instance
+
+int get_device_discovery_age(sqlite3* instance)
+{
+	sqlite3_stmt*				statement;				// Database query statement
+	int							age = -1;				// Age of the device discovery
+	int							result;					// Result from SQLite function call
+
+	if(instance == nullptr) return -1;
+
+	// The discovery is only meaningful if at least one tuner device from it is still present
+	auto sql = "select max(0, cast(strftime('%s', 'now') as integer) - timestamp) from discovery where source = 'device' "
+		"and exists(select deviceid from device where type = 'tuner')";
+
+	result = prepare_statement(instance, sql, &statement);
+	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+	try { 
+
+		// Execute the scalar query
+		result = sqlite3_step(statement);
+
+		// There will be a single SQLITE_ROW returned from the initial step if the discovery is known
+		if((result == SQLITE_ROW) && (sqlite3_column_type(statement, 0) != SQLITE_NULL)) age = sqlite3_column_int(statement, 0);
+		else if((result != SQLITE_ROW) && (result != SQLITE_DONE)) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+		release_statement(statement);
+		return age;
+	}
+
+	catch(...) { release_statement(statement); throw; }
+}
+
 //---------------------------------------------------------------------------
 // get_episode_number
 //
@@ -2383,6 +3804,20 @@ void get_episode_number(sqlite3_context* context, int argc, sqlite3_value** argv
 	return sqlite3_result_int(context, -1);
 }
 
+//---------------------------------------------------------------------------
+// get_http_share
+//
+// Gets the curlshare instance used by the database layer HTTP requests
+//
+// Arguments:
+//
+//	NONE
+
+curlshare& get_http_share(void)
+{
+	return g_curlshare;
+}
+
 //---------------------------------------------------------------------------
 // get_recording_count
 //
@@ -2401,8 +3836,8 @@ int get_recording_count(sqlite3* instance)
 	if(instance == nullptr) return 0;
 
 	// Prepare a scalar result query to get the number of recordings
-	auto sql = "select count(json_type(value, '$.ProgramID')) from recording, json_each(recording.data)";
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	auto sql = "select count(programid) from recordingentry";
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try { 
@@ -2414,11 +3849,11 @@ int get_recording_count(sqlite3* instance)
 		if(result == SQLITE_ROW) recordings = sqlite3_column_int(statement, 0);
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return recordings;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2442,14 +3877,14 @@ std::string get_recording_filename(sqlite3* instance, char const* recordingid)
 	// Prepare a scalar result query to generate the file name of the recording MPG file
 	//
 	// FORMAT: {DisplayGroupTitle}/{Title} {EpisodeNumber} {OriginalAirDate} [{StartTime}]
-	auto sql = "select rtrim(clean_filename(json_extract(value, '$.DisplayGroupTitle')), ' .') || '/' || "
-		"clean_filename(json_extract(value, '$.Title')) || ' ' || "
-		"coalesce(json_extract(value, '$.EpisodeNumber') || ' ', '') || "
-		"coalesce(strftime('%Y%m%d', datetime(json_extract(value, '$.OriginalAirdate'), 'unixepoch')) || ' ', '') || "
-		"'[' || strftime('%Y%m%d-%H%M', datetime(json_extract(value, '$.StartTime'), 'unixepoch')) || ']' as filename "
-		"from recording, json_each(recording.data) where json_extract(value, '$.CmdURL') like ?1 limit 1";
-
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	auto sql = "select rtrim(clean_filename(displaygrouptitle), ' .') || '/' || "
+		"clean_filename(title) || ' ' || "
+		"coalesce(episodenumber || ' ', '') || "
+		"coalesce(strftime('%Y%m%d', datetime(originalairdate, 'unixepoch')) || ' ', '') || "
+		"'[' || strftime('%Y%m%d-%H%M', datetime(starttime, 'unixepoch')) || ']' as filename "
+		"from recordingentry where recordingid = ?1 limit 1";
+
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2465,11 +3900,11 @@ std::string get_recording_filename(sqlite3* instance, char const* recordingid)
 		if(result == SQLITE_ROW) filename.assign(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return filename;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2490,12 +3925,11 @@ int get_recording_lastposition(sqlite3* instance, char const* recordingid)
 
 	if(instance == nullptr) return 0;
 
-	// Prepare a scalar result query to get the last played position of the recording from the storage engine
-	auto sql = "with httprequest(response) as (select http_request(json_extract(device.data, '$.StorageURL')) from device where device.type = 'storage') "
-		"select coalesce(json_extract(entry.value, '$.Resume'), 0) as resume from httprequest, json_each(httprequest.response) as entry "
-		"where json_extract(entry.value, '$.CmdURL') like ?1 limit 1";
+	// Prepare a scalar result query to get the last played position of the recording from the local recording data; the
+	// positions are refreshed from the storage engine(s) during recording discovery and by set_recording_lastposition
+	auto sql = "select coalesce(resume, 0) as resume from recordingentry where recordingid = ?1 limit 1";
 	
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try { 
@@ -2510,11 +3944,11 @@ int get_recording_lastposition(sqlite3* instance, char const* recordingid)
 		// If the query returned a result, use that value otherwise leave at zero
 		if(result == SQLITE_ROW) lastposition = sqlite3_column_int(statement, 0);
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return lastposition;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2536,10 +3970,9 @@ std::string get_recording_stream_url(sqlite3* instance, char const* recordingid)
 	if((instance == nullptr) || (recordingid == nullptr)) return streamurl;
 
 	// Prepare a scalar result query to generate a stream URL for the specified recording
-	auto sql = "select json_extract(value, '$.PlayURL') as streamurl "
-		"from recording, json_each(recording.data) where json_extract(value, '$.CmdURL') like ?1";
+	auto sql = "select playurl as streamurl from recordingentry where recordingid = ?1";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2555,11 +3988,11 @@ std::string get_recording_stream_url(sqlite3* instance, char const* recordingid)
 		if(result == SQLITE_ROW) streamurl.assign(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return streamurl;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2581,7 +4014,7 @@ int get_recordingrule_count(sqlite3* instance)
 
 	// Prepare a scalar result query to get the number of recording rules
 	auto sql = "select count(recordingruleid) from recordingrule";
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try { 
@@ -2593,11 +4026,11 @@ int get_recordingrule_count(sqlite3* instance)
 		if(result == SQLITE_ROW) rules = sqlite3_column_int(statement, 0);
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return rules;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2650,7 +4083,7 @@ std::string get_stream_url(sqlite3* instance, union channelid channelid)
 	auto sql = "select json_extract(device.data, '$.BaseURL') || '/auto/v' || decode_channel_id(?1) || "
 		"'?ClientID=' || (select clientid from client limit 1) || '&SessionID=0x' || hex(randomblob(4)) from device where type = 'storage' limit 1";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2666,11 +4099,11 @@ std::string get_stream_url(sqlite3* instance, union channelid channelid)
 		if(result == SQLITE_ROW) streamurl.assign(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return streamurl;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2695,10 +4128,9 @@ int get_timer_count(sqlite3* instance, int maxdays)
 	if(maxdays < 0) maxdays = 31;
 
 	// Select the number of episodes set to record in the specified timeframe
-	auto sql = "select count(*) from episode, json_each(episode.data) where json_extract(value, '$.RecordingRule') = 1 and "
-		"(json_extract(value, '$.StartTime') < (cast(strftime('%s', 'now') as integer) + (?1 * 86400)))";
+	auto sql = "select count(*) from timer where starttime < (cast(strftime('%s', 'now') as integer) + (?1 * 86400))";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2714,11 +4146,11 @@ int get_timer_count(sqlite3* instance, int maxdays)
 		if(result == SQLITE_ROW) timers = sqlite3_column_int(statement, 0);
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return timers;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2741,11 +4173,9 @@ bool get_tuner_direct_channel_flag(sqlite3* instance, union channelid channelid)
 
 	// Select a boolean flag indicating if any instances of this channel in the lineup table
 	// are flagged as tuner-direct only channels
-	auto sql = "select coalesce((select json_extract(lineupdata.value, '$.Demo') as tuneronly "
-		"from lineup, json_each(lineup.data) as lineupdata "
-		"where json_extract(lineupdata.value, '$.GuideNumber') = decode_channel_id(?1) and tuneronly is not null limit 1), 0)";
+	auto sql = "select coalesce((select demo from lineupentry where channelid = ?1 and demo is not null limit 1), 0)";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2761,11 +4191,11 @@ bool get_tuner_direct_channel_flag(sqlite3* instance, union channelid channelid)
 		if(result == SQLITE_ROW) directonly = (sqlite3_column_int(statement, 0) != 0);
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return directonly;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -2799,11 +4229,9 @@ std::string get_tuner_stream_url(sqlite3* instance, char const* tunerid, union c
 	if((deviceid.length() == 0) || (tunerindex.length() != 1)) throw std::invalid_argument("tunerid");
 
 	// Prepare a scalar query to generate the URL by matching up the device id and channel against the lineup
-	auto sql = "select replace(json_extract(lineupdata.value, '$.URL'), 'auto', 'tuner' || ?1) as url "
-		"from lineup, json_each(lineup.data) as lineupdata where lineup.deviceid = ?2 "
-		"and json_extract(lineupdata.value, '$.GuideNumber') = decode_channel_id(?3)";
+	auto sql = "select replace(url, 'auto', 'tuner' || ?1) as url from lineupentry where deviceid = ?2 and channelid = ?3";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -2821,178 +4249,751 @@ std::string get_tuner_stream_url(sqlite3* instance, char const* tunerid, union c
 		if(result == SQLITE_ROW) streamurl.assign(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
 		else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 		return streamurl;
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
 }
 
 //---------------------------------------------------------------------------
-// http_request
+// http_host_available
 //
-// SQLite scalar function to load data from a URL as a blob
+// Determines if HTTP requests are currently allowed to the host of a URL
 //
 // Arguments:
 //
-//	context		- SQLite context object
-//	argc		- Number of supplied arguments
-//	argv		- Argument values
+//	url			- URL of the request
 
-void http_request(sqlite3_context* context, int argc, sqlite3_value** argv)
+bool http_host_available(char const* url)
 {
-	long				responsecode = 200;		// HTTP response code
-	sqlite_buffer		blob;					// Dynamically allocated blob buffer
-
-	// useragent
-	//
-	// Static string to use as the User-Agent for this HTTP request
-	static std::string useragent = "Kodi-PVR/" + std::string(ADDON_INSTANCE_VERSION_PVR) + " " + VERSION_PRODUCTNAME_ANSI + "/" + VERSION_VERSION3_ANSI;
-
-	if((argc < 1) || (argc > 2) || (argv[0] == nullptr)) return sqlite3_result_error(context, "invalid argument", -1);
-
-	// A null or zero-length URL results in a NULL result
-	const char* url = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
-	if((url == nullptr) || (*url == 0)) return sqlite3_result_null(context);
-
-	// Create a write callback for libcurl to invoke to write the data
-	auto write_function = [](void const* data, size_t size, size_t count, void* userdata) -> size_t {
-
-		try { return reinterpret_cast<sqlite_buffer*>(userdata)->append(data, (size * count)); }
-		catch(...) { return 0; }
-	};
+	return g_circuitbreaker.available(url);
+}
 
-	// Initialize the CURL session for the download operation
-	CURL* curl = curl_easy_init();
-	if(curl == nullptr) return sqlite3_result_error(context, "cannot initialize libcurl object", -1);
+//---------------------------------------------------------------------------
+// http_json_each_bestindex
+//
+// SQLite virtual table xBestIndex implementation for http_json_each
+//
+// Arguments:
+//
+//	vtab		- Virtual table instance
+//	info		- Index information
 
-	// Set the CURL options and execute the web request to get the JSON string data
-	CURLcode curlresult = curl_easy_setopt(curl, CURLOPT_URL, url);
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_USERAGENT, useragent.c_str());
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, static_cast<CURL_WRITEFUNCTION>(write_function));
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_WRITEDATA, reinterpret_cast<void*>(&blob));
-	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_SHARE, static_cast<CURLSH*>(g_curlshare));
-	if(curlresult == CURLE_OK) curlresult = curl_easy_perform(curl);
-	if(curlresult == CURLE_OK) curlresult = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responsecode);
-	curl_easy_cleanup(curl);
+int http_json_each_bestindex(sqlite3_vtab* /*vtab*/, sqlite3_index_info* info)
+{
+	// The url argument is the hidden column, it's required to evaluate the table
+	for(int index = 0; index < info->nConstraint; index++) {
 
-	// Check if any of the above operations failed and return an error condition
-	if(curlresult != CURLE_OK) {
+		if((info->aConstraint[index].iColumn == 2) && (info->aConstraint[index].op == SQLITE_INDEX_CONSTRAINT_EQ) && (info->aConstraint[index].usable)) {
 
-		// If a default result was provided, use it rather than returning an error result
-		if(argc >= 2) return sqlite3_result_value(context, argv[1]);
-	
-		// Use sqlite3_mprintf to generate the formatted error message
-		auto message = sqlite3_mprintf("http request on [%s] failed: %s", url, curl_easy_strerror(curlresult));
-		sqlite3_result_error(context, message, -1);
-		return sqlite3_free(reinterpret_cast<void*>(message));
-	}
+			info->aConstraintUsage[index].argvIndex = 1;
+			info->aConstraintUsage[index].omit = 1;
+			info->idxNum = 1;
+			info->estimatedCost = 1000.0;
 
-	// Check the HTTP response code and return an error condition if unsuccessful
-	if((responsecode < 200) || (responsecode > 299)) {
-	
-		// If a default result was provided, use it rather than returning an error result
-		if(argc >= 2) return sqlite3_result_value(context, argv[1]);
-	
-		// Use sqlite3_mprintf to generate the formatted error message
-		auto message = sqlite3_mprintf("http request on url [%s] failed with http response code %ld", url, responsecode);
-		sqlite3_result_error(context, message, -1);
-		return sqlite3_free(reinterpret_cast<void*>(message));
+			return SQLITE_OK;
+		}
 	}
 
-	// Watch for data that exceeds int::max, sqlite3_result_blob does not accept a size_t for the length
-	size_t cb = blob.size();
-	if(cb > static_cast<size_t>(std::numeric_limits<int>::max())) 
-		return sqlite3_result_error(context, "blob data exceeds std::numeric_limits<int>::max() in length", -1);
+	// Without a usable url argument make this plan as unattractive as possible
+	info->idxNum = 0;
+	info->estimatedCost = std::numeric_limits<double>::max();
 
-	// Send the resultant blob to SQLite as the result from this scalar function; detach from the sqlite_buffer
-	return (cb > 0) ? sqlite3_result_blob(context, blob.detach(), static_cast<int>(cb), sqlite3_free) : sqlite3_result_null(context);
+	return SQLITE_OK;
 }
 
 //---------------------------------------------------------------------------
-// modify_recordingrule
+// http_json_each_close
 //
-// Modifies an existing recording rule
+// SQLite virtual table xClose implementation for http_json_each
 //
 // Arguments:
 //
-//	instance		- Database instance
-//	recordingrule	- Recording rule to be modified with updated information
-//	seriesid		- On success, contains the series id for the recording rule
+//	cursor		- Virtual table cursor
 
-void modify_recordingrule(sqlite3* instance, struct recordingrule const& recordingrule, std::string& seriesid)
+int http_json_each_close(sqlite3_vtab_cursor* cursor)
 {
-	sqlite3_stmt*				statement;			// SQL statement to execute
-	int							result;				// Result from SQLite function
-	
-	if(instance == nullptr) return;
-
-	execute_non_query(instance, "begin immediate transaction");
+	delete static_cast<http_json_each_cursor*>(cursor);
+	return SQLITE_OK;
+}
 
-	try {
+//---------------------------------------------------------------------------
+// http_json_each_column
+//
+// SQLite virtual table xColumn implementation for http_json_each
+//
+// Arguments:
+//
+//	cursor		- Virtual table cursor
+//	context		- SQLite context object
+//	ordinal		- Column ordinal
 
-		// Update the specific recording rule with the new information provided
-		auto sql = "replace into recordingrule "
-			"select json_extract(value, '$.RecordingRuleID') as recordingruleid, "
-			"json_extract(value, '$.SeriesID') as seriesid, "
-			"value as data "
-			"from "
-			"json_each((with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-			"select http_request('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Cmd=change&RecordingRuleID=' || ?1 || "
-			"'&RecentOnly=' || case when ?2 is null then '' else ?2 end || "
-			"'&ChannelOnly=' || case when ?3 is null then '' else decode_channel_id(?3) end || "
-			"'&AfterOriginalAirdateOnly=' || case when ?4 is null then '' else strftime('%s', date(?4, 'unixepoch')) end || "
-			"'&StartPadding=' || case when ?5 is null then '30' else ?5 end || "
-			"'&EndPadding=' || case when ?6 is null then '30' else ?6 end) as data "
-			"from deviceauth))";
+int http_json_each_column(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int ordinal)
+{
+	http_json_each_cursor* jsoncursor = static_cast<http_json_each_cursor*>(cursor);
 
-		// Prepare the query
-		result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
-		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+	switch(ordinal) {
 
-		try {
+		// key
+		case 0: sqlite3_result_int64(context, jsoncursor->rowid()); break;
 
-			// Bind the non-null query parameter(s)
-			result = sqlite3_bind_int(statement, 1, recordingrule.recordingruleid);
-			if((result == SQLITE_OK) && (recordingrule.recentonly)) result = sqlite3_bind_int(statement, 2, 1);
-			if((result == SQLITE_OK) && (recordingrule.channelid.value != 0)) result = sqlite3_bind_int(statement, 3, recordingrule.channelid.value);
-			if((result == SQLITE_OK) && (recordingrule.afteroriginalairdateonly != 0)) result = sqlite3_bind_int(statement, 4, static_cast<int>(recordingrule.afteroriginalairdateonly));
-			if((result == SQLITE_OK) && (recordingrule.startpadding != 30)) result = sqlite3_bind_int(statement, 5, recordingrule.startpadding);
-			if((result == SQLITE_OK) && (recordingrule.endpadding != 30))  result = sqlite3_bind_int(statement, 6, recordingrule.endpadding);
-			if(result != SQLITE_OK) throw sqlite_exception(result);
+		// value
+		case 1: sqlite3_result_text(context, jsoncursor->value().c_str(), static_cast<int>(jsoncursor->value().size()), SQLITE_TRANSIENT); break;
 
-			// Execute the query - no result set is expected
-			result = sqlite3_step(statement);
-			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
-			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+		// url (hidden)
+		case 2: sqlite3_result_text(context, jsoncursor->url().c_str(), -1, SQLITE_TRANSIENT); break;
+	}
 
-			sqlite3_finalize(statement);			// Finalize the SQLite statement
-		}
+	return SQLITE_OK;
+}
 
-		catch(...) { sqlite3_finalize(statement); throw; }
+//---------------------------------------------------------------------------
+// http_json_each_connect
+//
+// SQLite virtual table xConnect implementation for http_json_each
+//
+// Arguments:
+//
+//	instance	- SQLite database instance
+//	aux			- Module auxiliary data
+//	argc		- Number of module arguments
+//	argv		- Module arguments
+//	vtab		- On success, receives the virtual table instance
+//	error		- On failure, receives the error message
 
-		// Update the episode data to take the modified recording rule(s) into account; watch out for the web
-		// services returning 'null' on the episode query -- this happens when there are no episodes
-		sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
-			"replace into episode "
-			"select recordingrule.seriesid, "
-			"http_request('http://api.hdhomerun.com/api/episodes?DeviceAuth=' || coalesce(deviceauth.code, '') || '&SeriesID=' || recordingrule.seriesid) as data "
-			"from recordingrule, deviceauth "
-			"where recordingrule.recordingruleid = ?1 "
-			"and cast(data as text) <> 'null'";
+int http_json_each_connect(sqlite3* instance, void* /*aux*/, int /*argc*/, const char* const* /*argv*/, sqlite3_vtab** vtab, char** /*error*/)
+{
+	int result = sqlite3_declare_vtab(instance, "create table http_json_each(key, value, url hidden)");
+	if(result != SQLITE_OK) return result;
 
-		// Prepare the query
-		result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
-		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+	*vtab = reinterpret_cast<sqlite3_vtab*>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+	if(*vtab == nullptr) return SQLITE_NOMEM;
 
-		try {
+	memset(*vtab, 0, sizeof(sqlite3_vtab));
+	return SQLITE_OK;
+}
 
-			// Bind the non-null query parameter(s)
-			result = sqlite3_bind_int(statement, 1, recordingrule.recordingruleid);
+//---------------------------------------------------------------------------
+// http_json_each_disconnect
+//
+// SQLite virtual table xDisconnect implementation for http_json_each
+//
+// Arguments:
+//
+//	vtab		- Virtual table instance
+
+int http_json_each_disconnect(sqlite3_vtab* vtab)
+{
+	sqlite3_free(vtab);
+	return SQLITE_OK;
+}
+
+//---------------------------------------------------------------------------
+// http_json_each_eof
+//
+// SQLite virtual table xEof implementation for http_json_each
+//
+// Arguments:
+//
+//	cursor		- Virtual table cursor
+
+int http_json_each_eof(sqlite3_vtab_cursor* cursor)
+{
+	return (static_cast<http_json_each_cursor*>(cursor)->eof()) ? 1 : 0;
+}
+
+//---------------------------------------------------------------------------
+// http_json_each_filter
+//
+// SQLite virtual table xFilter implementation for http_json_each
+//
+// Arguments:
+//
+//	cursor		- Virtual table cursor
+//	indexnum	- Index number from xBestIndex
+//	indexstr	- Index string from xBestIndex
+//	argc		- Number of supplied arguments
+//	argv		- Argument values
+
+int http_json_each_filter(sqlite3_vtab_cursor* cursor, int indexnum, char const* /*indexstr*/, int argc, sqlite3_value** argv)
+{
+	sqlite3_free(cursor->pVtab->zErrMsg);
+	cursor->pVtab->zErrMsg = nullptr;
+
+	if((indexnum == 0) || (argc < 1)) { cursor->pVtab->zErrMsg = sqlite3_mprintf("http_json_each: url argument is required"); return SQLITE_ERROR; }
+
+	try { static_cast<http_json_each_cursor*>(cursor)->open(reinterpret_cast<char const*>(sqlite3_value_text(argv[0]))); }
+	catch(std::bad_alloc&) { return SQLITE_NOMEM; }
+	catch(std::exception& ex) { cursor->pVtab->zErrMsg = sqlite3_mprintf("%s", ex.what()); return SQLITE_ERROR; }
+	catch(...) { return SQLITE_ERROR; }
+
+	return SQLITE_OK;
+}
+
+//---------------------------------------------------------------------------
+// http_json_each_next
+//
+// SQLite virtual table xNext implementation for http_json_each
+//
+// Arguments:
+//
+//	cursor		- Virtual table cursor
+
+int http_json_each_next(sqlite3_vtab_cursor* cursor)
+{
+	try { static_cast<http_json_each_cursor*>(cursor)->next(); }
+	catch(std::bad_alloc&) { return SQLITE_NOMEM; }
+	catch(std::exception& ex) { sqlite3_free(cursor->pVtab->zErrMsg); cursor->pVtab->zErrMsg = sqlite3_mprintf("%s", ex.what()); return SQLITE_ERROR; }
+	catch(...) { return SQLITE_ERROR; }
+
+	return SQLITE_OK;
+}
+
+//---------------------------------------------------------------------------
+// http_json_each_open
+//
+// SQLite virtual table xOpen implementation for http_json_each
+//
+// Arguments:
+//
+//	vtab		- Virtual table instance
+//	cursor		- On success, receives the virtual table cursor
+
+int http_json_each_open(sqlite3_vtab* /*vtab*/, sqlite3_vtab_cursor** cursor)
+{
+	*cursor = new(std::nothrow) http_json_each_cursor();
+	return (*cursor == nullptr) ? SQLITE_NOMEM : SQLITE_OK;
+}
+
+//---------------------------------------------------------------------------
+// http_json_each_rowid
+//
+// SQLite virtual table xRowid implementation for http_json_each
+//
+// Arguments:
+//
+//	cursor		- Virtual table cursor
+//	rowid		- Receives the rowid of the current element
+
+int http_json_each_rowid(sqlite3_vtab_cursor* cursor, sqlite_int64* rowid)
+{
+	*rowid = static_cast<http_json_each_cursor*>(cursor)->rowid();
+	return SQLITE_OK;
+}
+
+//---------------------------------------------------------------------------
+// http_request
+//
+// SQLite scalar function to load data from a URL as a blob
+//
+// Arguments:
+//
+//	context		- SQLite context object
+//	argc		- Number of supplied arguments
+//	argv		- Argument values
+
+void http_request(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+	long				responsecode = 200;		// HTTP response code
+	sqlite_buffer		blob;					// Dynamically allocated blob buffer
+
+	if((argc < 1) || (argc > 2) || (argv[0] == nullptr)) return sqlite3_result_error(context, "invalid argument", -1);
+
+	// A null or zero-length URL results in a NULL result
+	const char* url = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+	if((url == nullptr) || (*url == 0)) return sqlite3_result_null(context);
+
+	// If the host is known to be unreachable, fail the request immediately rather than waiting for it to time out
+	if(!http_host_available(url)) {
+
+		increment_metric("http.circuit.rejected");
+
+		// If a default result was provided, use it rather than returning an error result
+		if(argc >= 2) return sqlite3_result_value(context, argv[1]);
+
+		auto message = sqlite3_mprintf("http request on [%s] failed: host is unavailable", url);
+		sqlite3_result_error(context, message, -1);
+		return sqlite3_free(reinterpret_cast<void*>(message));
+	}
+
+	// Acquire a CURL session for the download operation from the handle pool
+	CURL* curl = g_curlshare.acquire_handle();
+	if(curl == nullptr) return sqlite3_result_error(context, "cannot initialize libcurl object", -1);
+
+	// Set the CURL options and execute the web request to get the JSON string data
+	CURLcode curlresult = prepare_http_request(curl, url, &blob);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_perform(curl);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responsecode);
+	record_http_metrics(curl, url, curlresult, responsecode);
+	g_curlshare.release_handle(curl);
+
+	// Check if any of the above operations failed and return an error condition
+	if(curlresult != CURLE_OK) {
+
+		// If a default result was provided, use it rather than returning an error result
+		if(argc >= 2) return sqlite3_result_value(context, argv[1]);
+	
+		// Use sqlite3_mprintf to generate the formatted error message
+		auto message = sqlite3_mprintf("http request on [%s] failed: %s", url, curl_easy_strerror(curlresult));
+		sqlite3_result_error(context, message, -1);
+		return sqlite3_free(reinterpret_cast<void*>(message));
+	}
+
+	// Check the HTTP response code and return an error condition if unsuccessful
+	if((responsecode < 200) || (responsecode > 299)) {
+	
+		// If a default result was provided, use it rather than returning an error result
+		if(argc >= 2) return sqlite3_result_value(context, argv[1]);
+	
+		// Use sqlite3_mprintf to generate the formatted error message
+		auto message = sqlite3_mprintf("http request on url [%s] failed with http response code %ld", url, responsecode);
+		sqlite3_result_error(context, message, -1);
+		return sqlite3_free(reinterpret_cast<void*>(message));
+	}
+
+	// Watch for data that exceeds int::max, sqlite3_result_blob does not accept a size_t for the length
+	size_t cb = blob.size();
+	if(cb > static_cast<size_t>(std::numeric_limits<int>::max())) 
+		return sqlite3_result_error(context, "blob data exceeds std::numeric_limits<int>::max() in length", -1);
+
+	// Send the resultant blob to SQLite as the result from this scalar function; detach from the sqlite_buffer
+	return (cb > 0) ? sqlite3_result_blob(context, blob.detach(), static_cast<int>(cb), sqlite3_free) : sqlite3_result_null(context);
+}
+
+//---------------------------------------------------------------------------
+// http_request_multi
+//
+// Executes the HTTP requests listed in a table concurrently and stores the results
+//
+// Arguments:
+//
+//	instance		- SQLite database instance
+//	table			- Name of the table with the url and data columns to process
+//	ignoreerrors	- Flag to leave the data unchanged rather than throwing on a failed request
+//	maxconcurrency	- Maximum number of concurrent transfers
+
+bool http_request_multi(sqlite3* instance, char const* table, bool ignoreerrors, int maxconcurrency)
+{
+	sqlite3_stmt*				statement;				// SQL statement to execute
+	int							result;					// Result from SQLite function
+	CURLMcode					curlmresult;			// Result from curl multi function
+	bool						modified = false;		// Flag if any data was modified
+
+	// transfer
+	//
+	// Tracks the state of an individual transfer
+	struct transfer {
+
+		sqlite3_int64			rowid = 0;				// Table rowid
+		std::string				url;					// Request URL
+		std::string				key;					// Validator cache key
+		CURL*					curl = nullptr;			// Easy interface handle
+		curl_slist*				headers = nullptr;		// Conditional request headers
+		sqlite_buffer			blob;					// Response data
+		std::string				etag;					// Response ETag: header
+		std::string				lastmodified;			// Response Last-Modified: header
+		bool					conditional = false;	// Flag if request was conditional
+		CURLcode				result = CURLE_OK;		// Transfer result
+		long					responsecode = 0;		// HTTP response code
+	};
+
+	std::vector<std::unique_ptr<transfer>>	transfers;	// Pending transfers
+
+	if(instance == nullptr) throw std::invalid_argument("instance");
+	if(table == nullptr) throw std::invalid_argument("table");
+	if(maxconcurrency < 1) throw std::invalid_argument("maxconcurrency");
+
+	// Create a header callback for libcurl to capture the response validators
+	auto header_function = [](void const* data, size_t size, size_t count, void* userdata) -> size_t {
+
+		size_t cb = size * count;
+		transfer* current = reinterpret_cast<transfer*>(userdata);
+
+		try {
+
+			std::string header(reinterpret_cast<char const*>(data), cb);
+
+			// A status line indicates the start of a new response (redirect), discard any previous validators
+			if(header.compare(0, 5, "HTTP/") == 0) { current->etag.clear(); current->lastmodified.clear(); return cb; }
+
+			size_t colon = header.find(':');
+			if(colon == std::string::npos) return cb;
+
+			// Header field names are case-insensitive, the value has the leading whitespace and trailing CRLF removed
+			std::string name = header.substr(0, colon);
+			std::transform(name.begin(), name.end(), name.begin(), [](char ch) -> char { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+
+			size_t first = header.find_first_not_of(" \t", colon + 1);
+			size_t last = header.find_last_not_of(" \t\r\n");
+			std::string value = ((first == std::string::npos) || (last < first)) ? std::string() : header.substr(first, last - first + 1);
+
+			if(name == "etag") current->etag = value;
+			else if(name == "last-modified") current->lastmodified = value;
+
+			return cb;
+		}
+
+		catch(...) { return 0; }
+	};
+
+	// The device authorization code embedded in some URLs changes routinely but does not affect the content
+	// that will be returned; remove it from the URL to generate the key for the validator cache
+	auto cache_key = [](char const* url) -> std::string {
+
+		std::string key(url);
+		size_t pos = key.find("DeviceAuth=");
+
+		if((pos != std::string::npos) && (pos > 0) && ((key[pos - 1] == '?') || (key[pos - 1] == '&'))) {
+
+			size_t end = key.find('&', pos);
+			key.erase(pos, (end == std::string::npos) ? std::string::npos : end - pos + 1);
+		}
+
+		return key;
+	};
+
+	// Load the URLs from the table; each row will have the data column updated individually by rowid.  Any data
+	// already present in the table is the caller's current copy of the response, it's fingerprint is compared with
+	// the validator cache to determine if a conditional request can be made for this URL
+	auto sql = sqlite3_mprintf("select rowid, url, case when data is null then null else fnv_hash(data) end from \"%w\"", table);
+	if(sql == nullptr) throw std::bad_alloc();
+
+	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	sqlite3_free(reinterpret_cast<void*>(sql));
+	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+	sqlite3_stmt* validators = nullptr;
+	result = sqlite3_prepare_v2(instance, "select etag, lastmodified from httpcache where url = ?1 and fingerprint = ?2", -1, &validators, nullptr);
+	if(result != SQLITE_OK) { sqlite3_finalize(statement); throw sqlite_exception(result, sqlite3_errmsg(instance)); }
+
+	try {
+
+		// Execute the query and iterate over all returned rows, a null or empty URL results in a null result
+		while(sqlite3_step(statement) == SQLITE_ROW) {
+
+			char const* url = reinterpret_cast<char const*>(sqlite3_column_text(statement, 1));
+			if((url == nullptr) || (*url == 0)) continue;
+
+			transfers.emplace_back(new transfer());
+			transfer* current = transfers.back().get();
+
+			current->rowid = sqlite3_column_int64(statement, 0);
+			current->url.assign(url);
+			current->key = cache_key(url);
+
+			// If the caller's data matches the fingerprint of the cached response, send the validators
+			if(sqlite3_column_type(statement, 2) == SQLITE_NULL) continue;
+
+			result = sqlite3_bind_text(validators, 1, current->key.c_str(), -1, SQLITE_STATIC);
+			if(result == SQLITE_OK) result = sqlite3_bind_int(validators, 2, sqlite3_column_int(statement, 2));
+			if(result != SQLITE_OK) throw sqlite_exception(result);
+
+			if(sqlite3_step(validators) == SQLITE_ROW) {
+
+				char const* etag = reinterpret_cast<char const*>(sqlite3_column_text(validators, 0));
+				char const* lastmodified = reinterpret_cast<char const*>(sqlite3_column_text(validators, 1));
+
+				if((etag != nullptr) && (*etag != 0)) current->headers = curl_slist_append(current->headers, (std::string("If-None-Match: ") + etag).c_str());
+				if((lastmodified != nullptr) && (*lastmodified != 0)) current->headers = curl_slist_append(current->headers, (std::string("If-Modified-Since: ") + lastmodified).c_str());
+				current->conditional = (current->headers != nullptr);
+			}
+
+			result = sqlite3_reset(validators);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
+		}
+
+		sqlite3_finalize(validators);
+		sqlite3_finalize(statement);
+	}
+
+	catch(...) {
+
+		for(auto const& iterator : transfers) curl_slist_free_all(iterator->headers);
+
+		sqlite3_finalize(validators);
+		sqlite3_finalize(statement);
+		throw;
+	}
+
+	if(transfers.empty()) return false;
+
+	// Create the multi interface handle that will be used to process all of the transfers
+	CURLM* curlm = curl_multi_init();
+	if(curlm == nullptr) {
+
+		for(auto const& iterator : transfers) curl_slist_free_all(iterator->headers);
+		throw string_exception(__func__, ": curl_multi_init() failed");
+	}
+
+	try {
+
+		auto next = transfers.begin();				// Next transfer to be started
+		int active = 0;								// Number of active transfers
+
+		do {
+
+			// Start as many transfers as allowed by the concurrency limit; the easy handles are
+			// returned to the pool as each transfer completes to keep the number of handles bounded
+			while((active < maxconcurrency) && (next != transfers.end())) {
+
+				transfer* current = next->get();
+
+				// Requests to a host that is known to be unreachable fail immediately
+				if(!http_host_available(current->url.c_str())) {
+
+					increment_metric("http.circuit.rejected");
+					current->result = CURLE_COULDNT_CONNECT;
+					++next;
+					continue;
+				}
+
+				current->curl = g_curlshare.acquire_handle();
+				if(current->curl == nullptr) throw string_exception(__func__, ": curl_easy_init() failed");
+
+				CURLcode curlresult = prepare_http_request(current->curl, current->url.c_str(), &current->blob);
+				if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(current->curl, CURLOPT_HEADERFUNCTION, static_cast<CURL_WRITEFUNCTION>(header_function));
+				if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(current->curl, CURLOPT_HEADERDATA, reinterpret_cast<void*>(current));
+				if((curlresult == CURLE_OK) && (current->headers != nullptr)) curlresult = curl_easy_setopt(current->curl, CURLOPT_HTTPHEADER, current->headers);
+				if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(current->curl, CURLOPT_PRIVATE, reinterpret_cast<void*>(current));
+				if(curlresult != CURLE_OK) throw string_exception(__func__, ": curl_easy_setopt() failed: ", curl_easy_strerror(curlresult));
+
+				curlmresult = curl_multi_add_handle(curlm, current->curl);
+				if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_add_handle() failed: ", curl_multi_strerror(curlmresult));
+
+				++active;
+				++next;
+			}
+
+			// Execute the active transfers and wait for any socket activity
+			int running = 0;
+			curlmresult = curl_multi_perform(curlm, &running);
+			if(curlmresult == CURLM_OK) curlmresult = curl_multi_wait(curlm, nullptr, 0, 500, nullptr);
+			if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_perform() failed: ", curl_multi_strerror(curlmresult));
+
+			// Process any transfers that have completed, successfully or otherwise
+			int remaining = 0;
+			CURLMsg* message = nullptr;
+			while((message = curl_multi_info_read(curlm, &remaining)) != nullptr) {
+
+				if(message->msg != CURLMSG_DONE) continue;
+
+				transfer* current = nullptr;
+				curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&current));
+				assert(current != nullptr);
+
+				current->result = message->data.result;
+				if(current->result == CURLE_OK) current->result = curl_easy_getinfo(current->curl, CURLINFO_RESPONSE_CODE, &current->responsecode);
+				record_http_metrics(current->curl, current->url.c_str(), current->result, current->responsecode);
+
+				curl_multi_remove_handle(curlm, current->curl);
+				g_curlshare.release_handle(current->curl);
+				current->curl = nullptr;
+
+				--active;
+			}
+
+		} while((active > 0) || (next != transfers.end()));
+
+		curl_multi_cleanup(curlm);
+	}
+
+	// Clean up any remaining easy handles and the multi handle on exception
+	catch(...) {
+
+		for(auto const& iterator : transfers) {
+
+			if(iterator->curl != nullptr) {
+
+				curl_multi_remove_handle(curlm, iterator->curl);
+				g_curlshare.release_handle(iterator->curl);
+			}
+
+			curl_slist_free_all(iterator->headers);
+		}
+
+		curl_multi_cleanup(curlm);
+		throw;
+	}
+
+	// The conditional request headers are no longer needed once all the transfers have completed
+	for(auto const& iterator : transfers) { curl_slist_free_all(iterator->headers); iterator->headers = nullptr; }
+
+	// Write the results back into the data column of the table and update the validator cache; the fingerprint
+	// of the response is generated from the table data to ensure it will match on the next request
+	sqlite3_stmt* update = nullptr;
+	sqlite3_stmt* cache = nullptr;
+	sqlite3_stmt* uncache = nullptr;
+
+	sql = sqlite3_mprintf("update \"%w\" set data = ?1 where rowid = ?2", table);
+	if(sql == nullptr) throw std::bad_alloc();
+
+	result = sqlite3_prepare_v2(instance, sql, -1, &update, nullptr);
+	sqlite3_free(reinterpret_cast<void*>(sql));
+
+	if(result == SQLITE_OK) {
+
+		sql = sqlite3_mprintf("replace into httpcache select ?1, ?2, ?3, fnv_hash(data) from \"%w\" where rowid = ?4", table);
+		if(sql == nullptr) { sqlite3_finalize(update); throw std::bad_alloc(); }
+
+		result = sqlite3_prepare_v2(instance, sql, -1, &cache, nullptr);
+		sqlite3_free(reinterpret_cast<void*>(sql));
+	}
+
+	if(result == SQLITE_OK) result = sqlite3_prepare_v2(instance, "delete from httpcache where url = ?1", -1, &uncache, nullptr);
+	if(result != SQLITE_OK) { sqlite3_finalize(cache); sqlite3_finalize(update); throw sqlite_exception(result, sqlite3_errmsg(instance)); }
+
+	try {
+
+		for(auto const& iterator : transfers) {
+
+			// Check the transfer result and HTTP response code, failed requests either throw or store null
+			if(iterator->result != CURLE_OK) {
+
+				if(!ignoreerrors) throw string_exception(__func__, ": http request on [", iterator->url.c_str(), "] failed: ", curl_easy_strerror(iterator->result));
+				continue;
+			}
+
+			// HTTP 304: Not Modified in response to a conditional request indicates the caller's data is current
+			if((iterator->responsecode == 304) && (iterator->conditional)) continue;
+
+			if((iterator->responsecode < 200) || (iterator->responsecode > 299)) {
+
+				if(!ignoreerrors) throw string_exception(__func__, ": http request on url [", iterator->url.c_str(), "] failed with http response code ", iterator->responsecode);
+				continue;
+			}
+
+			// Watch for data that exceeds int::max, sqlite3_bind_blob does not accept a size_t for the length
+			size_t cb = iterator->blob.size();
+			if(cb > static_cast<size_t>(std::numeric_limits<int>::max())) throw string_exception(__func__, ": blob data exceeds std::numeric_limits<int>::max() in length");
+
+			// Bind the query parameters; empty responses are stored as null to match http_request
+			result = (cb > 0) ? sqlite3_bind_blob(update, 1, iterator->blob.detach(), static_cast<int>(cb), sqlite3_free) : sqlite3_bind_null(update, 1);
+			if(result == SQLITE_OK) result = sqlite3_bind_int64(update, 2, iterator->rowid);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
+
+			// This is a non-query, it's not expected to return any rows
+			result = sqlite3_step(update);
+			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+			result = sqlite3_reset(update);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
+
+			// Responses without any validators cannot be requested conditionally, remove them from the cache
+			bool hasvalidators = (!iterator->etag.empty() || !iterator->lastmodified.empty());
+			sqlite3_stmt* validator = (hasvalidators) ? cache : uncache;
+
+			result = sqlite3_bind_text(validator, 1, iterator->key.c_str(), -1, SQLITE_STATIC);
+			if((result == SQLITE_OK) && (hasvalidators)) result = (iterator->etag.empty()) ? sqlite3_bind_null(validator, 2) : sqlite3_bind_text(validator, 2, iterator->etag.c_str(), -1, SQLITE_STATIC);
+			if((result == SQLITE_OK) && (hasvalidators)) result = (iterator->lastmodified.empty()) ? sqlite3_bind_null(validator, 3) : sqlite3_bind_text(validator, 3, iterator->lastmodified.c_str(), -1, SQLITE_STATIC);
+			if((result == SQLITE_OK) && (hasvalidators)) result = sqlite3_bind_int64(validator, 4, iterator->rowid);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
+
+			result = sqlite3_step(validator);
+			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+			result = sqlite3_reset(validator);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
+
+			modified = true;					// Caller's data has been modified
+		}
+
+		sqlite3_finalize(uncache);
+		sqlite3_finalize(cache);
+		sqlite3_finalize(update);
+	}
+
+	catch(...) { sqlite3_finalize(uncache); sqlite3_finalize(cache); sqlite3_finalize(update); throw; }
+
+	return modified;
+}
+
+//---------------------------------------------------------------------------
+// modify_recordingrule
+//
+// Modifies an existing recording rule
+//
+// Arguments:
+//
+//	instance		- Database instance
+//	recordingrule	- Recording rule to be modified with updated information
+//	seriesid		- On success, contains the series id for the recording rule
+
+void modify_recordingrule(sqlite3* instance, struct recordingrule const& recordingrule, std::string& seriesid)
+{
+	sqlite3_stmt*				statement;			// SQL statement to execute
+	int							result;				// Result from SQLite function
+	
+	if(instance == nullptr) return;
+
+	// Clone the recording rule and episode table schemas into temporary tables; the backend services responses
+	// are staged in these before the write lock is acquired
+	execute_non_query(instance, "drop table if exists modify_recordingrule_rule");
+	execute_non_query(instance, "drop table if exists modify_recordingrule_temp");
+	execute_non_query(instance, "create temp table modify_recordingrule_rule as select * from recordingrule limit 0");
+	execute_non_query(instance, "create temp table modify_recordingrule_temp as select * from episode limit 0");
+
+	try {
+
+		// Update the specific recording rule with the new information provided and stage the updated rule
+		auto sql = "insert into modify_recordingrule_rule "
+			"select json_extract(value, '$.RecordingRuleID') as recordingruleid, "
+			"json_extract(value, '$.SeriesID') as seriesid, "
+			"value as data "
+			"from "
+			"json_each((with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
+			"select http_request('http://api.hdhomerun.com/api/recording_rules?DeviceAuth=' || coalesce(deviceauth.code, '') || '&Cmd=change&RecordingRuleID=' || ?1 || "
+			"'&RecentOnly=' || case when ?2 is null then '' else ?2 end || "
+			"'&ChannelOnly=' || case when ?3 is null then '' else decode_channel_id(?3) end || "
+			"'&AfterOriginalAirdateOnly=' || case when ?4 is null then '' else strftime('%s', date(?4, 'unixepoch')) end || "
+			"'&StartPadding=' || case when ?5 is null then '30' else ?5 end || "
+			"'&EndPadding=' || case when ?6 is null then '30' else ?6 end) as data "
+			"from deviceauth))";
+
+		// Prepare the query
+		result = prepare_statement(instance, sql, &statement);
+		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+		try {
+
+			// Bind the non-null query parameter(s)
+			result = sqlite3_bind_int(statement, 1, recordingrule.recordingruleid);
+			if((result == SQLITE_OK) && (recordingrule.recentonly)) result = sqlite3_bind_int(statement, 2, 1);
+			if((result == SQLITE_OK) && (recordingrule.channelid.value != 0)) result = sqlite3_bind_int(statement, 3, recordingrule.channelid.value);
+			if((result == SQLITE_OK) && (recordingrule.afteroriginalairdateonly != 0)) result = sqlite3_bind_int(statement, 4, static_cast<int>(recordingrule.afteroriginalairdateonly));
+			if((result == SQLITE_OK) && (recordingrule.startpadding != 30)) result = sqlite3_bind_int(statement, 5, recordingrule.startpadding);
+			if((result == SQLITE_OK) && (recordingrule.endpadding != 30))  result = sqlite3_bind_int(statement, 6, recordingrule.endpadding);
+			if(result != SQLITE_OK) throw sqlite_exception(result);
+
+			// Execute the query - no result set is expected
+			result = sqlite3_step(statement);
+			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+			release_statement(statement);			// Release the SQLite statement
+		}
+
+		catch(...) { release_statement(statement); throw; }
+
+		// Stage the episode data to take the modified recording rule(s) into account; the 'null' responses returned by
+		// the web services when there are no episodes are filtered from the temporary table (see add_recordingrule)
+		sql = "with deviceauth(code) as (select url_encode(group_concat(json_extract(data, '$.DeviceAuth'), '')) from device) "
+			"insert into modify_recordingrule_temp "
+			"select modify_recordingrule_rule.seriesid, "
+			"http_request('http://api.hdhomerun.com/api/episodes?DeviceAuth=' || coalesce(deviceauth.code, '') || '&SeriesID=' || modify_recordingrule_rule.seriesid) as data "
+			"from modify_recordingrule_rule, deviceauth "
+			"where modify_recordingrule_rule.recordingruleid = ?1";
+
+		// Prepare the query
+		result = prepare_statement(instance, sql, &statement);
+		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+		try {
+
+			// Bind the non-null query parameter(s)
+			result = sqlite3_bind_int(statement, 1, recordingrule.recordingruleid);
 			if(result != SQLITE_OK) throw sqlite_exception(result);
 
 			// Execute the query - no result set is expected
@@ -3000,16 +5001,16 @@ void modify_recordingrule(sqlite3* instance, struct recordingrule const& recordi
 			if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
 			if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-			sqlite3_finalize(statement);			// Finalize the SQLite statement
+			release_statement(statement);			// Release the SQLite statement
 		}
 
-		catch(...) { sqlite3_finalize(statement); throw; }
+		catch(...) { release_statement(statement); throw; }
 
 		// Retrieve the seriesid for the recording rule for the caller
-		sql = "select seriesid from recordingrule where recordingrule.recordingruleid = ?1";
+		sql = "select seriesid from modify_recordingrule_rule where recordingruleid = ?1";
 
 		// Prepare the query
-		result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+		result = prepare_statement(instance, sql, &statement);
 		if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 		try { 
@@ -3023,20 +5024,43 @@ void modify_recordingrule(sqlite3* instance, struct recordingrule const& recordi
 			if(result == SQLITE_ROW) seriesid.assign(reinterpret_cast<char const*>(sqlite3_column_text(statement, 0)));
 			else if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-			sqlite3_finalize(statement);
+			release_statement(statement);
 		}
 
-		catch(...) { sqlite3_finalize(statement); throw; }
+		catch(...) { release_statement(statement); throw; }
 
-		// Commit the transaction
-		execute_non_query(instance, "commit transaction");
-	}
+		// Start a database transaction; only the local writes from the staged data are done under the write lock
+		std::unique_lock<std::mutex> writelock(g_writelock);
+		execute_non_query(instance, "begin immediate transaction");
+
+		try {
+
+			// Complete the replace operations into the recording rule and episode tables from the temporary tables
+			execute_non_query(instance, "replace into recordingrule select recordingruleid, seriesid, data from modify_recordingrule_rule");
+			execute_non_query(instance, "replace into episode select seriesid, data from modify_recordingrule_temp where cast(data as text) <> 'null'");
+
+			// The local recording rule and episode data no longer matches the last discovery
+			execute_non_query(instance, "delete from fingerprint where source in ('recordingrule', 'episode')");
+
+			// Commit the transaction
+			execute_non_query(instance, "commit transaction");
+		}
+
+		// Rollback the entire transaction on any failure above
+		catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
+
+		writelock.unlock();
 
-	// Rollback the entire transaction on any failure above
-	catch(...) { try_execute_non_query(instance, "rollback transaction"); throw; }
+		// Poke the recording engine(s) after a successful rule change; don't worry about exceptions
+		try_execute_non_query(instance, "select http_request(json_extract(data, '$.BaseURL') || '/recording_events.post?sync') from device where type = 'storage'");
+
+		// Drop the temporary tables
+		execute_non_query(instance, "drop table modify_recordingrule_temp");
+		execute_non_query(instance, "drop table modify_recordingrule_rule");
+	}
 
-	// Poke the recording engine(s) after a successful rule change; don't worry about exceptions
-	try_execute_non_query(instance, "select http_request(json_extract(data, '$.BaseURL') || '/recording_events.post?sync') from device where type = 'storage'");
+	// Drop the temporary tables on any exception
+	catch(...) { try_execute_non_query(instance, "drop table modify_recordingrule_temp"); execute_non_query(instance, "drop table modify_recordingrule_rule"); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -3080,6 +5104,10 @@ sqlite3* open_database(char const* connstring, int flags, bool initialize)
 	// set a busy_timeout handler for this connection
 	//
 	sqlite3_busy_timeout(instance, 5000);
+
+	// register the statement profiling callback for this connection
+	//
+	sqlite3_trace_v2(instance, SQLITE_TRACE_PROFILE, profile_statement, nullptr);
 	
 	try {
 
@@ -3087,6 +5115,19 @@ sqlite3* open_database(char const* connstring, int flags, bool initialize)
 		//
 		execute_non_query(instance, "pragma journal_mode=wal");
 
+		// set the page cache size for this connection (negative values are in KiB)
+		//
+		execute_non_query(instance, ("pragma cache_size=-" + std::to_string(g_cachesize.load())).c_str());
+
+		// enable memory-mapped I/O for reads from the database file, if allowed
+		//
+		execute_non_query(instance, ("pragma mmap_size=" + std::to_string(g_mmapsize.load())).c_str());
+
+		// keep temporary tables in memory; SQLITE_TEMP_STORE=3 already forces this for the library build
+		// but the pragma remains in effect if the library is ever built with a less restrictive setting
+		//
+		execute_non_query(instance, "pragma temp_store=memory");
+
 		// scalar function: clean_filename
 		//
 		result = sqlite3_create_function_v2(instance, "clean_filename", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, clean_filename, nullptr, nullptr, nullptr);
@@ -3137,6 +5178,11 @@ sqlite3* open_database(char const* connstring, int flags, bool initialize)
 		result = sqlite3_create_function_v2(instance, "url_encode", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, url_encode, nullptr, nullptr, nullptr);
 		if(result != SQLITE_OK) throw sqlite_exception(result);
 
+		// table-valued function: http_json_each
+		//
+		result = sqlite3_create_module_v2(instance, "http_json_each", &g_http_json_each_module, nullptr, nullptr);
+		if(result != SQLITE_OK) throw sqlite_exception(result);
+
 		// Only execute schema creation steps if the database is being initialized; the caller needs
 		// to ensure that this is set for only one connection otherwise locking issues can occur
 		//
@@ -3171,17 +5217,172 @@ sqlite3* open_database(char const* connstring, int flags, bool initialize)
 			//
 			// recordingruleid(pk) | data
 			execute_non_query(instance, "create table if not exists recordingrule(recordingruleid text primary key not null, seriesid text not null, data text)");
+			execute_non_query(instance, "create index if not exists recordingrule_seriesid_index on recordingrule(seriesid)");
 
 			// table: episode
 			//
-			// seriesid(pk) | data
-			execute_non_query(instance, "create table if not exists episode(seriesid text primary key not null, data text)");
+			// seriesid(pk) | data
+			execute_non_query(instance, "create table if not exists episode(seriesid text primary key not null, data text)");
+
+			// table: lineupentry
+			//
+			// deviceid | channelid | guidenumber | guidename | url | drm | hd | favorite | demo
+			execute_non_query(instance, "create table if not exists lineupentry(deviceid text not null, channelid integer not null, guidenumber text, guidename text, "
+				"url text, drm integer, hd integer, favorite integer, demo integer)");
+			execute_non_query(instance, "create index if not exists lineupentry_channelid_index on lineupentry(channelid)");
+			execute_non_query(instance, "create index if not exists lineupentry_deviceid_index on lineupentry(deviceid)");
+
+			// table: recordingentry
+			//
+			// recordingid | deviceid | fullkey | programid | title | episodenumber | episodetitle | originalairdate | starttime | playurl |
+			//   displaygrouptitle | synopsis | channelname | imageurl | recordstarttime | recordendtime | resume | channelnumber | channelid
+			execute_non_query(instance, "create table if not exists recordingentry(recordingid text, deviceid text not null, fullkey text not null, programid text, "
+				"title text, episodenumber text, episodetitle text, originalairdate integer, starttime integer, playurl text, displaygrouptitle text, synopsis text, "
+				"channelname text, imageurl text, recordstarttime integer, recordendtime integer, resume integer, channelnumber text, channelid integer)");
+			execute_non_query(instance, "create index if not exists recordingentry_recordingid_index on recordingentry(recordingid)");
+			execute_non_query(instance, "create index if not exists recordingentry_deviceid_index on recordingentry(deviceid)");
+
+			// table: episodeentry
+			//
+			// seriesid | starttime | endtime | programid | channelnumber | channelid | title | synopsis | recordingrule
+			execute_non_query(instance, "create table if not exists episodeentry(seriesid text not null, starttime integer, endtime integer, programid text, "
+				"channelnumber text, channelid integer, title text, synopsis text, recordingrule integer)");
+			execute_non_query(instance, "create index if not exists episodeentry_seriesid_index on episodeentry(seriesid, starttime)");
+			execute_non_query(instance, "create index if not exists episodeentry_starttime_index on episodeentry(starttime)");
+
+			// table: timer
+			//
+			// seriesid | starttime | endtime | timerid | channelid | recordingruleid | parenttype | title | synopsis
+			execute_non_query(instance, "create table if not exists timer(seriesid text not null, starttime integer, endtime integer, timerid integer, channelid integer, "
+				"recordingruleid integer, parenttype integer, title text, synopsis text)");
+			execute_non_query(instance, "create index if not exists timer_seriesid_index on timer(seriesid)");
+			execute_non_query(instance, "create index if not exists timer_starttime_index on timer(starttime)");
+
+			// triggers: lineup, recording, episode
+			//
+			// The entry tables are maintained from the JSON data in the discovery tables; the insert triggers also
+			// remove any existing entries since REPLACE does not fire the delete triggers (recursive_triggers is off)
+			execute_non_query(instance, "create trigger if not exists lineup_insert after insert on lineup begin "
+				"delete from lineupentry where deviceid = new.deviceid; "
+				"insert into lineupentry select new.deviceid, encode_channel_id(json_extract(entry.value, '$.GuideNumber')), json_extract(entry.value, '$.GuideNumber'), json_extract(entry.value, '$.GuideName'), "
+				"json_extract(entry.value, '$.URL'), json_extract(entry.value, '$.DRM'), json_extract(entry.value, '$.HD'), json_extract(entry.value, '$.Favorite'), "
+				"json_extract(entry.value, '$.Demo') from json_each(new.data) as entry where entry.type = 'object'; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists lineup_update after update on lineup begin "
+				"delete from lineupentry where deviceid = old.deviceid or deviceid = new.deviceid; "
+				"insert into lineupentry select new.deviceid, encode_channel_id(json_extract(entry.value, '$.GuideNumber')), json_extract(entry.value, '$.GuideNumber'), json_extract(entry.value, '$.GuideName'), "
+				"json_extract(entry.value, '$.URL'), json_extract(entry.value, '$.DRM'), json_extract(entry.value, '$.HD'), json_extract(entry.value, '$.Favorite'), "
+				"json_extract(entry.value, '$.Demo') from json_each(new.data) as entry where entry.type = 'object'; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists lineup_delete after delete on lineup begin "
+				"delete from lineupentry where deviceid = old.deviceid; end");
+			execute_non_query(instance, "create trigger if not exists recording_insert after insert on recording begin "
+				"delete from recordingentry where deviceid = new.deviceid; "
+				"insert into recordingentry select json_extract(entry.value, '$.CmdURL'), new.deviceid, entry.fullkey, json_extract(entry.value, '$.ProgramID'), json_extract(entry.value, '$.Title'), "
+				"json_extract(entry.value, '$.EpisodeNumber'), json_extract(entry.value, '$.EpisodeTitle'), json_extract(entry.value, '$.OriginalAirdate'), "
+				"json_extract(entry.value, '$.StartTime'), json_extract(entry.value, '$.PlayURL'), json_extract(entry.value, '$.DisplayGroupTitle'), "
+				"json_extract(entry.value, '$.Synopsis'), json_extract(entry.value, '$.ChannelName'), json_extract(entry.value, '$.ImageURL'), "
+				"json_extract(entry.value, '$.RecordStartTime'), json_extract(entry.value, '$.RecordEndTime'), json_extract(entry.value, '$.Resume'), "
+				"json_extract(entry.value, '$.ChannelNumber'), encode_channel_id(json_extract(entry.value, '$.ChannelNumber')) "
+				"from json_each(new.data) as entry where entry.type = 'object'; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists recording_update after update on recording begin "
+				"delete from recordingentry where deviceid = old.deviceid or deviceid = new.deviceid; "
+				"insert into recordingentry select json_extract(entry.value, '$.CmdURL'), new.deviceid, entry.fullkey, json_extract(entry.value, '$.ProgramID'), json_extract(entry.value, '$.Title'), "
+				"json_extract(entry.value, '$.EpisodeNumber'), json_extract(entry.value, '$.EpisodeTitle'), json_extract(entry.value, '$.OriginalAirdate'), "
+				"json_extract(entry.value, '$.StartTime'), json_extract(entry.value, '$.PlayURL'), json_extract(entry.value, '$.DisplayGroupTitle'), "
+				"json_extract(entry.value, '$.Synopsis'), json_extract(entry.value, '$.ChannelName'), json_extract(entry.value, '$.ImageURL'), "
+				"json_extract(entry.value, '$.RecordStartTime'), json_extract(entry.value, '$.RecordEndTime'), json_extract(entry.value, '$.Resume'), "
+				"json_extract(entry.value, '$.ChannelNumber'), encode_channel_id(json_extract(entry.value, '$.ChannelNumber')) "
+				"from json_each(new.data) as entry where entry.type = 'object'; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists recording_delete after delete on recording begin "
+				"delete from recordingentry where deviceid = old.deviceid; end");
+			execute_non_query(instance, "create trigger if not exists episode_insert after insert on episode begin "
+				"delete from episodeentry where seriesid = new.seriesid; "
+				"insert into episodeentry select new.seriesid, json_extract(entry.value, '$.StartTime'), json_extract(entry.value, '$.EndTime'), json_extract(entry.value, '$.ProgramID'), "
+				"json_extract(entry.value, '$.ChannelNumber'), encode_channel_id(json_extract(entry.value, '$.ChannelNumber')), json_extract(entry.value, '$.Title'), "
+				"json_extract(entry.value, '$.Synopsis'), json_extract(entry.value, '$.RecordingRule') from json_each(new.data) as entry where entry.type = 'object'; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists episode_update after update on episode begin "
+				"delete from episodeentry where seriesid = old.seriesid or seriesid = new.seriesid; "
+				"insert into episodeentry select new.seriesid, json_extract(entry.value, '$.StartTime'), json_extract(entry.value, '$.EndTime'), json_extract(entry.value, '$.ProgramID'), "
+				"json_extract(entry.value, '$.ChannelNumber'), encode_channel_id(json_extract(entry.value, '$.ChannelNumber')), json_extract(entry.value, '$.Title'), "
+				"json_extract(entry.value, '$.Synopsis'), json_extract(entry.value, '$.RecordingRule') from json_each(new.data) as entry where entry.type = 'object'; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists episode_delete after delete on episode begin "
+				"delete from episodeentry where seriesid = old.seriesid; end");
+
+			// triggers: episodeentry, recordingrule
+			//
+			// The timer table holds the episode entries that are scheduled to be recorded along with the recording rule that
+			// owns each of them; a date/time only rule for the specific start time takes precedence over the series rule
+			execute_non_query(instance, "create trigger if not exists episodeentry_insert after insert on episodeentry when new.recordingrule = 1 begin "
+				"insert into timer select new.seriesid, new.starttime, new.endtime, fnv_hash(new.programid, new.starttime, new.channelnumber), new.channelid, "
+				"coalesce((select recordingruleid from recordingrule where seriesid = new.seriesid and json_extract(data, '$.DateTimeOnly') = new.starttime limit 1), "
+				"(select recordingruleid from recordingrule where seriesid = new.seriesid and json_extract(data, '$.DateTimeOnly') is null limit 1)), "
+				"exists(select 1 from recordingrule where seriesid = new.seriesid and json_extract(data, '$.DateTimeOnly') = new.starttime), "
+				"new.title, new.synopsis; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists episodeentry_delete after delete on episodeentry when old.recordingrule = 1 begin "
+				"delete from timer where seriesid = old.seriesid and timerid = fnv_hash(old.programid, old.starttime, old.channelnumber); end");
+			execute_non_query(instance, "create trigger if not exists recordingrule_insert after insert on recordingrule begin "
+				"update timer set "
+				"recordingruleid = coalesce((select recordingruleid from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') = timer.starttime limit 1), "
+				"(select recordingruleid from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') is null limit 1)), "
+				"parenttype = exists(select 1 from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') = timer.starttime) "
+				"where seriesid = new.seriesid; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists recordingrule_update after update on recordingrule begin "
+				"update timer set "
+				"recordingruleid = coalesce((select recordingruleid from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') = timer.starttime limit 1), "
+				"(select recordingruleid from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') is null limit 1)), "
+				"parenttype = exists(select 1 from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') = timer.starttime) "
+				"where seriesid = old.seriesid or seriesid = new.seriesid; "
+				"end");
+			execute_non_query(instance, "create trigger if not exists recordingrule_delete after delete on recordingrule begin "
+				"update timer set "
+				"recordingruleid = coalesce((select recordingruleid from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') = timer.starttime limit 1), "
+				"(select recordingruleid from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') is null limit 1)), "
+				"parenttype = exists(select 1 from recordingrule where seriesid = timer.seriesid and json_extract(data, '$.DateTimeOnly') = timer.starttime) "
+				"where seriesid = old.seriesid; "
+				"end");
+
+			// Generate the entry table rows for any existing discovery data that doesn't have them yet
+			execute_non_query(instance, "update lineup set data = data where deviceid not in (select deviceid from lineupentry)");
+			execute_non_query(instance, "update recording set data = data where deviceid not in (select deviceid from recordingentry)");
+			execute_non_query(instance, "update episode set data = data where seriesid not in (select seriesid from episodeentry)");
+
+			// Generate the timer rows for any existing episode entries that don't have them yet
+			execute_non_query(instance, "update episode set data = data where seriesid in (select seriesid from episodeentry where recordingrule = 1) "
+				"and seriesid not in (select seriesid from timer)");
+
+			// table: fingerprint
+			//
+			// source(pk) | id(pk) | hash
+			execute_non_query(instance, "create table if not exists fingerprint(source text not null, id not null, hash integer, primary key(source, id))");
+
+			// table: discovery
+			//
+			// source(pk) | timestamp
+			execute_non_query(instance, "create table if not exists discovery(source text primary key not null, timestamp integer)");
 
 			// table: genremap
 			//
 			// filter(pk) | genretype
 			execute_non_query(instance, "create table if not exists genremap(filter text primary key not null, genretype integer)");
 
+			// table: guideentry
+			//
+			// channelid(pk) | starttime(pk) | endtime | seriesid | data | discovered
+			execute_non_query(instance, "create table if not exists guideentry(channelid integer not null, starttime integer not null, endtime integer not null, "
+				"seriesid text, data text, discovered integer not null, primary key(channelid, starttime))");
+
+			// table: httpcache
+			//
+			// url(pk) | etag | lastmodified | fingerprint
+			execute_non_query(instance, "create table if not exists httpcache(url text primary key not null, etag text, lastmodified text, fingerprint integer)");
+
 			// (re)generate the clientid
 			//
 			execute_non_query(instance, "delete from client");
@@ -3207,6 +5408,280 @@ sqlite3* open_database(char const* connstring, int flags, bool initialize)
 	return instance;
 }
 
+//---------------------------------------------------------------------------
+// prepare_http_request
+//
+// Applies the common options to a CURL easy interface handle for an HTTP request
+//
+// Arguments:
+//
+//	curl		- CURL easy interface handle
+//	url			- URL of the request
+//	blob		- Buffer to receive the response data
+
+CURLcode prepare_http_request(CURL* curl, char const* url, sqlite_buffer* blob)
+{
+	assert(blob != nullptr);
+
+	// Create a write callback for libcurl to invoke to write the data
+	auto write_function = [](void const* data, size_t size, size_t count, void* userdata) -> size_t {
+
+		try { return reinterpret_cast<sqlite_buffer*>(userdata)->append(data, (size * count)); }
+		catch(...) { return 0; }
+	};
+
+	return prepare_http_request(curl, url, write_function, reinterpret_cast<void*>(blob));
+}
+
+//---------------------------------------------------------------------------
+// prepare_http_request
+//
+// Applies the common options to a CURL easy interface handle for an HTTP request
+//
+// Arguments:
+//
+//	curl		- CURL easy interface handle
+//	url			- URL of the request
+//	write		- Write callback to receive the response data
+//	userdata	- Argument to pass into the write callback
+
+CURLcode prepare_http_request(CURL* curl, char const* url, size_t(*write)(void const*, size_t, size_t, void*), void* userdata)
+{
+	// useragent
+	//
+	// Static string to use as the User-Agent for this HTTP request
+	static std::string useragent = "Kodi-PVR/" + std::string(ADDON_INSTANCE_VERSION_PVR) + " " + VERSION_PRODUCTNAME_ANSI + "/" + VERSION_VERSION3_ANSI;
+
+	assert((curl != nullptr) && (url != nullptr) && (write != nullptr));
+
+	// Set the CURL options for the web request to get the JSON string data
+	CURLcode curlresult = curl_easy_setopt(curl, CURLOPT_URL, url);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_USERAGENT, useragent.c_str());
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_TIMEOUT, g_httptimeout.load());
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, (g_httplowspeedtime > 0) ? 1L : 0L);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, g_httplowspeedtime.load());
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, static_cast<CURL_WRITEFUNCTION>(write));
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_WRITEDATA, userdata);
+	if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_SHARE, static_cast<CURLSH*>(g_curlshare));
+
+	return curlresult;
+}
+
+//---------------------------------------------------------------------------
+// prepare_statement
+//
+// Retrieves a prepared statement from the connection's statement cache, preparing
+// and caching it as necessary.  Release the statement with release_statement
+//
+// Arguments:
+//
+//	instance	- Database instance
+//	sql			- SQL statement text; must be a string literal
+//	statement	- On success, receives the prepared statement
+
+int prepare_statement(sqlite3* instance, char const* sql, sqlite3_stmt** statement)
+{
+	assert((instance != nullptr) && (sql != nullptr) && (statement != nullptr));
+
+	*statement = nullptr;
+
+	std::unique_lock<std::mutex> lock(g_statementcacheslock);
+
+	auto& cache = g_statementcaches[instance];
+	if(!cache) cache.reset(new statementcache());
+
+	// If the statement has already been prepared and is not in use it can be returned
+	auto found = cache->statements.find(sql);
+	if(found != cache->statements.end()) {
+
+		if(cache->inuse.insert(found->second).second) { *statement = found->second; return SQLITE_OK; }
+
+		// The cached statement is in use (the same query was executed from within a callback), a
+		// separate statement is prepared that will be finalized when it's released
+		lock.unlock();
+		return sqlite3_prepare_v2(instance, sql, -1, statement, nullptr);
+	}
+
+	int result = sqlite3_prepare_v2(instance, sql, -1, statement, nullptr);
+	if(result != SQLITE_OK) return result;
+
+	cache->statements.emplace(sql, *statement);
+	cache->inuse.insert(*statement);
+
+	return SQLITE_OK;
+}
+
+//---------------------------------------------------------------------------
+// probe_http_hosts
+//
+// Probes each of the hosts that currently have an open circuit breaker
+//
+// Arguments:
+//
+//	NONE
+
+bool probe_http_hosts(void)
+{
+	bool tripped = false;						// Flag if any hosts remain unavailable
+
+	for(auto const& host : g_circuitbreaker.tripped()) {
+
+		// Acquire a CURL session for the probe operation from the handle pool
+		CURL* curl = g_curlshare.acquire_handle();
+		if(curl == nullptr) throw string_exception(__func__, ": curl_easy_init() failed");
+
+		// Any response to a HEAD request for the root of the host is enough to close the circuit, the body
+		// isn't needed and the probe is given a shorter timeout than a normal request
+		std::string url = host + "/";
+		CURLcode curlresult = curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+		if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+		if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+		if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+		if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+		if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(curl, CURLOPT_SHARE, static_cast<CURLSH*>(g_curlshare));
+		if(curlresult == CURLE_OK) curlresult = curl_easy_perform(curl);
+		g_curlshare.release_handle(curl);
+
+		increment_metric("http.circuit.probes");
+		g_circuitbreaker.report(url.c_str(), curlresult);
+
+		if(curlresult != CURLE_OK) tripped = true;
+	}
+
+	return tripped;
+}
+
+//---------------------------------------------------------------------------
+// profile_statement
+//
+// SQLite trace callback used to record the execution time of statements
+//
+// Arguments:
+//
+//	type		- Type of trace event being reported
+//	context		- Context pointer provided to sqlite3_trace_v2
+//	statement	- Prepared statement that was executed
+//	elapsed		- Pointer to the elapsed execution time in nanoseconds
+
+int profile_statement(unsigned int type, void* /*context*/, void* statement, void* elapsed)
+{
+	// Statement metrics are named after the (truncated) SQL text of the statement
+	static size_t const MAX_METRIC_NAME = 96;
+
+	if((type != SQLITE_TRACE_PROFILE) || (statement == nullptr) || (elapsed == nullptr)) return 0;
+
+	auto duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(*reinterpret_cast<sqlite3_int64*>(elapsed)));
+	record_metric_duration("sqlite.statements", duration);
+
+	// The metric name is generated on the stack, the metric lookup doesn't require a std::string
+	// so nothing is allocated here unless this is the first time the statement has been recorded
+	char const* sql = sqlite3_sql(reinterpret_cast<sqlite3_stmt*>(statement));
+	if(sql != nullptr) {
+
+		char name[MAX_METRIC_NAME + 16];
+		snprintf(name, std::extent<decltype(name)>::value, "sqlite: %.*s", static_cast<int>(strnlen(sql, MAX_METRIC_NAME)), sql);
+		record_metric_duration(name, duration);
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+// record_http_metrics
+//
+// Records the counters and timings of a completed http transfer
+//
+// Arguments:
+//
+//	curl			- CURL easy handle of the completed transfer
+//	url				- URL of the transfer
+//	curlresult		- Result code from the transfer
+//	responsecode	- HTTP response code from the transfer
+
+void record_http_metrics(CURL* curl, char const* url, CURLcode curlresult, long responsecode)
+{
+	// Converts a CURLINFO_XXX_TIME value into a steady_clock duration
+	auto toduration = [](double seconds) -> std::chrono::steady_clock::duration { 
+		
+		return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds)); 
+	};
+
+	// Track the health of the host to open or close the circuit breaker as necessary
+	g_circuitbreaker.report(url, curlresult);
+
+	increment_metric("http.requests");
+	if(responsecode == 304) increment_metric("http.notmodified");
+	else if((curlresult != CURLE_OK) || (responsecode < 200) || (responsecode > 299)) increment_metric("http.failures");
+
+	if(curlresult != CURLE_OK) return;
+
+	// The CURL timings are each measured from the start of the transfer
+	double namelookup = 0.0, connect = 0.0, starttransfer = 0.0, total = 0.0;
+	if(curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME, &namelookup) == CURLE_OK) record_metric_duration("http.namelookup", toduration(namelookup));
+	if(curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME, &connect) == CURLE_OK) record_metric_duration("http.connect", toduration(connect));
+	if(curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &starttransfer) == CURLE_OK) record_metric_duration("http.firstbyte", toduration(starttransfer));
+	if(curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total) == CURLE_OK) record_metric_duration("http.total", toduration(total));
+}
+
+//---------------------------------------------------------------------------
+// release_statement
+//
+// Releases a statement retrieved from prepare_statement
+//
+// Arguments:
+//
+//	statement	- Statement to be released
+
+void release_statement(sqlite3_stmt* statement)
+{
+	if(statement == nullptr) return;
+
+	std::unique_lock<std::mutex> lock(g_statementcacheslock);
+
+	// Cached statements are reset and have their bindings cleared for the next caller
+	auto found = g_statementcaches.find(sqlite3_db_handle(statement));
+	if((found != g_statementcaches.end()) && (found->second->inuse.erase(statement) > 0)) {
+
+		sqlite3_reset(statement);
+		sqlite3_clear_bindings(statement);
+	}
+
+	// Statements that were not cached are finalized
+	else sqlite3_finalize(statement);
+}
+
+//---------------------------------------------------------------------------
+// reset_statements
+//
+// Resets any cached statements that are still in use on a connection
+//
+// Arguments:
+//
+//	instance	- Database instance
+
+void reset_statements(sqlite3* instance)
+{
+	if(instance == nullptr) return;
+
+	std::unique_lock<std::mutex> lock(g_statementcacheslock);
+
+	auto found = g_statementcaches.find(instance);
+	if(found == g_statementcaches.end()) return;
+
+	for(auto const& iterator : found->second->inuse) {
+
+		sqlite3_reset(iterator);
+		sqlite3_clear_bindings(iterator);
+	}
+
+	found->second->inuse.clear();
+}
+
 //---------------------------------------------------------------------------
 // set_channel_visibility
 //
@@ -3238,11 +5713,10 @@ void set_channel_visibility(sqlite3* instance, union channelid channelid, enum c
 	// Prepate a query to generate the necessary URLs for each tuner that supports the channel
 	auto sql = "with deviceurls(url) as "
 		"(select distinct(json_extract(device.data, '$.BaseURL') || '/lineup.post?favorite=' || ?1 || decode_channel_id(?2)) "
-		"from lineup inner join device using(deviceid), json_each(lineup.data) as lineupdata "
-		"where json_extract(lineupdata.value, '$.GuideNumber') = decode_channel_id(?2)) "
+		"from lineupentry inner join device using(deviceid) where lineupentry.channelid = ?2) "
 		"select http_request(url) from deviceurls";
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -3259,16 +5733,75 @@ void set_channel_visibility(sqlite3* instance, union channelid channelid, enum c
 		// The final result from sqlite3_step should be SQLITE_DONE
 		if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);
+		release_statement(statement);
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
+}
+
+//---------------------------------------------------------------------------
+// set_database_memory_limits
+//
+// Sets the SQLite heap limit and the memory allowances applied to new connections
+//
+// Arguments:
+//
+//	heaplimit	- Soft limit on the SQLite heap, in bytes (zero for no limit)
+//	cachesize	- Page cache size for each connection, in KiB
+//	mmapsize	- Maximum size of the memory-mapped I/O region, in bytes
+
+void set_database_memory_limits(long long heaplimit, int cachesize, long long mmapsize)
+{
+	if(heaplimit < 0) throw std::invalid_argument("heaplimit");
+	if(cachesize <= 0) throw std::invalid_argument("cachesize");
+	if(mmapsize < 0) throw std::invalid_argument("mmapsize");
+
+	// The heap limit is advisory; SQLite will release cache memory to stay below it when possible
+	sqlite3_soft_heap_limit64(heaplimit);
+
+	g_cachesize = cachesize;
+	g_mmapsize = mmapsize;
+}
+
+//---------------------------------------------------------------------------
+// set_http_request_concurrency
+//
+// Sets the maximum number of concurrent HTTP requests generated by the database layer
+//
+// Arguments:
+//
+//	maxconcurrency	- Maximum number of concurrent transfers
+
+void set_http_request_concurrency(int maxconcurrency)
+{
+	if(maxconcurrency <= 0) throw std::invalid_argument("maxconcurrency");
+
+	g_httpconcurrency = maxconcurrency;
+}
+
+//---------------------------------------------------------------------------
+// set_http_request_timeouts
+//
+// Sets the timeouts applied to the HTTP requests generated by the database layer
+//
+// Arguments:
+//
+//	timeout		- Maximum amount of time allowed for a transfer, in seconds (zero for none)
+//	lowspeedtime	- Amount of time a transfer can be stalled, in seconds (zero for none)
+
+void set_http_request_timeouts(int timeout, int lowspeedtime)
+{
+	if(timeout < 0) throw std::invalid_argument("timeout");
+	if(lowspeedtime < 0) throw std::invalid_argument("lowspeedtime");
+
+	g_httptimeout = timeout;
+	g_httplowspeedtime = lowspeedtime;
 }
 
 //---------------------------------------------------------------------------
 // set_recording_lastposition
 //
-// Sets the last played position for a specific recording
+// Sets the last played position for a specific recording on the storage device
 //
 // Arguments:
 //
@@ -3283,15 +5816,53 @@ void set_recording_lastposition(sqlite3* instance, char const* recordingid, int
 	
 	if((instance == nullptr) || (recordingid == nullptr)) return;
 
-	// Prepare a query that will update the specified recording on the storage device and the local database
-	auto sql = "with httprequest(response) as (select http_request(?1 || '&cmd=set&Resume=' || ?2)) "
-		"replace into recording select "
-		"deviceid, "
-		"(select case when fullkey is null then recording.data else json_set(recording.data, fullkey || '.Resume', ?2) end) as data "
-		"from httprequest, recording, "
-		"(select fullkey from recording, json_each(recording.data) as entry where json_extract(entry.value, '$.CmdURL') like ?1 limit 1)";
+	// Update the specified recording on the storage device; this does not write to the database
+	result = prepare_statement(instance, "select http_request(?1 || '&cmd=set&Resume=' || ?2)", &statement);
+	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	try {
+
+		// Bind the query parameter(s)
+		result = sqlite3_bind_text(statement, 1, recordingid, -1, SQLITE_STATIC);
+		if(result == SQLITE_OK) result = sqlite3_bind_int(statement, 2, lastposition);
+		if(result != SQLITE_OK) throw sqlite_exception(result);
+
+		// Execute the query; the response from the device is not used
+		result = sqlite3_step(statement);
+		if((result != SQLITE_ROW) && (result != SQLITE_DONE)) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+		release_statement(statement);			// Release the SQLite statement
+	}
+
+	catch(...) { release_statement(statement); throw; }
+}
+
+//---------------------------------------------------------------------------
+// store_recording_lastposition
+//
+// Stores the last played position for a specific recording in the local database
+//
+// Arguments:
+//
+//	instance		- Database instance
+//	recordingid		- Recording identifier (command url)
+//	lastposition	- Last position to be stored
+
+void store_recording_lastposition(sqlite3* instance, char const* recordingid, int lastposition)
+{
+	sqlite3_stmt*				statement;			// SQL statement to execute
+	int							result;				// Result from SQLite function
+	
+	if((instance == nullptr) || (recordingid == nullptr)) return;
+
+	// get_recording_lastposition reads the position from the local data rather than the device
+	auto sql = "replace into recording select "
+		"recording.deviceid, "
+		"json_set(recording.data, recordingentry.fullkey || '.Resume', ?2) as data "
+		"from recordingentry inner join recording on recordingentry.deviceid = recording.deviceid "
+		"where recordingentry.recordingid = ?1";
+
+	result = prepare_statement(instance, sql, &statement);
 	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
 	try {
@@ -3306,10 +5877,13 @@ void set_recording_lastposition(sqlite3* instance, char const* recordingid, int
 		if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
 		if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
 
-		sqlite3_finalize(statement);			// Finalize the SQLite statement
+		release_statement(statement);			// Release the SQLite statement
 	}
 
-	catch(...) { sqlite3_finalize(statement); throw; }
+	catch(...) { release_statement(statement); throw; }
+
+	// The local recording data no longer matches the last discovery
+	execute_non_query(instance, "delete from fingerprint where source = 'recording'");
 }
 
 //---------------------------------------------------------------------------
@@ -3330,6 +5904,75 @@ bool try_execute_non_query(sqlite3* instance, char const* sql)
 	return true;
 }
 
+//---------------------------------------------------------------------------
+// update_fingerprints
+//
+// Replaces the stored fingerprints for a discovery data source
+//
+// Arguments:
+//
+//	instance	- SQLite database instance
+//	source		- Name of the discovery data source
+//	table		- Name of the table containing the discovered data
+//	idcolumn	- Name of the column that identifies each row within the source
+//	hashcolumns	- Comma-separated list of the columns used to generate the fingerprint
+
+void update_fingerprints(sqlite3* instance, char const* source, char const* table, char const* idcolumn, char const* hashcolumns)
+{
+	sqlite3_stmt*				statement;			// SQL statement to execute
+	int							result;				// Result from SQLite function
+
+	if(instance == nullptr) throw std::invalid_argument("instance");
+	if(source == nullptr) throw std::invalid_argument("source");
+	if(table == nullptr) throw std::invalid_argument("table");
+	if(idcolumn == nullptr) throw std::invalid_argument("idcolumn");
+	if(hashcolumns == nullptr) throw std::invalid_argument("hashcolumns");
+
+	// Remove all of the existing fingerprints for the source
+	result = prepare_statement(instance, "delete from fingerprint where source = ?1", &statement);
+	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+	try {
+
+		// Bind the query parameter(s)
+		result = sqlite3_bind_text(statement, 1, source, -1, SQLITE_STATIC);
+		if(result != SQLITE_OK) throw sqlite_exception(result);
+
+		// Execute the query; there shouldn't be any result set returned from it
+		result = sqlite3_step(statement);
+		if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+		if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+		release_statement(statement);			// Release the SQLite statement
+	}
+
+	catch(...) { release_statement(statement); throw; }
+
+	// Generate a new fingerprint for each row of the discovered data
+	auto sql = sqlite3_mprintf("insert into fingerprint select ?1, \"%w\", fnv_hash(%s) from \"%w\"", idcolumn, hashcolumns, table);
+	if(sql == nullptr) throw std::bad_alloc();
+
+	result = sqlite3_prepare_v2(instance, sql, -1, &statement, nullptr);
+	sqlite3_free(reinterpret_cast<void*>(sql));
+	if(result != SQLITE_OK) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+	try {
+
+		// Bind the query parameter(s)
+		result = sqlite3_bind_text(statement, 1, source, -1, SQLITE_STATIC);
+		if(result != SQLITE_OK) throw sqlite_exception(result);
+
+		// Execute the query; there shouldn't be any result set returned from it
+		result = sqlite3_step(statement);
+		if(result == SQLITE_ROW) throw string_exception(__func__, ": unexpected result set returned from non-query");
+		if(result != SQLITE_DONE) throw sqlite_exception(result, sqlite3_errmsg(instance));
+
+		sqlite3_finalize(statement);			// Finalize the SQLite statement
+	}
+
+	catch(...) { sqlite3_finalize(statement); throw; }
+}
+
 //---------------------------------------------------------------------------
 // url_encode
 //
@@ -24,13 +24,19 @@
 #define __DATABASE_H_
 #pragma once
 
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "curlshare.h"
 #include "scalar_condition.h"
 
 #pragma warning(push, 4)
@@ -234,6 +240,11 @@ using enumerate_series_callback = std::function<void(struct series const& series
 // Callback function passed to enumerate_timers
 using enumerate_timers_callback = std::function<void(struct timer const& timer)>;
 
+// enumerate_tuners_callback
+//
+// Callback function passed to enumerate_tuners
+using enumerate_tuners_callback = std::function<void(char const* tuner)>;
+
 //---------------------------------------------------------------------------
 // connectionpool
 //
@@ -243,29 +254,90 @@ class connectionpool
 {
 public:
 
-	// Instance Constructor
+	// Instance Constructors
 	//
 	connectionpool(char const* connstr, int flags);
+	connectionpool(char const* connstr, int flags, size_t poolsize, size_t warmcount, unsigned int timeout);
 
 	// Destructor
 	//
 	~connectionpool();
 
+	//-----------------------------------------------------------------------
+	// Type Declarations
+
+	// counters
+	//
+	// Usage counters for the connection pool
+	struct counters {
+
+		unsigned long long		acquires;			// Total number of acquire operations
+		unsigned long long		waits;				// Number of acquires that had to wait
+		unsigned long long		waittime;			// Total wait time, in milliseconds
+		size_t					connections;		// Number of open connections
+		size_t					highwater;			// Maximum number of connections in use
+		unsigned long long		mutations;			// Number of queued mutations executed
+		unsigned long long		coalesced;			// Number of queued mutations replaced before execution
+		unsigned long long		batches;			// Number of batched write transactions
+		unsigned long long		checkpoints;		// Number of WAL checkpoints executed
+	};
+
+	// mutation
+	//
+	// Function executed by the database writer within a batched write transaction; mutations only
+	// write to the local database, anything slow (such as an HTTP request) must be done before queuing
+	using mutation = std::function<void(sqlite3* instance)>;
+
+	//-----------------------------------------------------------------------
+	// Constants
+
+	// DEFAULT_POOL_SIZE
+	//
+	// Default maximum number of connections in the pool
+	static size_t const DEFAULT_POOL_SIZE;
+
+	// DEFAULT_TIMEOUT
+	//
+	// Default amount of time to wait for a connection, in milliseconds
+	static unsigned int const DEFAULT_TIMEOUT;
+
 	//-----------------------------------------------------------------------
 	// Member Functions
 
 	// acquire
 	//
-	// Acquires a connection from the pool, creating a new one as necessary
+	// Acquires a read-only connection from the pool, creating a new one as necessary
 	sqlite3* acquire(void);
 
+	// acquire_writable
+	//
+	// Acquires a read-write connection from the pool, creating a new one as necessary
+	sqlite3* acquire_writable(void);
+
+	// enqueue
+	//
+	// Queues a mutation to be executed by the database writer
+	void enqueue(char const* key, mutation const& mutation);
+
+	// pause_checkpoints
+	//
+	// Suspends idle WAL checkpoints until resume_checkpoints is called
+	void pause_checkpoints(void);
+
 	// release
 	//
 	// Releases a previously acquired connection back into the pool
 	void release(sqlite3* handle);
 
-	//-----------------------------------------------------------------------
-	// Type Declarations
+	// resume_checkpoints
+	//
+	// Resumes idle WAL checkpoints suspended by pause_checkpoints
+	void resume_checkpoints(void);
+
+	// statistics
+	//
+	// Gets the usage counters for the connection pool
+	struct counters statistics(void) const;
 
 	// handle
 	//
@@ -299,19 +371,108 @@ public:
 		sqlite3* m_handle;
 	};
 
+	// writehandle
+	//
+	// RAII class to acquire and release read-write connections from the pool
+	class writehandle
+	{
+	public:
+
+		// Constructor / Destructor
+		//
+		writehandle(std::shared_ptr<connectionpool> const& pool) : m_pool(pool), m_handle(pool->acquire_writable()) { }
+		~writehandle() { m_pool->release(m_handle); }
+
+		// sqlite3* type conversion operator
+		//
+		operator sqlite3*(void) const { return m_handle; }
+
+	private:
+
+		writehandle(writehandle const&)=delete;
+		writehandle& operator=(writehandle const&)=delete;
+
+		// m_pool
+		//
+		// Shared pointer to the parent connection pool
+		std::shared_ptr<connectionpool> const m_pool;
+
+		// m_handle
+		//
+		// SQLite handle acquired from the pool
+		sqlite3* m_handle;
+	};
+
 private:
 
 	connectionpool(connectionpool const&)=delete;
 	connectionpool& operator=(connectionpool const&)=delete;
 
+	// CHECKPOINT_INTERVAL
+	//
+	// Amount of time the writer must be idle before a WAL checkpoint, in milliseconds
+	static unsigned int const CHECKPOINT_INTERVAL;
+
+	// CHECKPOINT_LIMIT
+	//
+	// Number of WAL frames that forces a checkpoint even when checkpoints are paused
+	static int const CHECKPOINT_LIMIT;
+
+	//-----------------------------------------------------------------------
+	// Private Member Functions
+
+	// acquire
+	//
+	// Acquires a read-only or read-write connection from the pool
+	sqlite3* acquire(bool writable);
+
+	// checkpoint
+	//
+	// Executes a passive WAL checkpoint against the database
+	void checkpoint(void);
+
+	// execute_batch
+	//
+	// Executes a batch of queued mutations within a single write transaction
+	void execute_batch(std::deque<std::pair<std::string, mutation>> const& batch);
+
+	// open_connection
+	//
+	// Opens a new read-only or read-write database connection
+	sqlite3* open_connection(bool writable, bool initialize);
+
+	// wal_hook (static)
+	//
+	// Callback invoked by SQLite after a transaction is committed to the WAL
+	static int wal_hook(void* context, sqlite3* instance, char const* database, int frames);
+
+	// writer
+	//
+	// Database writer thread procedure
+	void writer(void);
+
 	//-----------------------------------------------------------------------
 	// Member Variables
 	
 	std::string	const			m_connstr;			// Connection string
 	int	const					m_flags;			// Connection flags
-	std::vector<sqlite3*>		m_connections;		// All active connections
-	std::queue<sqlite3*>		m_queue;			// Queue of unused connection
+	size_t const				m_poolsize;			// Maximum number of connections
+	std::chrono::milliseconds	m_timeout;			// Amount of time to wait for a connection
+	std::vector<sqlite3*>		m_connections;		// All active read-only connections
+	std::vector<sqlite3*>		m_writeconnections;	// All active read-write connections
+	std::queue<sqlite3*>		m_queue;			// Queue of unused read-only connection
+	std::queue<sqlite3*>		m_writequeue;		// Queue of unused read-write connections
 	mutable std::mutex			m_lock;				// Synchronization object
+	std::condition_variable		m_released;			// Signaled when a connection is released
+	struct counters				m_counters = {};	// Usage counters
+
+	std::deque<std::pair<std::string, mutation>> m_mutations;	// Queued mutations
+	std::thread					m_writer;			// Database writer thread
+	std::mutex					m_writerlock;		// Writer synchronization object
+	std::condition_variable		m_writercond;		// Signaled when a mutation is queued
+	bool						m_stop = false;		// Flag to stop the writer thread
+	bool						m_paused = false;	// Flag indicating checkpoints are paused
+	std::atomic<int>			m_walframes{0};		// Number of frames in the WAL
 };
 
 //---------------------------------------------------------------------------
@@ -361,6 +522,12 @@ void discover_episodes(sqlite3* instance, bool& changed);
 void discover_guide(sqlite3* instance);
 void discover_guide(sqlite3* instance, bool& changed);
 
+// discover_guideentries
+//
+// Loads the electronic program guide entries for a time frame
+void discover_guideentries(sqlite3* instance, int maxdays);
+void discover_guideentries(sqlite3* instance, int maxdays, enumerate_channelids_callback callback);
+
 // discover_lineups
 //
 // Reloads the information about the available channels
@@ -455,6 +622,11 @@ void enumerate_series(sqlite3* instance, char const* title, enumerate_series_cal
 // Enumerates the available timers
 void enumerate_timers(sqlite3* instance, int maxdays, enumerate_timers_callback callback);
 
+// enumerate_tuners
+//
+// Enumerates all of the tuners available on the discovered tuner devices
+void enumerate_tuners(sqlite3* instance, enumerate_tuners_callback callback);
+
 // execute_non_query
 //
 // executes a non-query against the database
@@ -480,6 +652,16 @@ long long get_available_storage_space(sqlite3* instance);
 // Gets the number of available channels in the database
 int get_channel_count(sqlite3* instance, bool showdrm);
 
+// get_device_discovery_age
+//
+// Gets the number of seconds since the last successful device discovery
+int get_device_discovery_age(sqlite3* instance);
+
+// get_http_share
+//
+// Gets the curlshare instance used by the database layer HTTP requests
+curlshare& get_http_share(void);
+
 // get_recording_count
 //
 // Gets the number of available recordings in the database
@@ -536,16 +718,41 @@ void modify_recordingrule(sqlite3* instance, struct recordingrule const& recordi
 sqlite3* open_database(char const* connstring, int flags);
 sqlite3* open_database(char const* connstring, int flags, bool initialize);
 
+// probe_http_hosts
+//
+// Probes the hosts that have been marked as unavailable, returns true if any remain unavailable
+bool probe_http_hosts(void);
+
 // set_channel_visibility
 //
 // Sets the visibility of a channel on all known tuner devices
 void set_channel_visibility(sqlite3* instance, union channelid channelid, enum channel_visibility visibility);
 
+// set_database_memory_limits
+//
+// Sets the SQLite heap limit and the memory allowances applied to new connections
+void set_database_memory_limits(long long heaplimit, int cachesize, long long mmapsize);
+
+// set_http_request_concurrency
+//
+// Sets the maximum number of concurrent HTTP requests generated by the database layer
+void set_http_request_concurrency(int maxconcurrency);
+
+// set_http_request_timeouts
+//
+// Sets the timeouts applied to the HTTP requests generated by the database layer
+void set_http_request_timeouts(int timeout, int lowspeedtime);
+
 // set_recording_lastposition
 //
-// Sets the last played position for a specific recording
+// Sets the last played position for a specific recording on the storage device
 void set_recording_lastposition(sqlite3* instance, char const* recordingid, int lastposition);
 
+// store_recording_lastposition
+//
+// Stores the last played position for a specific recording in the local database
+void store_recording_lastposition(sqlite3* instance, char const* recordingid, int lastposition);
+
 // try_execute_non_query
 //
 // executes a non-query against the database but eats any exceptions
@@ -25,12 +25,32 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
+#include <string>
+
+#if !defined(TARGET_WINDOWS) && !defined(TARGET_WINDOWS_STORE)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "align.h"
 #include "http_exception.h"
+#include "metrics.h"
 #include "string_exception.h"
 
+// The SIMD packet scanning kernels operate on the raw little-endian representation of the
+// transport stream headers; fall back to the scalar implementation on big-endian targets
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define DVRSTREAM_SCAN_SSE2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#define DVRSTREAM_SCAN_NEON
+#endif
+
 #pragma warning(push, 4)
 
 // dvrstream::DEFAULT_READ_MINCOUNT (static)
@@ -38,11 +58,21 @@
 // Default minimum amount of data to return from a read request
 size_t const dvrstream::DEFAULT_READ_MINCOUNT = (4 KiB);
 
+// dvrstream::BITRATE_INTERVAL (static)
+//
+// Minimum interval over which a bitrate measurement is taken, in 90KHz periods (2 seconds)
+uint64_t const dvrstream::BITRATE_INTERVAL = 180000;
+
 // dvrstream::DEFAULT_RINGBUFFER_SIZE (static)
 //
 // Default ring buffer size, in bytes
 size_t const dvrstream::DEFAULT_RINGBUFFER_SIZE = (1 MiB);
 
+// dvrstream::MAX_POOLED_BUFFERS (static)
+//
+// Maximum number of released heap ring buffers retained for reuse
+size_t const dvrstream::MAX_POOLED_BUFFERS = 1;
+
 // dvrstream::MAX_STREAM_LENGTH (static)
 //
 // Maximum allowable stream length; indicates a real-time stream
@@ -52,6 +82,50 @@ long long const dvrstream::MAX_STREAM_LENGTH = std::numeric_limits<long long>::m
 //
 // Length of a single mpeg-ts data packet
 size_t const dvrstream::MPEGTS_PACKET_LENGTH = 188;
+
+// dvrstream::READMIN_TARGET_INTERVAL (static)
+//
+// Amount of stream time the minimum read should represent, in 90KHz periods (100 milliseconds)
+uint64_t const dvrstream::READMIN_TARGET_INTERVAL = 9000;
+
+// dvrstream::TIMEINDEX_INTERVAL (static)
+//
+// Minimum interval between time index entries, in 90KHz periods (1 second)
+uint64_t const dvrstream::TIMEINDEX_INTERVAL = 90000;
+
+// PACKET_DESCRIPTOR_XXXX
+//
+// Bit fields of the packet descriptors generated by scan_packets()
+static uint32_t const PACKET_DESCRIPTOR_PID			= 0x1FFF;
+static uint32_t const PACKET_DESCRIPTOR_PUSI		= 0x2000;
+static uint32_t const PACKET_DESCRIPTOR_ADAPTATION	= 0x4000;
+static uint32_t const PACKET_DESCRIPTOR_PAYLOAD		= 0x8000;
+
+// SCAN_BATCH_SIZE
+//
+// Maximum number of packets to be scanned with a single call to scan_packets()
+static size_t const SCAN_BATCH_SIZE = 64;
+
+// g_bufferpool
+//
+// Heap ring buffers released by closed streams, indexed by size
+static std::multimap<size_t, std::unique_ptr<uint8_t[]>> g_bufferpool;
+
+// g_bufferpool_lock
+//
+// Synchronization object for g_bufferpool and the buffer memory counters
+static std::mutex g_bufferpool_lock;
+
+// g_bufferpool_enabled
+//
+// Flag indicating if released ring buffers are retained in g_bufferpool
+static bool g_bufferpool_enabled = true;
+
+// g_buffermemory
+//
+// Heap memory allocated for ring buffers, both in use and pooled, and its high water mark
+static size_t g_buffermemory = 0;
+static size_t g_buffermemory_peak = 0;
 	
 //---------------------------------------------------------------------------
 // decode_pcr90khz
@@ -147,16 +221,21 @@ inline uint32_t read_be32(uint8_t const* ptr)
 //	url				- URL of the stream to be opened
 //	buffersize		- Ring buffer size, in bytes
 //	readmincount	- Minimum bytes to return from a read operation
+//	bufferpath		- Folder in which to create a memory-mapped timeshift buffer
+//	segmentsize		- Size of each range request segment, or zero to request the entire stream
+//	share			- Optional cURL share interface handle to join
 
-dvrstream::dvrstream(char const* url, size_t buffersize, size_t readmincount) :
+dvrstream::dvrstream(char const* url, size_t buffersize, size_t readmincount, char const* bufferpath, size_t segmentsize, CURLSH* share) :
 	m_readmincount(std::max(align::down(readmincount, MPEGTS_PACKET_LENGTH), MPEGTS_PACKET_LENGTH)),
-	m_buffersize(align::up(buffersize, 65536))
+	m_segmentsize(std::min(segmentsize, (align::up(buffersize, 65536) - m_readmincount) / 2)),
+	m_buffersize(align::up(buffersize, 65536)), m_timeshift(bufferpath != nullptr)
 {
 	if(url == nullptr) throw std::invalid_argument("url");
+	if(m_readmincount >= m_buffersize) throw std::invalid_argument("readmincount");
 
-	// Allocate the ring buffer using the 64KiB upward-aligned buffer size
-	m_buffer = std::unique_ptr<uint8_t[]>(new uint8_t[m_buffersize]);
-	if(!m_buffer) throw std::bad_alloc();
+	// Allocate the ring buffer using the 64KiB upward-aligned buffer size; a timeshift buffer
+	// is backed by a temporary file rather than the heap to allow for much larger sizes
+	m_buffer = (m_timeshift) ? map_buffer(m_buffersize, bufferpath) : allocate_buffer(m_buffersize);
 
 	// Create and initialize the curl multi interface object
 	m_curlm = curl_multi_init();
@@ -177,18 +256,19 @@ dvrstream::dvrstream(char const* url, size_t buffersize, size_t readmincount) :
 			if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, this);
 			if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, &dvrstream::curl_write);
 			if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, this);
-			if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(m_curl, CURLOPT_RANGE, "0-");
+			if(curlresult == CURLE_OK) curlresult = curl_easy_setopt(m_curl, CURLOPT_TCP_KEEPALIVE, 1L);
+			if((curlresult == CURLE_OK) && (share != nullptr)) curlresult = curl_easy_setopt(m_curl, CURLOPT_SHARE, share);
 			if(curlresult != CURLE_OK) throw string_exception(__func__, ": curl_easy_setopt() failed: ", curl_easy_strerror(curlresult));
 
+			// Request the stream from the beginning; segmented streams only request the first segment
+			set_byterange(0);
+
 			// Attempt to add the easy handle to the multi handle
 			CURLMcode curlmresult = curl_multi_add_handle(m_curlm, m_curl);
 			if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_add_handle() failed: ", curl_multi_strerror(curlmresult));
 
-			try {
-
-				// Attempt to begin the data transfer and wait for the HTTP headers to be processed
-				if(!transfer_until([&]() -> bool { return m_headers == true; })) throw string_exception(__func__, ": failed to receive HTTP response headers");
-			}
+			// Start the data transfer thread and wait for the HTTP headers to be processed
+			try { start_transfer(); }
 
 			// Remove the easy handle from the multi interface on exception
 			catch(...) { curl_multi_remove_handle(m_curlm, m_curl); throw; }
@@ -210,6 +290,74 @@ dvrstream::~dvrstream()
 	close();
 }
 
+//---------------------------------------------------------------------------
+// dvrstream::allocate_buffer (static, private)
+//
+// Allocates the ring buffer storage from the heap
+//
+// Arguments:
+//
+//	buffersize		- Ring buffer size, in bytes
+
+dvrstream::buffer_t dvrstream::allocate_buffer(size_t buffersize)
+{
+	std::unique_ptr<uint8_t[]>	storage;			// Ring buffer storage
+	size_t						capacity = 0;		// Actual size of the storage
+
+	// The deleter returns the storage to the pool unless it's already full or pooling has been disabled
+	auto deleter = [](size_t capacity, uint8_t* ptr) -> void {
+
+		std::unique_ptr<uint8_t[]> storage(ptr);
+		std::unique_lock<std::mutex> lock(g_bufferpool_lock);
+
+		if((g_bufferpool_enabled) && (g_bufferpool.size() < MAX_POOLED_BUFFERS)) g_bufferpool.emplace(capacity, std::move(storage));
+		else g_buffermemory -= capacity;
+	};
+
+	std::unique_lock<std::mutex> lock(g_bufferpool_lock);
+
+	// Reuse the smallest pooled buffer that is large enough to satisfy the request
+	auto found = g_bufferpool.lower_bound(buffersize);
+	if(found != g_bufferpool.end()) {
+
+		capacity = found->first;
+		storage = std::move(found->second);
+		g_bufferpool.erase(found);
+	}
+
+	else {
+
+		// None of the pooled buffers can be used; release them before allocating a new one
+		// rather than allowing them to remain allocated alongside it
+		for(auto const& iterator : g_bufferpool) g_buffermemory -= iterator.first;
+		g_bufferpool.clear();
+
+		capacity = buffersize;
+		storage.reset(new uint8_t[capacity]);
+
+		g_buffermemory += capacity;
+		g_buffermemory_peak = std::max(g_buffermemory_peak, g_buffermemory);
+	}
+
+	lock.unlock();
+
+	return buffer_t(storage.release(), std::bind(deleter, capacity, std::placeholders::_1));
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::bitrate
+//
+// Gets the measured bitrate of the stream, in bits per second
+//
+// Arguments:
+//
+//	NONE
+
+long long dvrstream::bitrate(void) const
+{
+	return m_bitrate;
+}
+
 //---------------------------------------------------------------------------
 // dvrstream::canseek
 //
@@ -221,7 +369,8 @@ dvrstream::~dvrstream()
 
 bool dvrstream::canseek(void) const
 {
-	return m_canseek;
+	// Real-time streams can be seeked within the ring buffer when it's a timeshift buffer
+	return m_canseek || m_timeshift;
 }
 
 //---------------------------------------------------------------------------
@@ -235,6 +384,12 @@ bool dvrstream::canseek(void) const
 
 void dvrstream::close(void)
 {
+	// Stop the data transfer thread before releasing the handles it operates on
+	stop_transfer();
+
+	// Publish the metrics accumulated by the stream now that the transfer thread has stopped
+	publish_metrics();
+
 	// Remove the easy handle from the multi handle and close them both out
 	if((m_curlm != nullptr) && (m_curl != nullptr)) curl_multi_remove_handle(m_curlm, m_curl);
 	if(m_curl != nullptr) curl_easy_cleanup(m_curl);
@@ -310,7 +465,103 @@ std::unique_ptr<dvrstream> dvrstream::create(char const* url, size_t buffersize)
 
 std::unique_ptr<dvrstream> dvrstream::create(char const* url, size_t buffersize, size_t readmincount)
 {
-	return std::unique_ptr<dvrstream>(new dvrstream(url, buffersize, readmincount));
+	return std::unique_ptr<dvrstream>(new dvrstream(url, buffersize, readmincount, nullptr, 0, nullptr));
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::create (static)
+//
+// Factory method, creates a new dvrstream instance that joins a cURL share
+//
+// Arguments:
+//
+//	url				- URL of the stream to be opened
+//	buffersize		- Ring buffer size, in bytes
+//	readmincount	- Minimum bytes to return from a read operation
+//	share			- cURL share to use for the DNS, connection and SSL session caches
+
+std::unique_ptr<dvrstream> dvrstream::create(char const* url, size_t buffersize, size_t readmincount, curlshare& share)
+{
+	return std::unique_ptr<dvrstream>(new dvrstream(url, buffersize, readmincount, nullptr, 0, share));
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::create (static)
+//
+// Factory method, creates a new dvrstream instance with a timeshift buffer
+//
+// Arguments:
+//
+//	url				- URL of the stream to be opened
+//	buffersize		- Timeshift buffer size, in bytes
+//	readmincount	- Minimum bytes to return from a read operation
+//	bufferpath		- Folder in which to create the timeshift buffer file
+
+std::unique_ptr<dvrstream> dvrstream::create(char const* url, size_t buffersize, size_t readmincount, char const* bufferpath)
+{
+	if(bufferpath == nullptr) throw std::invalid_argument("bufferpath");
+
+	return std::unique_ptr<dvrstream>(new dvrstream(url, buffersize, readmincount, bufferpath, 0, nullptr));
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::create (static)
+//
+// Factory method, creates a new dvrstream instance with a timeshift buffer that joins a cURL share
+//
+// Arguments:
+//
+//	url				- URL of the stream to be opened
+//	buffersize		- Timeshift buffer size, in bytes
+//	readmincount	- Minimum bytes to return from a read operation
+//	bufferpath		- Folder in which to create the timeshift buffer file
+//	share			- cURL share to use for the DNS, connection and SSL session caches
+
+std::unique_ptr<dvrstream> dvrstream::create(char const* url, size_t buffersize, size_t readmincount, char const* bufferpath, curlshare& share)
+{
+	if(bufferpath == nullptr) throw std::invalid_argument("bufferpath");
+
+	return std::unique_ptr<dvrstream>(new dvrstream(url, buffersize, readmincount, bufferpath, 0, share));
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::create (static)
+//
+// Factory method, creates a new dvrstream instance that requests the stream in
+// fixed-size segments, reading ahead only when the ring buffer can hold a segment
+//
+// Arguments:
+//
+//	url				- URL of the stream to be opened
+//	buffersize		- Ring buffer size, in bytes
+//	readmincount	- Minimum bytes to return from a read operation
+//	segmentsize		- Size of each range request segment, in bytes
+
+std::unique_ptr<dvrstream> dvrstream::create(char const* url, size_t buffersize, size_t readmincount, size_t segmentsize)
+{
+	if(segmentsize == 0) throw std::invalid_argument("segmentsize");
+
+	return std::unique_ptr<dvrstream>(new dvrstream(url, buffersize, readmincount, nullptr, segmentsize, nullptr));
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::create (static)
+//
+// Factory method, creates a new segmented dvrstream instance that joins a cURL share
+//
+// Arguments:
+//
+//	url				- URL of the stream to be opened
+//	buffersize		- Ring buffer size, in bytes
+//	readmincount	- Minimum bytes to return from a read operation
+//	segmentsize		- Size of each range request segment, in bytes
+//	share			- cURL share to use for the DNS, connection and SSL session caches
+
+std::unique_ptr<dvrstream> dvrstream::create(char const* url, size_t buffersize, size_t readmincount, size_t segmentsize, curlshare& share)
+{
+	if(segmentsize == 0) throw std::invalid_argument("segmentsize");
+
+	return std::unique_ptr<dvrstream>(new dvrstream(url, buffersize, readmincount, nullptr, segmentsize, share));
 }
 
 //---------------------------------------------------------------------------
@@ -366,16 +617,41 @@ size_t dvrstream::curl_responseheaders(char const* data, size_t size, size_t cou
 		int result = sscanf(data, "Content-Range: bytes %lld-%lld/%lld", &start, &end, &length);
 		if((result == 0) && (sscanf(data, "Content-Range: bytes */%lld", &length)) == 1) start = length;
 
+		std::unique_lock<std::mutex> lock(instance->m_lock);
+
+		// A continuation segment has to pick up exactly where the previous segment left off,
+		// abort the transfer if it doesn't otherwise the ring buffer would be corrupted
+		if(instance->m_continuation) {
+
+			if(start != instance->m_writepos) return 0;
+			instance->m_length = length;
+		}
+
 		// Reset the stream read/write positions and overall length
-		instance->m_startpos = instance->m_readpos = instance->m_writepos = start;
-		instance->m_length = length;
+		else {
+
+			instance->m_startpos = instance->m_readpos = instance->m_writepos = start;
+			instance->m_length = length;
+		}
 	}
 
 	// \r\n (empty header)
 	else if((cb >= EMPTY_HEADER_LEN) && (strncmp(EMPTY_HEADER, data, EMPTY_HEADER_LEN) == 0)) {
 
+		// A continuation segment must be a partial content response; anything else (for example
+		// the entire stream being sent again) cannot be appended to the ring buffer
+		if(instance->m_continuation) {
+
+			long responsecode = 0;
+			curl_easy_getinfo(instance->m_curl, CURLINFO_RESPONSE_CODE, &responsecode);
+			if(responsecode != 206) return 0;
+		}
+
 		// The final header has been processed, indicate that by setting the flag
+		// and wake up the thread waiting for the transfer to start
+		std::unique_lock<std::mutex> lock(instance->m_lock);
 		instance->m_headers = true;
+		instance->m_readable.notify_all();
 	}
 
 	return cb;
@@ -403,35 +679,127 @@ size_t dvrstream::curl_write(void const* data, size_t size, size_t count, void*
 	// Cast the context pointer back into a dvrstream instance
 	dvrstream* instance = reinterpret_cast<dvrstream*>(context);
 
-	// This operation requires that all of the data be written, if it isn't going to fit in the
-	// available ring buffer space, the input stream has to be paused via CURL_WRITEFUNC_PAUSE
-	size_t available = (instance->m_head < instance->m_tail) ? instance->m_tail - instance->m_head : (instance->m_buffersize - instance->m_head) + instance->m_tail;
-	if(available < (cb + 1)) { instance->m_paused = true; return CURL_WRITEFUNC_PAUSE; }
-
-	// Write until the buffer has been exhausted or the desired count has been reached
+	// Write until the desired count has been reached; this executes on the data transfer thread
+	// so rather than pausing the transfer when the ring buffer is full, wait for the reader
 	while(cb) {
 
-		// If the head is behind the tail linearly, take the data between them otherwise
-		// take the data between the end of the buffer and the head
-		size_t chunk = (instance->m_head < instance->m_tail) ? std::min(cb, instance->m_tail - instance->m_head) : std::min(cb, instance->m_buffersize - instance->m_head);
-		memcpy(&instance->m_buffer[instance->m_head], &reinterpret_cast<uint8_t const*>(data)[byteswritten], chunk);
+		std::unique_lock<std::mutex> lock(instance->m_lock);
+
+		// The ring buffer always leaves one byte unused to distinguish between full and empty; if there
+		// is no space available, wait for read() or seek() to move the tail or for the thread to stop
+		size_t resumecount = 1;
+		auto writable = [&]() -> bool {
+
+			size_t head = instance->m_head.load();
+			size_t tail = instance->m_tail.load();
+			return instance->m_stop || (((head < tail) ? tail - head : (instance->m_buffersize - head) + tail) > resumecount);
+		};
+
+		// The flag must be set before the predicate is evaluated, see read() for details; the amount
+		// of time the transfer spends paused waiting for ring buffer space is recorded as a metric
+		instance->m_writewait = true;
+		if(!writable()) {
+
+			// Once the ring buffer has filled, don't resume the transfer until the reader has released
+			// enough space for a bitrate-based minimum read rather than waking up for every read
+			resumecount = std::max(std::min(instance->m_readtarget.load(), instance->m_buffersize / 8), static_cast<size_t>(1));
+
+			auto start = std::chrono::steady_clock::now();
+			instance->m_writable.wait(lock, writable);
 
-		instance->m_head += chunk;		// Increment the head position
+			auto paused = std::chrono::steady_clock::now() - start;
+			instance->m_pausetime += std::chrono::duration_cast<std::chrono::microseconds>(paused).count();
+			instance->m_pausemetric.record(paused);
+		}
+		instance->m_writewait = false;
+
+		// Returning a short count aborts the transfer if the thread has been asked to stop
+		if(instance->m_stop) return 0;
+
+		size_t head = instance->m_head.load(std::memory_order_relaxed);
+		size_t tail = instance->m_tail.load(std::memory_order_acquire);
+
+		// If the head is behind the tail linearly, take the data between them otherwise take the data
+		// between the end of the buffer and the head, leaving the unused byte in front of the tail
+		size_t chunk = (head < tail) ? std::min(cb, tail - head - 1) : std::min(cb, instance->m_buffersize - head - ((tail == 0) ? 1 : 0));
+		memcpy(&instance->m_buffer[head], &reinterpret_cast<uint8_t const*>(data)[byteswritten], chunk);
+
+		head += chunk;					// Increment the head position
 		byteswritten += chunk;			// Increment number of bytes written
 		cb -= chunk;					// Decrement remaining bytes
 
 		// If the head has reached the end of the buffer, reset it back to zero
-		if(instance->m_head >= instance->m_buffersize) instance->m_head = 0;
+		if(head >= instance->m_buffersize) head = 0;
+
+		// Publish the new head position and increment the number of bytes seen as part of this transfer
+		instance->m_head.store(head, std::memory_order_release);
+		instance->m_writepos.store(instance->m_writepos.load(std::memory_order_relaxed) + static_cast<long long>(chunk), std::memory_order_release);
+
+		// Wake up the reader if it's waiting for data to become available
+		lock.unlock();
+		instance->m_readable.notify_all();
 	}
 
 	assert(byteswritten == (size * count));		// Verify all bytes were written
 
-	// Increment the number of bytes seen as part of this transfer
-	instance->m_writepos += byteswritten;
-
 	return byteswritten;
 }
 
+//---------------------------------------------------------------------------
+// dvrstream::discard_buffered
+//
+// Discards any data that has been buffered but not yet read; the transfer continues
+// and the next read returns the data that is received after this call
+//
+// Arguments:
+//
+//	NONE
+
+void dvrstream::discard_buffered(void)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	// Move the tail up to the head to release all of the unread data in the ring buffer, the
+	// discarded data is behind the read position for the purposes of a timeshift buffer seek
+	m_tail.store(m_head.load());
+	m_readpos = m_writepos;
+
+	// Wake up the transfer thread if it's waiting for space in the ring buffer
+	m_writable.notify_all();
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::earliesttime
+//
+// Gets the earliest time of the stream that can be seeked to
+//
+// Arguments:
+//
+//	NONE
+
+time_t dvrstream::earliesttime(void) const
+{
+	// If the stream isn't real-time or hasn't started yet, the start time is the earliest time
+	if((m_canseek) || (m_starttime == 0)) return m_starttime;
+
+	time_t now = time(nullptr);
+
+	// The positions are updated by the data transfer thread, work from a single snapshot of them
+	long long startpos = m_startpos.load(std::memory_order_acquire);
+	long long writepos = m_writepos.load(std::memory_order_acquire);
+
+	long long maxlength = static_cast<long long>(m_buffersize) - 1;
+	long long minpos = ((writepos - startpos) > maxlength) ? writepos - maxlength : startpos;
+	long long total = writepos - startpos;
+
+	// If nothing has been overwritten in the ring buffer yet, the start time is the earliest time
+	if((now <= m_starttime) || (total <= 0) || (minpos <= startpos)) return m_starttime;
+
+	// Estimate the time of the earliest buffered position based on the average stream bitrate
+	double elapsed = static_cast<double>(now - m_starttime);
+	return m_starttime + static_cast<time_t>(elapsed * (static_cast<double>(minpos - startpos) / static_cast<double>(total)));
+}
+
 //---------------------------------------------------------------------------
 // dvrstream::filter_packets (private)
 //
@@ -441,134 +809,174 @@ size_t dvrstream::curl_write(void const* data, size_t size, size_t count, void*
 //
 //	buffer		- Pointer to the mpeg-ts packets to filter
 //	count		- Number of mpeg-ts packets provided in the buffer
+//	position	- Stream position of the first mpeg-ts packet
 
-void dvrstream::filter_packets(uint8_t* buffer, size_t count)
+void dvrstream::filter_packets(uint8_t* buffer, size_t count, long long position)
 {
+	uint32_t			descriptors[SCAN_BATCH_SIZE];		// Scanned packet descriptors
+	bool				stop = false;						// Flag to stop filtering the packets
+
 	// The packet filter can be disabled completely for a stream if the
 	// MPEG-TS packets become misaligned; leaving it enabled might trash things
 	if(!m_enablefilter) return;
 
-	// Iterate over all of the packets provided in the buffer
-	for(size_t index = 0; index < count; index++) {
-
-		// Set up the pointer to the start of the packet and a working pointer
-		uint8_t* packet = buffer + (index * MPEGTS_PACKET_LENGTH);
-		uint8_t* current = packet;
-
-		// Read relevant values from the transport stream header
-		uint32_t ts_header = read_be32(current);
-		uint8_t sync = (ts_header & 0xFF000000) >> 24;
-		bool pusi = (ts_header & 0x00400000) == 0x00400000;
-		uint16_t pid = static_cast<uint16_t>((ts_header & 0x001FFF00) >> 8);
-		bool adaptation = (ts_header & 0x00000020) == 0x00000020;
-		bool payload = (ts_header & 0x00000010) == 0x00000010;
-
-		// Check the sync byte, should always be 0x47.  If the packets aren't in sync
-		// all kinds of bad things can happen
-		assert(sync == 0x47);
-		if(sync != 0x47) { 
-			
-			m_enablefilter = m_enablepcrs = false;		// Stop filtering packets
-			m_startpts = m_currentpts = 0;				// Disable PCR reporting
+	auto start = std::chrono::steady_clock::now();
 
-			return;
-		}
+	// Scan the packets in batches to validate the sync bytes and decode the transport stream headers
+	for(size_t batch = 0; (batch < count) && (!stop); batch += SCAN_BATCH_SIZE) {
+
+		size_t batchcount = std::min(count - batch, SCAN_BATCH_SIZE);
+
+		// Check the sync bytes, should always be 0x47.  If the packets aren't in sync all kinds
+		// of bad things can happen; only the packets ahead of the first bad one are filtered
+		size_t synccount = scan_packets(buffer + (batch * MPEGTS_PACKET_LENGTH), batchcount, descriptors);
+
+		// Iterate over all of the packets in the batch that are in sync
+		for(size_t index = 0; (index < synccount) && (!stop); index++) {
+
+			uint32_t descriptor = descriptors[index];
+			uint16_t pid = static_cast<uint16_t>(descriptor & PACKET_DESCRIPTOR_PID);
+			bool pusi = (descriptor & PACKET_DESCRIPTOR_PUSI) == PACKET_DESCRIPTOR_PUSI;
+			bool adaptation = (descriptor & PACKET_DESCRIPTOR_ADAPTATION) == PACKET_DESCRIPTOR_ADAPTATION;
+			bool payload = (descriptor & PACKET_DESCRIPTOR_PAYLOAD) == PACKET_DESCRIPTOR_PAYLOAD;
+
+			// Only the PAT, PMT and PCR packets need to be examined; skip everything else
+			bool pcr = (adaptation) && (m_enablepcrs) && ((m_pcrpid == 0) || (pid == m_pcrpid));
+			if(!pcr && (pid != 0x0000) && !m_pmtpids.test(pid)) continue;
+
+			// Set up the pointer to the start of the packet and a working pointer
+			uint8_t* packet = buffer + ((batch + index) * MPEGTS_PACKET_LENGTH);
+			uint8_t* current = packet;
+
+			// Move the pointer beyond the TS header
+			current += 4U;
+
+			// If the packet contains adaptation bytes check for and handle the PCR
+			if(adaptation) {
+
+				// Get the adapation field length, this needs to be at least 7 bytes for
+				// it to possibly include the PCR value
+				uint8_t adaptationlength = read_be8(current);
+				if((adaptationlength >= 7) && (m_enablepcrs)) {
 
-		// Move the pointer beyond the TS header
-		current += 4U;
+					// Only use the first PID on which a PCR has been detected, there may
+					// be multiple elementary streams that contain PCR values
+					if((m_pcrpid == 0) || (pid == m_pcrpid)) {
 
-		// If the packet contains adaptation bytes check for and handle the PCR
-		if(adaptation) {
+						// Check the adaptation flags to see if a PCR is in this packet
+						uint8_t adaptationflags = read_be8(current + 1U);
+						if((adaptationflags & 0x10) == 0x10) {
 
-			// Get the adapation field length, this needs to be at least 7 bytes for
-			// it to possibly include the PCR value
-			uint8_t adaptationlength = read_be8(current);
-			if((adaptationlength >= 7) && (m_enablepcrs)) {
+							// If the PCR PID hasn't been set, use this PID from now on
+							if(m_pcrpid == 0) m_pcrpid = pid;
 
-				// Only use the first PID on which a PCR has been detected, there may
-				// be multiple elementary streams that contain PCR values
-				if((m_pcrpid == 0) || (pid == m_pcrpid)) {
+							// Decode the current PCR using the 90KHz period only, there is 
+							// no need to deal with the full 27MHz period
+							m_currentpts = decode_pcr90khz(current + 2U);
+							if(m_startpts == 0) m_startpts = m_currentpts;
 
-					// Check the adaptation flags to see if a PCR is in this packet
-					uint8_t adaptationflags = read_be8(current + 1U);
-					if((adaptationflags & 0x10) == 0x10) {
+							// A seekable stream can be read out of order; after a seek backwards a PCR that is
+							// less than the original PCR value is expected and becomes the new starting PCR
+							if((m_currentpts < m_startpts) && (m_canseek)) m_startpts = m_currentpts;
 
-						// If the PCR PID hasn't been set, use this PID from now on
-						if(m_pcrpid == 0) m_pcrpid = pid;
+							// If the current PCR is less than the original PCR value something has
+							// gone wrong; disable all PCR detection and reporting on this stream
+							if(m_currentpts < m_startpts) {
 
-						// Decode the current PCR using the 90KHz period only, there is 
-						// no need to deal with the full 27MHz period
-						m_currentpts = decode_pcr90khz(current + 2U);
-						if(m_startpts == 0) m_startpts = m_currentpts;
+								m_enablepcrs = false;
+								m_startpts = m_currentpts = 0;
+								m_timeindex.clear();
+							}
 
-						assert(m_currentpts >= m_startpts);
+							else {
 
-						// If the current PCR is less than the original PCR value something has
-						// gone wrong; disable all PCR detection and reporting on this stream
-						if(m_currentpts < m_startpts) {
+								long long pcrposition = position + static_cast<long long>((batch + index) * MPEGTS_PACKET_LENGTH);
 
-							m_enablepcrs = false;
-							m_startpts = m_currentpts = 0;
+								// Update the measured bitrate of the stream using the position of this packet
+								measure_bitrate(m_currentpts, pcrposition);
+
+								// Add the position of this packet to the time index for seekable streams if there
+								// isn't already an entry within TIMEINDEX_INTERVAL of the PCR; this keeps the
+								// index sparse regardless of how many times the same region is read
+								if(m_canseek) {
+
+									uint64_t lower = (m_currentpts > TIMEINDEX_INTERVAL) ? m_currentpts - TIMEINDEX_INTERVAL + 1 : 0;
+									auto found = m_timeindex.lower_bound(lower);
+									if((found == m_timeindex.end()) || (found->first >= (m_currentpts + TIMEINDEX_INTERVAL)))
+										m_timeindex.emplace_hint(found, m_currentpts, pcrposition);
+								}
+							}
 						}
 					}
 				}
-			}
 
-			// Move the pointer beyond the adaptation data
-			current += adaptationlength;
-		}
+				// Move the pointer beyond the adaptation data
+				current += adaptationlength;
+			}
 
-		// >> PAT
-		if((pid == 0x0000) && (payload)) {
+			// >> PAT
+			if((pid == 0x0000) && (payload)) {
 
-			// Align the payload using the pointer provided when pusi is set
-			if(pusi) current += read_be8(current) + 1U;
+				// Align the payload using the pointer provided when pusi is set
+				if(pusi) current += read_be8(current) + 1U;
 
-			// Get the first and last section indices and skip to the section data
-			uint8_t firstsection = read_be8(current + 6U);
-			uint8_t lastsection = read_be8(current + 7U);
-			current += 8U;
+				// Get the first and last section indices and skip to the section data
+				uint8_t firstsection = read_be8(current + 6U);
+				uint8_t lastsection = read_be8(current + 7U);
+				current += 8U;
 
-			// Iterate over all the sections and add the PMT program ids to the set<>
-			for(uint8_t section = firstsection; section <= lastsection; section++) {
+				// Iterate over all the sections and add the PMT program ids to the bitmap
+				for(uint8_t section = firstsection; section <= lastsection; section++) {
 
-				uint16_t pmt_program = read_be16(current);
-				if(pmt_program != 0) m_pmtpids.insert(read_be16(current + 2U) & 0x1FFF);
+					uint16_t pmt_program = read_be16(current);
+					if(pmt_program != 0) m_pmtpids.set(read_be16(current + 2U) & 0x1FFF);
 
-				current += 4U;				// Move to the next section
+					current += 4U;				// Move to the next section
+				}
 			}
-		}
 
-		// >> PMT
-		if((pusi) && (payload) && (m_pmtpids.find(pid) != m_pmtpids.end())) {
+			// >> PMT
+			if((pusi) && (payload) && (m_pmtpids.test(pid))) {
 
-			// Get the length of the entire payload to be sure we don't exceed it
-			size_t payloadlen = MPEGTS_PACKET_LENGTH - (current - packet);
+				// Get the length of the entire payload to be sure we don't exceed it
+				size_t payloadlen = MPEGTS_PACKET_LENGTH - (current - packet);
 
-			uint8_t* pointer = current;			// Get address of current pointer
-			current += (*pointer + 1U);			// Align offset with the pointer
+				uint8_t* pointer = current;			// Get address of current pointer
+				current += (*pointer + 1U);			// Align offset with the pointer
 
-			// FILTER: Skip over 0xC0 (SCTE Program Information Message) entries followed immediately
-			// by 0x02 (Program Map Table) entries by adjusting the payload pointer and overwriting 0xC0
-			if(read_be8(current) == 0xC0) {
+				// FILTER: Skip over 0xC0 (SCTE Program Information Message) entries followed immediately
+				// by 0x02 (Program Map Table) entries by adjusting the payload pointer and overwriting 0xC0
+				if(read_be8(current) == 0xC0) {
 
-				// Acquire the length of the 0xC0 entry, if it exceeds the length of the payload give
-				// up -- the + 4 bytes is for the pointer (1), the table id (1) and the length (2)
-				uint16_t length = read_be16(current + 1) & 0x3FF;
-				if((length + 4U) > payloadlen) break;
+					// Acquire the length of the 0xC0 entry, if it exceeds the length of the payload give
+					// up -- the + 4 bytes is for the pointer (1), the table id (1) and the length (2)
+					uint16_t length = read_be16(current + 1) & 0x3FF;
+					if((length + 4U) > payloadlen) { stop = true; break; }
 
-				// If the 0xC0 entry is immediately followed by a 0x02 entry, adjust the payload
-				// pointer to align to the 0x02 entry and overwrite the 0xC0 entry with filler
-				if(read_be8(current + 3U + length) == 0x02) {
+					// If the 0xC0 entry is immediately followed by a 0x02 entry, adjust the payload
+					// pointer to align to the 0x02 entry and overwrite the 0xC0 entry with filler
+					if(read_be8(current + 3U + length) == 0x02) {
 
-					// Take into account any existing pointer value when adjusting it
-					*pointer += (3U + static_cast<uint8_t>(length & 0xFF));
-					memset(current, 0xFF, 3U + length);
+						// Take into account any existing pointer value when adjusting it
+						*pointer += (3U + static_cast<uint8_t>(length & 0xFF));
+						memset(current, 0xFF, 3U + length);
+					}
 				}
 			}
+
+		}	// for(index ...
+
+		// If a packet was out of sync disable the filter; the remaining packets can't be trusted
+		if((!stop) && (synccount < batchcount)) {
+
+			m_enablefilter = m_enablepcrs = false;		// Stop filtering packets
+			m_startpts = m_currentpts = 0;				// Disable PCR reporting
+			m_timeindex.clear();						// Discard the time index
+			stop = true;
 		}
+	}	// for(batch ...
 
-	}	// for(index ...
+	m_filtermetric.record(std::chrono::steady_clock::now() - start);
 }
 
 //---------------------------------------------------------------------------
@@ -585,6 +993,221 @@ long long dvrstream::length(void) const
 	return (m_length == MAX_STREAM_LENGTH) ? -1 : m_length;
 }
 
+//---------------------------------------------------------------------------
+// dvrstream::map_buffer (static, private)
+//
+// Allocates the ring buffer storage from a memory-mapped temporary file
+//
+// Arguments:
+//
+//	buffersize		- Ring buffer size, in bytes
+//	path			- Folder in which to create the temporary file
+
+dvrstream::buffer_t dvrstream::map_buffer(size_t buffersize, char const* path)
+{
+	assert(path != nullptr);
+
+	std::string folder(path);
+
+#if defined(TARGET_WINDOWS)
+
+	char filename[MAX_PATH] = { '\0' };				// Temporary file name
+
+	// Generate a unique file name for the timeshift buffer in the specified folder
+	if(GetTempFileNameA(folder.c_str(), "hdr", 0, filename) == 0) throw string_exception(__func__, ": GetTempFileName() failed: ", GetLastError());
+
+	// Open the temporary file for read/write access; it will be deleted as soon as the last handle is closed
+	HANDLE file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if(file == INVALID_HANDLE_VALUE) { DeleteFileA(filename); throw string_exception(__func__, ": CreateFile() failed: ", GetLastError()); }
+
+	// Create a file mapping large enough to hold the entire buffer, this will extend the file as necessary
+	ULARGE_INTEGER size;
+	size.QuadPart = buffersize;
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr);
+	if(mapping == nullptr) { DWORD result = GetLastError(); CloseHandle(file); throw string_exception(__func__, ": CreateFileMapping() failed: ", result); }
+
+	// Map a view of the entire file into the process address space
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, buffersize);
+	if(view == nullptr) { DWORD result = GetLastError(); CloseHandle(mapping); CloseHandle(file); throw string_exception(__func__, ": MapViewOfFile() failed: ", result); }
+
+	// The mapping and file handles remain open for the lifetime of the view
+	return buffer_t(reinterpret_cast<uint8_t*>(view), [=](uint8_t* ptr) -> void {
+
+		UnmapViewOfFile(ptr);
+		CloseHandle(mapping);
+		CloseHandle(file);
+	});
+
+#elif defined(TARGET_WINDOWS_STORE)
+
+	(void)buffersize;
+	throw string_exception(__func__, ": memory-mapped timeshift buffers are not supported on this platform");
+
+#else
+
+	// Generate a unique file name for the timeshift buffer in the specified folder
+	if((!folder.empty()) && (folder.back() != '/')) folder.push_back('/');
+	folder.append("hdhomerundvr-timeshift-XXXXXX");
+
+	int fd = mkstemp(&folder[0]);
+	if(fd < 0) throw string_exception(__func__, ": mkstemp() failed: ", strerror(errno));
+
+	// Unlink the temporary file immediately, the storage is released once it has been unmapped
+	unlink(folder.c_str());
+
+	// Extend the file to the size of the buffer and map the entire thing as shared memory
+	if(ftruncate(fd, static_cast<off_t>(buffersize)) != 0) { int result = errno; ::close(fd); throw string_exception(__func__, ": ftruncate() failed: ", strerror(result)); }
+
+	void* view = mmap(nullptr, buffersize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	int result = errno;
+
+	// The file descriptor is no longer necessary once the mapping has been established
+	::close(fd);
+	if(view == MAP_FAILED) throw string_exception(__func__, ": mmap() failed: ", strerror(result));
+
+	return buffer_t(reinterpret_cast<uint8_t*>(view), [=](uint8_t* ptr) -> void { munmap(ptr, buffersize); });
+
+#endif
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::measure_bitrate (private)
+//
+// Updates the measured bitrate of the stream from a PCR and its stream position
+//
+// Arguments:
+//
+//	pcr			- Program clock reference value (90KHz periods)
+//	position	- Stream position of the packet that carried the PCR
+
+void dvrstream::measure_bitrate(uint64_t pcr, long long position)
+{
+	// Start a new measurement if there isn't one in progress or if the PCR/position has gone backwards
+	// or leapt ahead, which happens after a seek or when there is a discontinuity in the stream
+	if((m_bitratepcr == 0) || (pcr <= m_bitratepcr) || (position <= m_bitratepos) || ((pcr - m_bitratepcr) > (BITRATE_INTERVAL * 10))) {
+
+		m_bitratepcr = pcr;
+		m_bitratepos = position;
+		return;
+	}
+
+	// Wait until the measurement covers the minimum interval before calculating the bitrate
+	uint64_t elapsed = pcr - m_bitratepcr;
+	if(elapsed < BITRATE_INTERVAL) return;
+
+	// Calculate the bitrate over the measurement interval and smooth it against the previous value
+	long long bitrate = static_cast<long long>((static_cast<uint64_t>(position - m_bitratepos) * 8 * 90000) / elapsed);
+	long long previous = m_bitrate.load();
+	m_bitrate = (previous == 0) ? bitrate : ((previous * 3) + bitrate) / 4;
+
+	// Scale the minimum read count to represent READMIN_TARGET_INTERVAL of the stream, never going below
+	// the minimum read count specified at construction or above a quarter of the ring buffer size
+	size_t target = static_cast<size_t>(((static_cast<uint64_t>(m_bitrate.load()) / 8) * READMIN_TARGET_INTERVAL) / 90000);
+	m_readtarget = std::min(std::max(align::down(target, MPEGTS_PACKET_LENGTH), m_readmincount), align::down(m_buffersize / 4, MPEGTS_PACKET_LENGTH));
+
+	m_bitratemetric.record(static_cast<unsigned long long>(m_bitrate.load()));
+
+	// Start the next measurement at this PCR
+	m_bitratepcr = pcr;
+	m_bitratepos = position;
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::memory (static)
+//
+// Gets the heap memory allocated for stream ring buffers
+//
+// Arguments:
+//
+//	NONE
+
+struct dvrstream::memoryusage dvrstream::memory(void)
+{
+	std::unique_lock<std::mutex> lock(g_bufferpool_lock);
+
+	struct memoryusage usage = { g_buffermemory, g_buffermemory_peak, 0 };
+	for(auto const& iterator : g_bufferpool) usage.pooled += iterator.first;
+
+	return usage;
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::minimum_position (private)
+//
+// Calculates the minimum stream position currently represented in the ring buffer
+//
+// Arguments:
+//
+//	NONE
+
+long long dvrstream::minimum_position(void) const
+{
+	// The ring buffer always leaves one byte unused, only (buffersize - 1) bytes behind
+	// the current write position can be considered valid once the buffer has wrapped
+	long long maxlength = static_cast<long long>(m_buffersize) - 1;
+	long long startpos = m_startpos.load(std::memory_order_acquire);
+	long long writepos = m_writepos.load(std::memory_order_acquire);
+
+	return ((writepos - startpos) > maxlength) ? writepos - maxlength : startpos;
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::next_segment (private)
+//
+// Waits for the ring buffer to have room for the next segment and submits the
+// range request for it; executes on the data transfer thread
+//
+// Arguments:
+//
+//	NONE
+
+bool dvrstream::next_segment(void)
+{
+	// Remove the completed transfer from the multi handle; the connection is retained in the
+	// multi handle's connection cache and will be reused by the next segment request
+	CURLMcode curlmresult = curl_multi_remove_handle(m_curlm, m_curl);
+	if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_remove_handle() failed: ", curl_multi_strerror(curlmresult));
+
+	// Only read ahead when the entire segment can be written into the ring buffer; this leaves
+	// the connection idle rather than stalled mid-response, so a seek that restarts the transfer
+	// doesn't have to tear down a half-finished response to reposition the stream
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	auto writable = [&]() -> bool {
+
+		size_t head = m_head.load();
+		size_t tail = m_tail.load();
+		return m_stop || ((((head < tail) ? tail - head : (m_buffersize - head) + tail) - 1) >= m_segmentsize);
+	};
+
+	// The flag must be set before the predicate is evaluated, see read() for details
+	m_writewait = true;
+	if(!writable()) {
+
+		auto start = std::chrono::steady_clock::now();
+		m_writable.wait(lock, writable);
+
+		auto paused = std::chrono::steady_clock::now() - start;
+		m_pausetime += std::chrono::duration_cast<std::chrono::microseconds>(paused).count();
+		m_pausemetric.record(paused);
+	}
+	m_writewait = false;
+
+	if(m_stop) return false;
+	lock.unlock();
+
+	// Request the next segment from the current write position on the existing transfer handle
+	set_byterange(m_writepos);
+	m_continuation = true;
+
+	curlmresult = curl_multi_add_handle(m_curlm, m_curl);
+	if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_add_handle() failed: ", curl_multi_strerror(curlmresult));
+
+	m_segments++;
+
+	return true;
+}
+
 //---------------------------------------------------------------------------
 // dvrstream::position
 //
@@ -599,6 +1222,43 @@ long long dvrstream::position(void) const
 	return m_readpos;
 }
 
+//---------------------------------------------------------------------------
+// dvrstream::publish_metrics (private)
+//
+// Publishes the accumulated stream metrics; the transfer thread must be stopped
+//
+// Arguments:
+//
+//	NONE
+
+void dvrstream::publish_metrics(void)
+{
+	// The metric handles are resolved once and reused for every stream instance
+	static metric_handle const bitrate = resolve_metric("dvrstream.bitrate", metric_type::value);
+	static metric_handle const fill = resolve_metric("dvrstream.fill", metric_type::value);
+	static metric_handle const filter = resolve_metric("dvrstream.filter", metric_type::duration);
+	static metric_handle const paused = resolve_metric("dvrstream.paused", metric_type::duration);
+	static metric_handle const restarts = resolve_metric("dvrstream.restarts", metric_type::counter);
+	static metric_handle const segments = resolve_metric("dvrstream.segments", metric_type::counter);
+	static metric_handle const stall = resolve_metric("dvrstream.stall", metric_type::duration);
+
+	assert(!m_worker.joinable());
+
+	// The accumulators reset themselves when published, but the counters must only be published once
+	if(!m_published) {
+
+		if(m_restarts > 0) increment_metric(restarts, m_restarts);
+		if(m_segments > 0) increment_metric(segments, m_segments);
+		m_published = true;
+	}
+
+	m_bitratemetric.publish(bitrate);
+	m_fillmetric.publish(fill);
+	m_filtermetric.publish(filter);
+	m_pausemetric.publish(paused);
+	m_stallmetric.publish(stall);
+}
+
 //---------------------------------------------------------------------------
 // dvrstream::read
 //
@@ -621,16 +1281,46 @@ size_t dvrstream::read(uint8_t* buffer, size_t count)
 	if(count >= m_buffersize) throw std::invalid_argument("count");
 	if(count == 0) return 0;
 
-	// Transfer data into the ring buffer until the minimum amount of data is available, 
-	// the stream has completed, or an exception/error occurs
-	transfer_until([&]() -> bool {
+	// The minimum read count is scaled by the measured bitrate of the stream, but a read should
+	// never have to wait for more data than was requested to be satisfied
+	size_t readmincount = std::max(std::min(m_readtarget.load(), align::down(count, MPEGTS_PACKET_LENGTH)), m_readmincount);
 
-		available = (m_tail > m_head) ? (m_buffersize - m_tail) + m_head : m_head - m_tail;
-		return (available >= m_readmincount);
-	});
+	// The tail position is only ever modified by the reader, the head position is published
+	// by the data transfer thread after the data has been written into the ring buffer
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	auto readable = [&]() -> bool {
+
+		size_t head = m_head.load(std::memory_order_acquire);
+		available = (tail > head) ? (m_buffersize - tail) + head : head - tail;
+		return (available >= readmincount) || m_finished;
+	};
+
+	// Only block if the minimum amount of data isn't already available in the ring buffer; wait
+	// until it is, or the transfer thread has finished due to completion or an exception/error
+	if(!readable()) {
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_readable.wait(lock, readable);
+		lock.unlock();
+
+		auto stalled = std::chrono::steady_clock::now() - start;
+		m_stalltime += std::chrono::duration_cast<std::chrono::microseconds>(stalled).count();
+		m_stallmetric.record(stalled);
+	}
+
+	// Record the ring buffer fill level (percentage) observed by the reader; this is accumulated
+	// locally and published when the stream is closed to keep the read path free of any locks
+	m_fillmetric.record((available * 100) / m_buffersize);
 
-	// If there is no available data in the ring buffer after transfer_until, indicate stream is finished
-	if(available == 0) return 0;
+	// If there is no available data in the ring buffer and the transfer has finished, propagate any
+	// exception that caused it to finish or indicate that the stream is finished
+	if(available == 0) {
+
+		if(m_exception) std::rethrow_exception(m_exception);
+		return 0;
+	}
 
 	// Wait until the first successful read operation to set the start time for the stream
 	if(m_starttime == 0) m_starttime = time(nullptr);
@@ -647,24 +1337,31 @@ size_t dvrstream::read(uint8_t* buffer, size_t count)
 	// Copy the calculated amount of data into the destination buffer
 	while(count) {
 
-		// If the tail is behind the head linearly, take the data between them otherwise
-		// take the data between the end of the buffer and the tail
-		size_t chunk = (m_tail < m_head) ? std::min(count, m_head - m_tail) : std::min(count, m_buffersize - m_tail);
-		if(buffer != nullptr) memcpy(&buffer[bytesread], &m_buffer[m_tail], chunk);
+		// The available count was calculated against a head position that may have since moved
+		// forward, but the data up to that point is guaranteed to be in the ring buffer
+		size_t chunk = std::min(count, m_buffersize - tail);
+		if(buffer != nullptr) memcpy(&buffer[bytesread], &m_buffer[tail], chunk);
 
-		m_tail += chunk;					// Increment the tail position
+		tail += chunk;						// Increment the tail position
 		bytesread += chunk;					// Increment number of bytes read
 		count -= chunk;						// Decrement remaining bytes
 
 		// If the tail has reached the end of the buffer, reset it back to zero
-		if(m_tail >= m_buffersize) m_tail = 0;
+		if(tail >= m_buffersize) tail = 0;
 	}
 
 	m_readpos += bytesread;					// Update the reader position
+	m_bytesread += bytesread;				// Update the total bytes read
+
+	// Publish the new tail position to release the space in the ring buffer.  If the transfer thread
+	// was waiting for space it has to be signaled under the lock; the flag is tested after the tail has
+	// been stored so either the transfer thread sees the new tail, or this thread sees the flag
+	m_tail.store(tail);
+	if(m_writewait) { std::unique_lock<std::mutex> lock(m_lock); m_writable.notify_all(); }
 
 	// Apply the mpeg-ts packet filter against all complete packets that were read
 	if((bytesread >= (packetoffset + MPEGTS_PACKET_LENGTH)) && (buffer != nullptr)) 
-		filter_packets(buffer + packetoffset, (bytesread / MPEGTS_PACKET_LENGTH));
+		filter_packets(buffer + packetoffset, ((bytesread - packetoffset) / MPEGTS_PACKET_LENGTH), (m_readpos - static_cast<long long>(bytesread)) + static_cast<long long>(packetoffset));
 
 	return bytesread;
 }
@@ -696,39 +1393,179 @@ long long dvrstream::restart(long long position)
 {
 	assert(position >= 0);				// Should always be a positive value
 
+	m_restarts++;
+
+	// Stop the data transfer thread before manipulating the transfer handles
+	stop_transfer();
+
 	// Remove the easy transfer handle from the multi transfer handle
 	CURLMcode curlmresult = curl_multi_remove_handle(m_curlm, m_curl);
 	if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_remove_handle() failed: ", curl_multi_strerror(curlmresult));
 
-	// Reset all of the stream state and ring buffer values back to the defaults; leave the 
+	// Reset all of the stream state and ring buffer values back to the defaults; leave the
 	// start time and start presentation timestamp values at their original values
-	m_paused = m_headers = m_canseek = false;
+	m_headers = m_canseek = m_continuation = false;
 	m_head = m_tail = 0;
 	m_startpos = m_readpos = m_writepos = 0;
 	m_length = MAX_STREAM_LENGTH;
 	m_currentpts = 0;
 
-	// Format the Range: header value to apply to the transfer object, do not use CURLOPT_RESUME_FROM_LARGE 
-	// as it will not insert the request header when the position is zero
-	char byterange[32] = { '\0' };
-	snprintf(byterange, std::extent<decltype(byterange)>::value, "%lld-", std::max(position, 0LL));
+	// The time index is keyed to the stream positions and remains valid across a restart.  If bad data disabled
+	// the packet filter or the PCRs, give them another chance and rebuild the index from the restarted transfer
+	if((!m_enablefilter) || (!m_enablepcrs)) {
 
-	// Attempt to execute the current transfer operation
-	CURLcode curlresult = curl_easy_setopt(m_curl, CURLOPT_RANGE, byterange);
-	if(curlresult != CURLE_OK) throw string_exception(__func__, ": curl_easy_setopt() failed: ", curl_easy_strerror(curlresult));
+		m_enablefilter = m_enablepcrs = true;
+		m_pcrpid = 0;
+		m_startpts = 0;
+		m_timeindex.clear();
+	}
+
+	// Apply the Range: header value for the new position to the transfer object
+	set_byterange(position);
 
 	// Add the modified easy transfer handle back to the multi transfer handle and
 	// attempt to restart the stream at the specified position
 	curlmresult = curl_multi_add_handle(m_curlm, m_curl);
 	if(curlmresult != CURLM_OK) throw string_exception(__func__, ": curl_multi_remove_handle() failed: ", curl_multi_strerror(curlmresult));
 
-	// Execute the data transfer until the HTTP headers have been received and processed
-	if(!transfer_until([&]() -> bool { return m_headers == true; })) 
-		throw string_exception(__func__, ": failed to receive HTTP response headers");
+	// Restart the data transfer thread and wait for the HTTP headers to be received and processed
+	start_transfer();
 
 	return m_readpos;					// Return new starting position of the stream
 }
 
+//---------------------------------------------------------------------------
+// dvrstream::scan_packets (static, private)
+//
+// Validates the sync bytes of a batch of mpeg-ts packets and generates a descriptor
+// for each that contains the PID, PUSI, adaptation and payload flags.  Returns the
+// number of packets that precede the first packet found to be out of sync
+//
+// Arguments:
+//
+//	packets		- Pointer to the first mpeg-ts packet to be scanned
+//	count		- Number of mpeg-ts packets to scan; cannot exceed SCAN_BATCH_SIZE
+//	descriptors	- Array to receive the generated packet descriptors
+
+size_t dvrstream::scan_packets(uint8_t const* packets, size_t count, uint32_t* descriptors)
+{
+	size_t			index = 0;						// Current packet index
+	uint32_t		raw[4];							// Raw packet header values
+
+	assert((packets != nullptr) && (descriptors != nullptr));
+	assert(count <= SCAN_BATCH_SIZE);
+
+	(void)raw;										// Only used by the NEON implementation
+
+#if defined(DVRSTREAM_SCAN_SSE2)
+
+	__m128i const syncmask = _mm_set1_epi32(0xFF);
+	__m128i const syncbyte = _mm_set1_epi32(0x47);
+	__m128i const pidhigh = _mm_set1_epi32(0x1F00);
+	__m128i const pidlow = _mm_set1_epi32(0xFF);
+	__m128i const pusi = _mm_set1_epi32(PACKET_DESCRIPTOR_PUSI);
+	__m128i const adaptation = _mm_set1_epi32(PACKET_DESCRIPTOR_ADAPTATION);
+	__m128i const payload = _mm_set1_epi32(PACKET_DESCRIPTOR_PAYLOAD);
+
+	// Process the packet headers four at a time; the raw little-endian header values
+	// place the sync byte in the low 8 bits and the flags byte in the high 8 bits
+	for(; (index + 4) <= count; index += 4) {
+
+		int32_t			words[4];					// Raw packet header values
+
+		// Each header is moved directly into a register and the lanes are combined with unpacks; loading
+		// the vector from an array of just-stored headers stalls on store-to-load forwarding instead
+		for(size_t lane = 0; lane < 4; lane++) memcpy(&words[lane], packets + ((index + lane) * MPEGTS_PACKET_LENGTH), sizeof(int32_t));
+		__m128i headers = _mm_unpacklo_epi64(_mm_unpacklo_epi32(_mm_cvtsi32_si128(words[0]), _mm_cvtsi32_si128(words[1])),
+			_mm_unpacklo_epi32(_mm_cvtsi32_si128(words[2]), _mm_cvtsi32_si128(words[3])));
+		__m128i insync = _mm_cmpeq_epi32(_mm_and_si128(headers, syncmask), syncbyte);
+
+		__m128i desc = _mm_or_si128(_mm_and_si128(headers, pidhigh), _mm_and_si128(_mm_srli_epi32(headers, 16), pidlow));
+		desc = _mm_or_si128(desc, _mm_and_si128(_mm_srli_epi32(headers, 1), pusi));
+		desc = _mm_or_si128(desc, _mm_and_si128(_mm_srli_epi32(headers, 15), adaptation));
+		desc = _mm_or_si128(desc, _mm_and_si128(_mm_srli_epi32(headers, 13), payload));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&descriptors[index]), desc);
+
+		// If any of the packets are out of sync, return the number of packets that precede it
+		int lanes = _mm_movemask_epi8(insync);
+		if(lanes != 0xFFFF) {
+
+			while((lanes & 0x000F) == 0x000F) { index++; lanes >>= 4; }
+			return index;
+		}
+	}
+
+#elif defined(DVRSTREAM_SCAN_NEON)
+
+	uint32x4_t const syncmask = vdupq_n_u32(0xFF);
+	uint32x4_t const syncbyte = vdupq_n_u32(0x47);
+	uint32x4_t const pidhigh = vdupq_n_u32(0x1F00);
+	uint32x4_t const pidlow = vdupq_n_u32(0xFF);
+	uint32x4_t const pusi = vdupq_n_u32(PACKET_DESCRIPTOR_PUSI);
+	uint32x4_t const adaptation = vdupq_n_u32(PACKET_DESCRIPTOR_ADAPTATION);
+	uint32x4_t const payload = vdupq_n_u32(PACKET_DESCRIPTOR_PAYLOAD);
+
+	// Process the packet headers four at a time; the raw little-endian header values
+	// place the sync byte in the low 8 bits and the flags byte in the high 8 bits
+	for(; (index + 4) <= count; index += 4) {
+
+		for(size_t lane = 0; lane < 4; lane++) memcpy(&raw[lane], packets + ((index + lane) * MPEGTS_PACKET_LENGTH), sizeof(uint32_t));
+		uint32x4_t headers = vld1q_u32(raw);
+		uint32x4_t insync = vceqq_u32(vandq_u32(headers, syncmask), syncbyte);
+
+		uint32x4_t desc = vorrq_u32(vandq_u32(headers, pidhigh), vandq_u32(vshrq_n_u32(headers, 16), pidlow));
+		desc = vorrq_u32(desc, vandq_u32(vshrq_n_u32(headers, 1), pusi));
+		desc = vorrq_u32(desc, vandq_u32(vshrq_n_u32(headers, 15), adaptation));
+		desc = vorrq_u32(desc, vandq_u32(vshrq_n_u32(headers, 13), payload));
+
+		vst1q_u32(&descriptors[index], desc);
+
+		// If any of the packets are out of sync, return the number of packets that precede it
+		uint32x2_t syncfold = vand_u32(vget_low_u32(insync), vget_high_u32(insync));
+		if((vget_lane_u32(syncfold, 0) & vget_lane_u32(syncfold, 1)) != 0xFFFFFFFF) {
+
+			vst1q_u32(raw, insync);
+			for(size_t lane = 0; raw[lane] == 0xFFFFFFFF; lane++) index++;
+			return index;
+		}
+	}
+
+#endif
+
+	// Use the scalar implementation for any packets that remain after the SIMD implementation
+	return index + scan_packets_scalar(packets + (index * MPEGTS_PACKET_LENGTH), count - index, &descriptors[index]);
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::scan_packets_scalar (static, private)
+//
+// Scalar implementation of scan_packets
+//
+// Arguments:
+//
+//	packets		- Pointer to the first mpeg-ts packet to be scanned
+//	count		- Number of mpeg-ts packets to scan
+//	descriptors	- Array to receive the generated packet descriptors
+
+size_t dvrstream::scan_packets_scalar(uint8_t const* packets, size_t count, uint32_t* descriptors)
+{
+	size_t index = 0;
+
+	assert((packets != nullptr) && (descriptors != nullptr));
+
+	for(; index < count; index++) {
+
+		uint32_t header = read_be32(packets + (index * MPEGTS_PACKET_LENGTH));
+		if((header >> 24) != 0x47) break;
+
+		descriptors[index] = ((header >> 8) & PACKET_DESCRIPTOR_PID) | ((header >> 9) & PACKET_DESCRIPTOR_PUSI) |
+			((header << 9) & PACKET_DESCRIPTOR_ADAPTATION) | ((header << 11) & PACKET_DESCRIPTOR_PAYLOAD);
+	}
+
+	return index;
+}
+
 //---------------------------------------------------------------------------
 // dvrstream::seek
 //
@@ -744,7 +1581,8 @@ long long dvrstream::seek(long long position, int whence)
 	long long			newposition = 0;			// New stream position
 
 	// If the stream cannot be seeked, return -1 to indicate the operation is not supported.
-	if(!m_canseek) return -1;
+	// Real-time streams with a timeshift buffer can be seeked within the ring buffer only
+	if((!m_canseek) && (!m_timeshift)) return -1;
 
 	// Calculate the new position of the stream
 	if(whence == SEEK_SET) newposition = std::max(position, 0LL);
@@ -759,34 +1597,202 @@ long long dvrstream::seek(long long position, int whence)
 	// If the calculated position matches the current position there is nothing to do
 	if(newposition == m_readpos) return m_readpos;
 
+	// The bitrate measurement can't span the seek, start a new one from the next PCR
+	m_bitratepcr = 0;
+
+	// The data transfer thread cannot be allowed to write into the ring buffer while the tail
+	// is being moved, the region behind the tail may be overwritten at any time otherwise
+	std::unique_lock<std::mutex> lock(m_lock);
+
 	// Calculate the minimum stream position currently represented in the ring buffer
-	long long minpos = ((m_writepos - m_startpos) > static_cast<long long>(m_buffersize)) ? m_writepos - m_buffersize : m_startpos;
+	long long minpos = minimum_position();
+
+	// A real-time stream cannot be restarted at a different position, clamp the new position
+	// to the range of data that is currently available in the timeshift buffer
+	if(!m_canseek) newposition = std::min(std::max(newposition, minpos), m_writepos.load());
 
 	// If the new position is already represented in the ring buffer, modify the tail pointer to
 	// reference that position for the next read operation rather than restarting the stream
-	if((newposition >= minpos) && (newposition < m_writepos)) {
+	if((newposition >= minpos) && (newposition <= m_writepos)) {
 
-		// If the buffer hasn't wrapped around yet, the new tail position is relative to buffer[0]
-		if(minpos == m_startpos) m_tail = static_cast<size_t>(newposition - m_startpos);
+		// The new tail position is always relative to the current head position, the head
+		// references the buffer position that corresponds to the current write position
+		size_t behind = static_cast<size_t>(m_writepos - newposition);
+		size_t tail = (m_head + (m_buffersize - behind)) % m_buffersize;
 
-		else {
+		assert(tail < m_buffersize);					// Verify tail position is valid
 
-			// The buffer has wrapped around at least once, the new tail position is relative to the
-			// current head position rather than the start of the buffer
-			m_tail = static_cast<size_t>(m_head + (newposition - minpos));
-			if(m_tail >= m_buffersize) m_tail -= m_buffersize;
+		m_tail = tail;									// Set the new tail position
+		m_readpos = newposition;						// Set the new read position
 
-			assert(m_tail <= m_buffersize);				// Verify tail position is valid
-		}
+		// Moving the tail forward may have released space in the ring buffer
+		m_writable.notify_all();
 
-		m_readpos = newposition;						// Set the new tail position
 		return newposition;								// Successful ring buffer seek
 	}
 
+	lock.unlock();
+
 	// Attempt to restart the stream at the calculated position
 	return restart(newposition);
 }
 
+//---------------------------------------------------------------------------
+// dvrstream::seektime
+//
+// Sets the stream pointer to the position of a specific time; the position is
+// located via the time index generated from the PCRs that have been read
+//
+// Arguments:
+//
+//	milliseconds	- Time relative to the start of the stream (position zero)
+//	backwards		- Flag to locate a position at or before the time rather than nearest to it
+
+long long dvrstream::seektime(long long milliseconds, bool backwards)
+{
+	long long			newposition = 0;			// New stream position
+
+	// Time-based seeks require a seekable stream and at least one PCR to work with
+	if((!m_canseek) || (m_timeindex.empty())) return -1;
+
+	auto first = m_timeindex.begin();
+	auto last = std::prev(m_timeindex.end());
+
+	// The time is relative to position zero rather than to wherever the stream was first read from; unless the
+	// index starts at position zero, estimate the PCR at that position using the average bitrate across the index
+	uint64_t origin = first->first;
+	if((first->second > 0) && (last->second > first->second)) {
+
+		double periods = static_cast<double>(last->first - first->first) * (static_cast<double>(first->second) / static_cast<double>(last->second - first->second));
+		origin = (static_cast<double>(origin) > periods) ? origin - static_cast<uint64_t>(periods) : 0;
+	}
+
+	// Convert the requested time into a PCR value (90KHz periods) relative to the start
+	uint64_t target = origin + (static_cast<uint64_t>(std::max(milliseconds, 0LL)) * 90);
+
+	// Locate the index entries on either side of the target PCR
+	auto upper = m_timeindex.upper_bound(target);
+
+	// A backwards seek has to land at or before the requested time; back the target off by one index interval,
+	// but never beyond the index entry (or the start of the stream) below it since that position is known
+	if(backwards) {
+
+		uint64_t minimum = (upper == m_timeindex.begin()) ? origin : std::prev(upper)->first;
+		target = std::max(minimum, (target > TIMEINDEX_INTERVAL) ? target - TIMEINDEX_INTERVAL : 0);
+	}
+
+	// Before the first index entry: interpolate between the start of the stream and that entry
+	if(upper == m_timeindex.begin()) {
+
+		if(upper->first == origin) newposition = upper->second;
+		else newposition = static_cast<long long>(static_cast<double>(upper->second) * (static_cast<double>(target - origin) / static_cast<double>(upper->first - origin)));
+	}
+
+	else {
+
+		auto lower = std::prev(upper);
+
+		// Between two index entries: interpolate between them
+		if(upper != m_timeindex.end())
+			newposition = lower->second + static_cast<long long>(static_cast<double>(upper->second - lower->second) * 
+				(static_cast<double>(target - lower->first) / static_cast<double>(upper->first - lower->first)));
+
+		// Beyond the last index entry: extrapolate using the average bitrate observed across the index
+		else {
+
+			if((lower == first) || (lower->first == first->first)) newposition = lower->second;
+			else newposition = lower->second + static_cast<long long>(static_cast<double>(lower->second - first->second) *
+				(static_cast<double>(target - lower->first) / static_cast<double>(lower->first - first->first)));
+		}
+	}
+
+	// Align the new position to an mpeg-ts packet boundary and keep it within the stream
+	newposition = std::max(newposition, 0LL);
+	if(m_length != MAX_STREAM_LENGTH) newposition = std::min(newposition, std::max(m_length - 1, 0LL));
+	newposition -= (newposition % static_cast<long long>(MPEGTS_PACKET_LENGTH));
+
+	// Perform a single seek operation to the calculated position
+	return seek(newposition, SEEK_SET);
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::set_byterange (private)
+//
+// Sets the byte range to be requested by the next transfer
+//
+// Arguments:
+//
+//	position		- Starting position of the byte range
+
+void dvrstream::set_byterange(long long position)
+{
+	char byterange[64] = { '\0' };
+
+	// Format the Range: header value to apply to the transfer object, do not use CURLOPT_RESUME_FROM_LARGE 
+	// as it will not insert the request header when the position is zero.  Segmented streams request a
+	// bounded range so the response completes and the connection can be reused for the next segment
+	position = std::max(position, 0LL);
+	if(m_segmentsize == 0) snprintf(byterange, std::extent<decltype(byterange)>::value, "%lld-", position);
+	else snprintf(byterange, std::extent<decltype(byterange)>::value, "%lld-%lld", position, position + static_cast<long long>(m_segmentsize) - 1);
+
+	CURLcode curlresult = curl_easy_setopt(m_curl, CURLOPT_RANGE, byterange);
+	if(curlresult != CURLE_OK) throw string_exception(__func__, ": curl_easy_setopt() failed: ", curl_easy_strerror(curlresult));
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::start_transfer (private)
+//
+// Starts the data transfer thread and waits for the HTTP response headers
+//
+// Arguments:
+//
+//	NONE
+
+void dvrstream::start_transfer(void)
+{
+	assert(!m_worker.joinable());
+
+	m_stop = m_finished = false;				// Reset the thread state flags
+	m_exception = nullptr;						// Reset any prior thread exception
+
+	// Launch the data transfer thread, it owns the transfer handles until it has been stopped
+	m_worker = std::thread(&dvrstream::transfer, this);
+
+	// Wait for the HTTP headers to be processed or for the transfer to finish; if the transfer
+	// finished before the headers were processed, propagate the exception or throw a generic one
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_readable.wait(lock, [&]() -> bool { return m_headers || m_finished; });
+	
+	if(!m_headers) {
+
+		lock.unlock();
+		stop_transfer();
+
+		if(m_exception) std::rethrow_exception(m_exception);
+		throw string_exception(__func__, ": failed to receive HTTP response headers");
+	}
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::set_buffer_pooling (static)
+//
+// Enables or disables the reuse of released ring buffers; any pooled buffers
+// are released when pooling is disabled
+//
+// Arguments:
+//
+//	enable		- Flag to enable or disable the buffer pool
+
+void dvrstream::set_buffer_pooling(bool enable)
+{
+	{
+		std::unique_lock<std::mutex> lock(g_bufferpool_lock);
+		g_bufferpool_enabled = enable;
+	}
+
+	if(!enable) trim_buffers();
+}
+
 //---------------------------------------------------------------------------
 // dvrstream::starttime
 //
@@ -802,61 +1808,142 @@ time_t dvrstream::starttime(void) const
 }
 
 //---------------------------------------------------------------------------
-// dvrstream::transfer_until (private)
+// dvrstream::stats
+//
+// Gets the performance statistics for the stream
+//
+// Arguments:
+//
+//	NONE
+
+struct dvrstream::statistics dvrstream::stats(void) const
+{
+	struct statistics stats = {};
+
+	stats.bitrate = m_bitrate;
+	stats.bytesread = m_bytesread;
+	stats.restarts = m_restarts;
+	stats.segments = m_segments;
+	stats.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_created);
+	stats.paused = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::microseconds(m_pausetime.load()));
+	stats.stalled = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::microseconds(m_stalltime));
+
+	return stats;
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::stop_transfer (private)
 //
-// Executes the data transfer until the specified predicate has been satisfied
-// or the transfer has completed
+// Stops the data transfer thread
 //
 // Arguments:
 //
-//	predicate		- Predicate to be satisfied by the transfer
+//	NONE
 
-bool dvrstream::transfer_until(std::function<bool(void)> predicate)
+void dvrstream::stop_transfer(void)
+{
+	if(!m_worker.joinable()) return;
+
+	// Signal the thread to stop; it may be waiting for space in the ring buffer
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_stop = true;
+	m_writable.notify_all();
+	lock.unlock();
+
+	m_worker.join();
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::transfer (private)
+//
+// Data transfer thread entry point; executes the transfer until it has completed
+// or the thread has been signaled to stop
+//
+// Arguments:
+//
+//	NONE
+
+void dvrstream::transfer(void)
 {
 	int				numfds;				// Number of active file descriptors
 
-	// If the stream has been paused due to the ring buffer filling up, attempt to resume it
-	// CAUTION: calling curl_easy_pause() with CURLPAUSE_CONT *immediately* attempts to write 
-	// outstanding data into the ring buffer= so when it returns m_paused may have been set 
-	// back to true if the ring buffer is still full after attempting to resume
-	if(m_paused) {
+	try {
+
+		bool transferring = true;			// Flag to continue with another segment
 
-		m_paused = false;									// Reset the stream paused flag
-		curl_easy_pause(m_curl, CURLPAUSE_CONT);			// Resume transfer on the stream
-	}
+		while(transferring) {
 
-	// If the stream is still paused (buffer is still full) and the predicate can be satisfied,
-	// go ahead and let the caller do what it wants to do
-	if(m_paused && predicate()) return true;
+			long long segmentstart = m_writepos;		// Starting position of this segment
+			transferring = false;
 
-	// Continue to execute the data transfer until the predicate has been satisfied, the data
-	// transfer operation is complete, or the stream has been paused due to a full buffer condition
-	CURLMcode curlmresult = curl_multi_perform(m_curlm, &numfds);
-	while((curlmresult == CURLM_OK) && (!m_paused) && (numfds > 0) && (predicate() == false)) {
+			// Continue to execute the data transfer until it has completed or the thread has been signaled
+			// to stop; there is no need to pause the transfer, curl_write() will wait for ring buffer space
+			CURLMcode curlmresult = curl_multi_perform(m_curlm, &numfds);
+			while((curlmresult == CURLM_OK) && (numfds > 0) && (!m_stop)) {
 
-		curlmresult = curl_multi_wait(m_curlm, nullptr, 0, 500, &numfds);
-		if(curlmresult == CURLM_OK) curlmresult = curl_multi_perform(m_curlm, &numfds);
-	}
+				curlmresult = curl_multi_wait(m_curlm, nullptr, 0, 100, &numfds);
+				if(curlmresult == CURLM_OK) curlmresult = curl_multi_perform(m_curlm, &numfds);
+			}
 
-	// If a curl error occurred, throw an exception
-	if(curlmresult != CURLM_OK) throw string_exception(__func__, ": ", curl_multi_strerror(curlmresult));
+			// If a curl error occurred, throw an exception
+			if(curlmresult != CURLM_OK) throw string_exception(__func__, ": ", curl_multi_strerror(curlmresult));
 
-	// If the number of file descriptors has reduced to zero, the transfer has completed.
-	// Check for an HTTP error response on the transfer and throw an http_exception that
-	// will let the caller decide what to do about it
-	if(numfds == 0) {
+			// If the number of file descriptors has reduced to zero, the transfer has completed.
+			// Check for an HTTP error response on the transfer and throw an http_exception that
+			// will let the reader decide what to do about it
+			if((numfds == 0) && (!m_stop)) {
 
-		long responsecode = 200;			// Assume HTTP 200: OK
+				long responsecode = 200;			// Assume HTTP 200: OK
 
-		// The response code will come back as zero if there was no response from the host,
-		// otherwise it should be a standard HTTP response code
-		curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &responsecode);
+				// The response code will come back as zero if there was no response from the host,
+				// otherwise it should be a standard HTTP response code
+				curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &responsecode);
 
-		if(responsecode == 0) throw string_exception("no response from host");
-		else if((responsecode < 200) || (responsecode > 299)) throw http_exception(responsecode);
+				// A continuation segment that starts at the end of a fixed-length stream is normal
+				if((m_continuation) && (responsecode == 416)) break;
+
+				if(responsecode == 0) throw string_exception("no response from host");
+				else if((responsecode < 200) || (responsecode > 299)) throw http_exception(responsecode);
+				else if((m_continuation) && (responsecode != 206)) throw string_exception(__func__, ": invalid response to segment request");
+
+				// When the stream is being requested in segments and a partial content response has been
+				// completed, request the next segment.  Don't bother if the segment didn't make any progress
+				// as that indicates the server isn't honoring the requested byte ranges
+				if((m_segmentsize > 0) && (responsecode == 206) && (m_writepos < m_length)) {
+
+					if(m_writepos == segmentstart) throw string_exception(__func__, ": segment request returned no data");
+					transferring = next_segment();
+				}
+			}
+		}
 	}
 
-	return predicate();				// Re-evaluate the predicate as the result
+	// Exceptions cannot escape the thread, save it so it can be rethrown by the reader
+	catch(...) { m_exception = std::current_exception(); }
+
+	// Indicate that the transfer has finished and wake up any waiting reader
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_finished = true;
+	m_readable.notify_all();
+}
+
+//---------------------------------------------------------------------------
+// dvrstream::trim_buffers (static)
+//
+// Releases the pooled ring buffers that are not in use by any stream
+//
+// Arguments:
+//
+//	NONE
+
+void dvrstream::trim_buffers(void)
+{
+	std::multimap<size_t, std::unique_ptr<uint8_t[]>> released;
+
+	std::unique_lock<std::mutex> lock(g_bufferpool_lock);
+
+	for(auto const& iterator : g_bufferpool) g_buffermemory -= iterator.first;
+	released.swap(g_bufferpool);
 }
 
 //---------------------------------------------------------------------------
@@ -26,9 +26,19 @@
 
 #pragma warning(push, 4)
 
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <functional>
+#include <map>
 #include <memory>
-#include <set>
+#include <mutex>
+#include <thread>
+
+#include "curlshare.h"
+#include "metrics.h"
 
 //---------------------------------------------------------------------------
 // Class dvrstream
@@ -39,6 +49,26 @@ class dvrstream
 {
 public:
 
+	// Public Data Types
+	//
+	struct statistics {
+
+		long long						bitrate;			// Measured stream bitrate (bits per second)
+		long long						bytesread;			// Total bytes read from the stream
+		unsigned int					restarts;			// Number of stream restarts
+		unsigned int					segments;			// Number of range request segments
+		std::chrono::milliseconds		elapsed;			// Lifetime of the stream
+		std::chrono::milliseconds		paused;				// Time the transfer waited for buffer space
+		std::chrono::milliseconds		stalled;			// Time the reader waited for data
+	};
+
+	struct memoryusage {
+
+		size_t							allocated;			// Heap memory allocated for ring buffers
+		size_t							peak;				// High water mark of the allocated memory
+		size_t							pooled;				// Allocated memory held for reuse
+	};
+
 	// Destructor
 	//
 	~dvrstream();
@@ -46,6 +76,11 @@ public:
 	//-----------------------------------------------------------------------
 	// Member Functions
 
+	// bitrate
+	//
+	// Gets the measured bitrate of the stream
+	long long bitrate(void) const;
+
 	// canseek
 	//
 	// Flag indicating if the stream allows seek operations
@@ -62,17 +97,37 @@ public:
 	static std::unique_ptr<dvrstream> create(char const* url);
 	static std::unique_ptr<dvrstream> create(char const* url, size_t buffersize);
 	static std::unique_ptr<dvrstream> create(char const* url, size_t buffersize, size_t readmincount);
+	static std::unique_ptr<dvrstream> create(char const* url, size_t buffersize, size_t readmincount, char const* bufferpath);
+	static std::unique_ptr<dvrstream> create(char const* url, size_t buffersize, size_t readmincount, size_t segmentsize);
+	static std::unique_ptr<dvrstream> create(char const* url, size_t buffersize, size_t readmincount, curlshare& share);
+	static std::unique_ptr<dvrstream> create(char const* url, size_t buffersize, size_t readmincount, char const* bufferpath, curlshare& share);
+	static std::unique_ptr<dvrstream> create(char const* url, size_t buffersize, size_t readmincount, size_t segmentsize, curlshare& share);
 
 	// currenttime
 	//
 	// Gets the current time of the stream
 	time_t currenttime(void) const;
 
+	// discard_buffered
+	//
+	// Discards any data that has been buffered but not yet read
+	void discard_buffered(void);
+
+	// earliesttime
+	//
+	// Gets the earliest time of the stream that can be seeked to
+	time_t earliesttime(void) const;
+
 	// length
 	//
 	// Gets the length of the stream
 	long long length(void) const;
 
+	// memory (static)
+	//
+	// Gets the heap memory allocated for stream ring buffers
+	static struct memoryusage memory(void);
+
 	// position
 	//
 	// Gets the current position of the stream
@@ -93,16 +148,43 @@ public:
 	// Sets the stream pointer to a specific position
 	long long seek(long long position, int whence);
 
+	// seektime
+	//
+	// Sets the stream pointer to the position of a specific time
+	long long seektime(long long milliseconds, bool backwards);
+
+	// set_buffer_pooling (static)
+	//
+	// Enables or disables the reuse of released ring buffers
+	static void set_buffer_pooling(bool enable);
+
 	// starttime
 	//
 	// Gets the starting time for the stream
 	time_t starttime(void) const;
 
+	// stats
+	//
+	// Gets the performance statistics for the stream
+	struct statistics stats(void) const;
+
+	// trim_buffers (static)
+	//
+	// Releases the pooled ring buffers that are not in use by any stream
+	static void trim_buffers(void);
+
 private:
 
+	friend class benchmark;
+
 	dvrstream(dvrstream const&)=delete;
 	dvrstream& operator=(dvrstream const&)=delete;
 
+	// BITRATE_INTERVAL
+	//
+	// Minimum interval over which a bitrate measurement is taken, in 90KHz periods
+	static uint64_t const BITRATE_INTERVAL;
+
 	// DEFAULT_READ_MIN
 	//
 	// Default minimum amount of data to return from a read request
@@ -113,6 +195,11 @@ private:
 	// Default ring buffer size, in bytes
 	static size_t const DEFAULT_RINGBUFFER_SIZE;
 
+	// MAX_POOLED_BUFFERS
+	//
+	// Maximum number of released heap ring buffers retained for reuse
+	static size_t const MAX_POOLED_BUFFERS;
+
 	// MAX_STREAM_LENGTH
 	//
 	// Maximum allowable stream length; indicates a real-time stream
@@ -123,13 +210,36 @@ private:
 	// Length of a single mpeg-ts data packet
 	static size_t const MPEGTS_PACKET_LENGTH;
 
+	// READMIN_TARGET_INTERVAL
+	//
+	// Amount of stream time the minimum read should represent, in 90KHz periods
+	static uint64_t const READMIN_TARGET_INTERVAL;
+
+	// TIMEINDEX_INTERVAL
+	//
+	// Minimum interval between time index entries, in 90KHz periods
+	static uint64_t const TIMEINDEX_INTERVAL;
+
 	// Instance Constructor
 	//
-	dvrstream(char const* url, size_t buffersize, size_t readmincount);
+	dvrstream(char const* url, size_t buffersize, size_t readmincount, char const* bufferpath, size_t segmentsize, CURLSH* share);
+
+	//-----------------------------------------------------------------------
+	// Private Type Declarations
+
+	// buffer_t
+	//
+	// Ring buffer storage, either allocated from the heap or memory-mapped
+	using buffer_t = std::unique_ptr<uint8_t[], std::function<void(uint8_t*)>>;
 
 	//-----------------------------------------------------------------------
 	// Private Member Functions
 
+	// allocate_buffer (static)
+	//
+	// Allocates the ring buffer storage from the heap
+	static buffer_t allocate_buffer(size_t buffersize);
+
 	// curl_responseheaders (static)
 	//
 	// libcurl callback to handle processing of response headers
@@ -143,17 +253,67 @@ private:
 	// filter_packets
 	//
 	// Implements the transport stream packet filter
-	void filter_packets(uint8_t* buffer, size_t count);
+	void filter_packets(uint8_t* buffer, size_t count, long long position);
+
+	// map_buffer (static)
+	//
+	// Allocates the ring buffer storage from a memory-mapped temporary file
+	static buffer_t map_buffer(size_t buffersize, char const* path);
+
+	// measure_bitrate
+	//
+	// Updates the measured bitrate from a PCR and its stream position
+	void measure_bitrate(uint64_t pcr, long long position);
+
+	// minimum_position
+	//
+	// Calculates the minimum stream position represented in the ring buffer
+	long long minimum_position(void) const;
+
+	// next_segment
+	//
+	// Requests the next segment of a segmented stream
+	bool next_segment(void);
+
+	// publish_metrics
+	//
+	// Publishes the accumulated stream metrics
+	void publish_metrics(void);
 
 	// restart
 	//
 	// Restarts the stream at the specified position
 	long long restart(long long position);
 
-	// transfer_until
+	// scan_packets (static)
 	//
-	// Executes the data tranfer until the predicate has been satisfied
-	bool transfer_until(std::function<bool(void)> predicate);
+	// Validates and decodes the headers of a batch of mpeg-ts packets
+	static size_t scan_packets(uint8_t const* packets, size_t count, uint32_t* descriptors);
+
+	// scan_packets_scalar (static)
+	//
+	// Scalar implementation of scan_packets
+	static size_t scan_packets_scalar(uint8_t const* packets, size_t count, uint32_t* descriptors);
+
+	// set_byterange
+	//
+	// Sets the byte range to be requested by the next transfer
+	void set_byterange(long long position);
+
+	// start_transfer
+	//
+	// Starts the data transfer thread and waits for the response headers
+	void start_transfer(void);
+
+	// stop_transfer
+	//
+	// Stops the data transfer thread
+	void stop_transfer(void);
+
+	// transfer
+	//
+	// Data transfer thread entry point
+	void transfer(void);
 
 	//-----------------------------------------------------------------------
 	// Member Variables
@@ -163,15 +323,24 @@ private:
 	CURL*							m_curl = nullptr;				// CURL easy interface handle
 	CURLM*							m_curlm = nullptr;				// CURL multi interface handle
 	size_t const					m_readmincount;					// Minimum read byte count
+	size_t const					m_segmentsize;					// Range request segment size
+	std::thread						m_worker;						// Data transfer thread
+	std::mutex						m_lock;							// Synchronization object
+	std::condition_variable			m_readable;						// Signaled when data can be read
+	std::condition_variable			m_writable;						// Signaled when data can be written
+	std::atomic<bool>				m_stop{false};					// Flag to stop the transfer thread
+	std::atomic<bool>				m_finished{false};				// Flag if the transfer has finished
+	std::atomic<bool>				m_writewait{false};				// Flag if transfer waits for space
+	std::exception_ptr				m_exception;					// Exception from the transfer thread
 
 	// STREAM STATE
 	//
-	bool							m_paused = false;				// Flag if transfer is paused
 	bool							m_headers = false;				// Flag if headers have been processed
 	bool							m_canseek = false;				// Flag if stream can be seeked
-	long long						m_startpos = 0;					// Starting position
+	bool							m_continuation = false;			// Flag if transfer continues a segment
+	std::atomic<long long>			m_startpos{0};					// Starting position
 	long long						m_readpos = 0;					// Current read position
-	long long						m_writepos = 0;					// Current write position
+	std::atomic<long long>			m_writepos{0};					// Current write position
 	long long						m_length = MAX_STREAM_LENGTH;	// Length of the stream
 	time_t							m_starttime = 0;				// Start time of the stream
 	uint64_t						m_startpts = 0;					// Starting presentation timestamp
@@ -180,16 +349,43 @@ private:
 	// RING BUFFER
 	//
 	size_t const					m_buffersize;					// Size of the ring buffer
-	std::unique_ptr<uint8_t[]>		m_buffer;						// Ring buffer stroage
-	size_t							m_head = 0;						// Head (write) buffer position
-	size_t							m_tail = 0;						// Tail (read) buffer position
+	bool const						m_timeshift;					// Flag if buffer is a timeshift buffer
+	buffer_t						m_buffer;						// Ring buffer stroage
+	std::atomic<size_t>				m_head{0};						// Head (write) buffer position
+	std::atomic<size_t>				m_tail{0};						// Tail (read) buffer position
 
 	// PACKET FILTER
 	//
 	bool							m_enablefilter = true;			// Flag if packet filter is enabled
-	std::set<uint16_t>				m_pmtpids;						// Set of PMT program ids
+	std::bitset<8192>				m_pmtpids;						// Bitmap of PMT program ids
 	bool							m_enablepcrs = true;			// Flag if PCR reads are enabled
 	uint16_t						m_pcrpid = 0;					// Program Clock PID
+	std::map<uint64_t, long long>	m_timeindex;					// Sparse PCR to position index
+
+	// BITRATE
+	//
+	uint64_t						m_bitratepcr = 0;				// PCR at start of the measurement
+	long long						m_bitratepos = 0;				// Position at start of the measurement
+	std::atomic<long long>			m_bitrate{0};					// Measured bitrate (bits per second)
+	std::atomic<size_t>				m_readtarget{0};				// Bitrate-based minimum read count
+
+	// STATISTICS
+	//
+	std::chrono::steady_clock::time_point const	m_created = std::chrono::steady_clock::now();	// Creation time
+	long long						m_bytesread = 0;				// Total bytes read
+	unsigned int					m_restarts = 0;					// Number of restarts
+	unsigned int					m_segments = 0;					// Number of range segments
+	std::atomic<long long>			m_pausetime{0};					// Transfer wait time (us)
+	long long						m_stalltime = 0;				// Reader wait time (us)
+
+	// METRICS
+	//
+	bool							m_published = false;			// Flag if metrics have been published
+	metric_accumulator				m_bitratemetric;				// Measured bitrate samples
+	metric_accumulator				m_fillmetric;					// Ring buffer fill level samples
+	metric_accumulator				m_filtermetric;					// Packet filter duration samples
+	metric_accumulator				m_pausemetric;					// Transfer wait time samples
+	metric_accumulator				m_stallmetric;					// Reader wait time samples
 };
 
 //-----------------------------------------------------------------------------
@@ -23,6 +23,7 @@
 #include <hdhomerun.h>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "hdhr.h"
@@ -71,53 +72,241 @@ void enumerate_devices(enumerate_devices_callback callback)
 }
 
 //---------------------------------------------------------------------------
-// select_tuner
+// tunerregistry Constructor
 //
-// Selects an available tuner device from a list of possibilities
+// Arguments:
+//
+//	NONE
+
+tunerregistry::tunerregistry()
+{
+}
+
+//---------------------------------------------------------------------------
+// tunerregistry Destructor
+
+tunerregistry::~tunerregistry()
+{
+	// Wait for any outstanding probe threads to complete before the tuners are released
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_probed.wait(lock, [&]() -> bool { return m_probes == 0; });
+
+	m_tuners.clear();
+}
+
+//---------------------------------------------------------------------------
+// tunerregistry::available
+//
+// Counts the tuners from a list of possibilities that are not currently locked
 //
 // Arguments:
 //
-//	possibilities	- vector<> of tuners to select from
+//	possibilities	- vector<> of tuners to be counted
+
+size_t tunerregistry::available(std::vector<std::string> const& possibilities)
+{
+	std::vector<tuner_t>		candidates;				// Tuners to be queried
+	size_t						count = 0;				// Number of unlocked tuners
+
+	// Locate the tuner instances for each of the possibilities, create any that aren't registered yet
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+
+		for(auto const& iterator : possibilities) {
+
+			auto found = m_tuners.find(iterator);
+			if(found == m_tuners.end()) found = m_tuners.emplace(iterator, create_tuner(iterator)).first;
+			candidates.push_back(found->second);
+		}
+	}
 
-std::string select_tuner(std::vector<std::string> const& possibilities)
+	// Query the owner of each tuner lock, an unlocked tuner reports an owner of "none".  A tuner that
+	// cannot be queried is not counted, the caller is better off assuming that it's in use
+	for(auto const& iterator : candidates) {
+
+		std::unique_lock<std::mutex> tunerlock(iterator->lock);
+
+		char* owner = nullptr;
+		int result = hdhomerun_device_get_tuner_lockkey_owner(iterator->device.get(), &owner);
+		if(result <= 0) { iterator->state = tuner_state::unknown; continue; }
+
+		iterator->state = ((owner != nullptr) && (strcmp(owner, "none") == 0)) ? tuner_state::available : tuner_state::inuse;
+		if(iterator->state == tuner_state::available) ++count;
+	}
+
+	return count;
+}
+
+//---------------------------------------------------------------------------
+// tunerregistry::create_tuner (private, static)
+//
+// Creates a new tuner state instance
+//
+// Arguments:
+//
+//	tunerid		- Tuner identifier string (DDDDDDDD-T)
+
+tunerregistry::tuner_t tunerregistry::create_tuner(std::string const& tunerid)
 {
-	std::string					tunerid;			// Selected tuner identifier
+	struct hdhomerun_device_t* device = hdhomerun_device_create_from_str(tunerid.c_str(), nullptr);
+	if(device == nullptr) throw string_exception(__func__, ": hdhomerun_device_create_from_str() failed");
+
+	tuner_t tuner = std::make_shared<struct tuner>();
+	tuner->device = device_t(device, hdhomerun_device_destroy);
+	tuner->state = tuner_state::unknown;
 
-	// Allocate and initialize the device selector
-	struct hdhomerun_device_selector_t* selector = hdhomerun_device_selector_create(nullptr);
-	if(selector == nullptr) throw string_exception("hdhomerun_device_selector_create() failed");
+	return tuner;
+}
 
+//---------------------------------------------------------------------------
+// tunerregistry::probe (private)
+//
+// Probes a single tuner and attempts to select it if it's available
+//
+// Arguments:
+//
+//	tuner		- Tuner to be probed
+//	selection	- Selection state shared with the other probes
+
+void tunerregistry::probe(tuner_t tuner, std::shared_ptr<struct selection> selection)
+{
 	try {
 
-		// Add each of the possible device/tuner combinations to the selector
-		for(auto const& iterator : possibilities) {
+		std::unique_lock<std::mutex> tunerlock(tuner->lock);
 
-			struct hdhomerun_device_t* device = hdhomerun_device_create_from_str(iterator.c_str(), nullptr);
-			if(device == nullptr) throw string_exception("hdhomerun_device_create_from_str() failed");
+		// There is no need to probe the tuner if another one has already been selected
+		bool selected = false;
+		{ std::unique_lock<std::mutex> lock(selection->lock); selected = !selection->tunerid.empty(); }
 
-			hdhomerun_device_selector_add_device(selector, device);
-		}
+		if(!selected) {
+
+			// Check the owner of the tuner lock first, an unlocked tuner reports an owner of "none".  If the owner
+			// can't be determined the state is unknown; the lock request below will still decide it either way
+			char* owner = nullptr;
+			int result = hdhomerun_device_get_tuner_lockkey_owner(tuner->device.get(), &owner);
+			if(result <= 0) tuner->state = tuner_state::unknown;
+			else tuner->state = ((owner != nullptr) && (strcmp(owner, "none") == 0)) ? tuner_state::available : tuner_state::inuse;
+
+			// NOTE: There is an inherent race condition here with the tuner lock implementation.  When the tuner
+			// is selected here it will be locked, but it cannot remain locked since the ultimate purpose here is
+			// to generate an HTTP URL for the application to use.  The HTTP stream will attempt it's own lock
+			// and would fail if left locked after this function completes.  No way to tell it to use an existing lock.
+			if(tuner->state != tuner_state::inuse) {
 
-		// NOTE: There is an inherent race condition here with the tuner lock implementation.  When the tuner
-		// is selected here it will be locked, but it cannot remain locked since the ultimate purpose here is
-		// to generate an HTTP URL for the application to use.  The HTTP stream will attempt it's own lock
-		// and would fail if left locked after this function completes.  No way to tell it to use an existing lock.
+				if(hdhomerun_device_tuner_lockkey_request(tuner->device.get(), nullptr) == 1) {
 
-		// Let libhdhomerun pick a free tuner for us from the available possibilities
-		struct hdhomerun_device_t* selected = hdhomerun_device_selector_choose_and_lock(selector, nullptr);
-		if(selected) {
+					hdhomerun_device_tuner_lockkey_release(tuner->device.get());
 
-			tunerid = hdhomerun_device_get_name(selected);			// DDDDDDDD-T; D=DeviceID, T=TunerID
-			hdhomerun_device_tuner_lockkey_release(selected);		// Release the acquired lock
+					// The first tuner to be successfully locked is the one that gets selected
+					std::unique_lock<std::mutex> lock(selection->lock);
+					if(selection->tunerid.empty()) selection->tunerid = hdhomerun_device_get_name(tuner->device.get());
+				}
+
+				else tuner->state = tuner_state::inuse;
+			}
 		}
+	}
+
+	// Exceptions cannot be propagated from a probe thread; the tuner is simply not selected
+	catch(...) {}
+
+	// Signal the selecting thread that this probe has completed
+	{
+		std::unique_lock<std::mutex> lock(selection->lock);
+		selection->remaining--;
+		selection->changed.notify_all();
+	}
+
+	// Signal the registry that this probe has completed
+	std::unique_lock<std::mutex> lock(m_lock);
+	m_probes--;
+	m_probed.notify_all();
+}
+
+//---------------------------------------------------------------------------
+// tunerregistry::refresh
+//
+// Refreshes the registry with the currently known tuners
+//
+// Arguments:
+//
+//	tuners		- vector<> of all currently known tuners
+
+void tunerregistry::refresh(std::vector<std::string> const& tuners)
+{
+	std::map<std::string, tuner_t>		refreshed;		// Refreshed collection of tuners
+
+	std::unique_lock<std::mutex> lock(m_lock);
+
+	// Retain the existing tuner instances and create instances for any new ones; tuners that
+	// are no longer known are dropped from the registry
+	for(auto const& iterator : tuners) {
+
+		auto found = m_tuners.find(iterator);
+		refreshed.emplace(iterator, (found != m_tuners.end()) ? found->second : create_tuner(iterator));
+	}
+
+	m_tuners.swap(refreshed);
+}
+
+//---------------------------------------------------------------------------
+// tunerregistry::select
+//
+// Selects an available tuner from a list of possibilities
+//
+// Arguments:
+//
+//	possibilities	- vector<> of tuners to select from
+
+std::string tunerregistry::select(std::vector<std::string> const& possibilities)
+{
+	std::vector<tuner_t>		candidates;				// Tuners to be probed
+
+	auto selection = std::make_shared<struct selection>();
+
+	std::unique_lock<std::mutex> lock(m_lock);
 
-		// Release the selector along with all of the generated device structures
-		hdhomerun_device_selector_destroy(selector, true);
+	// Locate the tuner instances for each of the possibilities, create any that aren't registered yet
+	for(auto const& iterator : possibilities) {
+
+		auto found = m_tuners.find(iterator);
+		if(found == m_tuners.end()) found = m_tuners.emplace(iterator, create_tuner(iterator)).first;
+		candidates.push_back(found->second);
 	}
 
-	catch(...) { hdhomerun_device_selector_destroy(selector, true); }
+	// Rank the tuners by the state they were in the last time they were probed; the tuners that were known to
+	// be available are probed first, then the unknown ones and finally the ones that were known to be in use
+	auto rank = [](tuner_state state) -> int { return (state == tuner_state::available) ? 0 : (state == tuner_state::unknown) ? 1 : 2; };
+	std::vector<tuner_t> ranked[3];
+	for(auto const& iterator : candidates) ranked[rank(iterator->state)].push_back(iterator);
+
+	lock.unlock();
+
+	// Probe the tuners of each rank concurrently, only moving on to the next rank if none were selected
+	for(auto const& group : ranked) {
+
+		if(group.empty()) continue;
+
+		{
+			std::unique_lock<std::mutex> registrylock(m_lock);
+			std::unique_lock<std::mutex> selectionlock(selection->lock);
+
+			selection->remaining = group.size();
+			for(auto const& iterator : group) {
+
+				try { m_probes++; std::thread(&tunerregistry::probe, this, iterator, selection).detach(); }
+				catch(...) { m_probes--; selection->remaining--; }
+			}
+		}
+
+		// Wait for a tuner to be selected or for all of the probes to indicate that none are available
+		std::unique_lock<std::mutex> selectionlock(selection->lock);
+		selection->changed.wait(selectionlock, [&]() -> bool { return (!selection->tunerid.empty()) || (selection->remaining == 0); });
+
+		if(!selection->tunerid.empty()) return selection->tunerid;
+	}
 
-	return tunerid;
+	return std::string();
 }
 
 //---------------------------------------------------------------------------
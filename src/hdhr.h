@@ -24,7 +24,12 @@
 #define __HDHR_H_
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -58,6 +63,114 @@ struct discover_device {
 // Callback function passed to enumerate_devices
 using enumerate_devices_callback = std::function<void(struct discover_device const& device)>;
 
+//---------------------------------------------------------------------------
+// Class tunerregistry
+//
+// Maintains a long-lived collection of tuner device objects along with their
+// last known lock state; available tuners are selected by probing the possible
+// candidates concurrently, in groups ordered by their last known lock state
+
+class tunerregistry
+{
+public:
+
+	// Instance Constructor
+	//
+	tunerregistry();
+
+	// Destructor
+	//
+	~tunerregistry();
+
+	//-----------------------------------------------------------------------
+	// Member Functions
+
+	// available
+	//
+	// Counts the tuners from a list of possibilities that are not currently locked
+	size_t available(std::vector<std::string> const& possibilities);
+
+	// refresh
+	//
+	// Refreshes the registry with the currently known tuners
+	void refresh(std::vector<std::string> const& tuners);
+
+	// select
+	//
+	// Selects an available tuner from a list of possibilities
+	std::string select(std::vector<std::string> const& possibilities);
+
+private:
+
+	tunerregistry(tunerregistry const&)=delete;
+	tunerregistry& operator=(tunerregistry const&)=delete;
+
+	//-----------------------------------------------------------------------
+	// Private Type Declarations
+
+	// tuner_state
+	//
+	// Last known lock state of a tuner
+	enum class tuner_state {
+
+		unknown		= 0,
+		available	= 1,
+		inuse		= 2,
+	};
+
+	// device_t
+	//
+	// Unique pointer to a libhdhomerun device object
+	using device_t = std::unique_ptr<struct hdhomerun_device_t, std::function<void(struct hdhomerun_device_t*)>>;
+
+	// tuner
+	//
+	// State information about a single tuner; the device object is not thread-safe
+	struct tuner {
+
+		std::mutex									lock;		// Device synchronization
+		device_t									device;		// libhdhomerun device object
+		std::atomic<tuner_state>					state;		// Last known lock state
+	};
+
+	// selection
+	//
+	// State information shared among the threads probing for an available tuner
+	struct selection {
+
+		std::mutex									lock;		// Synchronization object
+		std::condition_variable						changed;	// Signaled when state changes
+		std::string									tunerid;	// Selected tuner identifier
+		size_t										remaining;	// Number of outstanding probes
+	};
+
+	// tuner_t
+	//
+	// Shared pointer to a tuner state instance
+	using tuner_t = std::shared_ptr<struct tuner>;
+
+	//-----------------------------------------------------------------------
+	// Private Member Functions
+
+	// create_tuner (static)
+	//
+	// Creates a new tuner state instance
+	static tuner_t create_tuner(std::string const& tunerid);
+
+	// probe
+	//
+	// Probes a single tuner and attempts to select it if it's available
+	void probe(tuner_t tuner, std::shared_ptr<struct selection> selection);
+
+	//-----------------------------------------------------------------------
+	// Member Variables
+
+	std::map<std::string, tuner_t>		m_tuners;			// Registered tuners
+	size_t								m_probes = 0;		// Number of active probes
+	std::mutex							m_lock;				// Synchronization object
+	std::condition_variable				m_probed;			// Signaled when a probe completes
+};
+
 //---------------------------------------------------------------------------
 // FUNCTION PROTOTYPES
 //---------------------------------------------------------------------------
@@ -67,11 +180,6 @@ using enumerate_devices_callback = std::function<void(struct discover_device con
 // Enumerates all of the HDHomeRun devices discovered via broadcast (libhdhomerun)
 void enumerate_devices(enumerate_devices_callback callback);
 
-// select_tuner
-//
-// Selects an available tuner device from a list of possibilities
-std::string select_tuner(std::vector<std::string> const& possibilities);
-
 //---------------------------------------------------------------------------
 
 #pragma warning(pop)
@@ -0,0 +1,526 @@
+//---------------------------------------------------------------------------
+// Copyright (c) 2018 Michael G. Brehm
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//---------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#pragma warning(push, 4)
+
+//---------------------------------------------------------------------------
+// TYPE DECLARATIONS
+//---------------------------------------------------------------------------
+
+// metric_data
+//
+// Accumulated state of a single metric; samples are counted in logarithmic
+// (power of two) buckets to approximate the percentile values.  The samples
+// are atomic so they can be recorded through a metric_handle without a lock
+struct metric_data {
+
+	metric_data(metric_type metrictype) : type(metrictype) { reset(); }
+
+	// reset
+	//
+	// Discards all of the recorded samples
+	void reset(void)
+	{
+		count = 0;
+		total = 0;
+		minimum = std::numeric_limits<unsigned long long>::max();
+		maximum = 0;
+		for(auto& bucket : buckets) bucket = 0;
+	}
+
+	metric_type const					type;
+	std::atomic<unsigned long long>		count;
+	std::atomic<unsigned long long>		total;
+	std::atomic<unsigned long long>		minimum;
+	std::atomic<unsigned long long>		maximum;
+	std::atomic<unsigned long long>		buckets[64];
+};
+
+// metric_snapshot
+//
+// Copy of the state of a single metric
+struct metric_snapshot {
+
+	metric_type			type;
+	unsigned long long	count;
+	unsigned long long	total;
+	unsigned long long	minimum;
+	unsigned long long	maximum;
+	unsigned long long	buckets[64];
+};
+
+//---------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//---------------------------------------------------------------------------
+
+static size_t bucket_index(unsigned long long value);
+static unsigned long long bucket_percentile(struct metric_snapshot const& data, unsigned int percent);
+static void record_metric(metric_handle handle, unsigned long long value, unsigned long long amount);
+static void store_maximum(std::atomic<unsigned long long>& maximum, unsigned long long value);
+static void store_minimum(std::atomic<unsigned long long>& minimum, unsigned long long value);
+
+//---------------------------------------------------------------------------
+// GLOBAL VARIABLES
+//---------------------------------------------------------------------------
+
+// g_metrics
+//
+// Collection of all recorded metrics.  Entries are never removed, the addresses of
+// their data are used as metric handles that are resolved once by the callers
+static std::map<std::string, struct metric_data> g_metrics;
+
+// g_metrics_lock
+//
+// Synchronization object for the metrics collection
+static std::mutex g_metrics_lock;
+
+// g_metrics_maximum
+//
+// Maximum number of distinct metrics; protects against unbounded growth
+static size_t const g_metrics_maximum = 512;
+
+//---------------------------------------------------------------------------
+// metric_accumulator Constructor
+//
+// Arguments:
+//
+//	NONE
+
+metric_accumulator::metric_accumulator() : m_count(0), m_total(0), m_minimum(std::numeric_limits<unsigned long long>::max()), m_maximum(0)
+{
+	for(auto& bucket : m_buckets) bucket = 0;
+}
+
+//---------------------------------------------------------------------------
+// metric_accumulator::publish
+//
+// Merges the accumulated samples into a metric and resets the accumulator
+//
+// Arguments:
+//
+//	handle		- Handle to the metric to merge the samples into
+
+void metric_accumulator::publish(metric_handle handle)
+{
+	unsigned long long count = m_count.exchange(0, std::memory_order_relaxed);
+	if((handle == nullptr) || (count == 0)) return;
+
+	handle->count.fetch_add(count, std::memory_order_relaxed);
+	handle->total.fetch_add(m_total.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+	store_minimum(handle->minimum, m_minimum.exchange(std::numeric_limits<unsigned long long>::max(), std::memory_order_relaxed));
+	store_maximum(handle->maximum, m_maximum.exchange(0, std::memory_order_relaxed));
+
+	for(size_t index = 0; index < 64; index++) {
+
+		unsigned long long samples = m_buckets[index].exchange(0, std::memory_order_relaxed);
+		if(samples > 0) handle->buckets[index].fetch_add(samples, std::memory_order_relaxed);
+	}
+}
+
+//---------------------------------------------------------------------------
+// metric_accumulator::record
+//
+// Records a sample into the accumulator
+//
+// Arguments:
+//
+//	value		- Value to be recorded
+
+void metric_accumulator::record(unsigned long long value)
+{
+	// There is only ever a single writer, the values are atomic so they can be published from
+	// another thread but there is no need for the (more expensive) read-modify-write operations
+	m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	m_total.store(m_total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	if(value < m_minimum.load(std::memory_order_relaxed)) m_minimum.store(value, std::memory_order_relaxed);
+	if(value > m_maximum.load(std::memory_order_relaxed)) m_maximum.store(value, std::memory_order_relaxed);
+
+	std::atomic<unsigned long long>& bucket = m_buckets[bucket_index(value)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------
+// metric_accumulator::record
+//
+// Records an elapsed time sample into the accumulator
+//
+// Arguments:
+//
+//	duration	- Elapsed time to be recorded
+
+void metric_accumulator::record(std::chrono::steady_clock::duration duration)
+{
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	record(static_cast<unsigned long long>(std::max(microseconds, static_cast<decltype(microseconds)>(0))));
+}
+
+//---------------------------------------------------------------------------
+// metric_timer Constructor
+//
+// Arguments:
+//
+//	name		- Name of the duration metric to record
+
+metric_timer::metric_timer(char const* name) : m_name(name), m_start(std::chrono::steady_clock::now())
+{
+}
+
+//---------------------------------------------------------------------------
+// metric_timer Destructor
+
+metric_timer::~metric_timer()
+{
+	record_metric_duration(m_name, std::chrono::steady_clock::now() - m_start);
+}
+
+//---------------------------------------------------------------------------
+// bucket_index
+//
+// Gets the logarithmic bucket index for a sample value
+//
+// Arguments:
+//
+//	value		- Sample value
+
+static size_t bucket_index(unsigned long long value)
+{
+	// The bucket index is the number of significant bits in the value
+	size_t bucket = 0;
+	while((bucket < 63) && ((value >> bucket) != 0)) bucket++;
+
+	return bucket;
+}
+
+//---------------------------------------------------------------------------
+// bucket_percentile
+//
+// Approximates a percentile value from the logarithmic sample buckets
+//
+// Arguments:
+//
+//	data		- Metric data to be evaluated
+//	percent		- Percentile to approximate (1 - 100)
+
+static unsigned long long bucket_percentile(struct metric_snapshot const& data, unsigned int percent)
+{
+	if(data.count == 0) return 0;
+
+	// Determine the rank of the sample that represents the percentile
+	unsigned long long rank = ((data.count * percent) + 99) / 100;
+	unsigned long long seen = 0;
+
+	for(size_t index = 0; index < 64; index++) {
+
+		if((seen + data.buckets[index]) < rank) { seen += data.buckets[index]; continue; }
+
+		// Interpolate linearly within the bucket and clamp the result to the observed range
+		unsigned long long lower = (index == 0) ? 0 : (1ULL << (index - 1));
+		unsigned long long upper = (1ULL << index) - 1;
+		unsigned long long value = lower + static_cast<unsigned long long>((static_cast<double>(upper - lower) * (rank - seen)) / data.buckets[index]);
+
+		return std::max(data.minimum, std::min(data.maximum, value));
+	}
+
+	return data.maximum;
+}
+
+//---------------------------------------------------------------------------
+// enumerate_metrics
+//
+// Enumerates a snapshot of all recorded metrics in name order
+//
+// Arguments:
+//
+//	callback	- Callback function
+
+void enumerate_metrics(enumerate_metrics_callback callback)
+{
+	std::map<std::string, struct metric_snapshot> snapshot;
+
+	// Take a copy of the metrics so the callback is not invoked under the lock; metrics
+	// that have been resolved or reset but haven't recorded any samples are skipped
+	{
+		std::unique_lock<std::mutex> lock(g_metrics_lock);
+
+		for(auto const& iterator : g_metrics) {
+
+			struct metric_data const& data = iterator.second;
+			if(data.count.load(std::memory_order_relaxed) == 0) continue;
+
+			struct metric_snapshot& copy = snapshot[iterator.first];
+			copy.type = data.type;
+			copy.count = data.count.load(std::memory_order_relaxed);
+			copy.total = data.total.load(std::memory_order_relaxed);
+			copy.minimum = data.minimum.load(std::memory_order_relaxed);
+			copy.maximum = data.maximum.load(std::memory_order_relaxed);
+			for(size_t index = 0; index < 64; index++) copy.buckets[index] = data.buckets[index].load(std::memory_order_relaxed);
+		}
+	}
+
+	for(auto const& iterator : snapshot) {
+
+		struct metric item = {};
+		struct metric_snapshot const& data = iterator.second;
+
+		item.name = iterator.first.c_str();
+		item.type = data.type;
+		item.count = data.count;
+		item.total = data.total;
+
+		if(data.type != metric_type::counter) {
+
+			item.minimum = data.minimum;
+			item.maximum = data.maximum;
+			item.p50 = bucket_percentile(data, 50);
+			item.p90 = bucket_percentile(data, 90);
+			item.p99 = bucket_percentile(data, 99);
+		}
+
+		callback(item);
+	}
+}
+
+//---------------------------------------------------------------------------
+// increment_metric
+//
+// Increments a counter metric
+//
+// Arguments:
+//
+//	name		- Name of the metric to increment
+
+void increment_metric(char const* name)
+{
+	return increment_metric(name, 1);
+}
+
+//---------------------------------------------------------------------------
+// increment_metric
+//
+// Increments a counter metric
+//
+// Arguments:
+//
+//	name		- Name of the metric to increment
+//	amount		- Amount to increment the metric by
+
+void increment_metric(char const* name, unsigned long long amount)
+{
+	record_metric(resolve_metric(name, metric_type::counter), 0, amount);
+}
+
+//---------------------------------------------------------------------------
+// increment_metric
+//
+// Increments a counter metric
+//
+// Arguments:
+//
+//	handle		- Handle to the metric to increment
+//	amount		- Amount to increment the metric by
+
+void increment_metric(metric_handle handle, unsigned long long amount)
+{
+	record_metric(handle, 0, amount);
+}
+
+//---------------------------------------------------------------------------
+// record_metric
+//
+// Records a sample for a metric
+//
+// Arguments:
+//
+//	handle		- Handle to the metric
+//	value		- Sample value (not used for counters)
+//	amount		- Amount to add to the metric count
+
+static void record_metric(metric_handle handle, unsigned long long value, unsigned long long amount)
+{
+	if(handle == nullptr) return;
+
+	handle->count.fetch_add(amount, std::memory_order_relaxed);
+	if(handle->type == metric_type::counter) { handle->total.fetch_add(amount, std::memory_order_relaxed); return; }
+
+	handle->total.fetch_add(value, std::memory_order_relaxed);
+	store_minimum(handle->minimum, value);
+	store_maximum(handle->maximum, value);
+	handle->buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------
+// record_metric_duration
+//
+// Records an elapsed time sample for a duration metric
+//
+// Arguments:
+//
+//	name		- Name of the metric
+//	duration	- Elapsed time to record
+
+void record_metric_duration(char const* name, std::chrono::steady_clock::duration duration)
+{
+	record_metric_duration(resolve_metric(name, metric_type::duration), duration);
+}
+
+//---------------------------------------------------------------------------
+// record_metric_duration
+//
+// Records an elapsed time sample for a duration metric
+//
+// Arguments:
+//
+//	handle		- Handle to the metric
+//	duration	- Elapsed time to record
+
+void record_metric_duration(metric_handle handle, std::chrono::steady_clock::duration duration)
+{
+	auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	record_metric(handle, static_cast<unsigned long long>(std::max(microseconds, static_cast<decltype(microseconds)>(0))), 1);
+}
+
+//---------------------------------------------------------------------------
+// record_metric_value
+//
+// Records a sample for a value metric
+//
+// Arguments:
+//
+//	name		- Name of the metric
+//	value		- Value to record
+
+void record_metric_value(char const* name, unsigned long long value)
+{
+	record_metric(resolve_metric(name, metric_type::value), value, 1);
+}
+
+//---------------------------------------------------------------------------
+// record_metric_value
+//
+// Records a sample for a value metric
+//
+// Arguments:
+//
+//	handle		- Handle to the metric
+//	value		- Value to record
+
+void record_metric_value(metric_handle handle, unsigned long long value)
+{
+	record_metric(handle, value, 1);
+}
+
+//---------------------------------------------------------------------------
+// reset_metrics
+//
+// Discards the samples of all recorded metrics; the metrics themselves are
+// retained since there may be outstanding handles that reference them
+//
+// Arguments:
+//
+//	NONE
+
+void reset_metrics(void)
+{
+	std::unique_lock<std::mutex> lock(g_metrics_lock);
+	for(auto& iterator : g_metrics) iterator.second.reset();
+}
+
+//---------------------------------------------------------------------------
+// resolve_metric
+//
+// Resolves a metric by name, creating it as necessary
+//
+// Arguments:
+//
+//	name		- Name of the metric
+//	type		- Type of the metric
+
+metric_handle resolve_metric(char const* name, metric_type type)
+{
+	if((name == nullptr) || (*name == '\0')) return nullptr;
+
+	std::unique_lock<std::mutex> lock(g_metrics_lock);
+
+	// Metrics are recorded from destructors; never allow an exception to escape
+	try {
+
+		std::string key(name);
+
+		auto found = g_metrics.find(key);
+		if(found == g_metrics.end()) {
+
+			// Silently discard new metrics once the maximum has been reached
+			if(g_metrics.size() >= g_metrics_maximum) return nullptr;
+			found = g_metrics.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(type)).first;
+		}
+
+		return &found->second;
+	}
+
+	catch(...) { return nullptr; }
+}
+
+//---------------------------------------------------------------------------
+// store_maximum
+//
+// Atomically raises a maximum value
+//
+// Arguments:
+//
+//	maximum		- Maximum value to be updated
+//	value		- Candidate value
+
+static void store_maximum(std::atomic<unsigned long long>& maximum, unsigned long long value)
+{
+	unsigned long long current = maximum.load(std::memory_order_relaxed);
+	while((value > current) && (!maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)));
+}
+
+//---------------------------------------------------------------------------
+// store_minimum
+//
+// Atomically lowers a minimum value
+//
+// Arguments:
+//
+//	minimum		- Minimum value to be updated
+//	value		- Candidate value
+
+static void store_minimum(std::atomic<unsigned long long>& minimum, unsigned long long value)
+{
+	unsigned long long current = minimum.load(std::memory_order_relaxed);
+	while((value < current) && (!minimum.compare_exchange_weak(current, value, std::memory_order_relaxed)));
+}
+
+//---------------------------------------------------------------------------
+
+#pragma warning(pop)
@@ -0,0 +1,187 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2018 Michael G. Brehm
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __METRICS_H_
+#define __METRICS_H_
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+#pragma warning(push, 4)
+
+//---------------------------------------------------------------------------
+// DATA TYPES
+//---------------------------------------------------------------------------
+
+// metric_type
+//
+// Indicates the type of a recorded metric
+enum class metric_type {
+
+	counter			= 0,		// Simple event counter
+	duration		= 1,		// Elapsed time samples (microseconds)
+	value			= 2,		// Arbitrary value samples
+};
+
+// metric
+//
+// Snapshot of a single recorded metric
+struct metric {
+
+	char const*			name;
+	metric_type			type;
+	unsigned long long	count;
+	unsigned long long	total;
+	unsigned long long	minimum;
+	unsigned long long	maximum;
+	unsigned long long	p50;
+	unsigned long long	p90;
+	unsigned long long	p99;
+};
+
+// enumerate_metrics_callback
+//
+// Callback function passed to enumerate_metrics
+using enumerate_metrics_callback = std::function<void(struct metric const& metric)>;
+
+// metric_handle
+//
+// Pre-resolved reference to a recorded metric; avoids the name lookup when recording
+using metric_handle = struct metric_data*;
+
+//---------------------------------------------------------------------------
+// Class metric_accumulator
+//
+// Accumulates samples for a duration or value metric without any locking; only a single
+// thread may record samples into an instance, they are merged into a metric by publish()
+
+class metric_accumulator
+{
+public:
+
+	// Instance Constructor
+	//
+	metric_accumulator();
+
+	//-----------------------------------------------------------------------
+	// Member Functions
+
+	// publish
+	//
+	// Merges the accumulated samples into a metric and resets the accumulator
+	void publish(metric_handle handle);
+
+	// record
+	//
+	// Records a sample into the accumulator
+	void record(unsigned long long value);
+	void record(std::chrono::steady_clock::duration duration);
+
+private:
+
+	metric_accumulator(metric_accumulator const&)=delete;
+	metric_accumulator& operator=(metric_accumulator const&)=delete;
+
+	//-----------------------------------------------------------------------
+	// Member Variables
+
+	std::atomic<unsigned long long>		m_count;			// Number of samples
+	std::atomic<unsigned long long>		m_total;			// Total of all samples
+	std::atomic<unsigned long long>		m_minimum;			// Minimum sample value
+	std::atomic<unsigned long long>		m_maximum;			// Maximum sample value
+	std::atomic<unsigned long long>		m_buckets[64];		// Logarithmic sample buckets
+};
+
+//---------------------------------------------------------------------------
+// Class metric_timer
+//
+// Records the elapsed lifetime of the instance as a duration metric
+
+class metric_timer
+{
+public:
+
+	// Instance Constructor
+	//
+	metric_timer(char const* name);
+
+	// Destructor
+	//
+	~metric_timer();
+
+private:
+
+	metric_timer(metric_timer const&)=delete;
+	metric_timer& operator=(metric_timer const&)=delete;
+
+	//-----------------------------------------------------------------------
+	// Member Variables
+
+	char const* const							m_name;		// Metric name
+	std::chrono::steady_clock::time_point const	m_start;	// Starting time
+};
+
+//---------------------------------------------------------------------------
+// FUNCTION PROTOTYPES
+//---------------------------------------------------------------------------
+
+// enumerate_metrics
+//
+// Enumerates a snapshot of all recorded metrics in name order
+void enumerate_metrics(enumerate_metrics_callback callback);
+
+// increment_metric
+//
+// Increments a counter metric
+void increment_metric(char const* name);
+void increment_metric(char const* name, unsigned long long amount);
+void increment_metric(metric_handle handle, unsigned long long amount);
+
+// record_metric_duration
+//
+// Records an elapsed time sample for a duration metric
+void record_metric_duration(char const* name, std::chrono::steady_clock::duration duration);
+void record_metric_duration(metric_handle handle, std::chrono::steady_clock::duration duration);
+
+// record_metric_value
+//
+// Records a sample for a value metric
+void record_metric_value(char const* name, unsigned long long value);
+void record_metric_value(metric_handle handle, unsigned long long value);
+
+// reset_metrics
+//
+// Discards the samples of all recorded metrics
+void reset_metrics(void);
+
+// resolve_metric
+//
+// Resolves a metric by name, creating it as necessary; returns null if it can't be created
+metric_handle resolve_metric(char const* name, metric_type type);
+
+//---------------------------------------------------------------------------
+
+#pragma warning(pop)
+
+#endif	// __METRICS_H_
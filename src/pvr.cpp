@@ -23,12 +23,16 @@
 #include "stdafx.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <future>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <set>
 #include <strings.h>
 #include <sstream>
 #include <vector>
@@ -38,6 +42,10 @@
 #include <sys/prctl.h>
 #endif
 
+#if !defined(TARGET_WINDOWS) && !defined(TARGET_WINDOWS_STORE)
+#include <sys/resource.h>
+#endif
+
 #include <xbmc_addon_dll.h>
 #include <xbmc_pvr_dll.h>
 #include <version.h>
@@ -49,6 +57,7 @@
 #include "database.h"
 #include "dvrstream.h"
 #include "hdhr.h"
+#include "metrics.h"
 #include "scalar_condition.h"
 #include "scheduler.h"
 #include "string_exception.h"
@@ -74,11 +83,21 @@
 #define MENUHOOK_CHANNEL_ADDFAVORITE					10
 #define MENUHOOK_CHANNEL_REMOVEFAVORITE					11
 #define MENUHOOK_SETTING_SHOWDEVICENAMES				12
+#define MENUHOOK_SETTING_SHOWMETRICS					13
 
 //---------------------------------------------------------------------------
 // FUNCTION PROTOTYPES
 //---------------------------------------------------------------------------
 
+// Database writer helpers
+//
+static void enqueue_recording_lastposition(char const* recordingid, int lastposition);
+
+// Edit decision list helpers
+//
+static void read_edl_file(char const* filename, std::vector<struct edl_entry>& entries);
+static bool stat_edl_file(char const* filename, int64_t& size, int64_t& mtime);
+
 // Exception helpers
 //
 static void handle_generalexception(char const* function);
@@ -94,6 +113,12 @@ template<typename... _args> static void log_info(_args&&... args);
 template<typename... _args>	static void log_message(ADDON::addon_log_t level, _args&&... args);
 template<typename... _args> static void log_notice(_args&&... args);
 
+// Recording snapshot helpers
+//
+static std::shared_ptr<std::vector<PVR_RECORDING> const> get_recordings_snapshot(void);
+static void invalidate_recordings_snapshot(void);
+static std::shared_ptr<std::vector<PVR_RECORDING> const> refresh_recordings_snapshot(sqlite3* instance, struct addon_settings const& settings);
+
 // Scheduled Tasks
 //
 static void discover_devices_task(scalar_condition<bool> const& cancel);
@@ -103,6 +128,16 @@ static void discover_lineups_task(scalar_condition<bool> const& cancel);
 static void discover_recordingrules_task(scalar_condition<bool> const& cancel);
 static void discover_recordings_task(scalar_condition<bool> const& cancel);
 static void discover_startup_task(scalar_condition<bool> const& cancel);
+static void expire_prebuffered_task(scalar_condition<bool> const& cancel);
+static void index_edl_task(scalar_condition<bool> const& cancel);
+static void log_metrics_task(scalar_condition<bool> const& cancel);
+static void prebuffer_channels_task(scalar_condition<bool> const& cancel);
+static void probe_hosts_task(scalar_condition<bool> const& cancel);
+static void trim_buffers_task(scalar_condition<bool> const& cancel);
+
+// Stream helpers
+//
+static size_t stream_buffer_size(struct addon_settings const& settings, unsigned int channelid);
 
 //---------------------------------------------------------------------------
 // TYPE DECLARATIONS
@@ -131,6 +166,38 @@ enum timer_type {
 	datetimeonlytimer		= 6,
 };
 
+// edl_entry
+//
+// An unadjusted entry read from an edit decision list file
+struct edl_entry {
+
+	float							start;			// Starting point, in seconds
+	float							end;			// Ending point, in seconds
+	int								type;			// Type of edit to be made
+};
+
+// edl_index_entry
+//
+// The parsed edit decision list of a recording and the attributes of the file it was read from
+struct edl_index_entry {
+
+	std::string						folder;			// Folder setting used to locate the file
+	std::string						filename;		// Full name of the .EDL file
+	bool							exists;			// Flag if the file exists
+	int64_t							size;			// Size of the file
+	int64_t							mtime;			// Last modification time of the file
+	std::vector<struct edl_entry>	entries;		// Entries read from the file
+};
+
+// prebuffered_stream
+//
+// A stream opened in the background for a channel that is likely to be watched next
+struct prebuffered_stream {
+
+	std::unique_ptr<dvrstream>				stream;			// Pre-buffered stream instance
+	std::chrono::steady_clock::time_point	created;		// Time the stream was opened
+};
+
 // addon_settings
 //
 // Defines all of the configurable addon settings
@@ -228,9 +295,24 @@ struct addon_settings {
 
 	// stream_ring_buffer_size
 	//
-	// Indicates the size of the stream ring buffer to allocate
+	// Indicates the size of the stream ring buffer to allocate, zero to size it automatically
 	int stream_ring_buffer_size;
 
+	// enable_live_timeshift
+	//
+	// Enables the disk-backed timeshift buffer for live streams
+	bool enable_live_timeshift;
+
+	// timeshift_buffer_folder
+	//
+	// Folder in which to create the timeshift buffer file; empty for the user data folder
+	std::string timeshift_buffer_folder;
+
+	// timeshift_buffer_size
+	//
+	// Indicates the size of the timeshift buffer to allocate
+	long long timeshift_buffer_size;
+
 	// enable_recording_edl
 	//
 	// Enables support recorded TV edit decision lists
@@ -250,6 +332,41 @@ struct addon_settings {
 	//
 	// Indicates the number of milliseconds to subtract to an EDL end value
 	int recording_edl_end_padding;
+
+	// metrics_log_interval
+	//
+	// Interval at which the performance metrics are written to the log (seconds)
+	int metrics_log_interval;
+
+	// enable_channel_prebuffering
+	//
+	// Enables pre-buffering of the channels adjacent to the live channel
+	bool enable_channel_prebuffering;
+
+	// recording_readahead_size
+	//
+	// Indicates the size of the read-ahead buffer for recorded streams, zero to disable
+	int recording_readahead_size;
+
+	// enable_low_memory_profile
+	//
+	// Reduces the memory used by the database, the connection pool and the stream buffers
+	bool enable_low_memory_profile;
+
+	// http_request_timeout
+	//
+	// Maximum amount of time allowed for an HTTP request (seconds), zero for no limit
+	int http_request_timeout;
+
+	// http_lowspeed_timeout
+	//
+	// Amount of time an HTTP request can be stalled before it's aborted (seconds), zero for no limit
+	int http_lowspeed_timeout;
+
+	// http_request_concurrency
+	//
+	// Maximum number of HTTP requests executed concurrently during discovery
+	int http_request_concurrency;
 };
 
 //---------------------------------------------------------------------------
@@ -261,6 +378,21 @@ struct addon_settings {
 // Kodi add-on callbacks
 static std::unique_ptr<ADDON::CHelper_libXBMC_addon> g_addon;
 
+// g_bitrates
+//
+// Last measured stream bitrate of each channel, in bits per second
+static std::map<unsigned int, long long> g_bitrates;
+
+// g_bitrates_lock
+//
+// Synchronization object to serialize access to the measured channel bitrates
+static std::mutex g_bitrates_lock;
+
+// g_channelsvisible
+//
+// Flag indicating if the channels have been provided to Kodi since startup
+static std::atomic<bool> g_channelsvisible{false};
+
 // g_capabilities (const)
 //
 // PVR implementation capability flags
@@ -293,15 +425,35 @@ static const PVR_ADDON_CAPABILITIES g_capabilities = {
 // Global SQLite database connection pool instance
 static std::shared_ptr<connectionpool> g_connpool;
 
+// g_connpool_warmcount (const)
+//
+// Number of database connections opened when the connection pool is created
+static size_t const g_connpool_warmcount = 4;
+
+// g_defaultbitrate (const)
+//
+// Bitrate assumed for a channel that hasn't been measured yet (ATSC maximum), in bits per second
+static long long const g_defaultbitrate = 19392658LL;
+
+// g_devicecachelifetime (const)
+//
+// Maximum age of the last device discovery that can be reused at startup
+static std::chrono::seconds const g_devicecachelifetime(std::chrono::hours(24));
+
 // g_dvrstream
 //
 // DVR stream buffer instance
 static std::unique_ptr<dvrstream> g_dvrstream;
 
-// g_epgenabled
+// g_edlindex
+//
+// Edit decision lists read ahead of time, indexed by recording identifier
+static std::map<std::string, struct edl_index_entry> g_edlindex;
+
+// g_edlindex_lock
 //
-// Flag indicating if EPG access is enabled for the process
-static bool g_epgenabled = true;
+// Synchronization object to serialize access to the edit decision list index
+static std::mutex g_edlindex_lock;
 
 // g_epgmaxtime
 //
@@ -313,11 +465,96 @@ static int g_epgmaxtime = EPG_TIMEFRAME_UNLIMITED;
 // Kodi GUI library callbacks
 static std::unique_ptr<CHelper_libKODI_guilib> g_gui;
 
+// g_hostprobeinterval (const)
+//
+// Interval at which hosts that have been marked as unavailable are probed
+static std::chrono::seconds const g_hostprobeinterval(30);
+
+// g_livestreamchannel
+//
+// Channel identifier of the current live stream
+static unsigned int g_livestreamchannel = 0;
+
+// g_lowmemory_cachesize (const)
+//
+// Page cache size for each database connection in the low-memory profile, in KiB
+static int const g_lowmemory_cachesize = 512;
+
+// g_lowmemory_heaplimit (const)
+//
+// Soft limit on the SQLite heap in the low-memory profile, in bytes
+static long long const g_lowmemory_heaplimit = (8LL MiB);
+
+// g_lowmemory_maxbuffersize (const)
+//
+// Maximum automatically sized stream ring buffer in the low-memory profile, in bytes
+static long long const g_lowmemory_maxbuffersize = (4LL MiB);
+
+// g_lowmemory_poolsize (const)
+//
+// Maximum number of database connections in the low-memory profile
+static size_t const g_lowmemory_poolsize = 4;
+
+// g_lowmemory_warmcount (const)
+//
+// Number of database connections opened when the connection pool is created in the low-memory profile
+static size_t const g_lowmemory_warmcount = 2;
+
+// g_prebuffered
+//
+// Streams that have been pre-buffered for the channels adjacent to the live channel
+static std::map<unsigned int, struct prebuffered_stream> g_prebuffered;
+
+// g_prebuffered_lock
+//
+// Synchronization object to serialize access to the pre-buffered streams
+static std::mutex g_prebuffered_lock;
+
+// g_prebufferlifetime (const)
+//
+// Amount of time a pre-buffered stream is retained before it's closed
+static std::chrono::seconds const g_prebufferlifetime(30);
+
+// g_prebufferscheduler
+//
+// Task scheduler for the channel pre-buffering tasks; never paused during streaming
+static scheduler g_prebufferscheduler([](std::exception const& ex) -> void { handle_stdexception("pre-buffer task", ex); }, 1);
+
+// g_prebuffertarget
+//
+// Channel identifier of the live channel to pre-buffer the adjacent channels of
+static std::atomic<unsigned int> g_prebuffertarget{0};
+
 // g_pvr
 //
 // Kodi PVR add-on callbacks
 static std::unique_ptr<CHelper_libXBMC_pvr> g_pvr;
 
+// g_recordings
+//
+// Immutable snapshot of the recordings reported to Kodi; replaced rather than modified
+static std::shared_ptr<std::vector<PVR_RECORDING> const> g_recordings;
+
+// g_recordings_generation
+//
+// Generation of the recordings snapshot; incremented whenever the snapshot is invalidated
+static unsigned long long g_recordings_generation = 0;
+
+// g_recordings_lock
+//
+// Synchronization object to serialize access to the recordings snapshot
+static std::mutex g_recordings_lock;
+
+// g_ringbufferduration (const)
+//
+// Amount of stream time an automatically sized ring buffer should be able to hold
+static std::chrono::seconds const g_ringbufferduration(4);
+
+// g_ringbufferlifetime (const)
+//
+// Amount of time a released ring buffer is retained for reuse by the next stream
+static std::chrono::seconds const g_ringbufferlifetime(10);
+
 // g_scheduler
 //
 // Task scheduler
@@ -346,11 +583,21 @@ static addon_settings g_settings = {
 	false,					// use_direct_tuning
 	3,						// startup_discovery_task_delay
 	(4 KiB),				// stream_read_chunk_size
-	(1 MiB),				// stream_ring_buffer_size
+	0,						// stream_ring_buffer_size				default = automatic
+	false,					// enable_live_timeshift
+	"",						// timeshift_buffer_folder
+	(512LL MiB),			// timeshift_buffer_size
 	false,					// enable_recording_edl
 	"",						// recording_edl_folder
 	0,						// recording_edl_start_padding
 	0,						// recording_edl_end_padding
+	0,						// metrics_log_interval					default = never
+	false,					// enable_channel_prebuffering
+	0,						// recording_readahead_size				default = disabled
+	false,					// enable_low_memory_profile
+	120,					// http_request_timeout					default = 2 minutes
+	30,						// http_lowspeed_timeout				default = 30 seconds
+	8,						// http_request_concurrency
 };
 
 // g_settings_lock
@@ -358,6 +605,16 @@ static addon_settings g_settings = {
 // Synchronization object to serialize access to addon settings
 static std::mutex g_settings_lock;
 
+// g_startuptime
+//
+// Time at which the add-on was started
+static std::chrono::steady_clock::time_point g_startuptime;
+
+// g_taskjitter (const)
+//
+// Percentage to randomly adjust the periodic discovery task intervals by
+static unsigned int const g_taskjitter = 10;
+
 // g_timertypes (const)
 //
 // Array of PVR_TIMER_TYPE structures to pass to Kodi
@@ -514,6 +771,16 @@ static const PVR_TIMER_TYPE g_timertypes[] ={
 	},
 };
 
+// g_tuners
+//
+// Tuner device registry
+static tunerregistry g_tuners;
+
+// g_userpath
+//
+// Addon user data folder
+static std::string g_userpath;
+
 //---------------------------------------------------------------------------
 // HELPER FUNCTIONS
 //---------------------------------------------------------------------------
@@ -563,12 +830,34 @@ static int delete_expired_enum_to_seconds(int nvalue)
 	return -1;						// Never = default
 }
 
+// discard_prebuffered_streams
+//
+// Closes and releases all of the pre-buffered streams
+static void discard_prebuffered_streams(void)
+{
+	std::map<unsigned int, struct prebuffered_stream> discarded;
+
+	// Swap the streams out of the collection so they aren't closed while the lock is held
+	{
+		std::unique_lock<std::mutex> lock(g_prebuffered_lock);
+		discarded.swap(g_prebuffered);
+	}
+
+	for(auto const& iterator : discarded) {
+
+		try { if(iterator.second.stream) iterator.second.stream->close(); }
+		catch(...) {}
+	}
+}
+
 // discover_devices_task
 //
 // Scheduled task implementation to discover the HDHomeRun devices
-static void discover_devices_task(scalar_condition<bool> const& cancel)
+static void discover_devices_task(scalar_condition<bool> const& /*cancel*/)
 {
 	bool		changed = false;			// Flag if the discovery data changed
+	bool		failed = false;				// Flag if the discovery failed
+	metric_timer	timer(__func__);					// Task execution time metric
 
 	assert(g_addon && g_pvr);
 	log_notice(__func__, ": initiated local network device discovery");
@@ -578,37 +867,38 @@ static void discover_devices_task(scalar_condition<bool> const& cancel)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// Discover the devices on the local network and check for changes
 		discover_devices(dbhandle, settings.use_broadcast_device_discovery, changed);
 
+		// Refresh the tuner registry with the tuners available from the discovered devices
+		std::vector<std::string> tuners;
+		enumerate_tuners(dbhandle, [&](char const* tuner) -> void { tuners.emplace_back(tuner); });
+		g_tuners.refresh(tuners);
+
 		if(changed) {
 
-			// Execute a lineup discovery now; task will reschedule itself
+			std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
+
+			// Schedule a lineup discovery now; the scheduler will execute it in parallel with the recording
+			// discovery, but not while another instance of it is running. Task will reschedule itself
 			log_notice(__func__, ": device discovery data changed -- execute lineup discovery now");
-			g_scheduler.remove(discover_lineups_task);
-			discover_lineups_task(cancel);
+			g_scheduler.add(now, discover_lineups_task);
 
-			// Execute a recording discovery now; task will reschedule itself
+			// Schedule a recording discovery now; task will reschedule itself
 			log_notice(__func__, ": device discovery data changed -- execute recording discovery now");
-			g_scheduler.remove(discover_recordings_task);
-			discover_recordings_task(cancel);
+			g_scheduler.add(now, discover_recordings_task);
 		}
-
-		// Re-enable access to the EPG if it had been disabled due to multiple failure(s) accessing
-		// a channel EPG.  The idea here is to prevent unauthorized clients from slamming the backend
-		// services for no reason -- see the GetEPGForChannel() function.
-		g_epgenabled = true;
 	}
 
-	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-	catch(...) { handle_generalexception(__func__); }
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); failed = true; }
+	catch(...) { handle_generalexception(__func__); failed = true; }
 
-	// Schedule the next periodic invocation of this discovery task
-	log_notice(__func__, ": scheduling next device discovery to initiate in ", settings.discover_devices_interval, " seconds");
-	g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.discover_devices_interval), discover_devices_task);
+	// Schedule the next periodic invocation of this discovery task; failures are retried with a backoff
+	auto delay = g_scheduler.reschedule(discover_devices_task, std::chrono::seconds(settings.discover_devices_interval), failed, g_taskjitter);
+	log_notice(__func__, ": scheduling next device discovery to initiate in ", delay.count(), " seconds");
 }
 
 // discover_episodes_task
@@ -617,6 +907,8 @@ static void discover_devices_task(scalar_condition<bool> const& cancel)
 static void discover_episodes_task(scalar_condition<bool> const& /*cancel*/)
 {
 	bool		changed = false;			// Flag if the discovery data changed
+	bool		failed = false;				// Flag if the discovery failed
+	metric_timer	timer(__func__);					// Task execution time metric
 
 	assert(g_addon && g_pvr);
 	log_notice(__func__, ": initiated recording rule episode discovery");
@@ -626,8 +918,8 @@ static void discover_episodes_task(scalar_condition<bool> const& /*cancel*/)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// Discover the episode data from the backend service
 		discover_episodes(dbhandle, changed);
@@ -640,12 +932,12 @@ static void discover_episodes_task(scalar_condition<bool> const& /*cancel*/)
 		}
 	}
 
-	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-	catch(...) { handle_generalexception(__func__); }
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); failed = true; }
+	catch(...) { handle_generalexception(__func__); failed = true; }
 
-	// Schedule the next periodic invocation of this discovery task
-	log_notice(__func__, ": scheduling next recording rule episode discovery to initiate in ", settings.discover_episodes_interval, " seconds");
-	g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.discover_episodes_interval), discover_episodes_task);
+	// Schedule the next periodic invocation of this discovery task; failures are retried with a backoff
+	auto delay = g_scheduler.reschedule(discover_episodes_task, std::chrono::seconds(settings.discover_episodes_interval), failed, g_taskjitter);
+	log_notice(__func__, ": scheduling next recording rule episode discovery to initiate in ", delay.count(), " seconds");
 }
 
 // discover_guide_task
@@ -654,6 +946,8 @@ static void discover_episodes_task(scalar_condition<bool> const& /*cancel*/)
 static void discover_guide_task(scalar_condition<bool> const& /*cancel*/)
 {
 	bool		changed = false;			// Flag if the discovery data changed
+	bool		failed = false;				// Flag if the discovery failed
+	metric_timer	timer(__func__);					// Task execution time metric
 
 	assert(g_addon && g_pvr);
 	log_notice(__func__, ": initiated guide discovery");
@@ -663,8 +957,8 @@ static void discover_guide_task(scalar_condition<bool> const& /*cancel*/)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// Discover the updated electronic program guide data from the backend service
 		discover_guide(dbhandle, changed);
@@ -675,14 +969,21 @@ static void discover_guide_task(scalar_condition<bool> const& /*cancel*/)
 			log_notice(__func__, ": guide channel discovery data changed -- trigger channel update");
 			g_pvr->TriggerChannelUpdate();
 		}
+
+		// Load any new or changed guide entries for the EPG time frame into the local store; Kodi only
+		// needs to be told to refresh the EPG for the channels that actually changed
+		discover_guideentries(dbhandle, g_epgmaxtime, [&](union channelid const& channelid) -> void {
+
+			g_pvr->TriggerEpgUpdate(channelid.value);
+		});
 	}
 
-	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-	catch(...) { handle_generalexception(__func__); }
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); failed = true; }
+	catch(...) { handle_generalexception(__func__); failed = true; }
 
-	// Schedule the next periodic invocation of this discovery task
-	log_notice(__func__, ": scheduling next guide discovery to initiate in ", settings.discover_guide_interval, " seconds");
-	g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.discover_guide_interval), discover_guide_task);
+	// Schedule the next periodic invocation of this discovery task; failures are retried with a backoff
+	auto delay = g_scheduler.reschedule(discover_guide_task, std::chrono::seconds(settings.discover_guide_interval), failed, g_taskjitter);
+	log_notice(__func__, ": scheduling next guide discovery to initiate in ", delay.count(), " seconds");
 }
 
 // discover_lineups_task
@@ -691,6 +992,8 @@ static void discover_guide_task(scalar_condition<bool> const& /*cancel*/)
 static void discover_lineups_task(scalar_condition<bool> const& /*cancel*/)
 {
 	bool		changed = false;			// Flag if the discovery data changed
+	bool		failed = false;				// Flag if the discovery failed
+	metric_timer	timer(__func__);					// Task execution time metric
 
 	assert(g_addon && g_pvr);
 	log_notice(__func__, ": initiated local tuner device lineup discovery");
@@ -700,8 +1003,8 @@ static void discover_lineups_task(scalar_condition<bool> const& /*cancel*/)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// Discover the channel lineups for all available tuner devices
 		discover_lineups(dbhandle, changed);
@@ -722,20 +1025,22 @@ static void discover_lineups_task(scalar_condition<bool> const& /*cancel*/)
 		}
 	}
 
-	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-	catch(...) { handle_generalexception(__func__); }
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); failed = true; }
+	catch(...) { handle_generalexception(__func__); failed = true; }
 
-	// Schedule the next periodic invocation of this discovery task
-	log_notice(__func__, ": scheduling next lineup discovery to initiate in ", settings.discover_lineups_interval, " seconds");
-	g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.discover_lineups_interval), discover_lineups_task);
+	// Schedule the next periodic invocation of this discovery task; failures are retried with a backoff
+	auto delay = g_scheduler.reschedule(discover_lineups_task, std::chrono::seconds(settings.discover_lineups_interval), failed, g_taskjitter);
+	log_notice(__func__, ": scheduling next lineup discovery to initiate in ", delay.count(), " seconds");
 }
 
 // discover_recordingrules_task
 //
 // Scheduled task implementation to discover the recording rules and timers
-static void discover_recordingrules_task(scalar_condition<bool> const& cancel)
+static void discover_recordingrules_task(scalar_condition<bool> const& /*cancel*/)
 {
 	bool		changed = false;			// Flag if the discovery data changed
+	bool		failed = false;				// Flag if the discovery failed
+	metric_timer	timer(__func__);					// Task execution time metric
 
 	assert(g_addon && g_pvr);
 	log_notice(__func__, ": initiated recording rule discovery");
@@ -745,8 +1050,8 @@ static void discover_recordingrules_task(scalar_condition<bool> const& cancel)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// Discover the recording rules from the backend service
 		discover_recordingrules(dbhandle, changed);
@@ -774,17 +1079,16 @@ static void discover_recordingrules_task(scalar_condition<bool> const& cancel)
 
 			// Execute a recording rule episode discovery now; task will reschedule itself
 			log_notice(__func__, ": device discovery data changed -- execute recording rule episode discovery now");
-			g_scheduler.remove(discover_episodes_task);
-			discover_episodes_task(cancel);
+			g_scheduler.add(std::chrono::system_clock::now(), discover_episodes_task);
 		}
 	}
 
-	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-	catch(...) { handle_generalexception(__func__); }
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); failed = true; }
+	catch(...) { handle_generalexception(__func__); failed = true; }
 
-	// Schedule the next periodic invocation of this discovery task
-	log_notice(__func__, ": scheduling next recording rule discovery to initiate in ", settings.discover_recordingrules_interval, " seconds");
-	g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.discover_recordingrules_interval), discover_recordingrules_task);
+	// Schedule the next periodic invocation of this discovery task; failures are retried with a backoff
+	auto delay = g_scheduler.reschedule(discover_recordingrules_task, std::chrono::seconds(settings.discover_recordingrules_interval), failed, g_taskjitter);
+	log_notice(__func__, ": scheduling next recording rule discovery to initiate in ", delay.count(), " seconds");
 }
 
 // discover_recordings_task
@@ -793,6 +1097,8 @@ static void discover_recordingrules_task(scalar_condition<bool> const& cancel)
 static void discover_recordings_task(scalar_condition<bool> const& /*cancel*/)
 {
 	bool		changed = false;			// Flag if the discovery data changed
+	bool		failed = false;				// Flag if the discovery failed
+	metric_timer	timer(__func__);					// Task execution time metric
 
 	assert(g_addon && g_pvr);
 	log_notice(__func__, ": initiated local storage device recording discovery");
@@ -802,38 +1108,42 @@ static void discover_recordings_task(scalar_condition<bool> const& /*cancel*/)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// Discover the recordings for all available local storage devices
 		discover_recordings(dbhandle, changed);
 		
 		if(changed) {
 
+			// Regenerate the recordings snapshot before Kodi asks for it
+			refresh_recordings_snapshot(dbhandle, settings);
+
+			// Read ahead the edit decision lists for the new or changed recordings
+			if(settings.enable_recording_edl) g_scheduler.add(std::chrono::system_clock::now(), index_edl_task);
+
 			// Trigger a recordings update
 			log_notice(__func__, ": recording discovery data changed -- trigger recording update");
 			g_pvr->TriggerRecordingUpdate();
 		}
 	}
 
-	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-	catch(...) { handle_generalexception(__func__); }
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); failed = true; }
+	catch(...) { handle_generalexception(__func__); failed = true; }
 
-	// Schedule the next periodic invocation of this discovery task
-	log_notice(__func__, ": scheduling next recording discovery to initiate in ", settings.discover_recordings_interval, " seconds");
-	g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.discover_recordings_interval), discover_recordings_task);
+	// Schedule the next periodic invocation of this discovery task; failures are retried with a backoff
+	auto delay = g_scheduler.reschedule(discover_recordings_task, std::chrono::seconds(settings.discover_recordings_interval), failed, g_taskjitter);
+	log_notice(__func__, ": scheduling next recording discovery to initiate in ", delay.count(), " seconds");
 }
 
 // discover_startup_task
 //
-// Scheduled task implementation to discover all data during PVR startup
+// Scheduled task implementation to discover all data during PVR startup; the discoveries are executed
+// in parallel where their dependencies allow it and each PVR trigger is fired as soon as possible
 static void discover_startup_task(scalar_condition<bool> const& /*cancel*/)
 {
-	bool				lineups_changed = false;			// Flag if lineups have changed
-	bool				recordings_changed = false;			// Flag if recordings have changed
-	bool				guide_changed = false;				// Flag if guide data has changed
-	bool				recordingrules_changed = false;		// Flag if recording rules have changed
-	bool				episodes_changed = false;			// Flag if episode data has changed
+	char const*			function = __func__;				// Function name for the discovery stages
+	metric_timer		timer(__func__);					// Task execution time metric
 
 	assert(g_addon && g_pvr);
 	log_notice(__func__, ": initiated startup discovery task");
@@ -841,100 +1151,228 @@ static void discover_startup_task(scalar_condition<bool> const& /*cancel*/)
 	// Create a copy of the current addon settings structure
 	struct addon_settings settings = copy_settings();
 
-	try {
+	// Executes a single discovery stage against its own database connection -- failures here are not
+	// fatal and will just be logged rather than aborting the discovery stages that depend on it
+	auto execute_stage = [&](std::function<void(sqlite3*)> const& stage) -> void {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		try { connectionpool::writehandle dbhandle(g_connpool); stage(dbhandle); }
+		catch(std::exception& ex) { handle_stdexception(function, ex); }
+		catch(...) { handle_generalexception(function); }
+	};
 
-		// Discover all of the local device and backend service data -- failures here are not
-		// fatal and will just be logged rather than aborting all of the discovery tasks
+	try {
 
 		// DISCOVER: Devices
-		try { discover_devices(dbhandle, settings.use_broadcast_device_discovery); }
-		catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-		catch(...) { handle_generalexception(__func__); }
+		//
+		// All of the other discoveries depend on the set of devices, this has to be executed first
+		execute_stage([&](sqlite3* instance) -> void { discover_devices(instance, settings.use_broadcast_device_discovery); });
+
+		// REFRESH: Tuners
+		execute_stage([&](sqlite3* instance) -> void {
+
+			std::vector<std::string> tuners;
+			enumerate_tuners(instance, [&](char const* tuner) -> void { tuners.emplace_back(tuner); });
+			g_tuners.refresh(tuners);
+		});
 
 		// DISCOVER: Lineups
-		try { discover_lineups(dbhandle, lineups_changed); }
-		catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-		catch(...) { handle_generalexception(__func__); }
+		auto lineups = std::async(std::launch::async, execute_stage, [&](sqlite3* instance) -> void {
 
-		// DISCOVER: Recordings
-		try { discover_recordings(dbhandle, recordings_changed); }
-		catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-		catch(...) { handle_generalexception(__func__); }
+			bool changed = false;
+			discover_lineups(instance, changed);
+
+			// TRIGGER: Channels, Channel Groups
+			if(changed) {
+
+				log_notice(function, ": lineup discovery data changed -- trigger channel and channel group update");
+				g_pvr->TriggerChannelUpdate();
+				g_pvr->TriggerChannelGroupsUpdate();
+			}
+		});
 
 		// DISCOVER: Guide Metadata
-		try { discover_guide(dbhandle, guide_changed); }
-		catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-		catch(...) { handle_generalexception(__func__); }
+		auto guide = std::async(std::launch::async, execute_stage, [&](sqlite3* instance) -> void {
 
-		// DISCOVER: Recording Rules
-		try { discover_recordingrules(dbhandle, recordingrules_changed); }
-		catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-		catch(...) { handle_generalexception(__func__); }
+			bool changed = false;
+			discover_guide(instance, changed);
 
-		// DISCOVER: Episodes
-		try { discover_episodes(dbhandle, episodes_changed); }
-		catch(std::exception& ex) { handle_stdexception(__func__, ex); }
-		catch(...) { handle_generalexception(__func__); }
+			// TRIGGER: Channels
+			if(changed) {
 
-		// Execute any necessary triggers based on what discovery data has changed
+				log_notice(function, ": guide discovery data changed -- trigger channel update");
+				g_pvr->TriggerChannelUpdate();
+			}
+		});
 
-		// TRIGGER: Channels
-		if(lineups_changed || guide_changed) {
-			
-			log_notice(__func__, ": discovery data changed -- trigger channel update");
-			g_pvr->TriggerChannelUpdate();
-		}
+		// DISCOVER: Recordings
+		auto recordings = std::async(std::launch::async, execute_stage, [&](sqlite3* instance) -> void {
 
-		// TRIGGER: Channel Groups
-		if(lineups_changed) {
-			
-			log_notice(__func__, ": discovery data changed -- trigger channel group update");
-			g_pvr->TriggerChannelGroupsUpdate();
-		}
+			bool changed = false;
+			discover_recordings(instance, changed);
 
-		// TRIGGER: Recordings
-		if(recordings_changed) {
-			
-			log_notice(__func__, ": discovery data changed -- trigger recording update");
-			g_pvr->TriggerRecordingUpdate();
-		}
+			// TRIGGER: Recordings
+			if(changed) {
+
+				refresh_recordings_snapshot(instance, settings);
+				log_notice(function, ": recording discovery data changed -- trigger recording update");
+				g_pvr->TriggerRecordingUpdate();
+			}
+		});
+
+		// DISCOVER: Recording Rules, Episodes
+		//
+		// The episodes are discovered for each of the recording rules, this has to follow that discovery
+		auto timers = std::async(std::launch::async, execute_stage, [&](sqlite3* instance) -> void {
+
+			bool recordingrules_changed = false;
+			bool episodes_changed = false;
+
+			try { discover_recordingrules(instance, recordingrules_changed); }
+			catch(std::exception& ex) { handle_stdexception(function, ex); }
+			catch(...) { handle_generalexception(function); }
+
+			discover_episodes(instance, episodes_changed);
+
+			// TRIGGER: Timers
+			if(recordingrules_changed || episodes_changed) {
+
+				log_notice(function, ": recording rule discovery data changed -- trigger timer update");
+				g_pvr->TriggerTimerUpdate();
+			}
+		});
 
-		// TRIGGER: Timers
-		if(recordingrules_changed || episodes_changed) {
+		// DISCOVER: Guide Entries
+		//
+		// This can take considerably longer than the other discoveries on an empty database and requires the
+		// channel lineups and guide metadata; execute it once those are complete without waiting on the others
+		lineups.wait();
+		guide.wait();
+
+		execute_stage([&](sqlite3* instance) -> void {
 			
-			log_notice(__func__, ": discovery data changed -- trigger timer update");
-			g_pvr->TriggerTimerUpdate();
-		}
+			discover_guideentries(instance, g_epgmaxtime, [&](union channelid const& channelid) -> void { g_pvr->TriggerEpgUpdate(channelid.value); }); 
+		});
+
+		recordings.wait();
+		timers.wait();
+
+		// Schedule the standard periodic updates to occur at the specified intervals, the jitter applied
+		// to the intervals prevents all of the discovery tasks from coming due at the same time
+		std::chrono::seconds delay;
+
+		delay = g_scheduler.reschedule(discover_devices_task, std::chrono::seconds(settings.discover_devices_interval), false, g_taskjitter);
+		log_notice(__func__, ": scheduling periodic device discovery to initiate in ", delay.count(), " seconds");
 
-		// Schedule the standard periodic updates to occur at the specified intervals
-		std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
+		delay = g_scheduler.reschedule(discover_lineups_task, std::chrono::seconds(settings.discover_lineups_interval), false, g_taskjitter);
+		log_notice(__func__, ": scheduling periodic lineup discovery to initiate in ", delay.count(), " seconds");
 
-		log_notice(__func__, ": scheduling periodic device discovery to initiate in ", settings.discover_devices_interval, " seconds");
-		g_scheduler.add(now + std::chrono::seconds(settings.discover_devices_interval), discover_devices_task);
+		delay = g_scheduler.reschedule(discover_recordings_task, std::chrono::seconds(settings.discover_recordings_interval), false, g_taskjitter);
+		log_notice(__func__, ": scheduling periodic recording discovery to initiate in ", delay.count(), " seconds");
 
-		log_notice(__func__, ": scheduling periodic lineup discovery to initiate in ", settings.discover_lineups_interval, " seconds");
-		g_scheduler.add(now + std::chrono::seconds(settings.discover_lineups_interval), discover_lineups_task);
+		delay = g_scheduler.reschedule(discover_guide_task, std::chrono::seconds(settings.discover_guide_interval), false, g_taskjitter);
+		log_notice(__func__, ": scheduling periodic guide discovery to initiate in ", delay.count(), " seconds");
 
-		log_notice(__func__, ": scheduling periodic recording discovery to initiate in ", settings.discover_recordings_interval, " seconds");
-		g_scheduler.add(now + std::chrono::seconds(settings.discover_recordings_interval), discover_recordings_task);
+		delay = g_scheduler.reschedule(discover_recordingrules_task, std::chrono::seconds(settings.discover_recordingrules_interval), false, g_taskjitter);
+		log_notice(__func__, ": scheduling periodic recording rule discovery to initiate in ", delay.count(), " seconds");
 
-		log_notice(__func__, ": scheduling periodic guide discovery to initiate in ", settings.discover_guide_interval, " seconds");
-		g_scheduler.add(now + std::chrono::seconds(settings.discover_guide_interval), discover_guide_task);
+		delay = g_scheduler.reschedule(discover_episodes_task, std::chrono::seconds(settings.discover_episodes_interval), false, g_taskjitter);
+		log_notice(__func__, ": scheduling periodic recording rule episode discovery to initiate in ", delay.count(), " seconds");
 
-		log_notice(__func__, ": scheduling periodic recording rule discovery to initiate in ", settings.discover_recordingrules_interval, " seconds");
-		g_scheduler.add(now + std::chrono::seconds(settings.discover_recordingrules_interval), discover_recordingrules_task);
+		// Schedule the periodic performance metrics log task if it has been enabled
+		if(settings.metrics_log_interval > 0) {
 
-		log_notice(__func__, ": scheduling periodic recording rule episode discovery to initiate in ", settings.discover_episodes_interval, " seconds");
-		g_scheduler.add(now + std::chrono::seconds(settings.discover_episodes_interval), discover_episodes_task);	
+			g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.metrics_log_interval), log_metrics_task);
+			log_notice(__func__, ": scheduling periodic performance metrics log to initiate in ", settings.metrics_log_interval, " seconds");
+		}
+
+		// Read ahead the edit decision lists for all of the recordings if they have been enabled
+		if(settings.enable_recording_edl) g_scheduler.add(std::chrono::system_clock::now(), index_edl_task);
+
+		// Schedule the periodic probe of any hosts that have been marked as unavailable
+		g_scheduler.add(std::chrono::system_clock::now() + g_hostprobeinterval, probe_hosts_task);
 	}
 
 	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
 	catch(...) { handle_generalexception(__func__); }
 }
 
+// enqueue_recording_lastposition
+//
+// Queues the local database write of the last played position of a recording to the database writer;
+// the position must have already been sent to the storage device
+static void enqueue_recording_lastposition(char const* recordingid, int lastposition)
+{
+	if(recordingid == nullptr) throw std::invalid_argument("recordingid");
+
+	// Repeated position updates for the same recording are coalesced by the writer, only the last one is applied
+	std::string id(recordingid);
+	std::string key = "recording_lastposition:" + id;
+
+	g_connpool->enqueue(key.c_str(), [=](sqlite3* instance) -> void {
+
+		try {
+
+			store_recording_lastposition(instance, id.c_str(), lastposition);
+			invalidate_recordings_snapshot();
+		}
+
+		catch(std::exception& ex) { handle_stdexception("enqueue_recording_lastposition", ex); }
+		catch(...) { handle_generalexception("enqueue_recording_lastposition"); }
+	});
+}
+
+// expire_prebuffered_task
+//
+// Scheduled task implementation to close pre-buffered streams that have expired
+static void expire_prebuffered_task(scalar_condition<bool> const& /*cancel*/)
+{
+	std::vector<std::unique_ptr<dvrstream>>	expired;		// Expired streams
+	bool									remaining;		// Flag if streams remain
+
+	{
+		std::unique_lock<std::mutex> lock(g_prebuffered_lock);
+
+		// Streams that were promoted to the live stream are left behind as empty entries
+		auto now = std::chrono::steady_clock::now();
+		for(auto iterator = g_prebuffered.begin(); iterator != g_prebuffered.end();) {
+
+			if((iterator->second.stream) && ((now - iterator->second.created) < g_prebufferlifetime)) { ++iterator; continue; }
+
+			if(iterator->second.stream) expired.push_back(std::move(iterator->second.stream));
+			iterator = g_prebuffered.erase(iterator);
+		}
+
+		remaining = !g_prebuffered.empty();
+	}
+
+	if(!expired.empty()) log_notice(__func__, ": closing ", expired.size(), " unused pre-buffered stream(s)");
+	for(auto const& iterator : expired) { try { iterator->close(); } catch(...) {} }
+
+	// The ring buffer of an expired stream may have been returned to the pool, release it after a while
+	if(!expired.empty()) {
+
+		expired.clear();
+		g_scheduler.remove(trim_buffers_task);
+		g_scheduler.add(std::chrono::system_clock::now() + g_ringbufferlifetime, trim_buffers_task);
+	}
+
+	// Check again later if there are still streams that have not expired yet
+	if(remaining) g_prebufferscheduler.add(std::chrono::system_clock::now() + g_prebufferlifetime, expire_prebuffered_task);
+}
+
+// get_recordings_snapshot
+//
+// Gets the current recordings snapshot, generating a new one if it has been invalidated
+static std::shared_ptr<std::vector<PVR_RECORDING> const> get_recordings_snapshot(void)
+{
+	{
+		std::unique_lock<std::mutex> lock(g_recordings_lock);
+		if(g_recordings) return g_recordings;
+	}
+
+	return refresh_recordings_snapshot(connectionpool::handle(g_connpool), copy_settings());
+}
+
 // handle_generalexception
 //
 // Handler for thrown generic exceptions
@@ -971,33 +1409,136 @@ static _result handle_stdexception(char const* function, std::exception const& e
 	return result;
 }
 
-// interval_enum_to_seconds
+// index_edl_task
 //
-// Converts the discovery interval enumeration values into a number of seconds
-static int interval_enum_to_seconds(int nvalue)
-{	
-	switch(nvalue) {
+// Scheduled task implementation to read ahead the edit decision lists of all recordings
+static void index_edl_task(scalar_condition<bool> const& cancel)
+{
+	std::map<std::string, struct edl_index_entry>	index;		// Regenerated index
+	std::map<std::string, struct edl_index_entry>	existing;	// Existing index
+	size_t											files = 0;	// Number of files read
+	metric_timer									timer(__func__);	// Task execution time metric
 
-		case 0: return 300;			// 5 minutes
-		case 1: return 600;			// 10 minutes
-		case 2: return 900;			// 15 minutes
-		case 3: return 1800;		// 30 minutes
-		case 4: return 2700;		// 45 minutes
-		case 5: return 3600;		// 1 hour
-		case 6: return 7200;		// 2 hours
-		case 7: return 14400;		// 4 hours
-		
-		// 30 seconds and 1 minute were added after the fact, for compatibility
-		// with existing settings they were put at the end.  Local network
-		// discoveries can be executed more quickly if the user prefers that
+	// Create a copy of the current addon settings structure
+	struct addon_settings settings = copy_settings();
 
-		case 8: return 30;			// 30 seconds
-		case 9: return 60;			// 1 minute
-	};
+	// If EDL has been disabled, just discard the existing index
+	if(!settings.enable_recording_edl) {
 
-	return 600;						// 10 minutes = default
-}
-	
+		std::unique_lock<std::mutex> lock(g_edlindex_lock);
+		g_edlindex.clear();
+		return;
+	}
+
+	try {
+
+		// Verify that the specified directory for the EDL files exists
+		if(!g_addon->DirectoryExists(settings.recording_edl_folder.c_str()))
+			throw string_exception(std::string("specified edit decision list file directory '") + settings.recording_edl_folder + "' cannot be accessed");
+
+		// The entries for files that haven't changed are carried over from the existing index
+		{
+			std::unique_lock<std::mutex> lock(g_edlindex_lock);
+			existing = g_edlindex;
+		}
+
+		// Pull a database connection out from the connection pool
+		connectionpool::handle dbhandle(g_connpool);
+
+		// Check the .EDL file for every recording in the current recordings snapshot
+		std::shared_ptr<std::vector<PVR_RECORDING> const> recordings = get_recordings_snapshot();
+		for(auto const& recording : *recordings) {
+
+			if(cancel.test(true)) return;
+
+			// Generate the base file name for the recording by combining the folder with the recording metadata
+			std::string basename = get_recording_filename(dbhandle, recording.strRecordingId);
+			if(basename.length() == 0) continue;
+
+			struct edl_index_entry entry;
+			entry.folder = settings.recording_edl_folder;
+			entry.filename = settings.recording_edl_folder + basename + ".edl";
+			entry.size = entry.mtime = 0;
+			entry.exists = stat_edl_file(entry.filename.c_str(), entry.size, entry.mtime);
+
+			// Reuse the existing entries if the file has the same name, size and modification time; otherwise read it
+			auto found = existing.find(recording.strRecordingId);
+			if((entry.exists) && (found != existing.end()) && (found->second.exists) && (found->second.filename == entry.filename) &&
+				(found->second.size == entry.size) && (found->second.mtime == entry.mtime)) entry.entries = std::move(found->second.entries);
+
+			else if(entry.exists) { read_edl_file(entry.filename.c_str(), entry.entries); ++files; }
+
+			index.emplace(recording.strRecordingId, std::move(entry));
+		}
+
+		// Replace the existing index with the regenerated one
+		{
+			std::unique_lock<std::mutex> lock(g_edlindex_lock);
+			g_edlindex.swap(index);
+		}
+
+		log_notice(__func__, ": indexed edit decision lists for ", recordings->size(), " recordings (", files, " file(s) read)");
+	}
+
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
+	catch(...) { handle_generalexception(__func__); }
+}
+
+// httptimeout_enum_to_seconds
+//
+// Converts the HTTP request timeout enumeration values into a number of seconds
+static int httptimeout_enum_to_seconds(int nvalue)
+{
+	switch(nvalue) {
+
+		case 0: return 0;			// None
+		case 1: return 30;			// 30 seconds
+		case 2: return 60;			// 1 minute
+		case 3: return 120;			// 2 minutes
+		case 4: return 300;			// 5 minutes
+	};
+
+	return 120;						// 2 minutes = default
+}
+
+// interval_enum_to_seconds
+//
+// Converts the discovery interval enumeration values into a number of seconds
+static int interval_enum_to_seconds(int nvalue)
+{	
+	switch(nvalue) {
+
+		case 0: return 300;			// 5 minutes
+		case 1: return 600;			// 10 minutes
+		case 2: return 900;			// 15 minutes
+		case 3: return 1800;		// 30 minutes
+		case 4: return 2700;		// 45 minutes
+		case 5: return 3600;		// 1 hour
+		case 6: return 7200;		// 2 hours
+		case 7: return 14400;		// 4 hours
+		
+		// 30 seconds and 1 minute were added after the fact, for compatibility
+		// with existing settings they were put at the end.  Local network
+		// discoveries can be executed more quickly if the user prefers that
+
+		case 8: return 30;			// 30 seconds
+		case 9: return 60;			// 1 minute
+	};
+
+	return 600;						// 10 minutes = default
+}
+
+// invalidate_recordings_snapshot
+//
+// Discards the current recordings snapshot; the next request will generate a new one
+static void invalidate_recordings_snapshot(void)
+{
+	std::unique_lock<std::mutex> lock(g_recordings_lock);
+
+	++g_recordings_generation;
+	g_recordings.reset();
+}
+	
 // log_debug
 //
 // Variadic method of writing a LOG_DEBUG entry into the Kodi application log
@@ -1061,6 +1602,126 @@ static void log_notice(_args&&... args)
 	log_message(ADDON::addon_log_t::LOG_NOTICE, std::forward<_args>(args)...);
 }
 
+// log_memory_usage
+//
+// Writes the memory usage attributable to each subsystem into the Kodi application log
+static void log_memory_usage(char const* function)
+{
+	long long rsspeak = 0;				// Peak resident set size of the process, in KiB
+
+#if !defined(TARGET_WINDOWS) && !defined(TARGET_WINDOWS_STORE)
+	struct rusage usage = {};
+	if(getrusage(RUSAGE_SELF, &usage) == 0) rsspeak = usage.ru_maxrss;
+#ifdef __APPLE__
+	rsspeak /= 1024;					// ru_maxrss is reported in bytes rather than KiB
+#endif
+#endif
+
+	// The SQLite heap includes the page caches, prepared statements and HTTP response buffers
+	long long sqliteused = sqlite3_memory_used();
+	long long sqlitepeak = sqlite3_memory_highwater(0);
+
+	// Memory-mapped timeshift buffers are backed by a file rather than the heap and are not included
+	struct dvrstream::memoryusage buffers = dvrstream::memory();
+
+	log_notice(function, ": memory usage: process peak rss = ", rsspeak, " KiB, sqlite = ", sqliteused / 1024, " KiB (peak ", sqlitepeak / 1024, 
+		" KiB), stream buffers = ", buffers.allocated / 1024, " KiB (peak ", buffers.peak / 1024, " KiB, pooled ", buffers.pooled / 1024, " KiB)");
+}
+
+// log_stream_statistics
+//
+// Writes the performance statistics of a closed stream into the Kodi application log
+static void log_stream_statistics(char const* function, dvrstream const& stream)
+{
+	struct dvrstream::statistics stats = stream.stats();
+
+	// Calculate the average throughput of the stream in KiB per second
+	long long kibps = (stats.elapsed.count() > 0) ? ((stats.bytesread * 1000LL) / stats.elapsed.count()) / 1024LL : 0LL;
+
+	log_notice(function, ": stream statistics: ", stats.bytesread, " bytes read in ", stats.elapsed.count(), "ms (", kibps, " KiB/s), ", stats.bitrate, " bps, ", 
+		stats.restarts, " restarts, ", stats.segments, " segments, ", stats.stalled.count(), "ms stalled, ", stats.paused.count(), "ms paused");
+}
+
+// lowspeedtime_enum_to_seconds
+//
+// Converts the HTTP stalled transfer timeout enumeration values into a number of seconds
+static int lowspeedtime_enum_to_seconds(int nvalue)
+{
+	switch(nvalue) {
+
+		case 0: return 0;			// None
+		case 1: return 10;			// 10 seconds
+		case 2: return 30;			// 30 seconds
+		case 3: return 60;			// 1 minute
+	};
+
+	return 30;						// 30 seconds = default
+}
+
+// metric_to_string
+//
+// Converts a metric snapshot into a descriptive string
+static std::string metric_to_string(struct metric const& metric)
+{
+	std::ostringstream stream;
+
+	stream << metric.name << ": ";
+	if(metric.type == metric_type::counter) { stream << metric.count; return stream.str(); }
+
+	// Duration metrics are recorded in microseconds, report them in milliseconds
+	char const* units = (metric.type == metric_type::duration) ? "ms" : "";
+	double scale = (metric.type == metric_type::duration) ? 1000.0 : 1.0;
+	double mean = (metric.count > 0) ? (static_cast<double>(metric.total) / metric.count) : 0.0;
+
+	stream.setf(std::ios::fixed);
+	stream.precision((metric.type == metric_type::duration) ? 3 : 1);
+	stream << "count=" << metric.count << ", mean=" << (mean / scale) << units << ", min=" << (metric.minimum / scale) << units << 
+		", p50=" << (metric.p50 / scale) << units << ", p90=" << (metric.p90 / scale) << units << ", p99=" << (metric.p99 / scale) << units << 
+		", max=" << (metric.maximum / scale) << units;
+
+	return stream.str();
+}
+
+// metrics_log_enum_to_seconds
+//
+// Converts the metrics log interval enumeration values into a number of seconds
+static int metrics_log_enum_to_seconds(int nvalue)
+{
+	switch(nvalue) {
+
+		case 0: return 0;			// Never
+		case 1: return 300;			// 5 minutes
+		case 2: return 600;			// 10 minutes
+		case 3: return 900;			// 15 minutes
+		case 4: return 3600;		// 1 hour
+	};
+
+	return 0;						// Never = default
+}
+
+// log_metrics_task
+//
+// Scheduled task implementation to write the performance metrics to the log
+static void log_metrics_task(scalar_condition<bool> const& /*cancel*/)
+{
+	char const*				function = __func__;		// Function name for the log entries
+
+	// Create a copy of the current addon settings structure
+	struct addon_settings settings = copy_settings();
+
+	try { 
+		
+		enumerate_metrics([&](struct metric const& metric) -> void { log_notice(function, ": ", metric_to_string(metric).c_str()); }); 
+		log_memory_usage(function);
+	}
+
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
+	catch(...) { handle_generalexception(__func__); }
+
+	// Schedule the next periodic invocation of this task unless it has been disabled
+	if(settings.metrics_log_interval > 0) g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.metrics_log_interval), log_metrics_task);
+}
+
 // edltype_to_string
 //
 // Converts a PVR_EDL_TYPE enumeration value into a string
@@ -1077,6 +1738,319 @@ static char const* const edltype_to_string(PVR_EDL_TYPE const& type)
 	return "<UNKNOWN>";
 }
 
+// select_stream_url
+//
+// Selects the URL to stream a live channel from, either a storage engine or a tuner
+static std::string select_stream_url(sqlite3* instance, struct addon_settings const& settings, union channelid channelid, char const* channelstr)
+{
+	std::string			streamurl;				// Generated stream URL
+
+	// Generate a log message for tuner-direct channels indicating that the storage engine will not be used;
+	// streamurl will be left as a zero-length string triggering the tuner-direct action below
+	if(get_tuner_direct_channel_flag(instance, channelid))
+		log_notice(__func__, ": channel ", channelstr, " is flagged as tuner-direct only; an available storage engine will not be used for this stream");
+
+	// If direct tuning is disabled, first attempt to generate the stream URL for the specified 
+	// channel from the storage engine; if that fails we can fall back to using a tuner directly
+	else if(settings.use_direct_tuning == false) {
+		
+		streamurl = get_stream_url(instance, channelid);
+		if(streamurl.length() == 0) log_notice(__func__, ": unable to generate storage engine stream URL for channel ", 
+			channelstr, " - falling back to a tuner-direct stream");
+	}
+
+	// In direct-tuning mode or upon a failure to generate the stream URL for the storage engine
+	// a tuner device must be instead be selected to stream the content
+	if((settings.use_direct_tuning == true) || (streamurl.length() == 0)) {
+
+		// The available tuners for the channel are captured into a vector<>
+		std::vector<std::string> tuners;
+
+		// Create a collection of all the tuners that can possibly stream the requested channel
+		enumerate_channeltuners(instance, channelid, [&](char const* item) -> void { tuners.emplace_back(item); });
+		if(tuners.size() == 0) throw string_exception("unable to find any possible tuners for channel ", channelstr);
+	
+		// Select an available tuner from the possibilities and generate the stream URL
+		std::string selected = g_tuners.select(tuners);
+		streamurl = get_tuner_stream_url(instance, selected.c_str(), channelid);
+	}
+
+	return streamurl;
+}
+
+// prebuffer_channels_task
+//
+// Scheduled task implementation to pre-buffer the channels adjacent to the live channel
+static void prebuffer_channels_task(scalar_condition<bool> const& cancel)
+{
+	std::vector<union channelid>			channelids;		// Ordered channel identifiers
+	std::vector<std::string>				tuners;			// All known tuners
+	std::vector<union channelid>			adjacent;		// Channels to be pre-buffered
+	std::vector<std::unique_ptr<dvrstream>>	discarded;		// Streams no longer required
+
+	// Create a copy of the current addon settings structure
+	struct addon_settings settings = copy_settings();
+
+	// Pre-buffered streams always use the standard ring buffer, do not use them with timeshift enabled
+	if((!settings.enable_channel_prebuffering) || (settings.enable_live_timeshift)) return;
+
+	try {
+
+		unsigned int target = g_prebuffertarget;
+
+		// Pull a database connection out from the connection pool
+		connectionpool::handle dbhandle(g_connpool);
+
+		// Only tuners that are currently unlocked can be used, the live channel already holds one of them.  The tuners
+		// held by the existing pre-buffered streams can be reused, but always leave one spare for other clients and recordings
+		enumerate_tuners(dbhandle, [&](char const* tuner) -> void { tuners.emplace_back(tuner); });
+		size_t unlocked = g_tuners.available(tuners);
+
+		{
+			std::unique_lock<std::mutex> lock(g_prebuffered_lock);
+			unlocked += static_cast<size_t>(std::count_if(g_prebuffered.begin(), g_prebuffered.end(), 
+				[](std::pair<unsigned int const, struct prebuffered_stream> const& item) -> bool { return static_cast<bool>(item.second.stream); }));
+		}
+
+		size_t maxstreams = (unlocked > 1) ? std::min(unlocked - 1, static_cast<size_t>(2)) : 0;
+
+		// Generate the list of channels ordered by channel number; DRM channels cannot be streamed
+		enumerate_channels(dbhandle, false, false, [&](struct channel const& item) -> void { if(!item.drm) channelids.push_back(item.channelid); });
+		std::sort(channelids.begin(), channelids.end(), [](union channelid const& lhs, union channelid const& rhs) -> bool { return lhs.value < rhs.value; });
+
+		// Select the next channel up and, if there is capacity, the next channel down from the target
+		auto found = std::find_if(channelids.begin(), channelids.end(), [&](union channelid const& item) -> bool { return item.value == target; });
+		if((found != channelids.end()) && (channelids.size() > 1)) {
+
+			size_t index = static_cast<size_t>(found - channelids.begin());
+			if(maxstreams >= 1) adjacent.push_back(channelids[(index + 1) % channelids.size()]);
+			if((maxstreams >= 2) && (channelids.size() > 2)) adjacent.push_back(channelids[(index + channelids.size() - 1) % channelids.size()]);
+		}
+
+		// Discard any pre-buffered streams that are not adjacent to the target channel
+		{
+			std::unique_lock<std::mutex> lock(g_prebuffered_lock);
+
+			for(auto iterator = g_prebuffered.begin(); iterator != g_prebuffered.end();) {
+
+				bool keep = std::any_of(adjacent.begin(), adjacent.end(), [&](union channelid const& item) -> bool { return item.value == iterator->first; });
+				if(keep && iterator->second.stream) { ++iterator; continue; }
+
+				if(iterator->second.stream) discarded.push_back(std::move(iterator->second.stream));
+				iterator = g_prebuffered.erase(iterator);
+			}
+		}
+
+		for(auto const& iterator : discarded) { try { iterator->close(); } catch(...) {} }
+		discarded.clear();
+
+		// Open a stream for each adjacent channel that does not already have one
+		for(auto const& channelid : adjacent) {
+
+			// Stop if the task has been cancelled or the live channel has changed again; the task will
+			// be executed again for the new target channel
+			if((cancel.test(true)) || (g_prebuffertarget != target)) break;
+
+			{
+				std::unique_lock<std::mutex> lock(g_prebuffered_lock);
+				if(g_prebuffered.find(channelid.value) != g_prebuffered.end()) continue;
+			}
+
+			char channelstr[64];			// Channel number as a string
+			if(channelid.parts.subchannel == 0) snprintf(channelstr, std::extent<decltype(channelstr)>::value, "%d", channelid.parts.channel);
+			else snprintf(channelstr, std::extent<decltype(channelstr)>::value, "%d.%d", channelid.parts.channel, channelid.parts.subchannel);
+
+			try {
+
+				std::string streamurl = select_stream_url(dbhandle, settings, channelid, channelstr);
+				if(streamurl.length() == 0) throw string_exception("unable to generate a valid stream URL for channel ", channelstr);
+
+				log_notice(__func__, ": pre-buffering channel ", channelstr, " via url ", streamurl.c_str());
+
+				struct prebuffered_stream item;
+				item.stream = dvrstream::create(streamurl.c_str(), stream_buffer_size(settings, channelid.value), settings.stream_read_chunk_size, get_http_share());
+				item.created = std::chrono::steady_clock::now();
+
+				std::unique_lock<std::mutex> lock(g_prebuffered_lock);
+				g_prebuffered.emplace(channelid.value, std::move(item));
+			}
+
+			catch(std::exception& ex) { handle_stdexception(__func__, ex); }
+			catch(...) { handle_generalexception(__func__); }
+		}
+
+		// Schedule the pre-buffered streams to be closed if they aren't used
+		g_prebufferscheduler.remove(expire_prebuffered_task);
+		g_prebufferscheduler.add(std::chrono::system_clock::now() + g_prebufferlifetime, expire_prebuffered_task);
+	}
+
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
+	catch(...) { handle_generalexception(__func__); }
+}
+
+// probe_hosts_task
+//
+// Scheduled task implementation to probe the hosts that have been marked as unavailable
+static void probe_hosts_task(scalar_condition<bool> const& /*cancel*/)
+{
+	// Requests to a host that has an open circuit fail immediately, this is the only way they get reset
+	try { if(probe_http_hosts()) log_notice(__func__, ": one or more hosts remain unavailable"); }
+	catch(std::exception& ex) { handle_stdexception(__func__, ex); }
+	catch(...) { handle_generalexception(__func__); }
+
+	// Schedule the next periodic invocation of this task
+	g_scheduler.add(std::chrono::system_clock::now() + g_hostprobeinterval, probe_hosts_task);
+}
+
+// read_edl_file
+//
+// Reads the unadjusted entries from an edit decision list file
+static void read_edl_file(char const* filename, std::vector<struct edl_entry>& entries)
+{
+	entries.clear();
+
+	// 2 KiB should be more than sufficient to hold a single line from the .edl file
+	std::unique_ptr<char[]> line(new char[2 KiB]);
+
+	// Attempt to open the input edit decision list file
+	void* handle = g_addon->OpenFile(filename, 0);
+	if(handle == nullptr) { log_error(__func__, ": unable to open edit decision list file: ", filename); return; }
+
+	size_t linenumber = 0;
+	log_debug(__func__, ": processing edit decision list file: ", filename);
+
+	// Process each line of the file individually
+	while(g_addon->ReadFileString(handle, &line[0], 2 KiB)) {
+
+		++linenumber;									// Increment the line number
+
+		struct edl_entry entry = { 0.0F, 0.0F, PVR_EDL_TYPE_CUT };
+
+		// The only currently supported format for EDL is the {float|float|[int]} format, as the
+		// frame rate of the recording would be required to process the {#frame|#frame|[int]} format
+		if(sscanf(&line[0], "%f %f %i", &entry.start, &entry.end, &entry.type) >= 2) entries.push_back(entry);
+		else log_error(__func__, ": invalid edit decision list entry detected at line #", linenumber, " of ", filename);
+	}
+				
+	g_addon->CloseFile(handle);
+}
+
+// readaheadsize_enum_to_bytes
+//
+// Converts the recorded stream read-ahead size enumeration values into a number of bytes
+static int readaheadsize_enum_to_bytes(int nvalue)
+{
+	switch(nvalue) {
+
+		case 0: return 0;			// Disabled
+		case 1: return (8 MiB);		// 8 Megabytes
+		case 2: return (16 MiB);	// 16 Megabytes
+		case 3: return (32 MiB);	// 32 Megabytes
+		case 4: return (64 MiB);	// 64 Megabytes
+	};
+
+	return 0;						// Disabled = default
+}
+
+// refresh_recordings_snapshot
+//
+// Generates and publishes a new recordings snapshot from the database
+static std::shared_ptr<std::vector<PVR_RECORDING> const> refresh_recordings_snapshot(sqlite3* instance, struct addon_settings const& settings)
+{
+	unsigned long long generation;				// Generation of the new snapshot
+
+	// Supersede the existing snapshot, it continues to be used until the new one is published.  If it gets
+	// invalidated again before the new one has been generated, the new one is stale and won't be published
+	{
+		std::unique_lock<std::mutex> lock(g_recordings_lock);
+		generation = ++g_recordings_generation;
+	}
+
+	// Collect all of the PVR_RECORDING structures into the new snapshot
+	std::shared_ptr<std::vector<PVR_RECORDING>> recordings = std::make_shared<std::vector<PVR_RECORDING>>();
+
+	try {
+
+		// Enumerate all of the recordings in the database
+		enumerate_recordings(instance, settings.use_episode_number_as_title, [&](struct recording const& item) -> void {
+
+			PVR_RECORDING recording;							// PVR_RECORDING to be transferred to Kodi
+			memset(&recording, 0, sizeof(PVR_RECORDING));		// Initialize the structure
+
+			// strRecordingId (required)
+			if(item.recordingid == nullptr) return;
+			snprintf(recording.strRecordingId, std::extent<decltype(recording.strRecordingId)>::value, "%s", item.recordingid);
+		
+			// strTitle (required)
+			if(item.title == nullptr) return;
+			snprintf(recording.strTitle, std::extent<decltype(recording.strTitle)>::value, "%s", item.title);
+
+			// strEpisodeName
+			if(item.episodename != nullptr) snprintf(recording.strEpisodeName, std::extent<decltype(recording.strEpisodeName)>::value, "%s", item.episodename);
+
+			// iSeriesNumber
+			recording.iSeriesNumber = item.seriesnumber;
+		 
+			// iEpisodeNumber
+			recording.iEpisodeNumber = item.episodenumber;
+
+			// iYear
+			recording.iYear = item.year;
+
+			// strDirectory
+			if(item.directory != nullptr) {
+			
+				// Special case: "movie" --> #30402
+				if(strcasecmp(item.directory, "movie") == 0) 
+					snprintf(recording.strDirectory, std::extent<decltype(recording.strDirectory)>::value, "%s", g_addon->GetLocalizedString(30402));
+
+				// Special case: "sport" --> #30403
+				else if(strcasecmp(item.directory, "sport") == 0)
+					snprintf(recording.strDirectory, std::extent<decltype(recording.strDirectory)>::value, "%s", g_addon->GetLocalizedString(30403));
+
+				else snprintf(recording.strDirectory, std::extent<decltype(recording.strDirectory)>::value, "%s", item.directory);
+			}
+
+			// strPlot
+			if(item.plot != nullptr) snprintf(recording.strPlot, std::extent<decltype(recording.strPlot)>::value, "%s", item.plot);
+
+			// strChannelName
+			if(item.channelname != nullptr) snprintf(recording.strChannelName, std::extent<decltype(recording.strChannelName)>::value, "%s", item.channelname);
+
+			// strThumbnailPath
+			if(item.thumbnailpath != nullptr) snprintf(recording.strThumbnailPath, std::extent<decltype(recording.strThumbnailPath)>::value, "%s", item.thumbnailpath);
+
+			// recordingTime
+			recording.recordingTime = item.recordingtime;
+
+			// iDuration
+			recording.iDuration = item.duration;
+
+			// iLastPlayedPosition
+			//
+			recording.iLastPlayedPosition = item.lastposition;
+
+			// iChannelUid
+			recording.iChannelUid = item.channelid.value;
+
+			// channelType
+			recording.channelType = PVR_RECORDING_CHANNEL_TYPE_TV;
+
+			// Copy the PVR_RECORDING structure into the local vector<>
+			recordings->push_back(recording);
+		});
+	}
+
+	// Don't leave the superseded snapshot in place if the new one could not be generated
+	catch(...) { invalidate_recordings_snapshot(); throw; }
+
+	// Publish the new snapshot if nothing has invalidated it in the meantime
+	std::unique_lock<std::mutex> lock(g_recordings_lock);
+	if(generation == g_recordings_generation) g_recordings = recordings;
+
+	return recordings;
+}
+
 // ringbuffersize_enum_to_bytes
 //
 // Converts the ring buffer size enumeration values into a number of bytes
@@ -1089,11 +2063,76 @@ static int ringbuffersize_enum_to_bytes(int nvalue)
 		case 2: return (4 MiB);		// 4 Megabytes
 		case 3: return (8 MiB);		// 8 Megabytes
 		case 4: return (16 MiB);	// 16 Megabytes
+		case 5: return 0;			// Automatic
 	};
 
 	return (4 MiB);					// 4 Megabytes = default
 }
 
+// stat_edl_file
+//
+// Gets the size and modification time of an edit decision list file, returns false if it doesn't exist
+static bool stat_edl_file(char const* filename, int64_t& size, int64_t& mtime)
+{
+	struct __stat64 info;
+	memset(&info, 0, sizeof(info));
+
+	if(g_addon->StatFile(filename, &info) != 0) return false;
+
+	size = static_cast<int64_t>(info.st_size);
+	mtime = static_cast<int64_t>(info.st_mtime);
+
+	return true;
+}
+
+// stream_buffer_size
+//
+// Determines the ring buffer size for a stream; when sized automatically the last bitrate
+// measured for the channel is used to hold g_ringbufferduration worth of the stream
+static size_t stream_buffer_size(struct addon_settings const& settings, unsigned int channelid)
+{
+	if(settings.stream_ring_buffer_size > 0) return static_cast<size_t>(settings.stream_ring_buffer_size);
+
+	long long bitrate = g_defaultbitrate;
+	{
+		std::unique_lock<std::mutex> lock(g_bitrates_lock);
+
+		auto found = g_bitrates.find(channelid);
+		if(found != g_bitrates.end()) bitrate = found->second;
+	}
+
+	// Limit the automatically sized ring buffer to the range of the fixed ring buffer sizes, or to
+	// the smaller maximum size when the low-memory profile is enabled
+	long long buffersize = (bitrate / 8) * g_ringbufferduration.count();
+	long long maxsize = (settings.enable_low_memory_profile) ? g_lowmemory_maxbuffersize : (16LL MiB);
+	return static_cast<size_t>(std::min(std::max(buffersize, (1LL MiB)), maxsize));
+}
+
+// timeshiftsize_enum_to_bytes
+//
+// Converts the timeshift buffer size enumeration values into a number of bytes
+static long long timeshiftsize_enum_to_bytes(int nvalue)
+{
+	switch(nvalue) {
+
+		case 0: return (256LL MiB);		// 256 Megabytes
+		case 1: return (512LL MiB);		// 512 Megabytes
+		case 2: return (1LL GiB);		// 1 Gigabyte
+		case 3: return (2LL GiB);		// 2 Gigabytes
+		case 4: return (4LL GiB);		// 4 Gigabytes
+	};
+
+	return (512LL MiB);					// 512 Megabytes = default
+}
+
+// trim_buffers_task
+//
+// Scheduled task implementation to release the pooled ring buffers that were not reused by another stream
+static void trim_buffers_task(scalar_condition<bool> const& /*cancel*/)
+{
+	dvrstream::trim_buffers();
+}
+
 // try_getepgforchannel
 //
 // Request the EPG for a channel from the backend
@@ -1107,9 +2146,8 @@ static bool try_getepgforchannel(ADDON_HANDLE handle, PVR_CHANNEL const& channel
 	channelid.value = channel.iUniqueId;
 
 	//
-	// NOTE: This does not cache all of the enumerated guide data locally before
-	// transferring it over to Kodi, it's done realtime to reduce the heap footprint
-	// and allow Kodi to process the entries as they are generated
+	// NOTE: The guide entries are loaded into the database in the background by the
+	// guide discovery task; this is only a local query against the stored entries
 	//
 
 	try {
@@ -1213,6 +2251,10 @@ ADDON_STATUS ADDON_Create(void* handle, void* props)
 
 	if((handle == nullptr) || (props == nullptr)) return ADDON_STATUS::ADDON_STATUS_PERMANENT_FAILURE;
 
+	// Record the startup time to measure how long it takes for the channels to become visible
+	g_startuptime = std::chrono::steady_clock::now();
+	g_channelsvisible = false;
+
 	// Copy anything relevant from the provided parameters
 	PVR_PROPERTIES* pvrprops = reinterpret_cast<PVR_PROPERTIES*>(props);
 	g_epgmaxtime = pvrprops->iEpgMaxDays;
@@ -1251,6 +2293,8 @@ ADDON_STATUS ADDON_Create(void* handle, void* props)
 				log_notice(__func__, ": user data directory ", pvrprops->strUserPath, " created");
 			}
 
+			g_userpath.assign(pvrprops->strUserPath);
+
 			// Load the general settings
 			if(g_addon->GetSetting("pause_discovery_while_streaming", &bvalue)) g_settings.pause_discovery_while_streaming = bvalue;
 			if(g_addon->GetSetting("prepend_channel_numbers", &bvalue)) g_settings.prepend_channel_numbers = bvalue;
@@ -1275,10 +2319,20 @@ ADDON_STATUS ADDON_Create(void* handle, void* props)
 			if(g_addon->GetSetting("startup_discovery_task_delay", &nvalue)) g_settings.startup_discovery_task_delay = nvalue;
 			if(g_addon->GetSetting("stream_read_chunk_size", &nvalue)) g_settings.stream_read_chunk_size = chunksize_enum_to_bytes(nvalue);
 			if(g_addon->GetSetting("stream_ring_buffer_size", &nvalue)) g_settings.stream_ring_buffer_size = ringbuffersize_enum_to_bytes(nvalue);
+			if(g_addon->GetSetting("enable_live_timeshift", &bvalue)) g_settings.enable_live_timeshift = bvalue;
+			if(g_addon->GetSetting("timeshift_buffer_folder", strvalue)) g_settings.timeshift_buffer_folder.assign(strvalue);
+			if(g_addon->GetSetting("timeshift_buffer_size", &nvalue)) g_settings.timeshift_buffer_size = timeshiftsize_enum_to_bytes(nvalue);
 			if(g_addon->GetSetting("enable_recording_edl", &bvalue)) g_settings.enable_recording_edl = bvalue;
 			if(g_addon->GetSetting("recording_edl_folder", strvalue)) g_settings.recording_edl_folder.assign(strvalue);
 			if(g_addon->GetSetting("recording_edl_start_padding", &nvalue)) g_settings.recording_edl_start_padding = nvalue;
 			if(g_addon->GetSetting("recording_edl_end_padding", &nvalue)) g_settings.recording_edl_end_padding = nvalue;
+			if(g_addon->GetSetting("metrics_log_interval", &nvalue)) g_settings.metrics_log_interval = metrics_log_enum_to_seconds(nvalue);
+			if(g_addon->GetSetting("enable_channel_prebuffering", &bvalue)) g_settings.enable_channel_prebuffering = bvalue;
+			if(g_addon->GetSetting("recording_readahead_size", &nvalue)) g_settings.recording_readahead_size = readaheadsize_enum_to_bytes(nvalue);
+			if(g_addon->GetSetting("enable_low_memory_profile", &bvalue)) g_settings.enable_low_memory_profile = bvalue;
+			if(g_addon->GetSetting("http_request_timeout", &nvalue)) g_settings.http_request_timeout = httptimeout_enum_to_seconds(nvalue);
+			if(g_addon->GetSetting("http_lowspeed_timeout", &nvalue)) g_settings.http_lowspeed_timeout = lowspeedtime_enum_to_seconds(nvalue);
+			if(g_addon->GetSetting("http_request_concurrency", &nvalue)) g_settings.http_request_concurrency = nvalue;
 
 			// Create the global guicallbacks instance
 			g_gui.reset(new CHelper_libKODI_guilib());
@@ -1316,6 +2370,14 @@ ADDON_STATUS ADDON_Create(void* handle, void* props)
 					menuhook.category = PVR_MENUHOOK_SETTING;
 					g_pvr->AddMenuHook(&menuhook);
 
+					// MENUHOOK_SETTING_SHOWMETRICS
+					//
+					memset(&menuhook, 0, sizeof(PVR_MENUHOOK));
+					menuhook.iHookId = MENUHOOK_SETTING_SHOWMETRICS;
+					menuhook.iLocalizedStringId = 30313;
+					menuhook.category = PVR_MENUHOOK_SETTING;
+					g_pvr->AddMenuHook(&menuhook);
+
 					// MENUHOOK_SETTING_TRIGGERDEVICEDISCOVERY
 					//
 					memset(&menuhook, 0, sizeof(PVR_MENUHOOK));
@@ -1388,9 +2450,28 @@ ADDON_STATUS ADDON_Create(void* handle, void* props)
 					menuhook.category = PVR_MENUHOOK_CHANNEL;
 					g_pvr->AddMenuHook(&menuhook);
 
-					// Create the global database connection pool instance, the file name is based on the versionb
+					// Apply the timeouts and the concurrency limit for the HTTP requests generated by the database layer
+					set_http_request_timeouts(g_settings.http_request_timeout, g_settings.http_lowspeed_timeout);
+					set_http_request_concurrency(g_settings.http_request_concurrency);
+
+					// The low-memory profile limits the SQLite heap, shrinks the per-connection page cache and disables
+					// memory-mapped I/O; this has to be done before any of the database connections are opened.  Released
+					// stream ring buffers are also freed immediately rather than being retained for the next stream
+					if(g_settings.enable_low_memory_profile) {
+
+						set_database_memory_limits(g_lowmemory_heaplimit, g_lowmemory_cachesize, 0);
+						dvrstream::set_buffer_pooling(false);
+						log_notice(__func__, ": low-memory profile enabled: sqlite heap limit = ", g_lowmemory_heaplimit, " bytes, page cache = ", 
+							g_lowmemory_cachesize, " KiB per connection");
+					}
+
+					// Create the global database connection pool instance, the file name is based on the versionb.  The pool
+					// uses the default size and acquire timeout, and a few connections are opened up front to cover the startup
+					// discovery task and Kodi's initial channel/EPG/recording requests.  The low-memory profile uses a smaller pool
 					std::string databasefile = "file:///" + std::string(pvrprops->strUserPath) + "/hdhomerundvr-v" + VERSION_VERSION2_ANSI + ".db";
-					g_connpool = std::make_shared<connectionpool>(databasefile.c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI);
+					g_connpool = std::make_shared<connectionpool>(databasefile.c_str(), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, 
+						(g_settings.enable_low_memory_profile) ? g_lowmemory_poolsize : connectionpool::DEFAULT_POOL_SIZE, 
+						(g_settings.enable_low_memory_profile) ? g_lowmemory_warmcount : g_connpool_warmcount, connectionpool::DEFAULT_TIMEOUT);
 
 					try {
 
@@ -1399,11 +2480,28 @@ ADDON_STATUS ADDON_Create(void* handle, void* props)
 							// Kodi currently has no means to create EPG entries in the database for channels that are
 							// added after the PVR manager has been started.  Synchronously execute a device and lineup
 							// discovery so that the initial set of channels are immediately available to Kodi
-							connectionpool::handle dbhandle(g_connpool);
+							connectionpool::writehandle dbhandle(g_connpool);
 
-							log_notice(__func__, ": initiating local network resource discovery (startup)");
-							discover_devices(dbhandle, g_settings.use_broadcast_device_discovery);
-							discover_lineups(dbhandle);
+							// If the devices were discovered recently, reuse them as-is rather than waiting on another discovery;
+							// the devices will be revalidated by the startup discovery task shortly after the PVR has started
+							int age = get_device_discovery_age(dbhandle);
+							bool cached = ((age >= 0) && (std::chrono::seconds(age) < g_devicecachelifetime));
+
+							if(cached) log_notice(__func__, ": reusing devices discovered ", age, " seconds ago (startup)");
+							else {
+
+								log_notice(__func__, ": initiating local network resource discovery (startup)");
+								discover_devices(dbhandle, g_settings.use_broadcast_device_discovery);
+							}
+
+							// When the devices were reused and channels from the previous session are available, serve those
+							// to Kodi immediately and let the startup discovery task update the lineups in the background
+							if((cached) && (get_channel_count(dbhandle, true) > 0)) log_notice(__func__, ": serving cached channel lineups (startup)");
+							else discover_lineups(dbhandle);
+
+							// Generate the recordings snapshot from the data cached by the previous session so that
+							// Kodi's initial request for recordings doesn't have to wait on the database
+							refresh_recordings_snapshot(dbhandle, g_settings);
 						}
 
 						// Failure to perform the synchronous device and lineup discovery is not fatal
@@ -1418,6 +2516,7 @@ ADDON_STATUS ADDON_Create(void* handle, void* props)
 						log_notice(__func__, ": delaying startup discovery task for ", g_settings.startup_discovery_task_delay, " seconds");					
 						g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(g_settings.startup_discovery_task_delay), discover_startup_task);
 						g_scheduler.start();
+						g_prebufferscheduler.start();
 					}
 
 					// Clean up the database connection pool on exception
@@ -1464,11 +2563,26 @@ void ADDON_Destroy(void)
 	g_dvrstream.reset();					// Destroy any active stream instance
 	g_scheduler.stop();						// Stop the task scheduler
 	g_scheduler.clear();					// Clear all tasks from the scheduler
+	g_prebufferscheduler.stop();			// Stop the pre-buffer task scheduler
+	g_prebufferscheduler.clear();			// Clear all tasks from the pre-buffer scheduler
+	discard_prebuffered_streams();			// Close any pre-buffered streams
+	log_memory_usage(__func__);				// Log the peak memory usage
+	dvrstream::trim_buffers();				// Release any pooled stream buffers
 
 	// Check for more than just the global connection pool reference during shutdown,
 	// there shouldn't still be any active callbacks running during ADDON_Destroy
 	long poolrefs = g_connpool.use_count();
 	if(poolrefs != 1) log_notice(__func__, ": warning: g_connpool.use_count = ", g_connpool.use_count());
+
+	// Log the connection pool usage counters to help with sizing the pool
+	if(g_connpool) {
+
+		struct connectionpool::counters counters = g_connpool->statistics();
+		log_notice(__func__, ": connection pool: acquires = ", counters.acquires, ", waits = ", counters.waits, ", wait time = ", counters.waittime, 
+			"ms, connections = ", counters.connections, ", high water = ", counters.highwater, ", mutations = ", counters.mutations, 
+			", coalesced = ", counters.coalesced, ", batches = ", counters.batches, ", checkpoints = ", counters.checkpoints);
+	}
+
 	g_connpool.reset();
 
 	// Destroy the PVR and GUI callback instances
@@ -1549,6 +2663,7 @@ ADDON_STATUS ADDON_SetSetting(char const* name, void const* value)
 		if(bvalue != g_settings.use_episode_number_as_title) {
 
 			g_settings.use_episode_number_as_title = bvalue;
+			invalidate_recordings_snapshot();
 			log_notice(__func__, ": setting use_episode_number_as_title changed to ", (bvalue) ? "true" : "false", " -- trigger recording update");
 			g_pvr->TriggerRecordingUpdate();
 		}
@@ -1767,6 +2882,44 @@ ADDON_STATUS ADDON_SetSetting(char const* name, void const* value)
 
 			g_settings.stream_ring_buffer_size = nvalue;
 			log_notice(__func__, ": setting stream_ring_buffer_size changed to ", nvalue, " bytes");
+
+			// A pooled ring buffer was sized for the previous setting, don't keep it allocated
+			dvrstream::trim_buffers();
+		}
+	}
+
+	// enable_live_timeshift
+	//
+	else if(strcmp(name, "enable_live_timeshift") == 0) {
+
+		bool bvalue = *reinterpret_cast<bool const*>(value);
+		if(bvalue != g_settings.enable_live_timeshift) {
+
+			g_settings.enable_live_timeshift = bvalue;
+			log_notice(__func__, ": setting enable_live_timeshift changed to ", (bvalue) ? "true" : "false");
+		}
+	}
+
+	// timeshift_buffer_folder
+	//
+	else if(strcmp(name, "timeshift_buffer_folder") == 0) {
+
+		if(strcmp(g_settings.timeshift_buffer_folder.c_str(), reinterpret_cast<char const*>(value)) != 0) {
+
+			g_settings.timeshift_buffer_folder.assign(reinterpret_cast<char const*>(value));
+			log_notice(__func__, ": setting timeshift_buffer_folder changed to ", g_settings.timeshift_buffer_folder.c_str());
+		}
+	}
+
+	// timeshift_buffer_size
+	//
+	else if(strcmp(name, "timeshift_buffer_size") == 0) {
+
+		long long llvalue = timeshiftsize_enum_to_bytes(*reinterpret_cast<int const*>(value));
+		if(llvalue != g_settings.timeshift_buffer_size) {
+
+			g_settings.timeshift_buffer_size = llvalue;
+			log_notice(__func__, ": setting timeshift_buffer_size changed to ", llvalue, " bytes");
 		}
 	}
 
@@ -1779,6 +2932,9 @@ ADDON_STATUS ADDON_SetSetting(char const* name, void const* value)
 
 			g_settings.enable_recording_edl = bvalue;
 			log_notice(__func__, ": setting enable_recording_edl changed to ", (bvalue) ? "true" : "false");
+
+			// Regenerate (or discard) the edit decision list index
+			g_scheduler.add(now, index_edl_task);
 		}
 	}
 
@@ -1790,6 +2946,9 @@ ADDON_STATUS ADDON_SetSetting(char const* name, void const* value)
 
 			g_settings.recording_edl_folder.assign(reinterpret_cast<char const*>(value));
 			log_notice(__func__, ": setting recording_edl_folder changed to ", g_settings.recording_edl_folder.c_str());
+
+			// Regenerate the edit decision list index from the new folder
+			if(g_settings.enable_recording_edl) g_scheduler.add(now, index_edl_task);
 		}
 	}
 
@@ -1817,6 +2976,101 @@ ADDON_STATUS ADDON_SetSetting(char const* name, void const* value)
 		}
 	}
 
+	// metrics_log_interval
+	//
+	else if(strcmp(name, "metrics_log_interval") == 0) {
+
+		int nvalue = metrics_log_enum_to_seconds(*reinterpret_cast<int const*>(value));
+		if(nvalue != g_settings.metrics_log_interval) {
+
+			// Reschedule the log_metrics_task to execute at the specified interval from now, or remove it
+			g_settings.metrics_log_interval = nvalue;
+			g_scheduler.remove(log_metrics_task);
+			if(nvalue > 0) g_scheduler.add(now + std::chrono::seconds(nvalue), log_metrics_task);
+			log_notice(__func__, ": setting metrics_log_interval changed to ", nvalue, " seconds");
+		}
+	}
+
+	// enable_channel_prebuffering
+	//
+	else if(strcmp(name, "enable_channel_prebuffering") == 0) {
+
+		bool bvalue = *reinterpret_cast<bool const*>(value);
+		if(bvalue != g_settings.enable_channel_prebuffering) {
+
+			g_settings.enable_channel_prebuffering = bvalue;
+			log_notice(__func__, ": setting enable_channel_prebuffering changed to ", (bvalue) ? "true" : "false");
+
+			// Release any tuners that are being held by pre-buffered streams when disabled
+			if(!bvalue) { g_prebufferscheduler.clear(); discard_prebuffered_streams(); }
+		}
+	}
+
+	// recording_readahead_size
+	//
+	else if(strcmp(name, "recording_readahead_size") == 0) {
+
+		int nvalue = readaheadsize_enum_to_bytes(*reinterpret_cast<int const*>(value));
+		if(nvalue != g_settings.recording_readahead_size) {
+
+			g_settings.recording_readahead_size = nvalue;
+			log_notice(__func__, ": setting recording_readahead_size changed to ", nvalue, " bytes");
+		}
+	}
+
+	// http_request_timeout
+	//
+	else if(strcmp(name, "http_request_timeout") == 0) {
+
+		int nvalue = httptimeout_enum_to_seconds(*reinterpret_cast<int const*>(value));
+		if(nvalue != g_settings.http_request_timeout) {
+
+			g_settings.http_request_timeout = nvalue;
+			set_http_request_timeouts(g_settings.http_request_timeout, g_settings.http_lowspeed_timeout);
+			log_notice(__func__, ": setting http_request_timeout changed to ", nvalue, " seconds");
+		}
+	}
+
+	// http_lowspeed_timeout
+	//
+	else if(strcmp(name, "http_lowspeed_timeout") == 0) {
+
+		int nvalue = lowspeedtime_enum_to_seconds(*reinterpret_cast<int const*>(value));
+		if(nvalue != g_settings.http_lowspeed_timeout) {
+
+			g_settings.http_lowspeed_timeout = nvalue;
+			set_http_request_timeouts(g_settings.http_request_timeout, g_settings.http_lowspeed_timeout);
+			log_notice(__func__, ": setting http_lowspeed_timeout changed to ", nvalue, " seconds");
+		}
+	}
+
+	// http_request_concurrency
+	//
+	else if(strcmp(name, "http_request_concurrency") == 0) {
+
+		int nvalue = *reinterpret_cast<int const*>(value);
+		if(nvalue != g_settings.http_request_concurrency) {
+
+			g_settings.http_request_concurrency = nvalue;
+			set_http_request_concurrency(nvalue);
+			log_notice(__func__, ": setting http_request_concurrency changed to ", nvalue);
+		}
+	}
+
+	// enable_low_memory_profile
+	//
+	else if(strcmp(name, "enable_low_memory_profile") == 0) {
+
+		bool bvalue = *reinterpret_cast<bool const*>(value);
+		if(bvalue != g_settings.enable_low_memory_profile) {
+
+			// The database memory limits, the connection pool size and stream buffer pooling are applied at startup
+			g_settings.enable_low_memory_profile = bvalue;
+			log_notice(__func__, ": setting enable_low_memory_profile changed to ", (bvalue) ? "true" : "false", " -- restart required");
+			return ADDON_STATUS_NEED_RESTART;
+		}
+	}
+
 	return ADDON_STATUS_OK;
 }
 
@@ -1930,10 +3184,11 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 
 		// This is a standard deletion; you need at least 2 hooks to get the menu to appear otherwise the
 		// user will only see the text "Client actions" in the context menu
-		try { delete_recording(connectionpool::handle(g_connpool), item.data.recording.strRecordingId, false); }
+		try { delete_recording(connectionpool::writehandle(g_connpool), item.data.recording.strRecordingId, false); }
 		catch(std::exception& ex) { return handle_stdexception(__func__, ex, PVR_ERROR::PVR_ERROR_FAILED); }
 		catch(...) { return handle_generalexception(__func__, PVR_ERROR::PVR_ERROR_FAILED); }
 
+		invalidate_recordings_snapshot();
 		g_pvr->TriggerRecordingUpdate();
 		return PVR_ERROR::PVR_ERROR_NO_ERROR;
 	}
@@ -1943,10 +3198,11 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 	else if((menuhook.iHookId == MENUHOOK_RECORD_DELETERERECORD) && (item.cat == PVR_MENUHOOK_RECORDING)) {
 
 		// Delete the recording with the re-record flag set to true
-		try { delete_recording(connectionpool::handle(g_connpool), item.data.recording.strRecordingId, true); }
+		try { delete_recording(connectionpool::writehandle(g_connpool), item.data.recording.strRecordingId, true); }
 		catch(std::exception& ex) { return handle_stdexception(__func__, ex, PVR_ERROR::PVR_ERROR_FAILED); }
 		catch(...) { return handle_generalexception(__func__, PVR_ERROR::PVR_ERROR_FAILED); }
 
+		invalidate_recordings_snapshot();
 		g_pvr->TriggerRecordingUpdate();
 		return PVR_ERROR::PVR_ERROR_NO_ERROR;
 	}
@@ -1973,6 +3229,28 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 		return PVR_ERROR::PVR_ERROR_NO_ERROR;
 	}
 
+	// MENUHOOK_SETTING_SHOWMETRICS
+	//
+	else if(menuhook.iHookId == MENUHOOK_SETTING_SHOWMETRICS) {
+
+		try {
+
+			// Enumerate all of the recorded performance metrics and build out the text string
+			std::string metrics;
+			enumerate_metrics([&](struct metric const& metric) -> void {
+
+				metrics.append(metric_to_string(metric) + "\r\n");
+			});
+
+			g_gui->Dialog_TextViewer("Performance Metrics", metrics.c_str());
+		}
+
+		catch(std::exception& ex) { return handle_stdexception(__func__, ex, PVR_ERROR::PVR_ERROR_FAILED); }
+		catch(...) { return handle_generalexception(__func__, PVR_ERROR::PVR_ERROR_FAILED); }
+		
+		return PVR_ERROR::PVR_ERROR_NO_ERROR;
+	}
+
 	// MENUHOOK_SETTING_TRIGGERDEVICEDISCOVERY
 	//
 	else if(menuhook.iHookId == MENUHOOK_SETTING_TRIGGERDEVICEDISCOVERY) {
@@ -1980,7 +3258,6 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 		try {
 
 			log_notice(__func__, ": scheduling device discovery task");
-			g_scheduler.remove(discover_devices_task);
 			g_scheduler.add(now, discover_devices_task);
 		}
 
@@ -1997,7 +3274,6 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 		try {
 
 			log_notice(__func__, ": scheduling lineup discovery task");
-			g_scheduler.remove(discover_lineups_task);
 			g_scheduler.add(now, discover_lineups_task);
 		}
 
@@ -2014,7 +3290,6 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 		try {
 
 			log_notice(__func__, ": scheduling guide discovery task");
-			g_scheduler.remove(discover_guide_task);
 			g_scheduler.add(now, discover_guide_task);
 		}
 
@@ -2031,7 +3306,6 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 		try {
 
 			log_notice(__func__, ": scheduling recording discovery task");
-			g_scheduler.remove(discover_recordings_task);
 			g_scheduler.add(now, discover_recordings_task);
 		}
 
@@ -2048,7 +3322,6 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 		try {
 
 			log_notice(__func__, ": scheduling recording rule discovery task");
-			g_scheduler.remove(discover_recordingrules_task);
 			g_scheduler.add(now, discover_recordingrules_task);
 		}
 
@@ -2072,7 +3345,8 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 			g_scheduler.clear();				// Clear all pending tasks
 
 			// Clear the database using an automatically scoped connection
-			clear_database(connectionpool::handle(g_connpool));
+			clear_database(connectionpool::writehandle(g_connpool));
+			invalidate_recordings_snapshot();
 
 			// Schedule a startup discovery to occur and reload the entire database from scratch;
 			// the startup task is more efficient with the callbacks to Kodi than the periodic ones
@@ -2101,7 +3375,6 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 			set_channel_visibility(connectionpool::handle(g_connpool), channelid, channel_visibility::disabled);
 		
 			log_notice(__func__, ": channel ", item.data.channel.strChannelName, " disabled; scheduling lineup discovery task");
-			g_scheduler.remove(discover_lineups_task);
 			g_scheduler.add(now, discover_lineups_task);
 		}
 
@@ -2124,7 +3397,6 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 			set_channel_visibility(connectionpool::handle(g_connpool), channelid, channel_visibility::favorite);
 		
 			log_notice(__func__, ": channel ", item.data.channel.strChannelName, " added as favorite; scheduling lineup discovery task");
-			g_scheduler.remove(discover_lineups_task);
 			g_scheduler.add(now, discover_lineups_task);
 		}
 
@@ -2143,11 +3415,10 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 			union channelid channelid;
 			channelid.value = item.data.channel.iUniqueId;
 
-			// Set the channel visibility to favorite (gray star) and kick off a lineup discovery task
+			// Set the channel visibility to enabled (gray star) and kick off a lineup discovery task
 			set_channel_visibility(connectionpool::handle(g_connpool), channelid, channel_visibility::enabled);
 		
 			log_notice(__func__, ": channel ", item.data.channel.strChannelName, " removed from favorites; scheduling lineup discovery task");
-			g_scheduler.remove(discover_lineups_task);
 			g_scheduler.add(now, discover_lineups_task);
 		}
 
@@ -2179,31 +3450,13 @@ PVR_ERROR CallMenuHook(PVR_MENUHOOK const& menuhook, PVR_MENUHOOK_DATA const& it
 
 PVR_ERROR GetEPGForChannel(ADDON_HANDLE handle, PVR_CHANNEL const& channel, time_t start, time_t end)
 {
-	bool		cancel = false;				// Unused cancellation flag for discover_devices_task
+	metric_timer timer(__func__);
 
 	if(handle == nullptr) return PVR_ERROR::PVR_ERROR_INVALID_PARAMETERS;
 
-	// Check if the EPG function has been disabled due to failure(s)
-	if(!g_epgenabled) return PVR_ERROR::PVR_ERROR_FAILED;
-
-	// Try to get the EPG data for the channel, if successful the operation is complete
-	bool result = try_getepgforchannel(handle, channel, start, end);
-	if(result == true) return PVR_ERROR::PVR_ERROR_NO_ERROR;
-
-	// If the operation failed, re-execute a device discovery in case the deviceauth code(s) are stale
-	log_notice(__func__, ": failed to retrieve EPG data for channel -- execute device discovery now");
-	g_scheduler.remove(discover_devices_task);
-	discover_devices_task(cancel);
-
-	// Try the operation again after the device discovery task has completed
-	result = try_getepgforchannel(handle, channel, start, end);
-	if(result == true) return PVR_ERROR::PVR_ERROR_NO_ERROR;
-
-	// If the operation failed a second time, temporarily disable the EPG functionality.  This flag
-	// will be cleared after the next successful device discovery completes.
-	log_error(__func__, ": Multiple failures were encountered accessing EPG data; EPG functionality is temporarily disabled");
-	g_epgenabled = false;
-	return PVR_ERROR::PVR_ERROR_FAILED;
+	// The guide entries are read from the local store, there are no backend services involved that
+	// would require a device discovery (stale deviceauth code) and retry on failure
+	return (try_getepgforchannel(handle, channel, start, end)) ? PVR_ERROR::PVR_ERROR_NO_ERROR : PVR_ERROR::PVR_ERROR_FAILED;
 }
 
 //---------------------------------------------------------------------------
@@ -2439,6 +3692,8 @@ int GetChannelsAmount(void)
 
 PVR_ERROR GetChannels(ADDON_HANDLE handle, bool radio)
 {
+	metric_timer timer(__func__);
+
 	assert(g_pvr);		
 
 	if(handle == nullptr) return PVR_ERROR::PVR_ERROR_INVALID_PARAMETERS;
@@ -2496,6 +3751,14 @@ PVR_ERROR GetChannels(ADDON_HANDLE handle, bool radio)
 
 		// Transfer the generated PVR_CHANNEL structure over to Kodi 
 		for(auto const& it : channels) g_pvr->TransferChannelEntry(handle, &it);
+
+		// Record the amount of time it took for the channels to become visible after startup
+		if((!channels.empty()) && (!g_channelsvisible.exchange(true))) {
+
+			auto elapsed = std::chrono::steady_clock::now() - g_startuptime;
+			record_metric_duration("startup.channels", elapsed);
+			log_notice(__func__, ": channels visible ", std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), "ms after startup");
+		}
 	}
 	
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex, PVR_ERROR::PVR_ERROR_FAILED); }
@@ -2573,7 +3836,7 @@ int GetRecordingsAmount(bool deleted)
 {
 	if(deleted) return 0;			// Deleted recordings aren't supported
 
-	try { return get_recording_count(connectionpool::handle(g_connpool)); }
+	try { return static_cast<int>(get_recordings_snapshot()->size()); }
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex, -1); }
 	catch(...) { return handle_generalexception(__func__, -1); }
 }
@@ -2590,6 +3853,8 @@ int GetRecordingsAmount(bool deleted)
 
 PVR_ERROR GetRecordings(ADDON_HANDLE handle, bool deleted)
 {
+	metric_timer timer(__func__);
+
 	assert(g_pvr);				
 
 	if(handle == nullptr) return PVR_ERROR::PVR_ERROR_INVALID_PARAMETERS;
@@ -2597,89 +3862,13 @@ PVR_ERROR GetRecordings(ADDON_HANDLE handle, bool deleted)
 	// The PVR doesn't support tracking deleted recordings
 	if(deleted) return PVR_ERROR::PVR_ERROR_NO_ERROR;
 
-	// Collect all of the PVR_RECORDING structures locally so that the database
-	// connection isn't open any longer than necessary
-	std::vector<PVR_RECORDING> recordings;
-
-	// Create a copy of the current addon settings structure
-	struct addon_settings settings = copy_settings();
-
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
-
-		// Enumerate all of the recordings in the database
-		enumerate_recordings(dbhandle, settings.use_episode_number_as_title, [&](struct recording const& item) -> void {
-
-			PVR_RECORDING recording;							// PVR_RECORDING to be transferred to Kodi
-			memset(&recording, 0, sizeof(PVR_RECORDING));		// Initialize the structure
-
-			// strRecordingId (required)
-			if(item.recordingid == nullptr) return;
-			snprintf(recording.strRecordingId, std::extent<decltype(recording.strRecordingId)>::value, "%s", item.recordingid);
-			
-			// strTitle (required)
-			if(item.title == nullptr) return;
-			snprintf(recording.strTitle, std::extent<decltype(recording.strTitle)>::value, "%s", item.title);
-
-			// strEpisodeName
-			if(item.episodename != nullptr) snprintf(recording.strEpisodeName, std::extent<decltype(recording.strEpisodeName)>::value, "%s", item.episodename);
-
-			// iSeriesNumber
-			recording.iSeriesNumber = item.seriesnumber;
-			 
-			// iEpisodeNumber
-			recording.iEpisodeNumber = item.episodenumber;
-
-			// iYear
-			recording.iYear = item.year;
-
-			// strDirectory
-			if(item.directory != nullptr) {
-				
-				// Special case: "movie" --> #30402
-				if(strcasecmp(item.directory, "movie") == 0) 
-					snprintf(recording.strDirectory, std::extent<decltype(recording.strDirectory)>::value, "%s", g_addon->GetLocalizedString(30402));
-
-				// Special case: "sport" --> #30403
-				else if(strcasecmp(item.directory, "sport") == 0)
-					snprintf(recording.strDirectory, std::extent<decltype(recording.strDirectory)>::value, "%s", g_addon->GetLocalizedString(30403));
-
-				else snprintf(recording.strDirectory, std::extent<decltype(recording.strDirectory)>::value, "%s", item.directory);
-			}
-
-			// strPlot
-			if(item.plot != nullptr) snprintf(recording.strPlot, std::extent<decltype(recording.strPlot)>::value, "%s", item.plot);
-
-			// strChannelName
-			if(item.channelname != nullptr) snprintf(recording.strChannelName, std::extent<decltype(recording.strChannelName)>::value, "%s", item.channelname);
-
-			// strThumbnailPath
-			if(item.thumbnailpath != nullptr) snprintf(recording.strThumbnailPath, std::extent<decltype(recording.strThumbnailPath)>::value, "%s", item.thumbnailpath);
-
-			// recordingTime
-			recording.recordingTime = item.recordingtime;
-
-			// iDuration
-			recording.iDuration = item.duration;
-
-			// iLastPlayedPosition
-			//
-			recording.iLastPlayedPosition = item.lastposition;
-
-			// iChannelUid
-			recording.iChannelUid = item.channelid.value;
-
-			// channelType
-			recording.channelType = PVR_RECORDING_CHANNEL_TYPE_TV;
-
-			// Copy the PVR_RECORDING structure into the local vector<>
-			recordings.push_back(recording);
-		});
+		// Get the current recordings snapshot, this only accesses the database if it has been invalidated
+		std::shared_ptr<std::vector<PVR_RECORDING> const> recordings = get_recordings_snapshot();
 
-		// Transfer the generated PVR_RECORDING structure over to Kodi 
-		for(auto const& it : recordings) g_pvr->TransferRecordingEntry(handle, &it);
+		// Transfer the PVR_RECORDING structures from the snapshot over to Kodi
+		for(auto const& it : *recordings) g_pvr->TransferRecordingEntry(handle, &it);
 	}
 	
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex, PVR_ERROR::PVR_ERROR_FAILED); }
@@ -2699,10 +3888,12 @@ PVR_ERROR GetRecordings(ADDON_HANDLE handle, bool deleted)
 
 PVR_ERROR DeleteRecording(PVR_RECORDING const& recording)
 {
-	try { delete_recording(connectionpool::handle(g_connpool), recording.strRecordingId, false); }
+	try { delete_recording(connectionpool::writehandle(g_connpool), recording.strRecordingId, false); }
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex, PVR_ERROR::PVR_ERROR_FAILED); }
 	catch(...) { return handle_generalexception(__func__, PVR_ERROR::PVR_ERROR_FAILED); }
 
+	invalidate_recordings_snapshot();
+
 	return PVR_ERROR::PVR_ERROR_NO_ERROR;
 }
 
@@ -2791,7 +3982,10 @@ PVR_ERROR SetRecordingLastPlayedPosition(PVR_RECORDING const& recording, int las
 {
 	try {
 		
+		// The position is written to the device before returning, the local database write is queued
 		set_recording_lastposition(connectionpool::handle(g_connpool), recording.strRecordingId, lastposition);
+		enqueue_recording_lastposition(recording.strRecordingId, lastposition);
+
 		return PVR_ERROR::PVR_ERROR_NO_ERROR;
 	}
 
@@ -2841,64 +4035,87 @@ PVR_ERROR GetRecordingEdl(PVR_RECORDING const& recording, PVR_EDL_ENTRY edl[], i
 		struct addon_settings settings = copy_settings();
 		if(!settings.enable_recording_edl) return PVR_ERROR::PVR_ERROR_NOT_IMPLEMENTED;
 
-		// Verify that the specified directory for the EDL files exists
-		if(!g_addon->DirectoryExists(settings.recording_edl_folder.c_str()))
-			throw string_exception(std::string("specified edit decision list file directory '") + settings.recording_edl_folder + "' cannot be accessed");
+		struct edl_index_entry		entry;				// Edit decision list for the recording
+		bool						found = false;		// Flag if the index contained the list
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Check the edit decision list index for the recording first; the index is generated in the background
+		// after recording discovery detects changes.  A recording known not to have a file is taken at its word
+		// until the index is regenerated, that doesn't need to access the file system or the database at all
+		{
+			std::unique_lock<std::mutex> lock(g_edlindex_lock);
+
+			auto iterator = g_edlindex.find(recording.strRecordingId);
+			if((iterator != g_edlindex.end()) && (iterator->second.folder == settings.recording_edl_folder)) {
+
+				entry = iterator->second;
+				found = true;
+			}
+		}
 
-		// Generate the base file name for the recording by combining the folder with the recording metadata
-		std::string basename = get_recording_filename(dbhandle, recording.strRecordingId);
-		if(basename.length() == 0) throw string_exception("unable to determine the base file name of the specified recording");
+		// If the index has the file, make sure that it hasn't been modified or deleted since it was read
+		if((found) && (entry.exists)) {
 
-		// Generate the full name of the .EDL file and if it exists, attempt to process it
-		std::string filename = settings.recording_edl_folder.append(basename).append(".edl");
-		if(g_addon->FileExists(filename.c_str(), false)) {
+			int64_t size = 0, mtime = 0;
+			bool exists = stat_edl_file(entry.filename.c_str(), size, mtime);
 
-			// 2 KiB should be more than sufficient to hold a single line from the .edl file
-			std::unique_ptr<char[]> line(new char[2 KiB]);
+			if((!exists) || (size != entry.size) || (mtime != entry.mtime)) {
 
-			// Attempt to open the input edit decision list file
-			void* handle = g_addon->OpenFile(filename.c_str(), 0);
-			if(handle != nullptr) {
+				entry.exists = exists;
+				entry.size = size;
+				entry.mtime = mtime;
+				entry.entries.clear();
+				if(entry.exists) read_edl_file(entry.filename.c_str(), entry.entries);
 
-				size_t linenumber = 0;
-				log_notice(__func__, ": processing edit decision list file: ", filename.c_str());
+				// Update the index with the current contents of the file
+				std::unique_lock<std::mutex> lock(g_edlindex_lock);
+				g_edlindex[recording.strRecordingId] = entry;
+			}
+		}
 
-				// Process each line of the file individually
-				while(g_addon->ReadFileString(handle, &line[0], 2 KiB)) {
+		// The recording may have been added after the index was generated, check for the file directly
+		if(!found) {
 
-					++linenumber;									// Increment the line number
+			// Verify that the specified directory for the EDL files exists
+			if(!g_addon->DirectoryExists(settings.recording_edl_folder.c_str()))
+				throw string_exception(std::string("specified edit decision list file directory '") + settings.recording_edl_folder + "' cannot be accessed");
 
-					float			start	= 0.0F;					// Starting point, in milliseconds
-					float			end		= 0.0F;					// Ending point, in milliseconds
-					int				type	= PVR_EDL_TYPE_CUT;		// Type of edit to be made
+			// Pull a database connection out from the connection pool
+			connectionpool::handle dbhandle(g_connpool);
 
-					// The only currently supported format for EDL is the {float|float|[int]} format, as the
-					// frame rate of the recording would be required to process the {#frame|#frame|[int]} format
-					if(sscanf(&line[0], "%f %f %i", &start, &end, &type) >= 2) {
+			// Generate the base file name for the recording by combining the folder with the recording metadata
+			std::string basename = get_recording_filename(dbhandle, recording.strRecordingId);
+			if(basename.length() == 0) throw string_exception("unable to determine the base file name of the specified recording");
 
-						// Apply any user-specified adjustments to the start and end times accordingly
-						start += (static_cast<float>(settings.recording_edl_start_padding) / 1000.0F);
-						end -= (static_cast<float>(settings.recording_edl_end_padding) / 1000.0F);
-						
-						// Ensure the start and end times are positive and do not overlap
-						start = std::min(std::max(start, 0.0F), std::max(end, 0.0F));
-						end = std::max(std::max(end, 0.0F), std::max(start, 0.0F));
+			// Generate the full name of the .EDL file and if it exists, attempt to process it
+			entry.folder = settings.recording_edl_folder;
+			entry.filename = settings.recording_edl_folder + basename + ".edl";
+			entry.size = entry.mtime = 0;
+			entry.exists = stat_edl_file(entry.filename.c_str(), entry.size, entry.mtime);
+			if(entry.exists) read_edl_file(entry.filename.c_str(), entry.entries);
 
-						// Log the adjusted values for the entry and add a PVR_EDL_ENTRY to the vector<>
-						log_notice(__func__, ": adding edit decision list entry (start=", start, "ms, end=", end, "ms, type=", edltype_to_string(static_cast<PVR_EDL_TYPE>(type)), ")");
-						entries.emplace_back(PVR_EDL_ENTRY{ static_cast<int64_t>(start * 1000.0F), static_cast<int64_t>(end * 1000.0F), static_cast<PVR_EDL_TYPE>(type)});
-					}
+			// Add the file to the index so that it doesn't need to be read again
+			std::unique_lock<std::mutex> lock(g_edlindex_lock);
+			g_edlindex[recording.strRecordingId] = entry;
+		}
 
-					else log_error(__func__, ": invalid edit decision list entry detected at line #", linenumber);
-				}
-				
-				g_addon->CloseFile(handle);
-			}
+		if(entry.exists) log_notice(__func__, ": applying ", entry.entries.size(), " edit decision list entries from file: ", entry.filename.c_str());
 
-			else log_error(__func__, ": unable to open edit decision list file: ", filename.c_str());
+		for(auto const& item : entry.entries) {
+
+			float start = item.start;
+			float end = item.end;
+
+			// Apply any user-specified adjustments to the start and end times accordingly
+			start += (static_cast<float>(settings.recording_edl_start_padding) / 1000.0F);
+			end -= (static_cast<float>(settings.recording_edl_end_padding) / 1000.0F);
+						
+			// Ensure the start and end times are positive and do not overlap
+			start = std::min(std::max(start, 0.0F), std::max(end, 0.0F));
+			end = std::max(std::max(end, 0.0F), std::max(start, 0.0F));
+
+			// Log the adjusted values for the entry and add a PVR_EDL_ENTRY to the vector<>
+			log_debug(__func__, ": adding edit decision list entry (start=", start, "ms, end=", end, "ms, type=", edltype_to_string(static_cast<PVR_EDL_TYPE>(item.type)), ")");
+			entries.emplace_back(PVR_EDL_ENTRY{ static_cast<int64_t>(start * 1000.0F), static_cast<int64_t>(end * 1000.0F), static_cast<PVR_EDL_TYPE>(item.type)});
 		}
 
 		// Copy the parsed entries, if any, from the vector<> into the output array
@@ -2972,6 +4189,7 @@ int GetTimersAmount(void)
 PVR_ERROR GetTimers(ADDON_HANDLE handle)
 {
 	time_t					now;			// Current date/time as seconds from epoch
+	metric_timer			timer(__func__);	// Callback execution time metric
 
 	assert(g_pvr);				
 
@@ -3122,8 +4340,8 @@ PVR_ERROR AddTimer(PVR_TIMER const& timer)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// seriesrule / epgseriesrule --> recordingrule_type::series
 		//
@@ -3246,8 +4464,8 @@ PVR_ERROR DeleteTimer(PVR_TIMER const& timer, bool /*force*/)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// datetimeonlytimer --> delete the parent rule
 		//
@@ -3298,8 +4516,8 @@ PVR_ERROR UpdateTimer(PVR_TIMER const& timer)
 
 	try {
 
-		// Pull a database connection out from the connection pool
-		connectionpool::handle dbhandle(g_connpool);
+		// Pull a read-write database connection out from the connection pool
+		connectionpool::writehandle dbhandle(g_connpool);
 
 		// seriesrule / epgseriesrule --> recordingrule_type::series
 		//
@@ -3383,38 +4601,21 @@ bool OpenLiveStream(PVR_CHANNEL const& channel)
 		// Pull a database connection out from the connection pool
 		connectionpool::handle dbhandle(g_connpool);
 
-		// Generate a log message for tuner-direct channels indicating that the storage engine will not be used;
-		// streamurl will be left as a zero-length string triggering the tuner-direct action below
-		if(get_tuner_direct_channel_flag(dbhandle, channelid))
-			log_notice(__func__, ": channel ", channelstr, " is flagged as tuner-direct only; an available storage engine will not be used for this stream");
+		// If a pre-buffered stream for the channel is available and hasn't expired, promote it to the live stream
+		std::unique_ptr<dvrstream> prebuffered;
+		{
+			std::unique_lock<std::mutex> lock(g_prebuffered_lock);
 
-		// If direct tuning is disabled, first attempt to generate the stream URL for the specified 
-		// channel from the storage engine; if that fails we can fall back to using a tuner directly
-		else if(settings.use_direct_tuning == false) {
-			
-			streamurl = get_stream_url(dbhandle, channelid);
-			if(streamurl.length() == 0) log_notice(__func__, ": unable to generate storage engine stream URL for channel ", 
-				channelstr, " - falling back to a tuner-direct stream");
+			auto found = g_prebuffered.find(channelid.value);
+			if((found != g_prebuffered.end()) && ((std::chrono::steady_clock::now() - found->second.created) < g_prebufferlifetime))
+				prebuffered = std::move(found->second.stream);
 		}
 
-		// In direct-tuning mode or upon a failure to generate the stream URL for the storage engine
-		// a tuner device must be instead be selected to stream the content
-		if((settings.use_direct_tuning == true) || (streamurl.length() == 0)) {
-
-			// The available tuners for the channel are captured into a vector<>
-			std::vector<std::string> tuners;
-
-			// Create a collection of all the tuners that can possibly stream the requested channel
-			enumerate_channeltuners(dbhandle, channelid, [&](char const* item) -> void { tuners.emplace_back(item); });
-			if(tuners.size() == 0) throw string_exception("unable to find any possible tuners for channel ", channelstr);
-		
-			// Select an available tuner from the possibilities and generate the stream URL
-			std::string selected = select_tuner(tuners);
-			streamurl = get_tuner_stream_url(dbhandle, selected.c_str(), channelid);
-		}
+		// Select the URL to stream the channel from unless a pre-buffered stream is being used
+		if(!prebuffered) streamurl = select_stream_url(dbhandle, settings, channelid, channelstr);
 
 		// If none of the above methods yielded a valid URL, we're done here
-		if(streamurl.length() == 0) throw string_exception("unable to generate a valid stream URL for channel ", channelstr);
+		if((!prebuffered) && (streamurl.length() == 0)) throw string_exception("unable to generate a valid stream URL for channel ", channelstr);
 
 		// Stop and destroy any existing stream instance before opening the new one
 		g_dvrstream.reset();
@@ -3422,14 +4623,53 @@ bool OpenLiveStream(PVR_CHANNEL const& channel)
 		// Pause the scheduler if the user wants that functionality disabled during streaming
 		if(settings.pause_discovery_while_streaming) g_scheduler.pause();
 
+		// Suspend the idle database checkpoints to keep their disk I/O away from the stream
+		g_connpool->pause_checkpoints();
+
 		try {
 
-			// Start the new channel stream using the tuning parameters currently specified by the settings
-			log_notice(__func__, ": streaming channel ", channelstr, " via url ", streamurl.c_str());
-			g_dvrstream = dvrstream::create(streamurl.c_str(), settings.stream_ring_buffer_size, settings.stream_read_chunk_size);
+			// Use the pre-buffered stream for the channel if one was available
+			if(prebuffered) {
+
+				// The ring buffer of a pre-buffered stream fills up while it's waiting to be used, drop the backlog
+				// so that the stream starts at the live position rather than where the buffer started
+				log_notice(__func__, ": streaming channel ", channelstr, " via pre-buffered stream");
+				prebuffered->discard_buffered();
+				g_dvrstream = std::move(prebuffered);
+			}
+
+			else {
+
+				// Start the new channel stream using the tuning parameters currently specified by the settings
+				log_notice(__func__, ": streaming channel ", channelstr, " via url ", streamurl.c_str());
+
+				// If the timeshift buffer is enabled, attempt to create the stream with a memory-mapped buffer file.  The
+				// size of the buffer is limited on 32-bit platforms to leave some address space for everything else
+				if(settings.enable_live_timeshift) {
+
+					std::string folder = (settings.timeshift_buffer_folder.length() > 0) ? settings.timeshift_buffer_folder : g_userpath;
+					long long maxsize = (sizeof(size_t) < sizeof(long long)) ? (1LL GiB) : settings.timeshift_buffer_size;
+					size_t buffersize = static_cast<size_t>(std::min(settings.timeshift_buffer_size, maxsize));
+
+					try { g_dvrstream = dvrstream::create(streamurl.c_str(), buffersize, settings.stream_read_chunk_size, folder.c_str(), get_http_share()); }
+					catch(std::exception& ex) { log_error(__func__, ": unable to create timeshift buffer in ", folder.c_str(), ": ", ex.what()); }
+				}
+
+				// Fall back to the standard ring buffer if the timeshift buffer is disabled or could not be created
+				if(!g_dvrstream) g_dvrstream = dvrstream::create(streamurl.c_str(), stream_buffer_size(settings, channelid.value), settings.stream_read_chunk_size, get_http_share());
+			}
 		}
 
-		catch(...) { g_scheduler.resume(); throw; }
+		catch(...) { g_connpool->resume_checkpoints(); g_scheduler.resume(); throw; }
+
+		g_livestreamchannel = channelid.value;
+
+		// Pre-buffer the channels adjacent to the live channel in the background if enabled
+		if(settings.enable_channel_prebuffering) {
+
+			g_prebuffertarget = channelid.value;
+			g_prebufferscheduler.add(std::chrono::system_clock::now(), prebuffer_channels_task);
+		}
 
 		return true;
 	}
@@ -3464,17 +4704,31 @@ void CloseLiveStream(void)
 		if(settings.discover_recordings_after_playback) {
 
 			log_notice(__func__, ": triggering periodic recording discovery");
-			g_scheduler.remove(discover_recordings_task);
 			g_scheduler.add(std::chrono::system_clock::now(), discover_recordings_task);
 		}
 			
 		// Ensure scheduler is running, may have been paused during playback
 		g_scheduler.resume();
 
+		// Resume the idle database checkpoints that were suspended during playback
+		g_connpool->resume_checkpoints();
+
 		// If the DVR stream is active, close it normally so exceptions are
 		// propagated before destroying it; destructor alone won't throw
-		if(g_dvrstream) g_dvrstream->close();
+		if(g_dvrstream) { g_dvrstream->close(); log_stream_statistics(__func__, *g_dvrstream); }
+
+		// Retain the measured bitrate of the channel to size the ring buffer the next time it's streamed
+		if((g_dvrstream) && (g_dvrstream->bitrate() > 0)) {
+
+			std::unique_lock<std::mutex> lock(g_bitrates_lock);
+			g_bitrates[g_livestreamchannel] = g_dvrstream->bitrate();
+		}
+
 		g_dvrstream.reset();
+
+		// Release the pooled ring buffer if another stream hasn't reused it by the time the task runs
+		g_scheduler.remove(trim_buffers_task);
+		g_scheduler.add(std::chrono::system_clock::now() + g_ringbufferlifetime, trim_buffers_task);
 	}
 
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex); }
@@ -3723,14 +4977,22 @@ bool OpenRecordedStream(PVR_RECORDING const& recording)
 		// Pause the scheduler if the user wants that functionality disabled during streaming
 		if(settings.pause_discovery_while_streaming) g_scheduler.pause();
 
+		// Suspend the idle database checkpoints to keep their disk I/O away from the stream
+		g_connpool->pause_checkpoints();
+
 		try {
 
 			// Start the new recording stream using the tuning parameters currently specified by the settings
 			log_notice(__func__, ": streaming recording ", recording.strTitle, " via url ", streamurl.c_str());
-			g_dvrstream = dvrstream::create(streamurl.c_str(), settings.stream_ring_buffer_size, settings.stream_read_chunk_size);
+
+			// When read-ahead is enabled the recording is requested in segments of a quarter of the read-ahead
+			// buffer size over a persistent connection; the next segment is only requested when it will fit
+			if(settings.recording_readahead_size > 0) 
+				g_dvrstream = dvrstream::create(streamurl.c_str(), settings.recording_readahead_size, settings.stream_read_chunk_size, settings.recording_readahead_size / 4, get_http_share());
+			else g_dvrstream = dvrstream::create(streamurl.c_str(), stream_buffer_size(settings, 0), settings.stream_read_chunk_size, get_http_share());
 		}
 
-		catch(...) { g_scheduler.resume(); throw; }
+		catch(...) { g_connpool->resume_checkpoints(); g_scheduler.resume(); throw; }
 
 		return true;
 	}
@@ -3765,17 +5027,23 @@ void CloseRecordedStream(void)
 		if(settings.discover_recordings_after_playback) {
 
 			log_notice(__func__, ": triggering periodic recording discovery");
-			g_scheduler.remove(discover_recordings_task);
 			g_scheduler.add(std::chrono::system_clock::now(), discover_recordings_task);
 		}
 			
 		// Ensure scheduler is running, may have been paused during playback
 		g_scheduler.resume();
 
+		// Resume the idle database checkpoints that were suspended during playback
+		g_connpool->resume_checkpoints();
+
 		// If the DVR stream is active, close it normally so exceptions are
 		// propagated before destroying it; destructor alone won't throw
-		if(g_dvrstream) g_dvrstream->close();
+		if(g_dvrstream) { g_dvrstream->close(); log_stream_statistics(__func__, *g_dvrstream); }
 		g_dvrstream.reset();
+
+		// Release the pooled ring buffer if another stream hasn't reused it by the time the task runs
+		g_scheduler.remove(trim_buffers_task);
+		g_scheduler.add(std::chrono::system_clock::now() + g_ringbufferlifetime, trim_buffers_task);
 	}
 
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex); }
@@ -3941,11 +5209,24 @@ void PauseStream(bool /*paused*/)
 //	backwards	- True to seek to keyframe BEFORE time, else AFTER
 //	startpts	- Can be updated to point to where display should start
 
-bool SeekTime(double /*time*/, bool /*backwards*/, double* startpts)
+bool SeekTime(double time, bool backwards, double* startpts)
 {
 	if(startpts == nullptr) return false;
 
-	return false;
+	try {
+
+		if(!g_dvrstream) return false;
+
+		// The stream locates the position for the time (milliseconds) from the PCRs that have been read; the
+		// resulting position is aligned to a transport stream packet and the demuxer resynchronizes from there
+		if(g_dvrstream->seektime(static_cast<long long>(time), backwards) < 0) return false;
+
+		*startpts = time * 1000.0;				// DVD_TIME_BASE is in microseconds
+		return true;
+	}
+
+	catch(std::exception& ex) { return handle_stdexception(__func__, ex, false); }
+	catch(...) { return handle_generalexception(__func__, false); }
 }
 
 //---------------------------------------------------------------------------
@@ -4028,7 +5309,13 @@ bool IsRealTimeStream(void)
 
 PVR_ERROR SetEPGTimeFrame(int days)
 {
+	if(days == g_epgmaxtime) return PVR_ERROR::PVR_ERROR_NO_ERROR;
 	g_epgmaxtime = days;
+
+	// Reschedule the guide discovery task to run now so the local guide entries cover the new time frame
+	log_notice(__func__, ": epg time frame changed -- trigger guide discovery");
+	g_scheduler.add(std::chrono::system_clock::now(), discover_guide_task);
+
 	return PVR_ERROR::PVR_ERROR_NO_ERROR;
 }
 
@@ -4050,6 +5337,10 @@ void OnSystemSleep()
 
 		g_scheduler.stop();				// Stop the scheduler
 		g_scheduler.clear();			// Clear out any pending tasks
+
+		g_prebufferscheduler.stop();	// Stop the pre-buffer scheduler
+		g_prebufferscheduler.clear();	// Clear out any pending pre-buffer tasks
+		discard_prebuffered_streams();	// Release the tuners held by pre-buffered streams
 	}
 
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex); }
@@ -4084,6 +5375,7 @@ void OnSystemWake()
 		g_scheduler.add(std::chrono::system_clock::now() + std::chrono::seconds(settings.startup_discovery_task_delay), discover_startup_task);
 	
 		g_scheduler.start();				// Restart the scheduler
+		g_prebufferscheduler.start();		// Restart the pre-buffer scheduler
 	}
 
 	catch(std::exception& ex) { return handle_stdexception(__func__, ex); }
@@ -4134,7 +5426,7 @@ PVR_ERROR GetStreamTimes(PVR_STREAM_TIMES* times)
 	// in VideoPlayer.cpp and a great deal of trial and error, setting the start and begin pts
 	// both to zero and the setting the end in microseconds seems to work acceptably for now
 	times->ptsStart = 0;
-	times->ptsBegin = 0;
+	times->ptsBegin = (static_cast<int64_t>(std::max(g_dvrstream->earliesttime() - g_dvrstream->starttime(), static_cast<time_t>(0)))) * 1000000;
 	times->ptsEnd = (static_cast<int64_t>(time(nullptr) - g_dvrstream->starttime())) * 1000000;		// <-- microseconds
 
 	return PVR_ERROR::PVR_ERROR_NO_ERROR;
@@ -23,10 +23,23 @@
 #include "stdafx.h"
 #include "scheduler.h"
 
+#include <algorithm>
+
+#include "metrics.h"
 #include "string_exception.h"
 
 #pragma warning(push, 4)
 
+// scheduler::BACKOFF_MINIMUM (static)
+//
+// Delay before the first retry of a failed recurring task
+std::chrono::seconds const scheduler::BACKOFF_MINIMUM(30);
+
+// scheduler::DEFAULT_WORKERS (static)
+//
+// Default number of worker threads
+size_t const scheduler::DEFAULT_WORKERS = 3;
+
 //---------------------------------------------------------------------------
 // scheduler Constructor
 //
@@ -34,7 +47,7 @@
 //
 //	NONE
 
-scheduler::scheduler()
+scheduler::scheduler() : m_workercount(DEFAULT_WORKERS), m_random(std::random_device{}())
 {
 }
 
@@ -45,7 +58,20 @@ scheduler::scheduler()
 //
 //	handler		- Function to invoke when an exception occurs during a task
 
-scheduler::scheduler(scheduler::exception_handler_t handler) : m_handler(handler)
+scheduler::scheduler(scheduler::exception_handler_t handler) : scheduler(handler, DEFAULT_WORKERS)
+{
+}
+
+//---------------------------------------------------------------------------
+// scheduler Constructor
+//
+// Arguments:
+//
+//	handler		- Function to invoke when an exception occurs during a task
+//	workers		- Number of worker threads to execute tasks with
+
+scheduler::scheduler(scheduler::exception_handler_t handler, size_t workers) : m_handler(handler), m_workercount((workers > 0) ? workers : 1), 
+	m_random(std::random_device{}())
 {
 }
 
@@ -69,9 +95,24 @@ scheduler::~scheduler()
 
 void scheduler::add(std::chrono::time_point<std::chrono::system_clock> due, std::function<void(scalar_condition<bool> const&)> task)
 {
+	taskkey_t key = get_task_key(task);
+
 	std::unique_lock<std::mutex> lock(m_queue_lock);
 
-	m_queue.emplace(queueitem_t{ due, task });
+	// Tasks without a key can't be coalesced, they are always added to the queue
+	if(key == nullptr) { m_queue.emplace(due, task); m_queue_changed.notify_all(); return; }
+
+	// If the task is already pending, it only needs to be moved if the new due time is earlier
+	auto found = m_pending.find(key);
+	if(found != m_pending.end()) {
+
+		if(found->second->first <= due) return;
+		m_queue.erase(found->second);
+		m_pending.erase(found);
+	}
+
+	m_pending.emplace(key, m_queue.emplace(due, task));
+	m_queue_changed.notify_all();
 }
 
 //---------------------------------------------------------------------------
@@ -87,13 +128,32 @@ void scheduler::clear(void)
 {
 	std::unique_lock<std::mutex> lock(m_queue_lock);
 
-	while(!m_queue.empty()) m_queue.pop();
+	m_queue.clear();
+	m_pending.clear();
+	m_failures.clear();
+	m_queue_changed.notify_all();
+}
+
+//---------------------------------------------------------------------------
+// scheduler::get_task_key (private, static)
+//
+// Gets the serialization key for a task
+//
+// Arguments:
+//
+//	task		- Task to get the serialization key for
+
+scheduler::taskkey_t scheduler::get_task_key(task_t const& task)
+{
+	// Tasks that don't wrap a plain function pointer have no key and are not serialized
+	taskkey_t const* target = task.target<taskkey_t>();
+	return (target != nullptr) ? *target : nullptr;
 }
 
 //---------------------------------------------------------------------------
 // scheduler::pause
 //
-// Pauses execution of tasks; does not stop the worker thread
+// Pauses execution of tasks; does not stop the worker threads
 //
 // Arguments:
 //
@@ -116,32 +176,72 @@ void scheduler::pause(void)
 
 void scheduler::remove(std::function<void(scalar_condition<bool> const&)> task)
 {
-	queue_t			newqueue;			// The new queue_t instance
+	taskkey_t key = get_task_key(task);
+
+	std::unique_lock<std::mutex> lock(m_queue_lock);
+
+	// Keyed tasks can only be pending once, look up and remove the single instance
+	if(key != nullptr) {
+
+		auto found = m_pending.find(key);
+		if(found != m_pending.end()) { m_queue.erase(found->second); m_pending.erase(found); }
+	}
 
-	// targetptr_t
-	//
-	// Type returned by std::function::target<> below
-	using targetptr_t = void(*const*)(scalar_condition<bool> const&);
+	// Tasks without a key can't be compared, remove all of them
+	else {
+
+		for(auto iterator = m_queue.begin(); iterator != m_queue.end();) {
+
+			if(get_task_key(iterator->second) == nullptr) iterator = m_queue.erase(iterator);
+			else ++iterator;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+// scheduler::reschedule
+//
+// Adds the next invocation of a recurring task to the scheduler queue
+//
+// Arguments:
+//
+//	task		- task to be executed
+//	interval	- normal interval between invocations of the task
+//	failed		- flag indicating that the current invocation of the task failed
+//	jitter		- maximum percentage to randomly adjust the interval by
+
+std::chrono::seconds scheduler::reschedule(std::function<void(scalar_condition<bool> const&)> task, std::chrono::seconds interval, bool failed, unsigned int jitter)
+{
+	std::chrono::seconds delay = interval;				// Delay before the next invocation
+	taskkey_t key = get_task_key(task);
 
 	std::unique_lock<std::mutex> lock(m_queue_lock);
 
-	// priority_queue<> doesn't actually allow elements to be removed, create
-	// a new queue with all the elements that don't have the same target
-	while(!m_queue.empty()) {
+	// Retry failed tasks with an exponential backoff, starting at BACKOFF_MINIMUM and
+	// doubling for each consecutive failure; the backoff never exceeds the normal interval
+	if(key != nullptr) {
+
+		if(failed) {
 
-		// Pull out pointers to the left-hand and right-hand std::function targets to be compared
-		targetptr_t left = m_queue.top().second.target<void(*)(scalar_condition<bool> const&)>();
-		targetptr_t right = task.target<void(*)(scalar_condition<bool> const&)>();
+			unsigned int failures = ++m_failures[key];
+			std::chrono::seconds backoff = BACKOFF_MINIMUM * (1LL << std::min(failures - 1, 16U));
+			delay = std::min(backoff, interval);
+		}
+
+		else m_failures.erase(key);
+	}
 
-		// If the current item does not match the task being removed, move it into the new queue<>
-		if((left != nullptr) && (right != nullptr) && (*left != *right)) newqueue.push(m_queue.top());
+	// Apply the jitter to the delay, this prevents recurring tasks from lining up with each other
+	if((jitter > 0) && (delay.count() > 0)) {
 
-		// Always remove the current item from the old queue<>
-		m_queue.pop();
+		long long range = (delay.count() * std::min(jitter, 100U)) / 100;
+		if(range > 0) delay += std::chrono::seconds(std::uniform_int_distribution<long long>(-range, range)(m_random));
 	}
 
-	// Swap the contents of the new and original queues
-	m_queue.swap(newqueue);
+	lock.unlock();
+
+	add(std::chrono::system_clock::now() + delay, task);
+	return delay;
 }
 
 //---------------------------------------------------------------------------
@@ -157,45 +257,17 @@ void scheduler::start(void)
 {
 	std::unique_lock<std::mutex> lock(m_worker_lock);
 
-	if(m_worker.joinable()) return;		// Already running
-	m_stop = false;						// Reset the stop signal
-
-	// Define a scalar_condition for the worker to signal when it's running
-	scalar_condition<bool> started{false};
+	if(!m_workers.empty()) return;		// Already running
 
-	// Define and launch the scheduler worker thread
-	m_worker = std::thread([&]() -> void {
+	m_stop = false;						// Reset the stop signal
 	
-		started = true;			// Indicate that the thread started
-
-		// Poll the priority queue once per 500ms to acquire a new task or
-		// break when the stop signal has been set
-		while(!m_stop.wait_until_equals(true, 500)) {
+	std::unique_lock<std::mutex> queuelock(m_queue_lock);
+	m_stopping = false;
+	queuelock.unlock();
 
-			std::unique_lock<std::mutex> lock(m_queue_lock);
-			if(m_queue.empty() || m_paused) continue;
-
-			// Check if the topmost task in the queue has become due
-			queueitem_t const& task = m_queue.top();
-			if(task.first <= std::chrono::system_clock::now()) {
-
-				// Make a copy of the functor and remove the task from the queue
-				auto functor = task.second;
-				m_queue.pop();
-
-				// Allow other threads to manipulate the queue while the task runs
-				lock.unlock();
-
-				// Invoke the task and dispatch any exceptions that leak out to the handler
-				try { functor(m_stop); }
-				catch(std::exception& ex) { if(m_handler) m_handler(ex); }
-				catch(...) { if(m_handler) m_handler(string_exception("unhandled exception during task execution")); }
-			}
-		}
-	});
-
-	// Wait for the worker thread to start or die trying
-	started.wait_until_equals(true);
+	// Launch the worker threads
+	try { for(size_t index = 0; index < m_workercount; index++) m_workers.emplace_back(&scheduler::worker, this); }
+	catch(...) { lock.unlock(); stop(); throw; }
 }
 
 //---------------------------------------------------------------------------
@@ -210,7 +282,9 @@ void scheduler::start(void)
 void scheduler::resume(void)
 {
 	std::unique_lock<std::mutex> lock(m_queue_lock);
+
 	m_paused = false;
+	m_queue_changed.notify_all();
 }
 
 //---------------------------------------------------------------------------
@@ -226,11 +300,76 @@ void scheduler::stop(void)
 {
 	std::unique_lock<std::mutex> lock(m_worker_lock);
 
-	if(!m_worker.joinable()) return;		// Already stopped
+	if(m_workers.empty()) return;		// Already stopped
 
-	// Signal the worker thread to stop and wait for it to do so
+	// Signal any running tasks to cancel and the worker threads to stop
 	m_stop = true;
-	if(m_worker.joinable()) m_worker.join();
+
+	std::unique_lock<std::mutex> queuelock(m_queue_lock);
+	m_stopping = true;
+	m_queue_changed.notify_all();
+	queuelock.unlock();
+
+	// Wait for all of the worker threads to stop
+	for(auto& iterator : m_workers) if(iterator.joinable()) iterator.join();
+	m_workers.clear();
+}
+
+//---------------------------------------------------------------------------
+// scheduler::worker (private)
+//
+// Worker thread entry point
+//
+// Arguments:
+//
+//	NONE
+
+void scheduler::worker(void)
+{
+	std::unique_lock<std::mutex> lock(m_queue_lock);
+
+	while(!m_stopping) {
+
+		auto now = std::chrono::system_clock::now();
+		auto next = m_queue.end();
+
+		// Find the earliest task that isn't already being executed by another worker thread;
+		// if it's not due yet wait until it is, or until the queue has been changed
+		if(!m_paused) {
+
+			next = std::find_if(m_queue.begin(), m_queue.end(), [&](queue_t::value_type const& item) -> bool {
+
+				taskkey_t key = get_task_key(item.second);
+				return (key == nullptr) || (m_running.find(key) == m_running.end());
+			});
+		}
+
+		if(next == m_queue.end()) { m_queue_changed.wait(lock); continue; }
+		if(next->first > now) { m_queue_changed.wait_until(lock, next->first); continue; }
+
+		// Record how long the task waited in the queue beyond its due time
+		record_metric_duration("scheduler.delay", std::chrono::duration_cast<std::chrono::steady_clock::duration>(now - next->first));
+
+		// Make a copy of the functor and remove the task from the queue
+		task_t functor = next->second;
+		taskkey_t key = get_task_key(functor);
+		if(key != nullptr) m_pending.erase(key);
+		m_queue.erase(next);
+
+		// Mark the task as running and allow other threads to manipulate the queue while it runs
+		if(key != nullptr) m_running.insert(key);
+		lock.unlock();
+
+		// Invoke the task and dispatch any exceptions that leak out to the handler
+		try { metric_timer timer("scheduler.runtime"); functor(m_stop); }
+		catch(std::exception& ex) { if(m_handler) m_handler(ex); }
+		catch(...) { if(m_handler) m_handler(string_exception("unhandled exception during task execution")); }
+
+		// Release the task and wake up the other workers in case an instance of it was waiting
+		lock.lock();
+		if(key != nullptr) m_running.erase(key);
+		m_queue_changed.notify_all();
+	}
 }
 
 //---------------------------------------------------------------------------
@@ -25,8 +25,12 @@
 #pragma once
 
 #include <chrono>
+#include <condition_variable>
 #include <functional>
-#include <queue>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
 #include <thread>
 #include <vector>
 
@@ -37,7 +41,10 @@
 //---------------------------------------------------------------------------
 // Class scheduler
 //
-// Implements a simple task scheduler
+// Implements a simple task scheduler; tasks are executed by a pool of worker
+// threads but multiple instances of the same task never execute concurrently.
+// Tasks are keyed by their target function, only one instance of each keyed
+// task can be pending in the queue at a time
 
 class scheduler
 {
@@ -51,6 +58,7 @@ public:
 	//
 	scheduler();
 	scheduler(exception_handler_t handler);
+	scheduler(exception_handler_t handler, size_t workers);
 
 	// Destructor
 	//
@@ -61,7 +69,7 @@ public:
 
 	// add
 	//
-	// Adds a task to the scheduler queue
+	// Adds a task to the scheduler queue; if the task is already pending the earlier due time is kept
 	void add(std::chrono::time_point<std::chrono::system_clock> due, std::function<void(scalar_condition<bool> const&)> task);
 
 	// clear
@@ -79,6 +87,11 @@ public:
 	// Removes all instances of a single task from the queue
 	void remove(std::function<void(scalar_condition<bool> const&)> task);
 
+	// reschedule
+	//
+	// Adds the next invocation of a recurring task with optional jitter and failure backoff
+	std::chrono::seconds reschedule(std::function<void(scalar_condition<bool> const&)> task, std::chrono::seconds interval, bool failed, unsigned int jitter);
+
 	// resume
 	//
 	// Resumes the scheduler from a paused state
@@ -99,37 +112,66 @@ private:
 	scheduler(scheduler const&)=delete;
 	scheduler& operator=(scheduler const&)=delete;
 
-	// queueitem_t
+	// BACKOFF_MINIMUM
+	//
+	// Delay before the first retry of a failed recurring task
+	static std::chrono::seconds const BACKOFF_MINIMUM;
+
+	// DEFAULT_WORKERS
 	//
-	// queue<> element type
-	using queueitem_t = std::pair<std::chrono::time_point<std::chrono::system_clock>, std::function<void(scalar_condition<bool> const&)>>;
+	// Default number of worker threads
+	static size_t const DEFAULT_WORKERS;
 
-	// queueitem_greater_t
+	// task_t
 	//
-	// Comparator to sort queueitem_t elements in the priority queue
-	struct queueitem_greater_t
-	{
-		bool operator()(queueitem_t const& lhs, queueitem_t const& rhs) const
-		{
-			return lhs.first > rhs.first;
-		}
-	};
+	// Scheduled task function type
+	using task_t = std::function<void(scalar_condition<bool> const&)>;
+
+	// taskkey_t
+	//
+	// Identifies the type of a task for serialization; the target function pointer
+	using taskkey_t = void(*)(scalar_condition<bool> const&);
 
 	// queue_t
 	//
-	// Scheduler queue data type
-	using queue_t = std::priority_queue<queueitem_t, std::vector<queueitem_t>, queueitem_greater_t>;
+	// Scheduler queue data type, ordered by the due time of each task
+	using queue_t = std::multimap<std::chrono::time_point<std::chrono::system_clock>, task_t>;
+
+	// pending_t
+	//
+	// Index of the pending keyed tasks in the queue
+	using pending_t = std::map<taskkey_t, queue_t::iterator>;
+
+	//-----------------------------------------------------------------------
+	// Private Member Functions
+
+	// get_task_key (static)
+	//
+	// Gets the serialization key for a task
+	static taskkey_t get_task_key(task_t const& task);
+
+	// worker
+	//
+	// Worker thread entry point
+	void worker(void);
 
 	//-----------------------------------------------------------------------
 	// Member Variables
 
 	exception_handler_t	const	m_handler;				// Exception handler
+	size_t const				m_workercount;			// Number of worker threads
 	queue_t						m_queue;				// Task queue
+	pending_t					m_pending;				// Pending keyed tasks
+	std::set<taskkey_t>			m_running;				// Tasks currently executing
+	std::map<taskkey_t, unsigned int>	m_failures;		// Consecutive task failures
+	std::default_random_engine	m_random;				// Jitter random number engine
 	mutable std::mutex			m_queue_lock;			// Synchronization object
+	std::condition_variable		m_queue_changed;		// Signaled when the queue changes
 	bool						m_paused = false;		// Flag to pause the work load
-	std::thread					m_worker;				// Scheduler thread
+	bool						m_stopping = false;		// Flag to stop the worker threads
+	std::vector<std::thread>	m_workers;				// Worker threads
 	std::mutex					m_worker_lock;			// Synchronization object
-	scalar_condition<bool>		m_stop{false};			// Condition to stop the thread
+	scalar_condition<bool>		m_stop{false};			// Condition to stop the tasks
 };
 
 //-----------------------------------------------------------------------------